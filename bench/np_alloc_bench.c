@@ -0,0 +1,189 @@
+/*
+ * np_alloc_bench.c: nplib large array allocation benchmark
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures random gets from a large np_arraylist and np_hashmap with their
+ * arrays on ordinary pages, transparent huge pages and reserved huge pages.
+ * Reports nanoseconds per get and, where perf events are available, data
+ * TLB load misses per get.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "np_alloc.h"
+#include "np_arraylist.h"
+#include "np_hashmap.h"
+
+#define BENCH_ITEMS (1 << 22)
+#define BENCH_GETS (1 << 24)
+
+static uint32_t keys[BENCH_ITEMS];
+
+static uint64_t bench_nanos(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* opens a data TLB load miss counter, returning -1 if there is none */
+static int bench_tlb_open(void)
+{
+#ifdef __linux__
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof attr);
+  attr.size = sizeof attr;
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.config = PERF_COUNT_HW_CACHE_DTLB
+    | PERF_COUNT_HW_CACHE_OP_READ << 8
+    | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+  return -1;
+#endif
+}
+
+static void bench_tlb_start(int fd)
+{
+#ifdef __linux__
+  if (fd >= 0) {
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif
+}
+
+static long long bench_tlb_stop(int fd)
+{
+  long long count;
+
+  count = -1;
+#ifdef __linux__
+  if (fd >= 0) {
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &count, sizeof count) != sizeof count)
+      count = -1;
+  }
+#endif
+  return count;
+}
+
+static void bench_report(const char *name, const char *mode, uint64_t nanos,
+			 long long misses)
+{
+  if (misses < 0)
+    printf("%-10s %-12s %8.2f ns/get %12s\n", name, mode,
+	   (double)nanos / BENCH_GETS, "n/a");
+  else
+    printf("%-10s %-12s %8.2f ns/get %8.4f dTLB misses/get\n", name, mode,
+	   (double)nanos / BENCH_GETS, (double)misses / BENCH_GETS);
+}
+
+static int bench_cmp(void *key1, void *key2)
+{
+  return *(uint32_t *)key1 != *(uint32_t *)key2;
+}
+
+static unsigned bench_hash(void *key)
+{
+  return (unsigned)np_hashmap_hash64_u32(*(uint32_t *)key);
+}
+
+/* xorshift, so every run performs the same gets */
+static uint32_t bench_next(uint32_t *x)
+{
+  *x ^= *x << 13;
+  *x ^= *x >> 17;
+  *x ^= *x << 5;
+  return *x;
+}
+
+int main(void)
+{
+  static const char *modes[] = { "none", "transparent", "reserved" };
+  struct NpAllocPolicy policy;
+  struct NpArrayList *list;
+  struct NpHashMap *map;
+  volatile uintptr_t sink;
+  uint64_t start;
+  long long misses;
+  uint32_t x;
+  int fd;
+  int i;
+  int m;
+
+  fd = bench_tlb_open();
+  for (i = 0; i < BENCH_ITEMS; ++i)
+    keys[i] = i;
+  for (m = 0; m < 3; ++m) {
+    memset(&policy, 0, sizeof policy);
+    policy.huge_pages = (enum NpAllocHugePages)m;
+    policy.min_size = NP_ALLOC_HUGE_PAGE_SIZE;
+
+    if ((list = np_arraylist_new()) == NULL
+	|| np_arraylist_set_alloc_policy(list, &policy) == NULL)
+      return 1;
+    for (i = 0; i < BENCH_ITEMS; ++i)
+      np_arraylist_add(list, &keys[i], i);
+    x = 1;
+    bench_tlb_start(fd);
+    start = bench_nanos();
+    for (i = 0; i < BENCH_GETS; ++i)
+      sink = (uintptr_t)np_arraylist_get(list,
+					 bench_next(&x) % BENCH_ITEMS);
+    misses = bench_tlb_stop(fd);
+    bench_report("arraylist", modes[m], bench_nanos() - start, misses);
+    np_arraylist_free(list);
+
+    if ((map = np_hashmap_new_with_capacity(bench_cmp, bench_hash,
+					    BENCH_ITEMS)) == NULL
+	|| np_hashmap_set_alloc_policy(map, &policy) == NULL)
+      return 1;
+    for (i = 0; i < BENCH_ITEMS; ++i)
+      np_hashmap_put(map, &keys[i], &keys[i]);
+    x = 1;
+    bench_tlb_start(fd);
+    start = bench_nanos();
+    for (i = 0; i < BENCH_GETS; ++i)
+      sink = (uintptr_t)np_hashmap_get(map,
+				       &keys[bench_next(&x) % BENCH_ITEMS]);
+    misses = bench_tlb_stop(fd);
+    bench_report("hashmap", modes[m], bench_nanos() - start, misses);
+    np_hashmap_free(map);
+  }
+  (void)sink;
+  return 0;
+}
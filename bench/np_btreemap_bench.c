@@ -0,0 +1,130 @@
+/*
+ * np_btreemap_bench.c: nplib B+tree map benchmark
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares np_btreemap with np_treemap on random puts, random gets and an
+ * in order scan of integer keys, and reports the memory used by each.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "np_btreemap.h"
+#include "np_treemap.h"
+
+#define BENCH_KEYS (1 << 22)
+
+static uintptr_t keys[BENCH_KEYS];
+
+static double bench_seconds(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int bench_cmp(void *key1, void *key2)
+{
+  uintptr_t k1 = (uintptr_t)key1;
+  uintptr_t k2 = (uintptr_t)key2;
+
+  return k1 < k2 ? -1 : k1 > k2;
+}
+
+static void bench_report(const char *name, double put, double get,
+			 double scan, size_t bytes)
+{
+  printf("%-9s put %6.1f ns get %6.1f ns scan %5.1f ns %6.1f bytes/key\n",
+	 name, put * 1e9 / BENCH_KEYS, get * 1e9 / BENCH_KEYS,
+	 scan * 1e9 / BENCH_KEYS, (double)bytes / BENCH_KEYS);
+}
+
+int main(void)
+{
+  struct NpTreeMap *tree;
+  struct NpTreeMapStats tree_stats;
+  struct NpTreeMapIterator *tree_iter;
+  struct NpBTreeMap *btree;
+  struct NpBTreeMapStats btree_stats;
+  struct NpBTreeMapIterator *btree_iter;
+  volatile uintptr_t sink;
+  double start;
+  double put;
+  double get;
+  uint64_t x;
+  unsigned i;
+
+  /* distinct keys in random order */
+  x = 88172645463325252ull;
+  for (i = 0; i < BENCH_KEYS; ++i) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    keys[i] = (x & ~(uintptr_t)0xffffff) | i;
+  }
+
+  if ((tree = np_treemap_new(bench_cmp)) == NULL)
+    return 1;
+  start = bench_seconds();
+  for (i = 0; i < BENCH_KEYS; ++i)
+    np_treemap_put(tree, (void *)keys[i], (void *)keys[i]);
+  put = bench_seconds() - start;
+  start = bench_seconds();
+  for (i = 0; i < BENCH_KEYS; ++i)
+    sink = (uintptr_t)np_treemap_get(tree, (void *)keys[BENCH_KEYS - 1 - i]);
+  get = bench_seconds() - start;
+  start = bench_seconds();
+  if ((tree_iter = np_treemap_iterator(tree)) == NULL)
+    return 1;
+  while (np_treemap_iterator_next_key(tree_iter) != NULL)
+    ;
+  np_treemap_iterator_free(tree_iter);
+  np_treemap_stats(tree, &tree_stats);
+  bench_report("treemap", put, get, bench_seconds() - start,
+	       tree_stats.bytes);
+  np_treemap_free(tree);
+
+  if ((btree = np_btreemap_new(bench_cmp)) == NULL)
+    return 1;
+  start = bench_seconds();
+  for (i = 0; i < BENCH_KEYS; ++i)
+    np_btreemap_put(btree, (void *)keys[i], (void *)keys[i]);
+  put = bench_seconds() - start;
+  start = bench_seconds();
+  for (i = 0; i < BENCH_KEYS; ++i)
+    sink = (uintptr_t)np_btreemap_get(btree,
+				      (void *)keys[BENCH_KEYS - 1 - i]);
+  get = bench_seconds() - start;
+  start = bench_seconds();
+  if ((btree_iter = np_btreemap_iterator(btree)) == NULL)
+    return 1;
+  while (np_btreemap_iterator_next_key(btree_iter) != NULL)
+    ;
+  np_btreemap_iterator_free(btree_iter);
+  np_btreemap_stats(btree, &btree_stats);
+  bench_report("btreemap", put, get, bench_seconds() - start,
+	       btree_stats.bytes);
+  np_btreemap_free(btree);
+  (void)sink;
+  return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * np_concurrent_cache_bench.c: nplib concurrent cache benchmark
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures np_concurrent_cache throughput on a skewed get workload that puts
+ * missing keys, with 1 to 32 threads and 1 or the default number of shards.
+ * A single shard behaves like a cache behind one mutex.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "np_concurrent_cache.h"
+#include "np_hashmap.h"
+
+#define KEYS (1 << 20) /* must match the 20 bits drawn per key */
+#define CAPACITY (KEYS / 4)
+#define OPS_PER_THREAD 1000000
+#define MAX_THREADS 32
+
+static unsigned long keys[KEYS];
+
+struct bench_arg {
+  struct NpConcurrentCache *cache;
+  unsigned seed;
+};
+
+static int bench_cmp(void *key1, void *key2)
+{
+  unsigned long k1 = *(unsigned long *)key1;
+  unsigned long k2 = *(unsigned long *)key2;
+
+  return k1 < k2 ? -1 : k1 > k2;
+}
+
+static unsigned bench_hash(void *key)
+{
+  return np_hashmap_hash(key, sizeof(unsigned long));
+}
+
+static void *bench_worker(void *data)
+{
+  struct bench_arg *arg;
+  unsigned x;
+  unsigned i;
+  unsigned long *key;
+
+  arg = data;
+  x = arg->seed;
+  for (i = 0; i < OPS_PER_THREAD; ++i) {
+    x = x * 1103515245 + 12345;
+
+    /* squaring skews the keys towards the low indexes */
+    key = &keys[(unsigned long long)(x >> 12) * (x >> 12) >> 20];
+    if (np_concurrent_cache_get(arg->cache, key) == NULL)
+      np_concurrent_cache_put(arg->cache, key, key);
+  }
+  return NULL;
+}
+
+static double bench_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench_run(unsigned shards)
+{
+  struct NpConcurrentCache *cache;
+  struct NpConcurrentCacheStats stats;
+  struct bench_arg args[MAX_THREADS];
+  pthread_t threads[MAX_THREADS];
+  double start;
+  double elapsed;
+  int nthreads;
+  int t;
+
+  for (nthreads = 1; nthreads <= MAX_THREADS; nthreads *= 2) {
+    cache = np_concurrent_cache_new(bench_cmp, bench_hash, CAPACITY, shards);
+    if (cache == NULL)
+      return;
+    if (nthreads == 1)
+      printf("np_concurrent_cache get/put on miss, %d keys, capacity %d, "
+	     "%u shards\n", KEYS, CAPACITY, cache->shard_count);
+    start = bench_now();
+    for (t = 0; t < nthreads; ++t) {
+      args[t].cache = cache;
+      args[t].seed = t + 1;
+      pthread_create(&threads[t], NULL, bench_worker, &args[t]);
+    }
+    for (t = 0; t < nthreads; ++t)
+      pthread_join(threads[t], NULL);
+    elapsed = bench_now() - start;
+    np_concurrent_cache_stats(cache, &stats);
+    printf("%2d threads: %8.2f Mops/s, hit rate %.2f\n", nthreads,
+	   (double)nthreads * OPS_PER_THREAD / elapsed / 1e6,
+	   (double)stats.hits / (stats.hits + stats.misses));
+    np_concurrent_cache_free(cache);
+  }
+}
+
+int main(void)
+{
+  unsigned i;
+
+  for (i = 0; i < KEYS; ++i)
+    keys[i] = i;
+  bench_run(1);
+  bench_run(0);
+  return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * np_concurrent_hashmap_bench.c: nplib concurrent hash map benchmark
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures np_concurrent_hashmap throughput on a mixed 90% get / 10% put
+ * workload with 1 to 32 threads.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "np_concurrent_hashmap.h"
+#include "np_hashmap.h"
+
+#define KEYS (1 << 20)
+#define OPS_PER_THREAD 2000000
+#define MAX_THREADS 32
+
+static unsigned long keys[KEYS];
+
+struct bench_arg {
+  struct NpConcurrentHashMap *map;
+  unsigned seed;
+};
+
+static int bench_cmp(void *key1, void *key2)
+{
+  unsigned long k1 = *(unsigned long *)key1;
+  unsigned long k2 = *(unsigned long *)key2;
+
+  return k1 < k2 ? -1 : k1 > k2;
+}
+
+static unsigned bench_hash(void *key)
+{
+  return np_hashmap_hash(key, sizeof(unsigned long));
+}
+
+static void *bench_worker(void *data)
+{
+  struct bench_arg *arg;
+  unsigned x;
+  unsigned i;
+  unsigned long *key;
+
+  arg = data;
+  x = arg->seed;
+  for (i = 0; i < OPS_PER_THREAD; ++i) {
+    x = x * 1103515245 + 12345;
+    key = &keys[(x >> 8) % KEYS];
+    if ((x >> 4) % 10 == 0)
+      np_concurrent_hashmap_put(arg->map, key, key);
+    else
+      np_concurrent_hashmap_get(arg->map, key);
+  }
+  return NULL;
+}
+
+static double bench_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+  struct NpConcurrentHashMap *map;
+  struct bench_arg args[MAX_THREADS];
+  pthread_t threads[MAX_THREADS];
+  double start;
+  double elapsed;
+  int nthreads;
+  int t;
+  unsigned i;
+
+  map = np_concurrent_hashmap_new(bench_cmp, bench_hash, 0);
+  if (map == NULL)
+    return 1;
+  for (i = 0; i < KEYS; ++i) {
+    keys[i] = i;
+    if (i % 2 == 0)
+      np_concurrent_hashmap_put(map, &keys[i], &keys[i]);
+  }
+  printf("np_concurrent_hashmap 90/10 get/put, %d keys\n", KEYS);
+  for (nthreads = 1; nthreads <= MAX_THREADS; nthreads *= 2) {
+    start = bench_now();
+    for (t = 0; t < nthreads; ++t) {
+      args[t].map = map;
+      args[t].seed = t + 1;
+      pthread_create(&threads[t], NULL, bench_worker, &args[t]);
+    }
+    for (t = 0; t < nthreads; ++t)
+      pthread_join(threads[t], NULL);
+    elapsed = bench_now() - start;
+    printf("%2d threads: %8.2f Mops/s\n", nthreads,
+	   (double)nthreads * OPS_PER_THREAD / elapsed / 1e6);
+  }
+  np_concurrent_hashmap_free(map);
+  return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * np_hash_bench.c: nplib hash function benchmark
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares the throughput, in bytes per cycle, of np_hashmap_hash64 against
+ * the one-at-a-time hash np_hashmap_hash used previously and the keyed
+ * np_hashmap_siphash. Cycles are read with rdtsc on x86, elsewhere
+ * nanoseconds are reported instead.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define bench_ticks() __rdtsc()
+#define BENCH_UNIT "cycle"
+#else
+#define bench_ticks() bench_nanos()
+#define BENCH_UNIT "ns"
+#endif
+
+#include "np_hashmap.h"
+
+#define BENCH_BYTES (256 << 20)
+
+static unsigned char buf[8192];
+
+static uint64_t bench_nanos(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Bob Jenkins, one-at-a-time hash */
+static unsigned bench_one_at_a_time(void *key, int length)
+{
+  unsigned char *p = key;
+  unsigned h = 0;
+  int i;
+
+  for (i = 0; i < length; ++i) {
+    h += p[i];
+    h += (h << 10);
+    h ^= (h >> 6);
+  }
+  h += (h << 3);
+  h ^= (h >> 11);
+  h += (h << 15);
+  return h;
+}
+
+int main(void)
+{
+  static const size_t lengths[] = { 4, 8, 16, 32, 64, 128, 256, 1024, 8192 };
+  volatile uint64_t sink;
+  uint64_t start;
+  uint64_t oat;
+  uint64_t h64;
+  uint64_t sip;
+  uint64_t seed[2] = {1, 2};
+  size_t length;
+  size_t iterations;
+  size_t i;
+  size_t n;
+  uint32_t k32;
+  uint64_t k64;
+
+  (void)bench_nanos;
+  for (i = 0; i < sizeof buf; ++i)
+    buf[i] = (unsigned char)(i * 131 + 7);
+  printf("%8s %16s %16s %16s\n", "bytes", "one-at-a-time", "hash64",
+	 "siphash");
+  for (n = 0; n < sizeof lengths / sizeof *lengths; ++n) {
+    length = lengths[n];
+    iterations = BENCH_BYTES / length / 8;
+
+    start = bench_ticks();
+    for (i = 0; i < iterations; ++i) {
+      buf[0] = (unsigned char)i;
+      sink = bench_one_at_a_time(buf, length);
+    }
+    oat = bench_ticks() - start;
+
+    start = bench_ticks();
+    for (i = 0; i < iterations; ++i) {
+      buf[0] = (unsigned char)i;
+      sink = np_hashmap_hash64(buf, length);
+    }
+    h64 = bench_ticks() - start;
+
+    start = bench_ticks();
+    for (i = 0; i < iterations; ++i) {
+      buf[0] = (unsigned char)i;
+      sink = np_hashmap_siphash(buf, length, seed);
+    }
+    sip = bench_ticks() - start;
+
+    printf("%8lu %10.3f B/%s %10.3f B/%s %10.3f B/%s\n",
+	   (unsigned long)length,
+	   (double)length * iterations / oat, BENCH_UNIT,
+	   (double)length * iterations / h64, BENCH_UNIT,
+	   (double)length * iterations / sip, BENCH_UNIT);
+  }
+
+  iterations = BENCH_BYTES / 64;
+  start = bench_ticks();
+  for (k32 = 0; k32 < iterations; ++k32)
+    sink = np_hashmap_hash64_u32(k32);
+  printf("hash64_u32: %6.2f %ss/key\n",
+	 (double)(bench_ticks() - start) / iterations, BENCH_UNIT);
+  start = bench_ticks();
+  for (k64 = 0; k64 < iterations; ++k64)
+    sink = np_hashmap_hash64_u64(k64);
+  printf("hash64_u64: %6.2f %ss/key\n",
+	 (double)(bench_ticks() - start) / iterations, BENCH_UNIT);
+  (void)sink;
+  return 0;
+}
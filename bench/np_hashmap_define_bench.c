@@ -0,0 +1,111 @@
+/*
+ * Compares np_hashmap with boxed uint64_t keys and values against a map
+ * generated by NP_HASHMAP_DEFINE storing them by value.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "np_hashmap.h"
+#include "np_hashmap_define.h"
+
+#define KEYS (1 << 20)
+#define LOOKUPS (1 << 22)
+
+static uint64_t keys[KEYS];
+
+static inline unsigned bench_hash_u64(uint64_t key)
+{
+  uint64_t h;
+
+  h = np_hashmap_hash64_u64(key);
+  return (unsigned)(h ^ (h >> 32));
+}
+
+#define BENCH_EQUAL(key1, key2) ((key1) == (key2))
+
+NP_HASHMAP_DEFINE(bench_u64map, uint64_t, uint64_t, bench_hash_u64,
+		  BENCH_EQUAL);
+
+static int bench_cmp(void *key1, void *key2)
+{
+  uint64_t k1 = *(uint64_t *)key1;
+  uint64_t k2 = *(uint64_t *)key2;
+
+  return k1 < k2 ? -1 : k1 > k2;
+}
+
+static unsigned bench_hash(void *key)
+{
+  return bench_hash_u64(*(uint64_t *)key);
+}
+
+static double bench_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+  struct NpHashMap *map;
+  struct bench_u64map *typed;
+  double start;
+  double boxed_put;
+  double boxed_get;
+  double typed_put;
+  double typed_get;
+  uint64_t sum;
+  uint64_t *value;
+  unsigned x;
+  unsigned i;
+
+  if ((map = np_hashmap_new(bench_cmp, bench_hash)) == NULL
+      || (typed = bench_u64map_new()) == NULL)
+    return 1;
+  for (i = 0; i < KEYS; ++i)
+    keys[i] = (uint64_t)i * 2654435761u;
+
+  start = bench_now();
+  for (i = 0; i < KEYS; ++i)
+    np_hashmap_put(map, &keys[i], &keys[i]);
+  boxed_put = bench_now() - start;
+
+  start = bench_now();
+  for (i = 0; i < KEYS; ++i)
+    bench_u64map_put(typed, keys[i], keys[i]);
+  typed_put = bench_now() - start;
+
+  sum = 0;
+  start = bench_now();
+  for (i = 0, x = 1; i < LOOKUPS; ++i) {
+    x = x * 1103515245 + 12345;
+    if ((value = np_hashmap_get(map, &keys[(x >> 4) % KEYS])) != NULL)
+      sum += *value;
+  }
+  boxed_get = bench_now() - start;
+
+  start = bench_now();
+  for (i = 0, x = 1; i < LOOKUPS; ++i) {
+    x = x * 1103515245 + 12345;
+    if ((value = bench_u64map_get(typed, keys[(x >> 4) % KEYS])) != NULL)
+      sum -= *value;
+  }
+  typed_get = bench_now() - start;
+
+  printf("uint64_t maps, %d keys, %d lookups (checksum %s)\n", KEYS, LOOKUPS,
+	 sum == 0 ? "ok" : "mismatch");
+  printf("np_hashmap put:        %8.2f Mops/s\n", KEYS / boxed_put / 1e6);
+  printf("NP_HASHMAP_DEFINE put: %8.2f Mops/s\n", KEYS / typed_put / 1e6);
+  printf("np_hashmap get:        %8.2f Mops/s\n", LOOKUPS / boxed_get / 1e6);
+  printf("NP_HASHMAP_DEFINE get: %8.2f Mops/s\n", LOOKUPS / typed_get / 1e6);
+  np_hashmap_free(map);
+  bench_u64map_free(typed);
+  return 0;
+}
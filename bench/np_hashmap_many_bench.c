@@ -0,0 +1,100 @@
+/*
+ * np_hashmap_many_bench.c: nplib batched hash map lookup benchmark
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares np_hashmap_get in a loop against np_hashmap_get_many on a map
+ * too large to fit in cache.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "np_hashmap.h"
+
+#define KEYS (1 << 22)
+#define LOOKUPS (1 << 22)
+#define BATCH 256
+
+static unsigned long keys[KEYS];
+static void *lookups[LOOKUPS];
+static void *values[BATCH];
+
+static int bench_cmp(void *key1, void *key2)
+{
+  unsigned long k1 = *(unsigned long *)key1;
+  unsigned long k2 = *(unsigned long *)key2;
+
+  return k1 < k2 ? -1 : k1 > k2;
+}
+
+static unsigned bench_hash(void *key)
+{
+  return np_hashmap_hash(key, sizeof(unsigned long));
+}
+
+static double bench_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+  struct NpHashMap *map;
+  double start;
+  double single;
+  double many;
+  unsigned long found;
+  unsigned x;
+  unsigned i;
+
+  if ((map = np_hashmap_new(bench_cmp, bench_hash)) == NULL)
+    return 1;
+  for (i = 0; i < KEYS; ++i) {
+    keys[i] = i;
+    np_hashmap_put(map, &keys[i], &keys[i]);
+  }
+  for (i = 0, x = 1; i < LOOKUPS; ++i) {
+    x = x * 1103515245 + 12345;
+    lookups[i] = &keys[(x >> 4) % KEYS];
+  }
+
+  found = 0;
+  start = bench_now();
+  for (i = 0; i < LOOKUPS; ++i)
+    found += np_hashmap_get(map, lookups[i]) != NULL;
+  single = bench_now() - start;
+
+  start = bench_now();
+  for (i = 0; i < LOOKUPS; i += BATCH)
+    found += np_hashmap_get_many(map, lookups + i, values, BATCH);
+  many = bench_now() - start;
+
+  printf("np_hashmap %d keys, %d lookups (%lu found)\n", KEYS, LOOKUPS,
+	 found);
+  printf("get:      %8.2f Mops/s\n", LOOKUPS / single / 1e6);
+  printf("get_many: %8.2f Mops/s (batches of %d)\n", LOOKUPS / many / 1e6,
+	 BATCH);
+  np_hashmap_free(map);
+  return 0;
+}
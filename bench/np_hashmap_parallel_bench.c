@@ -0,0 +1,90 @@
+/*
+ * np_hashmap_parallel_bench.c: nplib parallel hash map build benchmark
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares building a large np_hashmap by putting keys one at a time, with
+ * serial and parallel resizes, against np_hashmap_build_parallel with 1 to
+ * 8 threads.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "np_hashmap.h"
+
+#define BENCH_ITEMS (1 << 23)
+
+static uint32_t keys[BENCH_ITEMS];
+static void *key_ptrs[BENCH_ITEMS];
+
+static double bench_seconds(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int bench_cmp(void *key1, void *key2)
+{
+  return *(uint32_t *)key1 != *(uint32_t *)key2;
+}
+
+static unsigned bench_hash(void *key)
+{
+  return (unsigned)np_hashmap_hash64_u32(*(uint32_t *)key);
+}
+
+int main(void)
+{
+  struct NpHashMap *map;
+  double start;
+  unsigned threads;
+  unsigned i;
+
+  for (i = 0; i < BENCH_ITEMS; ++i) {
+    keys[i] = i * 2654435761u;
+    key_ptrs[i] = &keys[i];
+  }
+  for (threads = 1; threads <= 8; threads *= 2) {
+    if ((map = np_hashmap_new(bench_cmp, bench_hash)) == NULL)
+      return 1;
+    np_hashmap_set_threads(map, threads);
+    start = bench_seconds();
+    for (i = 0; i < BENCH_ITEMS; ++i)
+      np_hashmap_put(map, key_ptrs[i], key_ptrs[i]);
+    printf("put, %u resize threads: %8.3f s (%.3f s resizing)\n", threads,
+	   bench_seconds() - start, map->resize_seconds);
+    np_hashmap_free(map);
+  }
+  for (threads = 1; threads <= 8; threads *= 2) {
+    start = bench_seconds();
+    if ((map = np_hashmap_build_parallel(bench_cmp, bench_hash, key_ptrs,
+					 key_ptrs, BENCH_ITEMS, threads))
+	== NULL)
+      return 1;
+    printf("build_parallel, %u threads: %8.3f s\n", threads,
+	   bench_seconds() - start);
+    np_hashmap_free(map);
+  }
+  return 0;
+}
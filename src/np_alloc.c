@@ -0,0 +1,162 @@
+/*
+ * np_alloc.c: nplib large array allocation
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "np_alloc.h"
+
+/* memory policy modes of the mbind system call */
+#define NP_ALLOC_MPOL_BIND 2
+#define NP_ALLOC_MPOL_INTERLEAVE 3
+
+/*
+ * Determines whether an array is mapped rather than taken from malloc.
+ * Must give the same answer for the allocation and the free.
+ */
+static int np_alloc_mapped(const struct NpAllocPolicy *policy, size_t size)
+{
+#ifdef __linux__
+  return policy != NULL && size >= policy->min_size && size > 0
+    && (policy->huge_pages != NP_ALLOC_HUGE_NONE
+	|| policy->numa != NP_ALLOC_NUMA_DEFAULT);
+#else
+  (void)policy;
+  (void)size;
+  return 0;
+#endif
+}
+
+#ifdef __linux__
+
+static size_t np_alloc_mapped_size(const struct NpAllocPolicy *policy,
+				   size_t size)
+{
+  size_t page;
+
+  page = policy->huge_pages != NP_ALLOC_HUGE_NONE ? NP_ALLOC_HUGE_PAGE_SIZE
+    : (size_t)sysconf(_SC_PAGESIZE);
+  return (size + page - 1) / page * page;
+}
+
+/*
+ * Maps an array of a multiple of the huge page size aligned to the huge
+ * page size, so that every page of it can be a huge page.
+ */
+static void *np_alloc_map_aligned(size_t size)
+{
+  char *map;
+  char *aligned;
+  size_t head;
+
+  map = mmap(NULL, size + NP_ALLOC_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+	     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED)
+    return NULL;
+  aligned = (char *)(((size_t)map + NP_ALLOC_HUGE_PAGE_SIZE - 1)
+		     & ~(size_t)(NP_ALLOC_HUGE_PAGE_SIZE - 1));
+  head = aligned - map;
+  if (head > 0)
+    munmap(map, head);
+  munmap(aligned + size, NP_ALLOC_HUGE_PAGE_SIZE - head);
+  return aligned;
+}
+
+static void *np_alloc_map(const struct NpAllocPolicy *policy, size_t size)
+{
+  void *array;
+
+  array = NULL;
+#ifdef MAP_HUGETLB
+  if (policy->huge_pages == NP_ALLOC_HUGE_RESERVED) {
+    array = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (array == MAP_FAILED)
+      array = NULL;
+  }
+#endif
+  if (array == NULL && policy->huge_pages != NP_ALLOC_HUGE_NONE) {
+    if ((array = np_alloc_map_aligned(size)) == NULL)
+      return NULL;
+#ifdef MADV_HUGEPAGE
+    madvise(array, size, MADV_HUGEPAGE);
+#endif
+  } else if (array == NULL) {
+    array = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (array == MAP_FAILED)
+      return NULL;
+  }
+
+  /* placement applies to pages touched from now on; failure is ignored */
+#ifdef SYS_mbind
+  if (policy->numa != NP_ALLOC_NUMA_DEFAULT && policy->nodes != 0)
+    syscall(SYS_mbind, array, size,
+	    policy->numa == NP_ALLOC_NUMA_BIND ? NP_ALLOC_MPOL_BIND
+	    : NP_ALLOC_MPOL_INTERLEAVE,
+	    &policy->nodes, sizeof policy->nodes * 8 + 1, 0);
+#endif
+  return array;
+}
+
+#endif
+
+void *np_alloc(const struct NpAllocPolicy *policy, size_t size)
+{
+#ifdef __linux__
+  if (np_alloc_mapped(policy, size))
+    return np_alloc_map(policy, np_alloc_mapped_size(policy, size));
+#endif
+  return malloc(size);
+}
+
+void np_alloc_free(const struct NpAllocPolicy *policy, void *array,
+		   size_t size)
+{
+  if (array == NULL)
+    return;
+#ifdef __linux__
+  if (np_alloc_mapped(policy, size)) {
+    munmap(array, np_alloc_mapped_size(policy, size));
+    return;
+  }
+#endif
+  free(array);
+}
+
+void *np_alloc_realloc(const struct NpAllocPolicy *policy, void *array,
+		       size_t size, size_t new_size)
+{
+  void *new_array;
+
+  if (!np_alloc_mapped(policy, size) && !np_alloc_mapped(policy, new_size))
+    return realloc(array, new_size);
+  if ((new_array = np_alloc(policy, new_size)) == NULL)
+    return NULL;
+  memcpy(new_array, array, size < new_size ? size : new_size);
+  np_alloc_free(policy, array, size);
+  return new_array;
+}
@@ -0,0 +1,134 @@
+/*
+ * np_alloc.h: nplib large array allocation header file
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NP_ALLOC_H
+#define __NP_ALLOC_H
+
+#include <stddef.h>
+
+/**
+   Size of the huge pages large arrays are rounded up to.
+*/
+#define NP_ALLOC_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/**
+   How large arrays are backed by huge pages.
+*/
+enum NpAllocHugePages {
+  /**
+     Arrays use the default page size.
+  */
+  NP_ALLOC_HUGE_NONE,
+
+  /**
+     Arrays are mapped and advised to use transparent huge pages.
+  */
+  NP_ALLOC_HUGE_TRANSPARENT,
+
+  /**
+     Arrays are mapped from the reserved huge page pool, falling back to
+     transparent huge pages if the pool is empty.
+  */
+  NP_ALLOC_HUGE_RESERVED
+};
+
+/**
+   How large arrays are placed on NUMA nodes.
+*/
+enum NpAllocNuma {
+  /**
+     Pages are placed by the system's default policy, usually on the node
+     of the thread that first touches them.
+  */
+  NP_ALLOC_NUMA_DEFAULT,
+
+  /**
+     Pages are interleaved over the nodes in the node mask.
+  */
+  NP_ALLOC_NUMA_INTERLEAVE,
+
+  /**
+     Pages are placed on the nodes in the node mask only.
+  */
+  NP_ALLOC_NUMA_BIND
+};
+
+/**
+   Allocation policy for large arrays. A zero initialized policy allocates
+   with malloc. Where huge pages or NUMA placement are unavailable the
+   policy falls back to ordinary pages and the default placement.
+*/
+struct NpAllocPolicy {
+  /**
+     The huge page mode.
+  */
+  enum NpAllocHugePages huge_pages;
+
+  /**
+     The NUMA placement mode.
+  */
+  enum NpAllocNuma numa;
+
+  /**
+     The NUMA nodes used by NP_ALLOC_NUMA_INTERLEAVE and NP_ALLOC_NUMA_BIND,
+     bit i standing for node i.
+  */
+  unsigned long nodes;
+
+  /**
+     The size in bytes below which arrays are allocated with malloc.
+  */
+  size_t min_size;
+};
+
+/**
+   Allocates an array under a policy. Arrays the policy applies to are
+   mapped separately, rounded up to a multiple of NP_ALLOC_HUGE_PAGE_SIZE
+   and aligned to it when huge pages are requested.
+
+   @param policy the policy or NULL for malloc
+   @param size the size of the array in bytes
+   @return a pointer to the array or NULL on error
+*/
+void *np_alloc(const struct NpAllocPolicy *policy, size_t size);
+
+/**
+   Frees an array allocated by np_alloc().
+
+   @param policy the policy the array was allocated under
+   @param array the array to free, may be NULL
+   @param size the size the array was allocated with
+*/
+void np_alloc_free(const struct NpAllocPolicy *policy, void *array,
+		   size_t size);
+
+/**
+   Resizes an array allocated by np_alloc(), keeping its contents up to the
+   smaller of the two sizes.
+
+   @param policy the policy the array was allocated under
+   @param array the array to resize
+   @param size the size the array was allocated with
+   @param new_size the new size
+   @return a pointer to the resized array or NULL on error, in which case
+   the array is unchanged
+*/
+void *np_alloc_realloc(const struct NpAllocPolicy *policy, void *array,
+		       size_t size, size_t new_size);
+
+#endif
@@ -0,0 +1,85 @@
+/*
+ * np_arena.c: nplib arena allocator
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "np_arena.h"
+
+struct NpArena *np_arena_new(void)
+{
+  struct NpArena *arena;
+
+  arena = malloc(sizeof *arena);
+  if (arena != NULL) {
+    arena->chunks = NULL;
+    arena->next = NULL;
+    arena->end = NULL;
+    arena->used = 0;
+    arena->bytes = 0;
+  }
+  return arena;
+}
+
+void np_arena_free(struct NpArena *arena)
+{
+  struct NpArenaChunk *chunk;
+  struct NpArenaChunk *next;
+
+  for (chunk = arena->chunks; chunk != NULL; chunk = next) {
+    next = chunk->next;
+    free(chunk);
+  }
+  free(arena);
+}
+
+void *np_arena_alloc(struct NpArena *arena, size_t size, size_t align)
+{
+  struct NpArenaChunk *chunk;
+  size_t pad;
+  size_t chunk_size;
+  char *block;
+
+  pad = arena->next != NULL ? -(uintptr_t)arena->next & (align - 1) : 0;
+  if (arena->next == NULL || (size_t)(arena->end - arena->next) < pad + size) {
+    chunk_size = size + align > NP_ARENA_CHUNK_SIZE ? size + align
+      : NP_ARENA_CHUNK_SIZE;
+    chunk = malloc(sizeof *chunk + chunk_size);
+    if (chunk == NULL)
+      return NULL;
+    arena->bytes += sizeof *chunk + chunk_size;
+    if (chunk_size > NP_ARENA_CHUNK_SIZE && arena->chunks != NULL) {
+      /* keep carving from the current chunk after an oversized block */
+      chunk->next = arena->chunks->next;
+      arena->chunks->next = chunk;
+      block = (char *)(chunk + 1);
+      block += -(uintptr_t)block & (align - 1);
+      arena->used += size;
+      return block;
+    }
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    arena->next = (char *)(chunk + 1);
+    arena->end = arena->next + chunk_size;
+    pad = -(uintptr_t)arena->next & (align - 1);
+  }
+  block = arena->next + pad;
+  arena->next = block + size;
+  arena->used += pad + size;
+  return block;
+}
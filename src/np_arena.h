@@ -0,0 +1,100 @@
+/*
+ * np_arena.h: nplib arena allocator header file
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NP_ARENA_H
+#define __NP_ARENA_H
+
+#include <stddef.h>
+
+/**
+   Size of the arena chunks. Larger allocations get a chunk of their own.
+*/
+#define NP_ARENA_CHUNK_SIZE 4096
+
+/**
+   Arena chunk header. The chunk memory follows the header.
+*/
+struct NpArenaChunk {
+  /**
+     The next chunk.
+  */
+  struct NpArenaChunk *next;
+
+  /**
+     Padding keeping the memory following the header aligned.
+  */
+  double align;
+};
+
+/**
+   Arena object. Hands out variable sized blocks carved sequentially from
+   large chunks. Blocks cannot be freed individually; all of them are freed
+   with the arena.
+*/
+struct NpArena {
+  /**
+     The allocated chunks, most recent first.
+  */
+  struct NpArenaChunk *chunks;
+
+  /**
+     The next unused byte in the most recent chunk.
+  */
+  char *next;
+
+  /**
+     The end of the most recent chunk.
+  */
+  char *end;
+
+  /**
+     The number of bytes handed out, including alignment padding.
+  */
+  size_t used;
+
+  /**
+     The number of bytes allocated for chunks.
+  */
+  size_t bytes;
+};
+
+/**
+   Allocates memory for and initializes an arena.
+
+   @return a pointer to the allocated memory or NULL on error
+*/
+struct NpArena *np_arena_new(void);
+
+/**
+   Frees the arena and all blocks allocated from it.
+
+   @param arena the arena to free
+*/
+void np_arena_free(struct NpArena *arena);
+
+/**
+   Allocates a block from the arena.
+
+   @param arena the arena
+   @param size the size of the block
+   @param align the alignment of the block, a power of two
+   @return a pointer to the block or NULL on error
+*/
+void *np_arena_alloc(struct NpArena *arena, size_t size, size_t align);
+
+#endif
@@ -18,6 +18,7 @@
 
 #include <stdlib.h>
 #include <limits.h>
+#include <string.h>
 
 #include "np_arraylist.h"
 
@@ -30,6 +31,7 @@ struct NpArrayList *np_arraylist_new()
     return NULL;
   list->size = 0;
   list->allocated = NP_ARRAYLIST_DEFAULT_ALLOC_SIZE;
+  memset(&list->alloc_policy, 0, sizeof list->alloc_policy);
   list->data = malloc((sizeof *list->data) * NP_ARRAYLIST_DEFAULT_ALLOC_SIZE);
   if (list->data == NULL) {
     free(list);
@@ -40,10 +42,27 @@ struct NpArrayList *np_arraylist_new()
 
 void np_arraylist_free(struct NpArrayList *list)
 {
-  free(list->data);
+  np_alloc_free(&list->alloc_policy, list->data,
+		(sizeof *list->data) * list->allocated);
   free(list);
 }
 
+struct NpArrayList *np_arraylist_set_alloc_policy(
+  struct NpArrayList *list, const struct NpAllocPolicy *policy)
+{
+  void *data;
+  size_t size;
+
+  size = (sizeof *list->data) * list->allocated;
+  if ((data = np_alloc(policy, size)) == NULL)
+    return NULL;
+  memcpy(data, list->data, size);
+  np_alloc_free(&list->alloc_policy, list->data, size);
+  list->data = data;
+  list->alloc_policy = *policy;
+  return list;
+}
+
 static struct NpArrayList *np_arraylist_realloc(struct NpArrayList *list)
 {
   int allocated;
@@ -59,7 +78,9 @@ static struct NpArrayList *np_arraylist_realloc(struct NpArrayList *list)
       allocated = INT_MAX;
     else
       allocated = allocated << 1;
-    data = realloc(list->data, (sizeof *list->data) * allocated);
+    data = np_alloc_realloc(&list->alloc_policy, list->data,
+			    (sizeof *list->data) * list->allocated,
+			    (sizeof *list->data) * allocated);
     if (data == NULL)
       return NULL;
     list->data = data;
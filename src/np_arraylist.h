@@ -19,6 +19,8 @@
 #ifndef __NP_ARRAYLIST_H
 #define __NP_ARRAYLIST_H
 
+#include "np_alloc.h"
+
 #define NP_ARRAYLIST_DEFAULT_ALLOC_SIZE 10
 
 /**
@@ -39,6 +41,11 @@ struct NpArrayList {
      Pointer to the list data.
   */
   void **data;
+
+  /**
+     The allocation policy of the list data.
+  */
+  struct NpAllocPolicy alloc_policy;
 };
 
 /**
@@ -69,6 +76,18 @@ struct NpArrayList *np_arraylist_new();
 */
 void np_arraylist_free(struct NpArrayList *list);
 
+/**
+   Sets the allocation policy of the list data, for instance to back a large
+   list with huge pages. The data is moved to memory allocated under the new
+   policy.
+
+   @param list the list
+   @param policy the allocation policy
+   @return the list or NULL on error, in which case the policy is unchanged
+*/
+struct NpArrayList *np_arraylist_set_alloc_policy(
+  struct NpArrayList *list, const struct NpAllocPolicy *policy);
+
 /**
    Adds an item to the head of the list.
 
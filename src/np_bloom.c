@@ -0,0 +1,157 @@
+/*
+ * np_bloom.c: nplib blocked Bloom filter
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "np_bloom.h"
+#include "np_hashmap.h"
+
+#define NP_BLOOM_CACHE_LINE 64
+
+/*
+ * Odd multipliers selecting the bit set in each word of a block, as used by
+ * split block Bloom filters.
+ */
+static const uint32_t np_bloom_salt[NP_BLOOM_BLOCK_WORDS] = {
+  0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+  0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u
+};
+
+static int np_bloom_init(struct NpBloom *bloom, unsigned capacity)
+{
+  void *blocks;
+  unsigned block_count;
+
+  if (capacity < NP_BLOOM_MIN_CAPACITY)
+    capacity = NP_BLOOM_MIN_CAPACITY;
+  block_count = ((unsigned long long)capacity * NP_BLOOM_BITS_PER_ITEM
+		 + sizeof(struct NpBloomBlock) * 8 - 1)
+    / (sizeof(struct NpBloomBlock) * 8);
+  if (posix_memalign(&blocks, NP_BLOOM_CACHE_LINE,
+		     sizeof(struct NpBloomBlock) * block_count) != 0)
+    return -1;
+  memset(blocks, 0, sizeof(struct NpBloomBlock) * block_count);
+  bloom->blocks = blocks;
+  bloom->block_count = block_count;
+  bloom->capacity = capacity;
+  bloom->items = 0;
+  bloom->removed = 0;
+  return 0;
+}
+
+struct NpBloom *np_bloom_new(unsigned capacity)
+{
+  struct NpBloom *bloom;
+
+  bloom = malloc(sizeof *bloom);
+  if (bloom != NULL) {
+    if (np_bloom_init(bloom, capacity) != 0) {
+      free(bloom);
+      return NULL;
+    }
+    bloom->lookups = 0;
+    bloom->rejected = 0;
+    bloom->false_positives = 0;
+  }
+  return bloom;
+}
+
+void np_bloom_free(struct NpBloom *bloom)
+{
+  free(bloom->blocks);
+  free(bloom);
+}
+
+struct NpBloom *np_bloom_reset(struct NpBloom *bloom, unsigned capacity)
+{
+  struct NpBloomBlock *blocks;
+
+  blocks = bloom->blocks;
+  if (np_bloom_init(bloom, capacity) != 0)
+    return NULL;
+  free(blocks);
+  return bloom;
+}
+
+/*
+ * Widens the 32 bit key hash so the block index and the bits within the
+ * block come from independent bits.
+ */
+static struct NpBloomBlock *np_bloom_block(struct NpBloom *bloom,
+					   unsigned hash, uint32_t *bits)
+{
+  uint64_t h;
+
+  h = np_hashmap_hash64_u32(hash);
+  *bits = (uint32_t)h;
+  return bloom->blocks + (unsigned)(((h >> 32) * bloom->block_count) >> 32);
+}
+
+void np_bloom_add(struct NpBloom *bloom, unsigned hash)
+{
+  struct NpBloomBlock *block;
+  uint32_t bits;
+  int i;
+
+  block = np_bloom_block(bloom, hash, &bits);
+  for (i = 0; i < NP_BLOOM_BLOCK_WORDS; ++i)
+    block->words[i] |= (uint64_t)1 << ((uint32_t)(bits * np_bloom_salt[i])
+				       >> 26);
+  bloom->items++;
+}
+
+int np_bloom_contains(struct NpBloom *bloom, unsigned hash)
+{
+  struct NpBloomBlock *block;
+  uint32_t bits;
+  int i;
+
+  bloom->lookups++;
+  block = np_bloom_block(bloom, hash, &bits);
+  for (i = 0; i < NP_BLOOM_BLOCK_WORDS; ++i) {
+    if ((block->words[i] & (uint64_t)1 << ((uint32_t)(bits * np_bloom_salt[i])
+					   >> 26)) == 0) {
+      bloom->rejected++;
+      return 0;
+    }
+  }
+  return 1;
+}
+
+void np_bloom_remove(struct NpBloom *bloom)
+{
+  bloom->removed++;
+}
+
+int np_bloom_stale(struct NpBloom *bloom)
+{
+  return bloom->items > bloom->capacity
+    || (bloom->items >= NP_BLOOM_MIN_CAPACITY
+	&& bloom->removed > bloom->items / 2);
+}
+
+double np_bloom_false_positive_rate(struct NpBloom *bloom)
+{
+  unsigned long absent;
+
+  absent = bloom->rejected + bloom->false_positives;
+  return absent != 0 ? (double)bloom->false_positives / absent : 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * np_bloom.h: nplib blocked Bloom filter header file
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NP_BLOOM_H
+#define __NP_BLOOM_H
+
+#include <stdint.h>
+
+/**
+   Number of 64 bit words in a block. A block fills a 64 byte cache line and
+   each key sets one bit in every word of its block.
+*/
+#define NP_BLOOM_BLOCK_WORDS 8
+
+/**
+   Number of filter bits per item the filter is sized for.
+*/
+#define NP_BLOOM_BITS_PER_ITEM 12
+
+/**
+   Smallest number of items a filter is sized for.
+*/
+#define NP_BLOOM_MIN_CAPACITY 64
+
+/**
+   Bloom filter block.
+*/
+struct NpBloomBlock {
+  /**
+     The block bits.
+  */
+  uint64_t words[NP_BLOOM_BLOCK_WORDS];
+};
+
+/**
+   Blocked Bloom filter object. Filters key hashes rather than keys, so a
+   map can maintain it from the hashes it already computes. All bits of a
+   hash fall in one cache line sized block, so a check costs a single cache
+   miss. Bits cannot be cleared, so removals are only counted and the owner
+   rebuilds the filter once np_bloom_stale() reports it.
+*/
+struct NpBloom {
+  /**
+     The blocks, aligned to a cache line.
+  */
+  struct NpBloomBlock *blocks;
+
+  /**
+     The number of blocks.
+  */
+  unsigned block_count;
+
+  /**
+     The number of items the filter is sized for.
+  */
+  unsigned capacity;
+
+  /**
+     The number of hashes added since the filter was last reset.
+  */
+  unsigned items;
+
+  /**
+     The number of removals since the filter was last reset.
+  */
+  unsigned removed;
+
+  /**
+     The number of checks made.
+  */
+  unsigned long lookups;
+
+  /**
+     The number of checks rejected by the filter.
+  */
+  unsigned long rejected;
+
+  /**
+     The number of checks passed by the filter for hashes that turned out
+     not to be in the map, as reported by the map.
+  */
+  unsigned long false_positives;
+};
+
+/**
+   Allocates memory for and initializes a filter.
+
+   @param capacity the number of items to size the filter for
+   @return a pointer to the allocated memory or NULL on error
+*/
+struct NpBloom *np_bloom_new(unsigned capacity);
+
+/**
+   Frees the memory used by the filter.
+
+   @param bloom the filter to free
+*/
+void np_bloom_free(struct NpBloom *bloom);
+
+/**
+   Clears the filter and resizes it for the given number of items. The
+   statistics are kept.
+
+   @param bloom the filter
+   @param capacity the number of items to size the filter for
+   @return the filter or NULL on error, in which case the filter is
+   unchanged
+*/
+struct NpBloom *np_bloom_reset(struct NpBloom *bloom, unsigned capacity);
+
+/**
+   Adds a hash to the filter.
+
+   @param bloom the filter
+   @param hash the key hash
+*/
+void np_bloom_add(struct NpBloom *bloom, unsigned hash);
+
+/**
+   Checks whether a hash may have been added to the filter.
+
+   @param bloom the filter
+   @param hash the key hash
+   @return 0 if the hash was definitely not added, non zero otherwise
+*/
+int np_bloom_contains(struct NpBloom *bloom, unsigned hash);
+
+/**
+   Records that an item added to the filter was removed from the map.
+
+   @param bloom the filter
+*/
+void np_bloom_remove(struct NpBloom *bloom);
+
+/**
+   Determines whether the filter should be rebuilt, either because more
+   items were added than it was sized for or because over half of them
+   were removed.
+
+   @param bloom the filter
+   @return non zero if the filter should be rebuilt
+*/
+int np_bloom_stale(struct NpBloom *bloom);
+
+/**
+   Computes the observed false positive rate: the fraction of checks for
+   absent hashes that the filter passed.
+
+   @param bloom the filter
+   @return the false positive rate, 0 if no absent hash was checked
+*/
+double np_bloom_false_positive_rate(struct NpBloom *bloom);
+
+#endif
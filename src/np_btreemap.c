@@ -0,0 +1,553 @@
+/*
+ * np_btreemap.c: nplib B+tree map
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "np_btreemap.h"
+
+/* fewest keys a node other than the root holds */
+#define NP_BTREEMAP_LEAF_MIN (NP_BTREEMAP_LEAF_KEYS / 2)
+#define NP_BTREEMAP_INNER_MIN (NP_BTREEMAP_INNER_KEYS / 2)
+
+#define NP_BTREEMAP_LEAF(n) ((struct NpBTreeMapLeaf *)(n))
+#define NP_BTREEMAP_INNER(n) ((struct NpBTreeMapInner *)(n))
+
+static void *np_btreemap_node_new(size_t size, int leaf)
+{
+  struct NpBTreeMapNode *node;
+  void *p;
+
+  if (posix_memalign(&p, NP_BTREEMAP_NODE_ALIGN, size) != 0)
+    return NULL;
+  node = p;
+  node->count = 0;
+  node->leaf = leaf;
+  return node;
+}
+
+static struct NpBTreeMapLeaf *np_btreemap_leaf_new(void)
+{
+  struct NpBTreeMapLeaf *leaf;
+
+  leaf = np_btreemap_node_new(sizeof *leaf, 1);
+  if (leaf != NULL)
+    leaf->next = NULL;
+  return leaf;
+}
+
+static struct NpBTreeMapInner *np_btreemap_inner_new(void)
+{
+  return np_btreemap_node_new(sizeof(struct NpBTreeMapInner), 0);
+}
+
+struct NpBTreeMap *np_btreemap_new(int (*comparator)(void *key1, void *key2))
+{
+  struct NpBTreeMap *map;
+
+  map = malloc(sizeof *map);
+  if (map != NULL) {
+    if ((map->root = (struct NpBTreeMapNode *)np_btreemap_leaf_new())
+	== NULL) {
+      free(map);
+      return NULL;
+    }
+    map->comparator = comparator;
+    map->size = 0;
+  }
+  return map;
+}
+
+static void np_btreemap_free_node(struct NpBTreeMapNode *node)
+{
+  unsigned i;
+
+  if (!node->leaf)
+    for (i = 0; i <= node->count; ++i)
+      np_btreemap_free_node(NP_BTREEMAP_INNER(node)->children[i]);
+  free(node);
+}
+
+void np_btreemap_free(struct NpBTreeMap *map)
+{
+  np_btreemap_free_node(map->root);
+  free(map);
+}
+
+/*
+ * Binary search for the first key of a leaf not less than the key.
+ */
+static unsigned np_btreemap_lower_bound(struct NpBTreeMap *map, void **keys,
+					unsigned count, void *key)
+{
+  unsigned low;
+  unsigned high;
+  unsigned mid;
+
+  low = 0;
+  high = count;
+  while (low < high) {
+    mid = (low + high) / 2;
+    if (map->comparator(keys[mid], key) < 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
+/*
+ * Binary search for the child of an inner node whose range holds the key:
+ * the number of separators not greater than the key.
+ */
+static unsigned np_btreemap_child_index(struct NpBTreeMap *map,
+					struct NpBTreeMapInner *inner,
+					void *key)
+{
+  unsigned low;
+  unsigned high;
+  unsigned mid;
+
+  low = 0;
+  high = inner->node.count;
+  while (low < high) {
+    mid = (low + high) / 2;
+    if (map->comparator(inner->keys[mid], key) <= 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
+void *np_btreemap_get(struct NpBTreeMap *map, void *key)
+{
+  struct NpBTreeMapNode *node;
+  struct NpBTreeMapLeaf *leaf;
+  unsigned i;
+
+  node = map->root;
+  while (!node->leaf)
+    node = NP_BTREEMAP_INNER(node)->children[
+      np_btreemap_child_index(map, NP_BTREEMAP_INNER(node), key)];
+  leaf = NP_BTREEMAP_LEAF(node);
+  i = np_btreemap_lower_bound(map, leaf->keys, node->count, key);
+  if (i < node->count && map->comparator(leaf->keys[i], key) == 0)
+    return leaf->values[i];
+  return NULL;
+}
+
+/*
+ * Splits the full child i of an inner node that has room for another key.
+ * A leaf keeps its upper half in a new right sibling whose first key is
+ * copied up; an inner node moves its middle key up.
+ */
+static int np_btreemap_split_child(struct NpBTreeMapInner *parent,
+				   unsigned i)
+{
+  struct NpBTreeMapNode *child;
+  struct NpBTreeMapLeaf *leaf;
+  struct NpBTreeMapLeaf *right_leaf;
+  struct NpBTreeMapInner *inner;
+  struct NpBTreeMapInner *right_inner;
+  struct NpBTreeMapNode *right;
+  void *separator;
+  unsigned keep;
+
+  child = parent->children[i];
+  if (child->leaf) {
+    if ((right_leaf = np_btreemap_leaf_new()) == NULL)
+      return -1;
+    leaf = NP_BTREEMAP_LEAF(child);
+    keep = (child->count + 1) / 2;
+    right_leaf->node.count = child->count - keep;
+    memcpy(right_leaf->keys, leaf->keys + keep,
+	   sizeof *leaf->keys * right_leaf->node.count);
+    memcpy(right_leaf->values, leaf->values + keep,
+	   sizeof *leaf->values * right_leaf->node.count);
+    right_leaf->next = leaf->next;
+    leaf->next = right_leaf;
+    child->count = keep;
+    separator = right_leaf->keys[0];
+    right = &right_leaf->node;
+  } else {
+    if ((right_inner = np_btreemap_inner_new()) == NULL)
+      return -1;
+    inner = NP_BTREEMAP_INNER(child);
+    keep = child->count / 2;
+    right_inner->node.count = child->count - keep - 1;
+    memcpy(right_inner->keys, inner->keys + keep + 1,
+	   sizeof *inner->keys * right_inner->node.count);
+    memcpy(right_inner->children, inner->children + keep + 1,
+	   sizeof *inner->children * (right_inner->node.count + 1));
+    child->count = keep;
+    separator = inner->keys[keep];
+    right = &right_inner->node;
+  }
+  memmove(parent->keys + i + 1, parent->keys + i,
+	  sizeof *parent->keys * (parent->node.count - i));
+  memmove(parent->children + i + 2, parent->children + i + 1,
+	  sizeof *parent->children * (parent->node.count - i));
+  parent->keys[i] = separator;
+  parent->children[i + 1] = right;
+  parent->node.count++;
+  return 0;
+}
+
+static int np_btreemap_full(struct NpBTreeMapNode *node)
+{
+  return node->count == (node->leaf ? NP_BTREEMAP_LEAF_KEYS
+			 : NP_BTREEMAP_INNER_KEYS);
+}
+
+/*
+ * Inserts top down, splitting every full node on the way so that a split
+ * never has to travel back up. A failed allocation leaves a valid tree.
+ */
+void *np_btreemap_put(struct NpBTreeMap *map, void *key, void *value)
+{
+  struct NpBTreeMapInner *root;
+  struct NpBTreeMapInner *inner;
+  struct NpBTreeMapNode *node;
+  struct NpBTreeMapLeaf *leaf;
+  unsigned i;
+
+  if (np_btreemap_full(map->root)) {
+    if ((root = np_btreemap_inner_new()) == NULL)
+      return NULL;
+    root->children[0] = map->root;
+    if (np_btreemap_split_child(root, 0) != 0) {
+      free(root);
+      return NULL;
+    }
+    map->root = &root->node;
+  }
+  node = map->root;
+  while (!node->leaf) {
+    inner = NP_BTREEMAP_INNER(node);
+    i = np_btreemap_child_index(map, inner, key);
+    if (np_btreemap_full(inner->children[i])) {
+      if (np_btreemap_split_child(inner, i) != 0)
+	return NULL;
+      if (map->comparator(inner->keys[i], key) <= 0)
+	i++;
+    }
+    node = inner->children[i];
+  }
+
+  leaf = NP_BTREEMAP_LEAF(node);
+  i = np_btreemap_lower_bound(map, leaf->keys, node->count, key);
+  if (i < node->count && map->comparator(leaf->keys[i], key) == 0) {
+    leaf->values[i] = value;
+    return value;
+  }
+  memmove(leaf->keys + i + 1, leaf->keys + i,
+	  sizeof *leaf->keys * (node->count - i));
+  memmove(leaf->values + i + 1, leaf->values + i,
+	  sizeof *leaf->values * (node->count - i));
+  leaf->keys[i] = key;
+  leaf->values[i] = value;
+  node->count++;
+  map->size++;
+  return value;
+}
+
+/*
+ * Moves the last item or child of the left sibling of child i to the front
+ * of the child, through the separator for inner nodes.
+ */
+static void np_btreemap_borrow_left(struct NpBTreeMapInner *parent,
+				    unsigned i)
+{
+  struct NpBTreeMapNode *child;
+  struct NpBTreeMapNode *left;
+  struct NpBTreeMapLeaf *c;
+  struct NpBTreeMapLeaf *l;
+  struct NpBTreeMapInner *ci;
+  struct NpBTreeMapInner *li;
+
+  child = parent->children[i];
+  left = parent->children[i - 1];
+  if (child->leaf) {
+    c = NP_BTREEMAP_LEAF(child);
+    l = NP_BTREEMAP_LEAF(left);
+    memmove(c->keys + 1, c->keys, sizeof *c->keys * child->count);
+    memmove(c->values + 1, c->values, sizeof *c->values * child->count);
+    c->keys[0] = l->keys[left->count - 1];
+    c->values[0] = l->values[left->count - 1];
+    parent->keys[i - 1] = c->keys[0];
+  } else {
+    ci = NP_BTREEMAP_INNER(child);
+    li = NP_BTREEMAP_INNER(left);
+    memmove(ci->keys + 1, ci->keys, sizeof *ci->keys * child->count);
+    memmove(ci->children + 1, ci->children,
+	    sizeof *ci->children * (child->count + 1));
+    ci->keys[0] = parent->keys[i - 1];
+    ci->children[0] = li->children[left->count];
+    parent->keys[i - 1] = li->keys[left->count - 1];
+  }
+  left->count--;
+  child->count++;
+}
+
+/*
+ * Moves the first item or child of the right sibling of child i to the end
+ * of the child, through the separator for inner nodes.
+ */
+static void np_btreemap_borrow_right(struct NpBTreeMapInner *parent,
+				     unsigned i)
+{
+  struct NpBTreeMapNode *child;
+  struct NpBTreeMapNode *right;
+  struct NpBTreeMapLeaf *c;
+  struct NpBTreeMapLeaf *r;
+  struct NpBTreeMapInner *ci;
+  struct NpBTreeMapInner *ri;
+
+  child = parent->children[i];
+  right = parent->children[i + 1];
+  if (child->leaf) {
+    c = NP_BTREEMAP_LEAF(child);
+    r = NP_BTREEMAP_LEAF(right);
+    c->keys[child->count] = r->keys[0];
+    c->values[child->count] = r->values[0];
+    memmove(r->keys, r->keys + 1, sizeof *r->keys * (right->count - 1));
+    memmove(r->values, r->values + 1, sizeof *r->values * (right->count - 1));
+    parent->keys[i] = r->keys[0];
+  } else {
+    ci = NP_BTREEMAP_INNER(child);
+    ri = NP_BTREEMAP_INNER(right);
+    ci->keys[child->count] = parent->keys[i];
+    ci->children[child->count + 1] = ri->children[0];
+    parent->keys[i] = ri->keys[0];
+    memmove(ri->keys, ri->keys + 1, sizeof *ri->keys * (right->count - 1));
+    memmove(ri->children, ri->children + 1,
+	    sizeof *ri->children * right->count);
+  }
+  right->count--;
+  child->count++;
+}
+
+/*
+ * Merges child i + 1 into child i and drops their separator.
+ */
+static void np_btreemap_merge(struct NpBTreeMapInner *parent, unsigned i)
+{
+  struct NpBTreeMapNode *child;
+  struct NpBTreeMapNode *right;
+  struct NpBTreeMapLeaf *c;
+  struct NpBTreeMapLeaf *r;
+  struct NpBTreeMapInner *ci;
+  struct NpBTreeMapInner *ri;
+
+  child = parent->children[i];
+  right = parent->children[i + 1];
+  if (child->leaf) {
+    c = NP_BTREEMAP_LEAF(child);
+    r = NP_BTREEMAP_LEAF(right);
+    memcpy(c->keys + child->count, r->keys, sizeof *r->keys * right->count);
+    memcpy(c->values + child->count, r->values,
+	   sizeof *r->values * right->count);
+    c->next = r->next;
+    child->count += right->count;
+  } else {
+    ci = NP_BTREEMAP_INNER(child);
+    ri = NP_BTREEMAP_INNER(right);
+    ci->keys[child->count] = parent->keys[i];
+    memcpy(ci->keys + child->count + 1, ri->keys,
+	   sizeof *ri->keys * right->count);
+    memcpy(ci->children + child->count + 1, ri->children,
+	   sizeof *ri->children * (right->count + 1));
+    child->count += right->count + 1;
+  }
+  free(right);
+  memmove(parent->keys + i, parent->keys + i + 1,
+	  sizeof *parent->keys * (parent->node.count - i - 1));
+  memmove(parent->children + i + 1, parent->children + i + 2,
+	  sizeof *parent->children * (parent->node.count - i - 1));
+  parent->node.count--;
+}
+
+/*
+ * Gives child i of an inner node more than the minimum number of keys, so
+ * that removing one below it cannot underflow it, and returns the index of
+ * the child now covering the child's range.
+ */
+static unsigned np_btreemap_fill_child(struct NpBTreeMapInner *parent,
+				       unsigned i)
+{
+  unsigned min;
+
+  min = parent->children[i]->leaf ? NP_BTREEMAP_LEAF_MIN
+    : NP_BTREEMAP_INNER_MIN;
+  if (parent->children[i]->count > min)
+    return i;
+  if (i > 0 && parent->children[i - 1]->count > min) {
+    np_btreemap_borrow_left(parent, i);
+  } else if (i < parent->node.count
+	     && parent->children[i + 1]->count > min) {
+    np_btreemap_borrow_right(parent, i);
+  } else if (i < parent->node.count) {
+    np_btreemap_merge(parent, i);
+  } else {
+    np_btreemap_merge(parent, i - 1);
+    return i - 1;
+  }
+  return i;
+}
+
+/*
+ * Removes top down, topping up every node on the way before descending into
+ * it so that the removal from the leaf never needs fixing up afterwards.
+ *
+ * A separator is always the key stored first in the leftmost leaf to its
+ * right; splits, borrows and merges keep it so. The separator that may hold
+ * the removed key is therefore the last one passed on the way down, and it
+ * is replaced by the leaf's new first key so that it does not outlive the
+ * key.
+ */
+void *np_btreemap_remove(struct NpBTreeMap *map, void *key)
+{
+  struct NpBTreeMapInner *inner;
+  struct NpBTreeMapNode *node;
+  struct NpBTreeMapLeaf *leaf;
+  void **separator;
+  unsigned i;
+  void *removed;
+  void *value;
+
+  separator = NULL;
+  node = map->root;
+  while (!node->leaf) {
+    inner = NP_BTREEMAP_INNER(node);
+    i = np_btreemap_fill_child(inner,
+			       np_btreemap_child_index(map, inner, key));
+    node = inner->children[i];
+    if (i > 0)
+      separator = inner->keys + i - 1;
+
+    /* a merge may have emptied the root */
+    if (inner->node.count == 0) {
+      map->root = node;
+      free(inner);
+    }
+  }
+
+  leaf = NP_BTREEMAP_LEAF(node);
+  i = np_btreemap_lower_bound(map, leaf->keys, node->count, key);
+  if (i == node->count || map->comparator(leaf->keys[i], key) != 0)
+    return NULL;
+  removed = leaf->keys[i];
+  value = leaf->values[i];
+  memmove(leaf->keys + i, leaf->keys + i + 1,
+	  sizeof *leaf->keys * (node->count - i - 1));
+  memmove(leaf->values + i, leaf->values + i + 1,
+	  sizeof *leaf->values * (node->count - i - 1));
+  node->count--;
+
+  /* a leaf below a separator keeps more than the minimum number of keys */
+  if (separator != NULL && *separator == removed)
+    *separator = leaf->keys[0];
+  map->size--;
+  return value;
+}
+
+static void np_btreemap_stats_node(struct NpBTreeMapNode *node,
+				   unsigned depth,
+				   struct NpBTreeMapStats *stats)
+{
+  unsigned i;
+
+  if (depth > stats->height)
+    stats->height = depth;
+  if (node->leaf) {
+    stats->leaves++;
+    stats->bytes += sizeof(struct NpBTreeMapLeaf);
+    return;
+  }
+  stats->inners++;
+  stats->bytes += sizeof(struct NpBTreeMapInner);
+  for (i = 0; i <= node->count; ++i)
+    np_btreemap_stats_node(NP_BTREEMAP_INNER(node)->children[i], depth + 1,
+			   stats);
+}
+
+void np_btreemap_stats(struct NpBTreeMap *map, struct NpBTreeMapStats *stats)
+{
+  memset(stats, 0, sizeof *stats);
+  stats->size = map->size;
+  stats->bytes = sizeof *map;
+  np_btreemap_stats_node(map->root, 1, stats);
+  stats->fill = (double)map->size / stats->leaves / NP_BTREEMAP_LEAF_KEYS;
+}
+
+/*
+ * Moves the iterator past empty leaves, of which only the root can be one.
+ */
+static void np_btreemap_iterator_settle(struct NpBTreeMapIterator *iter)
+{
+  while (iter->leaf != NULL && iter->index == iter->leaf->node.count) {
+    iter->leaf = iter->leaf->next;
+    iter->index = 0;
+  }
+}
+
+struct NpBTreeMapIterator *np_btreemap_iterator(struct NpBTreeMap *map)
+{
+  struct NpBTreeMapIterator *iter;
+  struct NpBTreeMapNode *node;
+
+  iter = malloc(sizeof *iter);
+  if (iter != NULL) {
+    iter->map = map;
+    for (node = map->root; !node->leaf;)
+      node = NP_BTREEMAP_INNER(node)->children[0];
+    iter->leaf = NP_BTREEMAP_LEAF(node);
+    iter->index = 0;
+    np_btreemap_iterator_settle(iter);
+  }
+  return iter;
+}
+
+void np_btreemap_iterator_free(struct NpBTreeMapIterator *iter)
+{
+  free(iter);
+}
+
+void *np_btreemap_iterator_next_key(struct NpBTreeMapIterator *iter)
+{
+  void *key;
+
+  if (iter->leaf == NULL)
+    return NULL;
+  key = iter->leaf->keys[iter->index++];
+  np_btreemap_iterator_settle(iter);
+  return key;
+}
+
+void *np_btreemap_iterator_peek_next_key(struct NpBTreeMapIterator *iter)
+{
+  return iter->leaf != NULL ? iter->leaf->keys[iter->index] : NULL;
+}
+
+void *np_btreemap_iterator_peek_next_value(struct NpBTreeMapIterator *iter)
+{
+  return iter->leaf != NULL ? iter->leaf->values[iter->index] : NULL;
+}
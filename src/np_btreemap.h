@@ -0,0 +1,267 @@
+/*
+ * np_btreemap.h: nplib B+tree map header file
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NP_BTREEMAP_H
+#define __NP_BTREEMAP_H
+
+#include <stddef.h>
+
+/**
+   Alignment of the tree nodes, the size of a cache line.
+*/
+#define NP_BTREEMAP_NODE_ALIGN 64
+
+/**
+   Maximum number of keys in a leaf and in an inner node. Chosen so that
+   each node fills 8 cache lines on 64 bit platforms.
+*/
+#define NP_BTREEMAP_LEAF_KEYS 31
+#define NP_BTREEMAP_INNER_KEYS 31
+
+/**
+   Header shared by leaves and inner nodes.
+*/
+struct NpBTreeMapNode {
+  /**
+     The number of keys in the node.
+  */
+  unsigned count;
+
+  /**
+     Non-zero for a leaf.
+  */
+  int leaf;
+};
+
+/**
+   Leaf node, holding keys and their values in key order.
+*/
+struct NpBTreeMapLeaf {
+  /**
+     The node header.
+  */
+  struct NpBTreeMapNode node;
+
+  /**
+     The next leaf in key order, NULL for the last leaf.
+  */
+  struct NpBTreeMapLeaf *next;
+
+  /**
+     The keys.
+  */
+  void *keys[NP_BTREEMAP_LEAF_KEYS];
+
+  /**
+     The values, values[i] belonging to keys[i].
+  */
+  void *values[NP_BTREEMAP_LEAF_KEYS];
+};
+
+/**
+   Inner node. The keys of children[i] are less than keys[i], which is no
+   greater than any key of children[i + 1].
+*/
+struct NpBTreeMapInner {
+  /**
+     The node header.
+  */
+  struct NpBTreeMapNode node;
+
+  /**
+     The separator keys.
+  */
+  void *keys[NP_BTREEMAP_INNER_KEYS];
+
+  /**
+     The children, one more than the keys.
+  */
+  struct NpBTreeMapNode *children[NP_BTREEMAP_INNER_KEYS + 1];
+};
+
+/**
+   B+tree map statistics.
+*/
+struct NpBTreeMapStats {
+  /**
+     The number of items in the map.
+  */
+  unsigned size;
+
+  /**
+     The number of levels of the tree, 1 for a map with a single leaf.
+  */
+  unsigned height;
+
+  /**
+     The number of leaves.
+  */
+  unsigned leaves;
+
+  /**
+     The number of inner nodes.
+  */
+  unsigned inners;
+
+  /**
+     The mean fraction of the leaf slots holding an item.
+  */
+  double fill;
+
+  /**
+     The number of bytes of memory used by the map and its nodes. Does not
+     include the keys and values.
+  */
+  size_t bytes;
+};
+
+/**
+   B+tree map object. Items are kept in wide, cache line aligned leaves
+   linked in key order, so a get touches one node per level and scans read
+   leaves sequentially.
+*/
+struct NpBTreeMap {
+  /**
+     A comparator function for the map keys.
+  */
+  int (*comparator)(void *key1, void *key2);
+
+  /**
+     The root node, an empty leaf for an empty map.
+  */
+  struct NpBTreeMapNode *root;
+
+  /**
+     The number of items in the map.
+  */
+  unsigned size;
+};
+
+/**
+   B+tree map iterator.
+*/
+struct NpBTreeMapIterator {
+  /**
+     The map being iterated over.
+  */
+  struct NpBTreeMap *map;
+
+  /**
+     The leaf holding the next item, NULL once the items are exhausted.
+  */
+  struct NpBTreeMapLeaf *leaf;
+
+  /**
+     The index of the next item in the leaf.
+  */
+  unsigned index;
+};
+
+/**
+   Allocates memory for and initializes a B+tree map.
+
+   @param comparator the key comparator function
+   @return a pointer to the allocated memory or NULL on error
+*/
+struct NpBTreeMap *np_btreemap_new(int (*comparator)(void *key1, void *key2));
+
+/**
+   Frees the memory used by the map. Does not free the keys or values contained
+   in the map.
+
+   @param map the map to free
+*/
+void np_btreemap_free(struct NpBTreeMap *map);
+
+/**
+   Puts a item into the map.
+
+   @param map the map
+   @param key the key used to store/retrieve the value
+   @param value the value
+   @return a pointer to the added item or NULL on error
+*/
+void *np_btreemap_put(struct NpBTreeMap *map, void *key, void *value);
+
+/**
+   Gets an item from the map.
+
+   @param map the map
+   @param key the search key
+   @return a pointer to the item or NULL if the item is not found
+*/
+void *np_btreemap_get(struct NpBTreeMap *map, void *key);
+
+/**
+   Removes an item from the map.
+
+   @param map the map
+   @param key the search key
+   @return the removed item or NULL if the item is not found
+*/
+void *np_btreemap_remove(struct NpBTreeMap *map, void *key);
+
+/**
+   Gathers statistics about the map's shape and memory use.
+
+   @param map the map
+   @param stats receives the statistics
+*/
+void np_btreemap_stats(struct NpBTreeMap *map, struct NpBTreeMapStats *stats);
+
+/**
+   Creates an iterator over the map keys in key order. The map must not be
+   modified while using the iterator.
+
+   @param map the map
+   @return the iterator or NULL on error
+*/
+struct NpBTreeMapIterator *np_btreemap_iterator(struct NpBTreeMap *map);
+
+/**
+   Frees the memory used by the iterator.
+
+   @param iter the iterator
+*/
+void np_btreemap_iterator_free(struct NpBTreeMapIterator *iter);
+
+/**
+   Retrieves the next key from the iterator.
+
+   @param iter the iterator
+   @return the next key or NULL if there are no more keys
+*/
+void *np_btreemap_iterator_next_key(struct NpBTreeMapIterator *iter);
+
+/**
+   Retrieves the next key without advancing the iterator.
+
+   @param iter the iterator
+   @return the next key or NULL if there are no more keys
+*/
+void *np_btreemap_iterator_peek_next_key(struct NpBTreeMapIterator *iter);
+
+/**
+   Retrieves the next value without advancing the iterator.
+
+   @param iter the iterator
+   @return the next value or NULL if there are no more values
+*/
+void *np_btreemap_iterator_peek_next_value(struct NpBTreeMapIterator *iter);
+
+#endif
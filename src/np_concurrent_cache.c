@@ -0,0 +1,322 @@
+/*
+ * np_concurrent_cache.c: nplib sharded concurrent cache
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "np_concurrent_cache.h"
+#include "np_lrucache.h"
+#include "np_hashmap.h"
+
+#define NP_CONCURRENT_CACHE_SKETCH_ROWS 4
+#define NP_CONCURRENT_CACHE_SKETCH_MAX 15
+
+/* odd multiplier spreading every bit of the mixed hash into its high bits */
+#define NP_CONCURRENT_CACHE_SKETCH_MIX 0x9e3779b97f4a7c15ULL
+
+/*
+ * A shard. The frequency sketch is a count-min sketch of small saturating
+ * counters with four counters per row for each entry the shard can hold.
+ * Once it has recorded ten accesses per entry all counters are halved, so
+ * old popularity fades.
+ */
+struct NpConcurrentCacheShard {
+  pthread_mutex_t lock;
+  struct NpLruCache *cache;
+  unsigned char *sketch;
+  unsigned sketch_mask;
+  unsigned sketch_count;
+  unsigned sketch_sample;
+  unsigned long rejected;
+
+  /* keeps the locks of neighbouring shards off a shared cache line */
+  char pad[64];
+};
+
+static int np_concurrent_cache_shard_init(
+  struct NpConcurrentCache *cache, struct NpConcurrentCacheShard *shard,
+  size_t capacity)
+{
+  unsigned width;
+
+  width = 64;
+  while (width < capacity * 4 && width < NP_CONCURRENT_CACHE_MAX_SKETCH_WIDTH)
+    width <<= 1;
+  shard->sketch_mask = width - 1;
+  shard->sketch_count = 0;
+  shard->sketch_sample = width / 4 * 10;
+  shard->rejected = 0;
+  shard->sketch = calloc(NP_CONCURRENT_CACHE_SKETCH_ROWS, width);
+  shard->cache = np_lrucache_new(cache->key_compare, cache->key_hash,
+				 capacity);
+  if (shard->sketch == NULL || shard->cache == NULL
+      || pthread_mutex_init(&shard->lock, NULL) != 0) {
+    free(shard->sketch);
+    if (shard->cache != NULL)
+      np_lrucache_free(shard->cache);
+    return -1;
+  }
+  np_lrucache_set_policy(shard->cache, NP_LRUCACHE_CLOCK);
+  return 0;
+}
+
+static void np_concurrent_cache_shard_destroy(
+  struct NpConcurrentCacheShard *shard)
+{
+  pthread_mutex_destroy(&shard->lock);
+  np_lrucache_free(shard->cache);
+  free(shard->sketch);
+}
+
+struct NpConcurrentCache *np_concurrent_cache_new(
+  int (*key_compare)(void *key1, void *key2), unsigned (*key_hash)(void *key),
+  size_t capacity, unsigned shards)
+{
+  struct NpConcurrentCache *cache;
+  unsigned i;
+
+  if (shards == 0)
+    shards = NP_CONCURRENT_CACHE_DEFAULT_SHARDS;
+  if (capacity > 0 && shards > capacity)
+    shards = capacity;
+  cache = malloc(sizeof *cache);
+  if (cache != NULL) {
+    cache->key_compare = key_compare;
+    cache->key_hash = key_hash;
+    cache->admission = NP_CONCURRENT_CACHE_ADMIT_ALL;
+    cache->shard_count = shards;
+    if ((cache->shards = malloc(sizeof *cache->shards * shards)) == NULL) {
+      free(cache);
+      return NULL;
+    }
+    for (i = 0; i < shards; ++i) {
+      if (np_concurrent_cache_shard_init(cache, &cache->shards[i],
+					 capacity / shards
+					 + (i < capacity % shards)) != 0) {
+	while (i-- > 0)
+	  np_concurrent_cache_shard_destroy(&cache->shards[i]);
+	free(cache->shards);
+	free(cache);
+	return NULL;
+      }
+    }
+  }
+  return cache;
+}
+
+void np_concurrent_cache_free(struct NpConcurrentCache *cache)
+{
+  unsigned i;
+
+  for (i = 0; i < cache->shard_count; ++i)
+    np_concurrent_cache_shard_destroy(&cache->shards[i]);
+  free(cache->shards);
+  free(cache);
+}
+
+void np_concurrent_cache_set_admission(
+  struct NpConcurrentCache *cache, enum NpConcurrentCacheAdmission admission)
+{
+  cache->admission = admission;
+}
+
+void np_concurrent_cache_set_evict(struct NpConcurrentCache *cache,
+				   void (*evict)(void *key, void *value))
+{
+  unsigned i;
+
+  for (i = 0; i < cache->shard_count; ++i)
+    np_lrucache_set_evict(cache->shards[i].cache, evict);
+}
+
+/*
+ * Selects a shard from the high bits of the 64 bit hash of the key hash,
+ * so that keys spread over the shards even when the key hash is weak, such
+ * as the identity of small integers.
+ */
+static struct NpConcurrentCacheShard *np_concurrent_cache_shard(
+  struct NpConcurrentCache *cache, uint64_t h)
+{
+  return &cache->shards[((h >> 32) * cache->shard_count) >> 32];
+}
+
+/*
+ * Estimates the access frequency of a key as the smallest of its counters.
+ * Each row takes its counter index from a different 16 bits of the 64 bit
+ * hash of the key hash. The high bits of that hash selected the shard and
+ * are alike for all its keys, so the hash is first multiplied to fill them
+ * from the low bits.
+ */
+static unsigned np_concurrent_cache_frequency(
+  struct NpConcurrentCacheShard *shard, uint64_t h)
+{
+  unsigned frequency;
+  unsigned count;
+  unsigned i;
+
+  h *= NP_CONCURRENT_CACHE_SKETCH_MIX;
+  frequency = NP_CONCURRENT_CACHE_SKETCH_MAX;
+  for (i = 0; i < NP_CONCURRENT_CACHE_SKETCH_ROWS; ++i) {
+    count = shard->sketch[i * (shard->sketch_mask + 1)
+			  + ((h >> 16 * i) & shard->sketch_mask)];
+    if (count < frequency)
+      frequency = count;
+  }
+  return frequency;
+}
+
+static void np_concurrent_cache_record(struct NpConcurrentCacheShard *shard,
+				       uint64_t h)
+{
+  unsigned char *counter;
+  unsigned i;
+
+  h *= NP_CONCURRENT_CACHE_SKETCH_MIX;
+  for (i = 0; i < NP_CONCURRENT_CACHE_SKETCH_ROWS; ++i) {
+    counter = &shard->sketch[i * (shard->sketch_mask + 1)
+			     + ((h >> 16 * i) & shard->sketch_mask)];
+    if (*counter < NP_CONCURRENT_CACHE_SKETCH_MAX)
+      (*counter)++;
+  }
+  if (++shard->sketch_count == shard->sketch_sample) {
+    for (i = 0; i < NP_CONCURRENT_CACHE_SKETCH_ROWS * (shard->sketch_mask + 1);
+	 ++i)
+      shard->sketch[i] >>= 1;
+    shard->sketch_count /= 2;
+  }
+}
+
+/*
+ * Decides whether a new key that does not fit in the shard is worth
+ * evicting the shard's next victim. The caller must hold the shard's lock.
+ */
+static int np_concurrent_cache_admit(struct NpConcurrentCacheShard *shard,
+				     void *key, unsigned hash, uint64_t h,
+				     size_t size)
+{
+  struct NpLruCacheEntry *victim;
+  struct NpLruCache *lru;
+
+  lru = shard->cache;
+  if (lru->capacity - lru->used >= size
+      || np_hashmap_get_item(lru->map, key, hash) != NULL
+      || (victim = np_lrucache_victim(lru)) == NULL)
+    return 1;
+  return np_concurrent_cache_frequency(shard, h)
+    > np_concurrent_cache_frequency(
+      shard, np_hashmap_hash64_u32(victim->item.hash));
+}
+
+void *np_concurrent_cache_put(struct NpConcurrentCache *cache, void *key,
+			      void *value)
+{
+  return np_concurrent_cache_put_sized(cache, key, value, 1);
+}
+
+void *np_concurrent_cache_put_sized(struct NpConcurrentCache *cache,
+				    void *key, void *value, size_t size)
+{
+  struct NpConcurrentCacheShard *shard;
+  unsigned hash;
+  uint64_t h;
+  void *ret;
+
+  hash = cache->key_hash(key);
+  h = np_hashmap_hash64_u32(hash);
+  shard = np_concurrent_cache_shard(cache, h);
+  pthread_mutex_lock(&shard->lock);
+  if (cache->admission == NP_CONCURRENT_CACHE_ADMIT_TINYLFU) {
+    np_concurrent_cache_record(shard, h);
+    if (!np_concurrent_cache_admit(shard, key, hash, h, size)) {
+      shard->rejected++;
+      pthread_mutex_unlock(&shard->lock);
+      return NULL;
+    }
+  }
+  ret = np_lrucache_put_hashed(shard->cache, key, value, size, hash);
+  pthread_mutex_unlock(&shard->lock);
+  return ret;
+}
+
+void *np_concurrent_cache_get(struct NpConcurrentCache *cache, void *key)
+{
+  struct NpConcurrentCacheShard *shard;
+  unsigned hash;
+  uint64_t h;
+  void *ret;
+
+  hash = cache->key_hash(key);
+  h = np_hashmap_hash64_u32(hash);
+  shard = np_concurrent_cache_shard(cache, h);
+  pthread_mutex_lock(&shard->lock);
+  if (cache->admission == NP_CONCURRENT_CACHE_ADMIT_TINYLFU)
+    np_concurrent_cache_record(shard, h);
+  ret = np_lrucache_get_hashed(shard->cache, key, hash);
+  pthread_mutex_unlock(&shard->lock);
+  return ret;
+}
+
+void *np_concurrent_cache_remove(struct NpConcurrentCache *cache, void *key)
+{
+  struct NpConcurrentCacheShard *shard;
+  unsigned hash;
+  void *ret;
+
+  hash = cache->key_hash(key);
+  shard = np_concurrent_cache_shard(cache, np_hashmap_hash64_u32(hash));
+  pthread_mutex_lock(&shard->lock);
+  ret = np_lrucache_remove_hashed(shard->cache, key, hash);
+  pthread_mutex_unlock(&shard->lock);
+  return ret;
+}
+
+void np_concurrent_cache_shard_stats(struct NpConcurrentCache *cache,
+				     unsigned shard,
+				     struct NpConcurrentCacheStats *stats)
+{
+  struct NpConcurrentCacheShard *s;
+
+  s = &cache->shards[shard];
+  pthread_mutex_lock(&s->lock);
+  stats->size = np_lrucache_size(s->cache);
+  stats->hits = s->cache->hits;
+  stats->misses = s->cache->misses;
+  stats->evictions = s->cache->evictions;
+  stats->rejected = s->rejected;
+  pthread_mutex_unlock(&s->lock);
+}
+
+void np_concurrent_cache_stats(struct NpConcurrentCache *cache,
+			       struct NpConcurrentCacheStats *stats)
+{
+  struct NpConcurrentCacheStats shard;
+  unsigned i;
+
+  memset(stats, 0, sizeof *stats);
+  for (i = 0; i < cache->shard_count; ++i) {
+    np_concurrent_cache_shard_stats(cache, i, &shard);
+    stats->size += shard.size;
+    stats->hits += shard.hits;
+    stats->misses += shard.misses;
+    stats->evictions += shard.evictions;
+    stats->rejected += shard.rejected;
+  }
+}
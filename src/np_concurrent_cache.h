@@ -0,0 +1,232 @@
+/*
+ * np_concurrent_cache.h: nplib sharded concurrent cache header file
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NP_CONCURRENT_CACHE_H
+#define __NP_CONCURRENT_CACHE_H
+
+#include <stddef.h>
+
+#define NP_CONCURRENT_CACHE_DEFAULT_SHARDS 64
+
+/**
+   Largest number of counters in each row of a shard's frequency sketch.
+*/
+#define NP_CONCURRENT_CACHE_MAX_SKETCH_WIDTH 65536
+
+/**
+   Cache admission policy.
+*/
+enum NpConcurrentCacheAdmission {
+  /**
+     Admit every new entry, evicting as needed.
+  */
+  NP_CONCURRENT_CACHE_ADMIT_ALL,
+
+  /**
+     TinyLFU admission. Each shard estimates how often keys are accessed and
+     a new entry that would force an eviction is only admitted if its key is
+     accessed more often than the key of the entry it would evict.
+  */
+  NP_CONCURRENT_CACHE_ADMIT_TINYLFU
+};
+
+/**
+   Cache statistics, for one shard or summed over all shards.
+*/
+struct NpConcurrentCacheStats {
+  /**
+     The number of entries.
+  */
+  unsigned size;
+
+  /**
+     The number of gets that found their key.
+  */
+  unsigned long hits;
+
+  /**
+     The number of gets that did not find their key.
+  */
+  unsigned long misses;
+
+  /**
+     The number of entries evicted.
+  */
+  unsigned long evictions;
+
+  /**
+     The number of new entries refused by the admission policy.
+  */
+  unsigned long rejected;
+};
+
+/**
+   Thread safe bounded cache object. The cache is partitioned into shards
+   selected by the high bits of a 64 bit hash of the key hash. Each shard is an np_lrucache
+   using CLOCK replacement, guarded by its own mutex and with its own
+   admission state and statistics, so threads only contend when they use
+   the same shard.
+*/
+struct NpConcurrentCache {
+  /**
+     Pointer to a function used to compare cache keys.
+
+     @param key1 the first key
+     @param key2 the second key
+     @return 0 if keys are equal, value > 0 if first key is greater than
+     the second key, value < 0 if the first key is lesser than the second
+  */
+  int (*key_compare)(void *key1, void *key2);
+
+  /**
+     Pointer to a function used to hash keys. Must be safe to call from
+     multiple threads.
+
+     @param key the key to hash
+     @return the hash
+  */
+  unsigned (*key_hash)(void *key);
+
+  /**
+     The admission policy.
+  */
+  enum NpConcurrentCacheAdmission admission;
+
+  /**
+     The number of shards.
+  */
+  unsigned shard_count;
+
+  /**
+     The shards.
+  */
+  struct NpConcurrentCacheShard *shards;
+};
+
+/**
+   Allocates memory for and initializes a concurrent cache. The capacity is
+   divided between the shards, whose capacities differ by at most one and
+   add up to the capacity. A capacity smaller than the number of shards
+   lowers the number of shards to the capacity.
+
+   @param key_compare the function to be used for comparing keys
+   @param key_hash the function to be used for hashing keys
+   @param capacity the maximum total size of the entries
+   @param shards the number of shards or 0 for the default
+   @return a pointer to the allocated memory or NULL on error
+*/
+struct NpConcurrentCache *np_concurrent_cache_new(
+  int (*key_compare)(void *key1, void *key2), unsigned (*key_hash)(void *key),
+  size_t capacity, unsigned shards);
+
+/**
+   Frees the memory used by the cache. Does not free the keys or values. No
+   other thread may be using the cache.
+
+   @param cache the cache to free
+*/
+void np_concurrent_cache_free(struct NpConcurrentCache *cache);
+
+/**
+   Sets the admission policy. Must be called before the cache is shared
+   between threads.
+
+   @param cache the cache
+   @param admission the admission policy
+*/
+void np_concurrent_cache_set_admission(
+  struct NpConcurrentCache *cache, enum NpConcurrentCacheAdmission admission);
+
+/**
+   Sets the function called for evicted entries. The function is called with
+   the shard's lock held and must not use the cache. Must be called before
+   the cache is shared between threads.
+
+   @param cache the cache
+   @param evict the function to call or NULL
+*/
+void np_concurrent_cache_set_evict(struct NpConcurrentCache *cache,
+				   void (*evict)(void *key, void *value));
+
+/**
+   Puts an entry of size 1 into the cache.
+
+   @param cache the cache in which to put the entry
+   @param key the key at which to store the value, replacing an existing entry
+   @param value the value to store
+   @return a pointer to the added value or NULL on error or if the entry was
+   not admitted
+*/
+void *np_concurrent_cache_put(struct NpConcurrentCache *cache, void *key,
+			      void *value);
+
+/**
+   Puts an entry of the given size into the cache.
+
+   @param cache the cache in which to put the entry
+   @param key the key at which to store the value, replacing an existing entry
+   @param value the value to store
+   @param size the entry size charged against the shard capacity
+   @return a pointer to the added value or NULL on error, if the size exceeds
+   the shard capacity, or if the entry was not admitted
+*/
+void *np_concurrent_cache_put_sized(struct NpConcurrentCache *cache,
+				    void *key, void *value, size_t size);
+
+/**
+   Gets a value from the cache. The value may be evicted by another thread
+   as soon as this returns.
+
+   @param cache the cache from which to retrieve the value
+   @param key the key of the value to retrieve
+   @return a pointer to the value or NULL if the key is not in the cache
+*/
+void *np_concurrent_cache_get(struct NpConcurrentCache *cache, void *key);
+
+/**
+   Removes an entry from the cache without calling the eviction callback.
+
+   @param cache the cache from which to remove the entry
+   @param key the key of the entry to remove
+   @return a pointer to the removed value or NULL if there is no entry at the
+   given key
+*/
+void *np_concurrent_cache_remove(struct NpConcurrentCache *cache, void *key);
+
+/**
+   Gets the statistics of one shard.
+
+   @param cache the cache
+   @param shard the shard index, less than cache->shard_count
+   @param stats receives the statistics
+*/
+void np_concurrent_cache_shard_stats(struct NpConcurrentCache *cache,
+				     unsigned shard,
+				     struct NpConcurrentCacheStats *stats);
+
+/**
+   Gets the statistics summed over all shards. The shards are read one at a
+   time so concurrent operations may or may not be reflected.
+
+   @param cache the cache
+   @param stats receives the statistics
+*/
+void np_concurrent_cache_stats(struct NpConcurrentCache *cache,
+			       struct NpConcurrentCacheStats *stats);
+
+#endif
@@ -0,0 +1,257 @@
+/*
+ * np_concurrent_hashmap.c: nplib concurrent hash map
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "np_concurrent_hashmap.h"
+#include "np_hashmap.h"
+#include "np_pool.h"
+
+/*
+ * A lock stripe. Uses the same chained layout and resize policy as
+ * np_hashmap with items allocated from a stripe local pool.
+ */
+struct NpConcurrentHashMapStripe {
+  pthread_rwlock_t lock;
+  unsigned capacity;
+  unsigned size;
+  unsigned threshold;
+  struct NpHashMapItem **items;
+  struct NpPool *pool;
+
+  /* keeps the locks of neighbouring stripes off a shared cache line */
+  char pad[64];
+};
+
+static int np_concurrent_hashmap_stripe_init(
+  struct NpConcurrentHashMapStripe *stripe)
+{
+  unsigned i;
+
+  stripe->capacity = NP_HASHMAP_INITIAL_CAPACITY;
+  stripe->size = 0;
+  stripe->threshold = stripe->capacity * NP_HASHMAP_DEFAULT_LOAD_FACTOR;
+  stripe->items = malloc(sizeof *stripe->items * stripe->capacity);
+  stripe->pool = np_pool_new(sizeof(struct NpHashMapItem));
+  if (stripe->items == NULL || stripe->pool == NULL
+      || pthread_rwlock_init(&stripe->lock, NULL) != 0) {
+    free(stripe->items);
+    if (stripe->pool != NULL)
+      np_pool_free(stripe->pool);
+    return -1;
+  }
+  for (i = 0; i < stripe->capacity; ++i)
+    stripe->items[i] = NULL;
+  return 0;
+}
+
+static void np_concurrent_hashmap_stripe_destroy(
+  struct NpConcurrentHashMapStripe *stripe)
+{
+  pthread_rwlock_destroy(&stripe->lock);
+  np_pool_free(stripe->pool);
+  free(stripe->items);
+}
+
+struct NpConcurrentHashMap *np_concurrent_hashmap_new(
+  int (*key_compare)(void *key1, void *key2), unsigned (*key_hash)(void *key),
+  unsigned stripes)
+{
+  struct NpConcurrentHashMap *map;
+  unsigned i;
+
+  if (stripes == 0)
+    stripes = NP_CONCURRENT_HASHMAP_DEFAULT_STRIPES;
+  map = malloc(sizeof *map);
+  if (map != NULL) {
+    map->key_compare = key_compare;
+    map->key_hash = key_hash;
+    map->stripe_count = stripes;
+    if ((map->stripes = malloc(sizeof *map->stripes * stripes)) == NULL) {
+      free(map);
+      return NULL;
+    }
+    for (i = 0; i < stripes; ++i) {
+      if (np_concurrent_hashmap_stripe_init(&map->stripes[i]) != 0) {
+	while (i-- > 0)
+	  np_concurrent_hashmap_stripe_destroy(&map->stripes[i]);
+	free(map->stripes);
+	free(map);
+	return NULL;
+      }
+    }
+  }
+  return map;
+}
+
+void np_concurrent_hashmap_free(struct NpConcurrentHashMap *map)
+{
+  unsigned i;
+
+  for (i = 0; i < map->stripe_count; ++i)
+    np_concurrent_hashmap_stripe_destroy(&map->stripes[i]);
+  free(map->stripes);
+  free(map);
+}
+
+/*
+ * Selects a stripe from the high bits of the hash, leaving the low bits to
+ * select the bucket within the stripe.
+ */
+static struct NpConcurrentHashMapStripe *np_concurrent_hashmap_stripe(
+  struct NpConcurrentHashMap *map, unsigned hash)
+{
+  return &map->stripes[((unsigned long long)hash * map->stripe_count) >> 32];
+}
+
+/*
+ * Doubles the stripe's bucket array, relinking items by their cached hash.
+ * The caller must hold the stripe's write lock.
+ */
+static int np_concurrent_hashmap_stripe_realloc(
+  struct NpConcurrentHashMapStripe *stripe)
+{
+  struct NpHashMapItem **items;
+  struct NpHashMapItem *item;
+  struct NpHashMapItem *next;
+  unsigned capacity;
+  unsigned i;
+  unsigned j;
+
+  capacity = stripe->capacity * 2;
+  if ((items = malloc(sizeof *items * capacity)) == NULL)
+    return -1;
+  for (i = 0; i < capacity; ++i)
+    items[i] = NULL;
+  for (i = 0; i < stripe->capacity; ++i) {
+    for (item = stripe->items[i]; item != NULL; item = next) {
+      next = item->next;
+      j = item->hash % capacity;
+      item->next = items[j];
+      items[j] = item;
+    }
+  }
+  free(stripe->items);
+  stripe->items = items;
+  stripe->capacity = capacity;
+  stripe->threshold = capacity * NP_HASHMAP_DEFAULT_LOAD_FACTOR;
+  return 0;
+}
+
+static struct NpHashMapItem **np_concurrent_hashmap_find(
+  struct NpConcurrentHashMap *map, struct NpConcurrentHashMapStripe *stripe,
+  void *key, unsigned hash)
+{
+  struct NpHashMapItem **link;
+
+  link = &stripe->items[hash % stripe->capacity];
+  for (; *link != NULL; link = &(*link)->next)
+    if ((*link)->hash == hash && map->key_compare(key, (*link)->key) == 0)
+      return link;
+  return NULL;
+}
+
+void *np_concurrent_hashmap_put(struct NpConcurrentHashMap *map, void *key,
+				void *value)
+{
+  struct NpConcurrentHashMapStripe *stripe;
+  struct NpHashMapItem **link;
+  struct NpHashMapItem *item;
+  unsigned hash;
+  unsigned i;
+
+  hash = map->key_hash(key);
+  stripe = np_concurrent_hashmap_stripe(map, hash);
+  pthread_rwlock_wrlock(&stripe->lock);
+  if ((link = np_concurrent_hashmap_find(map, stripe, key, hash)) != NULL) {
+    (*link)->value = value;
+  } else if ((stripe->size >= stripe->threshold
+	      && np_concurrent_hashmap_stripe_realloc(stripe) != 0)
+	     || (item = np_pool_alloc(stripe->pool)) == NULL) {
+    value = NULL;
+  } else {
+    i = hash % stripe->capacity;
+    item->key = key;
+    item->value = value;
+    item->hash = hash;
+    item->next = stripe->items[i];
+    stripe->items[i] = item;
+    stripe->size++;
+  }
+  pthread_rwlock_unlock(&stripe->lock);
+  return value;
+}
+
+void *np_concurrent_hashmap_get(struct NpConcurrentHashMap *map, void *key)
+{
+  struct NpConcurrentHashMapStripe *stripe;
+  struct NpHashMapItem **link;
+  unsigned hash;
+  void *value;
+
+  hash = map->key_hash(key);
+  stripe = np_concurrent_hashmap_stripe(map, hash);
+  pthread_rwlock_rdlock(&stripe->lock);
+  link = np_concurrent_hashmap_find(map, stripe, key, hash);
+  value = link != NULL ? (*link)->value : NULL;
+  pthread_rwlock_unlock(&stripe->lock);
+  return value;
+}
+
+void *np_concurrent_hashmap_remove(struct NpConcurrentHashMap *map,
+				   void *key)
+{
+  struct NpConcurrentHashMapStripe *stripe;
+  struct NpHashMapItem **link;
+  struct NpHashMapItem *item;
+  unsigned hash;
+  void *value;
+
+  hash = map->key_hash(key);
+  stripe = np_concurrent_hashmap_stripe(map, hash);
+  value = NULL;
+  pthread_rwlock_wrlock(&stripe->lock);
+  if ((link = np_concurrent_hashmap_find(map, stripe, key, hash)) != NULL) {
+    item = *link;
+    value = item->value;
+    *link = item->next;
+    np_pool_release(stripe->pool, item);
+    stripe->size--;
+  }
+  pthread_rwlock_unlock(&stripe->lock);
+  return value;
+}
+
+unsigned np_concurrent_hashmap_size(struct NpConcurrentHashMap *map)
+{
+  struct NpConcurrentHashMapStripe *stripe;
+  unsigned size;
+  unsigned i;
+
+  size = 0;
+  for (i = 0; i < map->stripe_count; ++i) {
+    stripe = &map->stripes[i];
+    pthread_rwlock_rdlock(&stripe->lock);
+    size += stripe->size;
+    pthread_rwlock_unlock(&stripe->lock);
+  }
+  return size;
+}
@@ -0,0 +1,121 @@
+/*
+ * np_concurrent_hashmap.h: nplib concurrent hash map header file
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NP_CONCURRENT_HASHMAP_H
+#define __NP_CONCURRENT_HASHMAP_H
+
+#define NP_CONCURRENT_HASHMAP_DEFAULT_STRIPES 64
+
+/**
+   Thread safe hash map object. The map is partitioned into lock stripes,
+   each an independent chained hash table guarded by its own reader/writer
+   lock, so readers never block each other and writers only block
+   operations on the same stripe. Stripes resize independently.
+*/
+struct NpConcurrentHashMap {
+  /**
+     Pointer to a function used to compare map keys.
+
+     @param key1 the first key
+     @param key2 the second key
+     @return 0 if keys are equal, value > 0 if first key is greater than
+     the second key, value < 0 if the first key is lesser than the second
+  */
+  int (*key_compare)(void *key1, void *key2);
+
+  /**
+     Pointer to a function used to hash keys. Must be safe to call from
+     multiple threads.
+
+     @param key the key to hash
+     @return the hash
+  */
+  unsigned (*key_hash)(void *key);
+
+  /**
+     The number of lock stripes.
+  */
+  unsigned stripe_count;
+
+  /**
+     The stripes.
+  */
+  struct NpConcurrentHashMapStripe *stripes;
+};
+
+/**
+   Allocates memory for and initializes a concurrent map.
+
+   @param key_compare the function to be used for comparing keys
+   @param key_hash the function to be used for hashing keys
+   @param stripes the number of lock stripes or 0 for the default
+   @return a pointer to the allocated memory or NULL on error
+*/
+struct NpConcurrentHashMap *np_concurrent_hashmap_new(
+  int (*key_compare)(void *key1, void *key2), unsigned (*key_hash)(void *key),
+  unsigned stripes);
+
+/**
+   Frees the memory used by the map. Does not free the keys or values. No
+   other thread may be using the map.
+
+   @param map the map to free
+*/
+void np_concurrent_hashmap_free(struct NpConcurrentHashMap *map);
+
+/**
+   Puts an item into the map.
+
+   @param map the map in which to put the item
+   @param key the key at which to store the value, replacing an existing item
+   @param value the value to store
+   @return a pointer to the added item or NULL on error
+*/
+void *np_concurrent_hashmap_put(struct NpConcurrentHashMap *map, void *key,
+				void *value);
+
+/**
+   Gets an item from the map.
+
+   @param map the map from which to retrieve the item
+   @param key the key of the item to retrieve
+   @return a pointer to the item or NULL if the item does not exist
+*/
+void *np_concurrent_hashmap_get(struct NpConcurrentHashMap *map, void *key);
+
+/**
+   Removes an item from the map.
+
+   @param map the map from which to remove the item
+   @param key the key of the item to remove
+   @return a pointer to the removed item or NULL if there is no item at the
+   given key
+*/
+void *np_concurrent_hashmap_remove(struct NpConcurrentHashMap *map,
+				   void *key);
+
+/**
+   Determines the number of items in the map. The stripes are counted one at
+   a time so concurrent modifications may or may not be reflected.
+
+   @param map the map
+   @return the number of items in the map
+*/
+unsigned np_concurrent_hashmap_size(struct NpConcurrentHashMap *map);
+
+#endif
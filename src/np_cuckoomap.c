@@ -0,0 +1,379 @@
+/*
+ * np_cuckoomap.c: nplib cuckoo hash map
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "np_cuckoomap.h"
+
+#define NP_CUCKOOMAP_CACHE_LINE 64
+
+/*
+ * Position of a slot, bucket * NP_CUCKOOMAP_SLOTS + slot, as found by a
+ * lookup. Stash items are numbered after the slots.
+ */
+#define NP_CUCKOOMAP_NOT_FOUND ((unsigned)-1)
+
+/*
+ * Breadth first search node: a bucket reached by evicting the item in
+ * slot of the bucket of node parent.
+ */
+struct NpCuckooMapSearch {
+  unsigned bucket;
+  unsigned parent;
+  unsigned slot;
+};
+
+/*
+ * Hashes are stored with 0 marking empty slots, so a key hash of 0 is
+ * stored as 1.
+ */
+static unsigned np_cuckoomap_hash(struct NpCuckooMap *map, void *key)
+{
+  unsigned hash;
+
+  hash = map->key_hash(key);
+  return hash != 0 ? hash : 1;
+}
+
+/*
+ * The two buckets of a hash. The first uses the low bits of the hash, the
+ * second moves away from it by an odd offset mixed from the high bits, so
+ * the two always differ.
+ */
+static unsigned np_cuckoomap_bucket1(struct NpCuckooMap *map, unsigned hash)
+{
+  return hash & (map->bucket_count - 1);
+}
+
+static unsigned np_cuckoomap_bucket2(struct NpCuckooMap *map, unsigned hash)
+{
+  return (hash ^ ((hash >> 16) * 0x5bd1e995u | 1)) & (map->bucket_count - 1);
+}
+
+static int np_cuckoomap_init(struct NpCuckooMap *map, unsigned bucket_count)
+{
+  void *buckets;
+
+  if (posix_memalign(&buckets, NP_CUCKOOMAP_CACHE_LINE,
+		     sizeof *map->buckets * bucket_count) != 0)
+    return -1;
+  map->buckets = buckets;
+  memset(map->buckets, 0, sizeof *map->buckets * bucket_count);
+  map->bucket_count = bucket_count;
+  map->size = 0;
+  map->threshold = (size_t)bucket_count * NP_CUCKOOMAP_SLOTS
+    * NP_CUCKOOMAP_MAX_LOAD_FACTOR;
+  map->stash_size = 0;
+  return 0;
+}
+
+struct NpCuckooMap *np_cuckoomap_new(int (*key_compare)(void *key1, void *key2),
+				     unsigned (*key_hash)(void *key))
+{
+  struct NpCuckooMap *map;
+
+  map = malloc(sizeof *map);
+  if (map != NULL) {
+    map->key_compare = key_compare;
+    map->key_hash = key_hash;
+    if (np_cuckoomap_init(map, NP_CUCKOOMAP_INITIAL_BUCKETS) != 0) {
+      free(map);
+      return NULL;
+    }
+  }
+  return map;
+}
+
+void np_cuckoomap_free(struct NpCuckooMap *map)
+{
+  free(map->buckets);
+  free(map);
+}
+
+/*
+ * Finds the slot of the key in a bucket, comparing keys only where the
+ * hashes match.
+ */
+static unsigned np_cuckoomap_find_in(struct NpCuckooMap *map, unsigned bucket,
+				     void *key, unsigned hash)
+{
+  struct NpCuckooMapBucket *b;
+  unsigned i;
+
+  b = map->buckets + bucket;
+  for (i = 0; i < NP_CUCKOOMAP_SLOTS; ++i)
+    if (b->hashes[i] == hash && map->key_compare(key, b->keys[i]) == 0)
+      return bucket * NP_CUCKOOMAP_SLOTS + i;
+  return NP_CUCKOOMAP_NOT_FOUND;
+}
+
+/*
+ * Finds the position of the key: its two buckets, then the stash.
+ */
+static unsigned np_cuckoomap_find(struct NpCuckooMap *map, void *key,
+				  unsigned hash)
+{
+  unsigned pos;
+  unsigned i;
+
+  if ((pos = np_cuckoomap_find_in(map, np_cuckoomap_bucket1(map, hash), key,
+				  hash)) != NP_CUCKOOMAP_NOT_FOUND)
+    return pos;
+  if ((pos = np_cuckoomap_find_in(map, np_cuckoomap_bucket2(map, hash), key,
+				  hash)) != NP_CUCKOOMAP_NOT_FOUND)
+    return pos;
+  for (i = 0; i < map->stash_size; ++i)
+    if (map->stash[i].hash == hash
+	&& map->key_compare(key, map->stash[i].key) == 0)
+      return map->bucket_count * NP_CUCKOOMAP_SLOTS + i;
+  return NP_CUCKOOMAP_NOT_FOUND;
+}
+
+static int np_cuckoomap_free_slot(struct NpCuckooMap *map, unsigned bucket)
+{
+  int i;
+
+  for (i = 0; i < NP_CUCKOOMAP_SLOTS; ++i)
+    if (map->buckets[bucket].hashes[i] == 0)
+      return i;
+  return -1;
+}
+
+static void np_cuckoomap_set(struct NpCuckooMap *map, unsigned bucket,
+			     unsigned slot, void *key, void *value,
+			     unsigned hash)
+{
+  map->buckets[bucket].hashes[slot] = hash;
+  map->buckets[bucket].keys[slot] = key;
+  map->buckets[bucket].values[slot] = value;
+}
+
+/*
+ * Searches breadth first for the shortest path of evictions ending in a
+ * bucket with a free slot, then moves the items along the path starting at
+ * its end, freeing a slot in one of the hash's buckets. Buckets are visited
+ * at most once so the moves cannot interfere. Returns the bucket with the
+ * freed slot or NP_CUCKOOMAP_NOT_FOUND.
+ */
+static unsigned np_cuckoomap_evict(struct NpCuckooMap *map, unsigned hash)
+{
+  struct NpCuckooMapSearch search[NP_CUCKOOMAP_MAX_SEARCH];
+  struct NpCuckooMapBucket *from;
+  unsigned count;
+  unsigned head;
+  unsigned bucket;
+  unsigned other;
+  unsigned h;
+  unsigned i;
+  unsigned j;
+  int slot;
+
+  search[0].bucket = np_cuckoomap_bucket1(map, hash);
+  search[1].bucket = np_cuckoomap_bucket2(map, hash);
+  search[0].parent = search[1].parent = NP_CUCKOOMAP_NOT_FOUND;
+  count = 2;
+  for (head = 0; head < count; ++head) {
+    bucket = search[head].bucket;
+    if ((slot = np_cuckoomap_free_slot(map, bucket)) >= 0)
+      break;
+    for (i = 0; i < NP_CUCKOOMAP_SLOTS && count < NP_CUCKOOMAP_MAX_SEARCH;
+	 ++i) {
+      h = map->buckets[bucket].hashes[i];
+      other = np_cuckoomap_bucket1(map, h);
+      if (other == bucket)
+	other = np_cuckoomap_bucket2(map, h);
+      for (j = 0; j < count && search[j].bucket != other; ++j)
+	;
+      if (j < count)
+	continue;
+      search[count].bucket = other;
+      search[count].parent = head;
+      search[count].slot = i;
+      count++;
+    }
+  }
+  if (head == count)
+    return NP_CUCKOOMAP_NOT_FOUND;
+
+  /* move each item on the path into the slot freed after it */
+  for (; search[head].parent != NP_CUCKOOMAP_NOT_FOUND;
+       head = search[head].parent) {
+    bucket = search[search[head].parent].bucket;
+    i = search[head].slot;
+    from = map->buckets + bucket;
+    np_cuckoomap_set(map, search[head].bucket, slot, from->keys[i],
+		     from->values[i], from->hashes[i]);
+    slot = i;
+  }
+  map->buckets[search[head].bucket].hashes[slot] = 0;
+  return search[head].bucket;
+}
+
+/*
+ * Inserts an item known not to be in the map into its first bucket, its
+ * second bucket, the end of an eviction path, or the stash. Returns -1 if
+ * there was no room.
+ */
+static int np_cuckoomap_insert(struct NpCuckooMap *map, void *key,
+			       void *value, unsigned hash)
+{
+  unsigned bucket;
+  int slot;
+
+  bucket = np_cuckoomap_bucket1(map, hash);
+  if ((slot = np_cuckoomap_free_slot(map, bucket)) < 0) {
+    bucket = np_cuckoomap_bucket2(map, hash);
+    if ((slot = np_cuckoomap_free_slot(map, bucket)) < 0) {
+      bucket = np_cuckoomap_evict(map, hash);
+      if (bucket != NP_CUCKOOMAP_NOT_FOUND)
+	slot = np_cuckoomap_free_slot(map, bucket);
+    }
+  }
+  if (slot >= 0) {
+    np_cuckoomap_set(map, bucket, slot, key, value, hash);
+  } else if (map->stash_size < NP_CUCKOOMAP_STASH_SIZE) {
+    map->stash[map->stash_size].key = key;
+    map->stash[map->stash_size].value = value;
+    map->stash[map->stash_size].hash = hash;
+    map->stash_size++;
+  } else {
+    return -1;
+  }
+  map->size++;
+  return 0;
+}
+
+/*
+ * Inserts all items of a map into another.
+ */
+static int np_cuckoomap_insert_all(struct NpCuckooMap *to,
+				   struct NpCuckooMap *from)
+{
+  struct NpCuckooMapBucket *bucket;
+  unsigned i;
+  unsigned j;
+
+  for (i = 0; i < from->bucket_count; ++i) {
+    bucket = from->buckets + i;
+    for (j = 0; j < NP_CUCKOOMAP_SLOTS; ++j)
+      if (bucket->hashes[j] != 0
+	  && np_cuckoomap_insert(to, bucket->keys[j], bucket->values[j],
+				 bucket->hashes[j]) != 0)
+	return -1;
+  }
+  for (i = 0; i < from->stash_size; ++i)
+    if (np_cuckoomap_insert(to, from->stash[i].key, from->stash[i].value,
+			    from->stash[i].hash) != 0)
+      return -1;
+  return 0;
+}
+
+/*
+ * Moves the items into a map with the given number of buckets. Fails,
+ * leaving the map as it is, if the items do not fit, which with a reasonable
+ * hash function is very unlikely once the map has grown.
+ */
+static struct NpCuckooMap *np_cuckoomap_resize(struct NpCuckooMap *map,
+					       unsigned bucket_count)
+{
+  struct NpCuckooMap new_map;
+
+  if (bucket_count <= map->bucket_count)
+    return NULL; /* overflow */
+  new_map.key_compare = map->key_compare;
+  new_map.key_hash = map->key_hash;
+  if (np_cuckoomap_init(&new_map, bucket_count) != 0)
+    return NULL;
+  if (np_cuckoomap_insert_all(&new_map, map) != 0) {
+    free(new_map.buckets);
+    return NULL;
+  }
+  free(map->buckets);
+  *map = new_map;
+  return map;
+}
+
+void *np_cuckoomap_put(struct NpCuckooMap *map, void *key, void *value)
+{
+  unsigned hash;
+  unsigned pos;
+
+  hash = np_cuckoomap_hash(map, key);
+  pos = np_cuckoomap_find(map, key, hash);
+  if (pos != NP_CUCKOOMAP_NOT_FOUND) {
+    if (pos < map->bucket_count * NP_CUCKOOMAP_SLOTS)
+      map->buckets[pos / NP_CUCKOOMAP_SLOTS].values[pos % NP_CUCKOOMAP_SLOTS]
+	= value;
+    else
+      map->stash[pos - map->bucket_count * NP_CUCKOOMAP_SLOTS].value = value;
+    return value;
+  }
+  if (map->size >= map->threshold
+      && np_cuckoomap_resize(map, map->bucket_count * 2) == NULL)
+    return NULL;
+
+  /*
+   * No eviction path and a full stash. Growing helps a map that is mostly
+   * full; in a mostly empty one the keys' hashes collide and it would not.
+   */
+  if (np_cuckoomap_insert(map, key, value, hash) != 0
+      && (map->size < map->bucket_count * NP_CUCKOOMAP_SLOTS / 2
+	  || np_cuckoomap_resize(map, map->bucket_count * 2) == NULL
+	  || np_cuckoomap_insert(map, key, value, hash) != 0))
+    return NULL;
+  return value;
+}
+
+void *np_cuckoomap_get(struct NpCuckooMap *map, void *key)
+{
+  unsigned pos;
+
+  pos = np_cuckoomap_find(map, key, np_cuckoomap_hash(map, key));
+  if (pos == NP_CUCKOOMAP_NOT_FOUND)
+    return NULL;
+  if (pos < map->bucket_count * NP_CUCKOOMAP_SLOTS)
+    return map->buckets[pos / NP_CUCKOOMAP_SLOTS].values[pos
+							 % NP_CUCKOOMAP_SLOTS];
+  return map->stash[pos - map->bucket_count * NP_CUCKOOMAP_SLOTS].value;
+}
+
+void *np_cuckoomap_remove(struct NpCuckooMap *map, void *key)
+{
+  struct NpCuckooMapBucket *bucket;
+  unsigned pos;
+  unsigned i;
+  void *value;
+
+  pos = np_cuckoomap_find(map, key, np_cuckoomap_hash(map, key));
+  if (pos == NP_CUCKOOMAP_NOT_FOUND)
+    return NULL;
+  if (pos < map->bucket_count * NP_CUCKOOMAP_SLOTS) {
+    bucket = map->buckets + pos / NP_CUCKOOMAP_SLOTS;
+    value = bucket->values[pos % NP_CUCKOOMAP_SLOTS];
+    bucket->hashes[pos % NP_CUCKOOMAP_SLOTS] = 0;
+  } else {
+    i = pos - map->bucket_count * NP_CUCKOOMAP_SLOTS;
+    value = map->stash[i].value;
+    map->stash[i] = map->stash[--map->stash_size];
+  }
+  map->size--;
+  return value;
+}
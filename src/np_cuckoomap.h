@@ -0,0 +1,187 @@
+/*
+ * np_cuckoomap.h: nplib cuckoo hash map header file
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NP_CUCKOOMAP_H
+#define __NP_CUCKOOMAP_H
+
+/**
+   Number of slots in a bucket. A bucket of hashes, keys and values fills a
+   64 byte cache line on 64 bit platforms.
+*/
+#define NP_CUCKOOMAP_SLOTS 3
+
+#define NP_CUCKOOMAP_INITIAL_BUCKETS 4
+#define NP_CUCKOOMAP_MAX_LOAD_FACTOR 0.9
+
+/**
+   Maximum number of buckets visited by the breadth first search for a path
+   of evictions freeing a slot.
+*/
+#define NP_CUCKOOMAP_MAX_SEARCH 256
+
+/**
+   Number of items the stash holds before a failed insert grows the map.
+*/
+#define NP_CUCKOOMAP_STASH_SIZE 8
+
+/**
+   Cuckoo map bucket. The hashes come first so that a lookup checks them and
+   reads a matching key from the same cache line.
+*/
+struct NpCuckooMapBucket {
+  /**
+     The slot key hashes, 0 for an empty slot.
+  */
+  unsigned hashes[NP_CUCKOOMAP_SLOTS];
+
+  /**
+     The slot keys.
+  */
+  void *keys[NP_CUCKOOMAP_SLOTS];
+
+  /**
+     The slot values.
+  */
+  void *values[NP_CUCKOOMAP_SLOTS];
+};
+
+/**
+   Cuckoo map stash item, holding an item for which no eviction path was
+   found.
+*/
+struct NpCuckooMapStashItem {
+  /**
+     The item key.
+  */
+  void *key;
+
+  /**
+     The item value.
+  */
+  void *value;
+
+  /**
+     The item hash.
+  */
+  unsigned hash;
+};
+
+/**
+   Bucketized cuckoo hash map object. Each key may only be stored in one of
+   two buckets derived from its hash, so a lookup reads at most two cache
+   lines and the small stash. Each bucket holds the hashes of its keys, so
+   key_compare is only called on matching hashes.
+*/
+struct NpCuckooMap {
+  /**
+     Pointer to a function used to compare map keys.
+
+     @param key1 the first key
+     @param key2 the second key
+     @return 0 if keys are equal, value > 0 if first key is greater than
+     the second key, value < 0 if the first key is lesser than the second
+  */
+  int (*key_compare)(void *key1, void *key2);
+
+  /**
+     Pointer to a function used to hash keys.
+
+     @param key the key to hash
+     @return the hash
+  */
+  unsigned (*key_hash)(void *key);
+
+  /**
+     The number of buckets. Always a power of two.
+  */
+  unsigned bucket_count;
+
+  /**
+     The number of items in the map, including the stash.
+  */
+  unsigned size;
+
+  /**
+     The number of items at which the map grows.
+  */
+  unsigned threshold;
+
+  /**
+     The buckets, aligned to a cache line.
+  */
+  struct NpCuckooMapBucket *buckets;
+
+  /**
+     The number of items in the stash.
+  */
+  unsigned stash_size;
+
+  /**
+     The stash.
+  */
+  struct NpCuckooMapStashItem stash[NP_CUCKOOMAP_STASH_SIZE];
+};
+
+/**
+   Allocates memory for and initializes a cuckoo map.
+
+   @param key_compare the function to be used for comparing keys
+   @param key_hash the function to be used for hashing keys
+   @return a pointer to the allocated memory or NULL on error
+*/
+struct NpCuckooMap *np_cuckoomap_new(int (*key_compare)(void *key1, void *key2),
+				     unsigned (*key_hash)(void *key));
+
+/**
+   Frees the memory used by the map. Does not free the keys or values.
+
+   @param map the map to free
+*/
+void np_cuckoomap_free(struct NpCuckooMap *map);
+
+/**
+   Puts an item into the map.
+
+   @param map the map in which to put the item
+   @param key the key at which to store the value, replacing an existing
+   item, must not be NULL
+   @param value the value to store
+   @return a pointer to the added item or NULL on error
+*/
+void *np_cuckoomap_put(struct NpCuckooMap *map, void *key, void *value);
+
+/**
+   Gets an item from the map.
+
+   @param map the map from which to retrieve the item
+   @param key the key of the item to retrieve
+   @return a pointer to the item or NULL if the item does not exist
+*/
+void *np_cuckoomap_get(struct NpCuckooMap *map, void *key);
+
+/**
+   Removes an item from the map.
+
+   @param map the map from which to remove the item
+   @param key the key of the item to remove
+   @return a pointer to the removed item or NULL if there is no item at the
+   given key
+*/
+void *np_cuckoomap_remove(struct NpCuckooMap *map, void *key);
+
+#endif
@@ -0,0 +1,164 @@
+/*
+ * np_epoch.c: nplib epoch based reclamation
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+
+#include "np_epoch.h"
+#include "np_pool.h"
+
+struct NpEpoch *np_epoch_new(void)
+{
+  struct NpEpoch *epoch;
+
+  epoch = malloc(sizeof *epoch);
+  if (epoch != NULL) {
+    if ((epoch->pool = np_pool_new(sizeof(struct NpEpochRetired))) == NULL) {
+      free(epoch);
+      return NULL;
+    }
+    epoch->global = 0;
+    epoch->records = NULL;
+    epoch->retired[0] = epoch->retired[1] = epoch->retired[2] = NULL;
+    epoch->retired_count = 0;
+  }
+  return epoch;
+}
+
+static void np_epoch_reclaim(struct NpEpoch *epoch, int index)
+{
+  struct NpEpochRetired *retired;
+  struct NpEpochRetired *next;
+
+  for (retired = epoch->retired[index]; retired != NULL; retired = next) {
+    next = retired->next;
+    retired->reclaim(retired->ptr, retired->arg);
+    np_pool_release(epoch->pool, retired);
+    epoch->retired_count--;
+  }
+  epoch->retired[index] = NULL;
+}
+
+void np_epoch_free(struct NpEpoch *epoch)
+{
+  struct NpEpochRecord *record;
+  struct NpEpochRecord *next;
+
+  np_epoch_reclaim(epoch, 0);
+  np_epoch_reclaim(epoch, 1);
+  np_epoch_reclaim(epoch, 2);
+  for (record = epoch->records; record != NULL; record = next) {
+    next = record->next;
+    free(record);
+  }
+  np_pool_free(epoch->pool);
+  free(epoch);
+}
+
+struct NpEpochRecord *np_epoch_register(struct NpEpoch *epoch)
+{
+  struct NpEpochRecord *record;
+  int in_use;
+
+  /* reuse an unregistered record if there is one */
+  for (record = __atomic_load_n(&epoch->records, __ATOMIC_ACQUIRE);
+       record != NULL; record = record->next) {
+    in_use = 0;
+    if (__atomic_compare_exchange_n(&record->in_use, &in_use, 1, 0,
+				    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+      return record;
+  }
+
+  if ((record = malloc(sizeof *record)) == NULL)
+    return NULL;
+  record->epoch = 0;
+  record->active = 0;
+  record->in_use = 1;
+  record->owner = epoch;
+  record->next = __atomic_load_n(&epoch->records, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&epoch->records, &record->next, record,
+				      0, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    ;
+  return record;
+}
+
+void np_epoch_unregister(struct NpEpochRecord *record)
+{
+  __atomic_store_n(&record->active, 0, __ATOMIC_RELEASE);
+  __atomic_store_n(&record->in_use, 0, __ATOMIC_RELEASE);
+}
+
+void np_epoch_enter(struct NpEpochRecord *record)
+{
+  unsigned long global;
+
+  global = __atomic_load_n(&record->owner->global, __ATOMIC_ACQUIRE);
+  __atomic_store_n(&record->epoch, global, __ATOMIC_RELAXED);
+  __atomic_store_n(&record->active, 1, __ATOMIC_RELAXED);
+
+  /*
+   * Orders the announcement before any subsequent load of shared memory.
+   * Pairs with the fence in np_epoch_collect().
+   */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void np_epoch_exit(struct NpEpochRecord *record)
+{
+  __atomic_store_n(&record->active, 0, __ATOMIC_RELEASE);
+}
+
+int np_epoch_retire(struct NpEpoch *epoch, void *ptr,
+		    void (*reclaim)(void *ptr, void *arg), void *arg)
+{
+  struct NpEpochRetired *retired;
+  int index;
+
+  if ((retired = np_pool_alloc(epoch->pool)) == NULL)
+    return -1;
+  index = epoch->global % 3;
+  retired->ptr = ptr;
+  retired->reclaim = reclaim;
+  retired->arg = arg;
+  retired->next = epoch->retired[index];
+  epoch->retired[index] = retired;
+  if (++epoch->retired_count >= NP_EPOCH_COLLECT_THRESHOLD)
+    np_epoch_collect(epoch);
+  return 0;
+}
+
+int np_epoch_collect(struct NpEpoch *epoch)
+{
+  struct NpEpochRecord *record;
+  unsigned long global;
+
+  global = epoch->global;
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  for (record = __atomic_load_n(&epoch->records, __ATOMIC_ACQUIRE);
+       record != NULL; record = record->next)
+    if (__atomic_load_n(&record->active, __ATOMIC_ACQUIRE)
+	&& __atomic_load_n(&record->epoch, __ATOMIC_RELAXED) != global)
+      return 0;
+
+  /*
+   * Every active reader has seen the current epoch, so nothing retired
+   * two epochs ago can still be referenced.
+   */
+  __atomic_store_n(&epoch->global, global + 1, __ATOMIC_RELEASE);
+  np_epoch_reclaim(epoch, (global + 1) % 3);
+  return 1;
+}
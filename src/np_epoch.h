@@ -0,0 +1,192 @@
+/*
+ * np_epoch.h: nplib epoch based reclamation header file
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NP_EPOCH_H
+#define __NP_EPOCH_H
+
+/**
+   Number of retired objects after which np_epoch_retire() attempts to
+   advance the epoch and reclaim memory.
+*/
+#define NP_EPOCH_COLLECT_THRESHOLD 64
+
+/**
+   Per reader epoch record. Each reading thread registers a record and
+   brackets its accesses to shared memory with np_epoch_enter() and
+   np_epoch_exit().
+*/
+struct NpEpochRecord {
+  /**
+     The global epoch observed when the reader last entered.
+  */
+  unsigned long epoch;
+
+  /**
+     Nonzero while the reader is inside a critical section.
+  */
+  int active;
+
+  /**
+     Nonzero while the record is registered to a thread.
+  */
+  int in_use;
+
+  /**
+     The epoch the record belongs to.
+  */
+  struct NpEpoch *owner;
+
+  /**
+     The next record.
+  */
+  struct NpEpochRecord *next;
+
+  /**
+     Keeps records written by different threads off a shared cache line.
+  */
+  char pad[64];
+};
+
+/**
+   Retired object waiting to be reclaimed.
+*/
+struct NpEpochRetired {
+  /**
+     The retired object.
+  */
+  void *ptr;
+
+  /**
+     The function reclaiming the object.
+  */
+  void (*reclaim)(void *ptr, void *arg);
+
+  /**
+     Argument passed to the reclaim function.
+  */
+  void *arg;
+
+  /**
+     The next retired object.
+  */
+  struct NpEpochRetired *next;
+};
+
+/**
+   Epoch based reclamation domain. Memory unlinked from a shared structure
+   is retired in the current epoch and reclaimed once every active reader
+   has been seen in a later epoch, at which point no reader can still hold a
+   reference to it. Readers only perform plain loads and stores.
+
+   Retiring and collecting are not thread safe with respect to each other
+   and must be serialized by the caller, typically under a writer lock.
+*/
+struct NpEpoch {
+  /**
+     The global epoch.
+  */
+  unsigned long global;
+
+  /**
+     The registered reader records.
+  */
+  struct NpEpochRecord *records;
+
+  /**
+     Retired objects by the epoch (modulo 3) in which they were retired.
+  */
+  struct NpEpochRetired *retired[3];
+
+  /**
+     The number of objects waiting to be reclaimed.
+  */
+  unsigned retired_count;
+
+  /**
+     The pool from which retired object entries are allocated.
+  */
+  struct NpPool *pool;
+};
+
+/**
+   Allocates memory for and initializes an epoch domain.
+
+   @return a pointer to the allocated memory or NULL on error
+*/
+struct NpEpoch *np_epoch_new(void);
+
+/**
+   Reclaims all retired objects and frees the epoch domain and its records.
+   No reader may be active.
+
+   @param epoch the epoch domain to free
+*/
+void np_epoch_free(struct NpEpoch *epoch);
+
+/**
+   Registers a reader. Thread safe.
+
+   @param epoch the epoch domain
+   @return the reader record or NULL on error
+*/
+struct NpEpochRecord *np_epoch_register(struct NpEpoch *epoch);
+
+/**
+   Unregisters a reader, making its record available for reuse.
+
+   @param record the reader record
+*/
+void np_epoch_unregister(struct NpEpochRecord *record);
+
+/**
+   Enters a read side critical section.
+
+   @param record the reader record
+*/
+void np_epoch_enter(struct NpEpochRecord *record);
+
+/**
+   Exits a read side critical section.
+
+   @param record the reader record
+*/
+void np_epoch_exit(struct NpEpochRecord *record);
+
+/**
+   Retires an object. The reclaim function is called once no reader can
+   hold a reference to the object.
+
+   @param epoch the epoch domain
+   @param ptr the object to retire
+   @param reclaim the function reclaiming the object
+   @param arg an argument passed to the reclaim function
+   @return 0 on success or -1 on error
+*/
+int np_epoch_retire(struct NpEpoch *epoch, void *ptr,
+		    void (*reclaim)(void *ptr, void *arg), void *arg);
+
+/**
+   Attempts to advance the global epoch, reclaiming objects retired two
+   epochs earlier.
+
+   @param epoch the epoch domain
+   @return nonzero if the epoch advanced
+*/
+int np_epoch_collect(struct NpEpoch *epoch);
+
+#endif
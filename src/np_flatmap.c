@@ -0,0 +1,305 @@
+/*
+ * np_flatmap.c: nplib flat hash map
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "np_flatmap.h"
+
+/*
+ * Control byte values. Full slots hold the low 7 bits of the key hash so
+ * empty and deleted slots are the only ones with the high bit set.
+ */
+#define NP_FLATMAP_EMPTY 0x80
+#define NP_FLATMAP_DELETED 0xfe
+
+#define NP_FLATMAP_TAG(hash) ((unsigned char)((hash) & 0x7f))
+#define NP_FLATMAP_GROUP(hash) ((hash) >> 7)
+
+/*
+ * Group matching. Each function returns a bit mask with bit i set if control
+ * byte i of the group matches.
+ */
+#ifdef __SSE2__
+
+static unsigned np_flatmap_match(const unsigned char *group, unsigned char tag)
+{
+  __m128i ctrl;
+
+  ctrl = _mm_loadu_si128((const __m128i *)group);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)tag)));
+}
+
+static unsigned np_flatmap_match_empty(const unsigned char *group)
+{
+  return np_flatmap_match(group, NP_FLATMAP_EMPTY);
+}
+
+static unsigned np_flatmap_match_free(const unsigned char *group)
+{
+  /* empty and deleted are the only control bytes with the high bit set */
+  return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+}
+
+#else
+
+static unsigned np_flatmap_match(const unsigned char *group, unsigned char tag)
+{
+  unsigned mask;
+  int i;
+
+  mask = 0;
+  for (i = 0; i < NP_FLATMAP_GROUP_SIZE; ++i)
+    if (group[i] == tag)
+      mask |= 1u << i;
+  return mask;
+}
+
+static unsigned np_flatmap_match_empty(const unsigned char *group)
+{
+  return np_flatmap_match(group, NP_FLATMAP_EMPTY);
+}
+
+static unsigned np_flatmap_match_free(const unsigned char *group)
+{
+  unsigned mask;
+  int i;
+
+  mask = 0;
+  for (i = 0; i < NP_FLATMAP_GROUP_SIZE; ++i)
+    if (group[i] & 0x80)
+      mask |= 1u << i;
+  return mask;
+}
+
+#endif
+
+static unsigned np_flatmap_ctz(unsigned mask)
+{
+#ifdef __GNUC__
+  return __builtin_ctz(mask);
+#else
+  unsigned i;
+
+  for (i = 0; (mask & 1) == 0; ++i)
+    mask >>= 1;
+  return i;
+#endif
+}
+
+static int np_flatmap_init(struct NpFlatMap *map, unsigned capacity)
+{
+  map->control = malloc(capacity);
+  map->slots = malloc(sizeof *map->slots * capacity);
+  if (map->control == NULL || map->slots == NULL) {
+    free(map->control);
+    free(map->slots);
+    return -1;
+  }
+  memset(map->control, NP_FLATMAP_EMPTY, capacity);
+  map->capacity = capacity;
+  map->size = 0;
+  map->deleted = 0;
+  map->threshold = capacity * NP_FLATMAP_MAX_LOAD_FACTOR;
+  return 0;
+}
+
+struct NpFlatMap *np_flatmap_new(int (*key_compare)(void *key1, void *key2),
+				 unsigned (*key_hash)(void *key))
+{
+  struct NpFlatMap *map;
+
+  map = malloc(sizeof *map);
+  if (map != NULL) {
+    map->key_compare = key_compare;
+    map->key_hash = key_hash;
+    if (np_flatmap_init(map, NP_FLATMAP_INITIAL_CAPACITY) != 0) {
+      free(map);
+      return NULL;
+    }
+  }
+  return map;
+}
+
+void np_flatmap_free(struct NpFlatMap *map)
+{
+  free(map->control);
+  free(map->slots);
+  free(map);
+}
+
+/*
+ * Finds the slot holding the key. Groups are visited using triangular
+ * probing which, with a power of two number of groups, visits every group.
+ * A group containing an empty slot ends the search.
+ */
+static struct NpFlatMapSlot *np_flatmap_find(struct NpFlatMap *map, void *key,
+					     unsigned hash)
+{
+  struct NpFlatMapSlot *slot;
+  unsigned char *group;
+  unsigned char tag;
+  unsigned mask;
+  unsigned bits;
+  unsigned g;
+  unsigned stride;
+
+  tag = NP_FLATMAP_TAG(hash);
+  mask = map->capacity / NP_FLATMAP_GROUP_SIZE - 1;
+  g = NP_FLATMAP_GROUP(hash) & mask;
+  for (stride = 0; stride <= mask; ++stride) {
+    group = map->control + g * NP_FLATMAP_GROUP_SIZE;
+    for (bits = np_flatmap_match(group, tag); bits != 0; bits &= bits - 1) {
+      slot = map->slots + g * NP_FLATMAP_GROUP_SIZE + np_flatmap_ctz(bits);
+      if (map->key_compare(key, slot->key) == 0)
+	return slot;
+    }
+    if (np_flatmap_match_empty(group))
+      break;
+    g = (g + stride + 1) & mask;
+  }
+  return NULL;
+}
+
+/*
+ * Finds the first empty or deleted slot along the probe sequence for the
+ * hash. The map always has empty slots so this cannot fail.
+ */
+static unsigned np_flatmap_find_free(struct NpFlatMap *map, unsigned hash)
+{
+  unsigned mask;
+  unsigned bits;
+  unsigned g;
+  unsigned stride;
+
+  mask = map->capacity / NP_FLATMAP_GROUP_SIZE - 1;
+  g = NP_FLATMAP_GROUP(hash) & mask;
+  for (stride = 0;; ++stride) {
+    bits = np_flatmap_match_free(map->control + g * NP_FLATMAP_GROUP_SIZE);
+    if (bits != 0)
+      return g * NP_FLATMAP_GROUP_SIZE + np_flatmap_ctz(bits);
+    g = (g + stride + 1) & mask;
+  }
+}
+
+/*
+ * Rebuilds the map into a new slot array. The capacity is doubled unless
+ * enough of the used slots are tombstones that dropping them leaves the map
+ * comfortably below the threshold.
+ */
+static struct NpFlatMap *np_flatmap_rehash(struct NpFlatMap *map)
+{
+  struct NpFlatMap new_map;
+  struct NpFlatMapSlot *slot;
+  unsigned capacity;
+  unsigned hash;
+  unsigned i;
+  unsigned j;
+
+  capacity = map->capacity;
+  if (map->size > map->capacity / 32 * 25)
+    capacity *= 2;
+  if (capacity < map->capacity)
+    return NULL; /* overflow */
+  if (np_flatmap_init(&new_map, capacity) != 0)
+    return NULL;
+  for (i = 0; i < map->capacity; ++i) {
+    if (map->control[i] & 0x80)
+      continue;
+    slot = map->slots + i;
+    hash = map->key_hash(slot->key);
+    j = np_flatmap_find_free(&new_map, hash);
+    new_map.control[j] = NP_FLATMAP_TAG(hash);
+    new_map.slots[j] = *slot;
+    new_map.size++;
+  }
+  free(map->control);
+  free(map->slots);
+  map->control = new_map.control;
+  map->slots = new_map.slots;
+  map->capacity = new_map.capacity;
+  map->size = new_map.size;
+  map->deleted = 0;
+  map->threshold = new_map.threshold;
+  return map;
+}
+
+void *np_flatmap_put(struct NpFlatMap *map, void *key, void *value)
+{
+  struct NpFlatMapSlot *slot;
+  unsigned hash;
+  unsigned i;
+
+  hash = map->key_hash(key);
+  if ((slot = np_flatmap_find(map, key, hash)) != NULL) {
+    slot->value = value;
+    return value;
+  }
+  i = np_flatmap_find_free(map, hash);
+  if (map->control[i] == NP_FLATMAP_EMPTY
+      && map->size + map->deleted >= map->threshold) {
+    if (np_flatmap_rehash(map) == NULL)
+      return NULL;
+    i = np_flatmap_find_free(map, hash);
+  }
+  if (map->control[i] == NP_FLATMAP_DELETED)
+    map->deleted--;
+  map->control[i] = NP_FLATMAP_TAG(hash);
+  map->slots[i].key = key;
+  map->slots[i].value = value;
+  map->size++;
+  return value;
+}
+
+void *np_flatmap_get(struct NpFlatMap *map, void *key)
+{
+  struct NpFlatMapSlot *slot;
+
+  slot = np_flatmap_find(map, key, map->key_hash(key));
+  return slot != NULL ? slot->value : NULL;
+}
+
+void *np_flatmap_remove(struct NpFlatMap *map, void *key)
+{
+  struct NpFlatMapSlot *slot;
+  unsigned char *group;
+  unsigned i;
+
+  if ((slot = np_flatmap_find(map, key, map->key_hash(key))) == NULL)
+    return NULL;
+  i = slot - map->slots;
+  group = map->control + i - i % NP_FLATMAP_GROUP_SIZE;
+
+  /*
+   * Probes stop at a group with an empty slot, so if the group already has
+   * one no probe sequence can pass through it and the slot can be marked
+   * empty rather than deleted.
+   */
+  if (np_flatmap_match_empty(group)) {
+    map->control[i] = NP_FLATMAP_EMPTY;
+  } else {
+    map->control[i] = NP_FLATMAP_DELETED;
+    map->deleted++;
+  }
+  map->size--;
+  return slot->value;
+}
@@ -0,0 +1,149 @@
+/*
+ * np_flatmap.h: nplib flat hash map header file
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NP_FLATMAP_H
+#define __NP_FLATMAP_H
+
+/**
+   Number of control bytes probed at once. Must be 16 to match the width of
+   an SSE2 register.
+*/
+#define NP_FLATMAP_GROUP_SIZE 16
+
+#define NP_FLATMAP_INITIAL_CAPACITY 16
+#define NP_FLATMAP_MAX_LOAD_FACTOR 0.875
+
+/**
+   Flat hash map slot.
+*/
+struct NpFlatMapSlot {
+  /**
+     The slot key.
+  */
+  void *key;
+
+  /**
+     The slot value.
+  */
+  void *value;
+};
+
+/**
+   Flat (open addressing) hash map object. Each slot has a matching control
+   byte holding either a 7 bit tag taken from the key hash or a marker for an
+   empty or deleted slot. Lookups compare a whole group of control bytes
+   against the tag at once and only call key_compare on tag matches.
+*/
+struct NpFlatMap {
+  /**
+     Pointer to a function used to compare map keys.
+
+     @param key1 the first key
+     @param key2 the second key
+     @return 0 if keys are equal, value > 0 if first key is greater than
+     the second key, value < 0 if the first key is lesser than the second
+  */
+  int (*key_compare)(void *key1, void *key2);
+
+  /**
+     Pointer to a function used to hash keys.
+
+     @param key the key to hash
+     @return the hash
+  */
+  unsigned (*key_hash)(void *key);
+
+  /**
+     The map capacity (number of slots). Always a power of two and a multiple
+     of NP_FLATMAP_GROUP_SIZE.
+  */
+  unsigned capacity;
+
+  /**
+     The number of items in the map.
+  */
+  unsigned size;
+
+  /**
+     The number of deleted slots (tombstones) in the map.
+  */
+  unsigned deleted;
+
+  /**
+     The number of used slots (size + deleted) at which the map is rehashed.
+  */
+  unsigned threshold;
+
+  /**
+     The control bytes, one per slot.
+  */
+  unsigned char *control;
+
+  /**
+     The slots.
+  */
+  struct NpFlatMapSlot *slots;
+};
+
+/**
+   Allocates memory for and initializes a flat map.
+
+   @param key_compare the function to be used for comparing keys
+   @param key_hash the function to be used for hashing keys
+   @return a pointer to the allocated memory or NULL on error
+*/
+struct NpFlatMap *np_flatmap_new(int (*key_compare)(void *key1, void *key2),
+				 unsigned (*key_hash)(void *key));
+
+/**
+   Frees the memory used by the map. Does not free the keys or values.
+
+   @param map the map to free
+*/
+void np_flatmap_free(struct NpFlatMap *map);
+
+/**
+   Puts an item into the map.
+
+   @param map the map in which to put the item
+   @param key the key at which to store the value, replacing an existing item
+   @param value the value to store
+   @return a pointer to the added item or NULL on error
+*/
+void *np_flatmap_put(struct NpFlatMap *map, void *key, void *value);
+
+/**
+   Gets an item from the map.
+
+   @param map the map from which to retrieve the item
+   @param key the key of the item to retrieve
+   @return a pointer to the item or NULL if the item does not exist
+*/
+void *np_flatmap_get(struct NpFlatMap *map, void *key);
+
+/**
+   Removes an item from the map.
+
+   @param map the map from which to remove the item
+   @param key the key of the item to remove
+   @return a pointer to the removed item or NULL if there is no item at the
+   given key
+*/
+void *np_flatmap_remove(struct NpFlatMap *map, void *key);
+
+#endif
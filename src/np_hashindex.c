@@ -0,0 +1,319 @@
+/*
+ * np_hashindex.c: nplib memory mapped hash index
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "np_hashindex.h"
+#include "np_hashmap.h"
+
+#define NP_HASHINDEX_ALIGN(n) (((n) + 7) & ~(uint64_t)7)
+
+static uint32_t np_hashindex_hash(const void *key, size_t length)
+{
+  uint64_t h;
+
+  h = np_hashmap_hash64(key, length);
+  return (uint32_t)(h ^ (h >> 32));
+}
+
+static int np_hashindex_write_padding(FILE *file, uint64_t from, uint64_t to)
+{
+  static const char zeros[8];
+
+  return fwrite(zeros, 1, to - from, file) == to - from ? 0 : -1;
+}
+
+/*
+ * Writes the file given the entries sorted by bucket. The data is written
+ * in entry order so the keys of a bucket are adjacent.
+ */
+static int np_hashindex_write_file(FILE *file,
+				   struct NpHashIndexHeader *header,
+				   uint32_t *buckets,
+				   struct NpHashIndexEntry *entries,
+				   void **keys, void **values)
+{
+  uint64_t offset;
+  uint64_t i;
+
+  if (fwrite(header, sizeof *header, 1, file) != 1
+      || fwrite(buckets, sizeof *buckets, header->bucket_count + 1, file)
+      != header->bucket_count + 1)
+    return -1;
+  offset = header->buckets_offset
+    + sizeof *buckets * (header->bucket_count + 1);
+  if (np_hashindex_write_padding(file, offset, header->entries_offset) != 0)
+    return -1;
+  if (fwrite(entries, sizeof *entries, header->count, file) != header->count)
+    return -1;
+  offset = header->data_offset;
+  for (i = 0; i < header->count; ++i) {
+    if (fwrite(keys[i], 1, entries[i].key_length, file)
+	!= entries[i].key_length)
+      return -1;
+    offset += entries[i].key_length;
+    if (np_hashindex_write_padding(file, offset, NP_HASHINDEX_ALIGN(offset))
+	!= 0)
+      return -1;
+    offset = NP_HASHINDEX_ALIGN(offset);
+    if (fwrite(values[i], 1, entries[i].value_length, file)
+	!= entries[i].value_length)
+      return -1;
+    offset += entries[i].value_length;
+    if (np_hashindex_write_padding(file, offset, NP_HASHINDEX_ALIGN(offset))
+	!= 0)
+      return -1;
+    offset = NP_HASHINDEX_ALIGN(offset);
+  }
+  return 0;
+}
+
+/*
+ * Sorts the map's items by bucket into the entry, key, and value arrays and
+ * fills in the bucket array and the entries' data offsets. The items array
+ * provides scratch space for the unsorted items.
+ */
+static int np_hashindex_build(struct NpHashMap *map,
+			      struct NpHashIndexHeader *header,
+			      uint32_t *buckets,
+			      struct NpHashIndexEntry *entries,
+			      struct NpHashIndexEntry *items,
+			      void **keys, void **values,
+			      size_t (*key_length)(void *key),
+			      size_t (*value_length)(void *value))
+{
+  void **unsorted_keys;
+  void **unsorted_values;
+  uint64_t offset;
+  uint64_t mask;
+  uint64_t i;
+  uint32_t *cursors;
+  uint32_t j;
+  size_t length;
+
+  unsorted_keys = keys + header->count;
+  unsorted_values = values + header->count;
+  np_hashmap_export(map, unsorted_keys, unsorted_values);
+  mask = header->bucket_count - 1;
+
+  /* count the items of each bucket, then turn the counts into starts */
+  for (i = 0; i < header->count; ++i) {
+    if ((length = key_length(unsorted_keys[i])) > UINT32_MAX)
+      return -1;
+    items[i].hash = np_hashindex_hash(unsorted_keys[i], length);
+    items[i].key_length = length;
+    items[i].value_length = value_length(unsorted_values[i]);
+    buckets[(items[i].hash & mask) + 1]++;
+  }
+  for (i = 0; i < header->bucket_count; ++i)
+    buckets[i + 1] += buckets[i];
+
+  /* place each item at the next free position of its bucket */
+  if ((cursors = malloc(sizeof *cursors * header->bucket_count)) == NULL)
+    return -1;
+  memcpy(cursors, buckets, sizeof *cursors * header->bucket_count);
+  for (i = 0; i < header->count; ++i) {
+    j = cursors[items[i].hash & mask]++;
+    entries[j] = items[i];
+    keys[j] = unsorted_keys[i];
+    values[j] = unsorted_values[i];
+  }
+  free(cursors);
+  offset = header->data_offset;
+  for (i = 0; i < header->count; ++i) {
+    entries[i].offset = offset;
+    offset = NP_HASHINDEX_ALIGN(offset + entries[i].key_length);
+    offset = NP_HASHINDEX_ALIGN(offset + entries[i].value_length);
+  }
+  header->file_size = offset;
+  return 0;
+}
+
+int np_hashindex_write(struct NpHashMap *map, const char *path,
+		       size_t (*key_length)(void *key),
+		       size_t (*value_length)(void *value))
+{
+  struct NpHashIndexHeader header;
+  struct NpHashIndexEntry *entries;
+  uint32_t *buckets;
+  void **keys;
+  void **values;
+  FILE *file;
+  uint64_t n;
+  int ret;
+
+  n = map->size;
+  memset(&header, 0, sizeof header);
+  memcpy(header.magic, NP_HASHINDEX_MAGIC, sizeof header.magic);
+  header.version = NP_HASHINDEX_VERSION;
+  header.byte_order = NP_HASHINDEX_BYTE_ORDER;
+  header.count = n;
+  for (header.bucket_count = 1; header.bucket_count < n;
+       header.bucket_count <<= 1)
+    ;
+  header.buckets_offset = sizeof header;
+  header.entries_offset = NP_HASHINDEX_ALIGN(
+    header.buckets_offset + sizeof *buckets * (header.bucket_count + 1));
+  header.data_offset = header.entries_offset + sizeof *entries * n;
+
+  /* entries and keys/values are each twice n: sorted, then unsorted */
+  buckets = calloc(header.bucket_count + 1, sizeof *buckets);
+  entries = malloc(sizeof *entries * (2 * n + 1));
+  keys = malloc(sizeof *keys * (2 * n + 1));
+  values = malloc(sizeof *values * (2 * n + 1));
+  ret = -1;
+  if (buckets != NULL && entries != NULL && keys != NULL && values != NULL
+      && n <= UINT32_MAX
+      && np_hashindex_build(map, &header, buckets, entries, entries + n,
+			    keys, values, key_length, value_length) == 0
+      && (file = fopen(path, "wb")) != NULL) {
+    ret = np_hashindex_write_file(file, &header, buckets, entries, keys,
+				  values);
+    if (fclose(file) != 0)
+      ret = -1;
+  }
+  free(buckets);
+  free(entries);
+  free(keys);
+  free(values);
+  return ret;
+}
+
+/*
+ * Checks that the header describes this file and that its sections fit in
+ * the file. Every bound is checked by subtracting from the file size so no
+ * sum can wrap. The data is checked on lookup.
+ */
+static int np_hashindex_valid(const struct NpHashIndexHeader *header,
+			      uint64_t file_size)
+{
+  if (memcmp(header->magic, NP_HASHINDEX_MAGIC, sizeof header->magic) != 0
+      || header->version != NP_HASHINDEX_VERSION
+      || header->byte_order != NP_HASHINDEX_BYTE_ORDER
+      || header->file_size != file_size)
+    return 0;
+  if (header->bucket_count == 0
+      || (header->bucket_count & (header->bucket_count - 1)) != 0)
+    return 0;
+
+  /* bucket_count + 1 offsets after the header */
+  if (header->buckets_offset < sizeof *header
+      || header->buckets_offset % sizeof(uint32_t) != 0
+      || header->buckets_offset > file_size
+      || header->bucket_count >= (file_size - header->buckets_offset)
+      / sizeof(uint32_t))
+    return 0;
+
+  /* count entries after the buckets */
+  if (header->entries_offset > file_size
+      || header->entries_offset % 8 != 0
+      || header->entries_offset < header->buckets_offset
+      || header->entries_offset - header->buckets_offset
+      < sizeof(uint32_t) * (header->bucket_count + 1)
+      || header->count > (file_size - header->entries_offset)
+      / sizeof(struct NpHashIndexEntry))
+    return 0;
+
+  /* the data after the entries */
+  return header->data_offset <= file_size
+    && header->data_offset >= header->entries_offset
+    && header->data_offset - header->entries_offset
+    >= sizeof(struct NpHashIndexEntry) * header->count;
+}
+
+struct NpHashIndex *np_hashindex_open(const char *path)
+{
+  struct NpHashIndex *index;
+  const struct NpHashIndexHeader *header;
+  struct stat st;
+  void *base;
+  int fd;
+
+  if ((fd = open(path, O_RDONLY)) < 0)
+    return NULL;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof *header) {
+    close(fd);
+    return NULL;
+  }
+  base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return NULL;
+
+  header = base;
+  if (!np_hashindex_valid(header, st.st_size)
+      || (index = malloc(sizeof *index)) == NULL) {
+    munmap(base, st.st_size);
+    return NULL;
+  }
+  index->base = base;
+  index->header = header;
+  index->buckets = (const uint32_t *)(index->base + header->buckets_offset);
+  index->entries = (const struct NpHashIndexEntry *)
+    (index->base + header->entries_offset);
+  index->mask = header->bucket_count - 1;
+  index->count = header->count;
+  return index;
+}
+
+void np_hashindex_close(struct NpHashIndex *index)
+{
+  munmap((void *)index->base, index->header->file_size);
+  free(index);
+}
+
+const void *np_hashindex_get(struct NpHashIndex *index, const void *key,
+			     size_t key_length, size_t *value_length)
+{
+  const struct NpHashIndexEntry *entry;
+  const struct NpHashIndexEntry *end;
+  uint64_t value_offset;
+  uint32_t hash;
+  uint32_t first;
+  uint32_t last;
+
+  hash = np_hashindex_hash(key, key_length);
+  first = index->buckets[hash & index->mask];
+  last = index->buckets[(hash & index->mask) + 1];
+  if (first > last || last > index->count)
+    return NULL;
+  end = index->entries + last;
+  for (entry = index->entries + first; entry < end; ++entry) {
+    if (entry->hash != hash || entry->key_length != key_length)
+      continue;
+    value_offset = NP_HASHINDEX_ALIGN(entry->offset + key_length);
+    if (value_offset < entry->offset
+	|| value_offset > index->header->file_size
+	|| entry->value_length > index->header->file_size - value_offset)
+      return NULL;
+    if (memcmp(index->base + entry->offset, key, key_length) == 0) {
+      if (value_length != NULL)
+	*value_length = entry->value_length;
+      return index->base + value_offset;
+    }
+  }
+  return NULL;
+}
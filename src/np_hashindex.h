@@ -0,0 +1,199 @@
+/*
+ * np_hashindex.h: nplib memory mapped hash index header file
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NP_HASHINDEX_H
+#define __NP_HASHINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "np_hashmap.h"
+
+#define NP_HASHINDEX_MAGIC "NPHINDEX"
+#define NP_HASHINDEX_VERSION 1
+
+/**
+   Written to the header in the writer's byte order so files are only
+   opened on hosts with the same byte order.
+*/
+#define NP_HASHINDEX_BYTE_ORDER 0x01020304u
+
+/**
+   Hash index file header. All offsets in the file are relative to the start
+   of the file, so the file can be mapped at any address.
+*/
+struct NpHashIndexHeader {
+  /**
+     NP_HASHINDEX_MAGIC without the terminating null.
+  */
+  char magic[8];
+
+  /**
+     NP_HASHINDEX_VERSION.
+  */
+  uint32_t version;
+
+  /**
+     NP_HASHINDEX_BYTE_ORDER in the writer's byte order.
+  */
+  uint32_t byte_order;
+
+  /**
+     The size of the file in bytes.
+  */
+  uint64_t file_size;
+
+  /**
+     The number of items.
+  */
+  uint64_t count;
+
+  /**
+     The number of buckets, a power of two.
+  */
+  uint64_t bucket_count;
+
+  /**
+     The offset of the bucket array. Holds bucket_count + 1 entry indexes;
+     the entries of bucket i are those from buckets[i] to buckets[i + 1].
+  */
+  uint64_t buckets_offset;
+
+  /**
+     The offset of the entry array, sorted by bucket.
+  */
+  uint64_t entries_offset;
+
+  /**
+     The offset of the key and value data.
+  */
+  uint64_t data_offset;
+};
+
+/**
+   Hash index file entry.
+*/
+struct NpHashIndexEntry {
+  /**
+     The offset of the key. The value follows the key, starting at the next
+     multiple of 8 bytes.
+  */
+  uint64_t offset;
+
+  /**
+     The key hash.
+  */
+  uint32_t hash;
+
+  /**
+     The key length in bytes.
+  */
+  uint32_t key_length;
+
+  /**
+     The value length in bytes.
+  */
+  uint64_t value_length;
+};
+
+/**
+   Read only hash index object. Lookups run directly against a memory
+   mapping of an index file written by np_hashindex_write(), so opening an
+   index takes constant time and processes opening the same file share its
+   pages.
+*/
+struct NpHashIndex {
+  /**
+     The mapped file.
+  */
+  const unsigned char *base;
+
+  /**
+     The mapped file's header.
+  */
+  const struct NpHashIndexHeader *header;
+
+  /**
+     The mapped bucket array.
+  */
+  const uint32_t *buckets;
+
+  /**
+     The mapped entry array.
+  */
+  const struct NpHashIndexEntry *entries;
+
+  /**
+     The number of buckets minus one.
+  */
+  uint64_t mask;
+
+  /**
+     The number of items.
+  */
+  uint64_t count;
+};
+
+/**
+   Writes the items of a map to a hash index file. Keys and values are copied
+   into the file; their lengths are given by the supplied functions. Keys are
+   hashed with np_hashmap_hash64() rather than the map's hash function, so an
+   index does not depend on the process that wrote it.
+
+   @param map the map to write
+   @param path the path of the file to create or replace
+   @param key_length the function giving the length in bytes of a key
+   @param value_length the function giving the length in bytes of a value
+   @return 0 on success or -1 on error
+*/
+int np_hashindex_write(struct NpHashMap *map, const char *path,
+		       size_t (*key_length)(void *key),
+		       size_t (*value_length)(void *value));
+
+/**
+   Opens a hash index file by mapping it into memory. Only the header is
+   read; the rest of the file is paged in as lookups touch it.
+
+   @param path the path of the index file
+   @return a pointer to the opened index or NULL on error or if the file is
+   not a valid index
+*/
+struct NpHashIndex *np_hashindex_open(const char *path);
+
+/**
+   Unmaps the file and frees the memory used by the index. Pointers returned
+   by np_hashindex_get() become invalid.
+
+   @param index the index to close
+*/
+void np_hashindex_close(struct NpHashIndex *index);
+
+/**
+   Gets a value from the index. The value is not copied; the pointer is into
+   the mapped file.
+
+   @param index the index from which to retrieve the value
+   @param key the key of the value to retrieve
+   @param key_length the key length in bytes
+   @param value_length receives the value length in bytes if not NULL
+   @return a pointer to the value or NULL if the key is not in the index
+*/
+const void *np_hashindex_get(struct NpHashIndex *index, const void *key,
+			     size_t key_length, size_t *value_length);
+
+#endif
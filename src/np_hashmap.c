@@ -16,30 +16,106 @@
  * limitations under the License.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "np_hashmap.h"
+#include "np_pool.h"
+#include "np_arena.h"
+#include "np_bloom.h"
+
+#ifdef __GNUC__
+#define NP_HASHMAP_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define NP_HASHMAP_PREFETCH(p) ((void)(p))
+#endif
+
+/*
+ * Number of buckets np_hashmap_export() reads ahead of the bucket it copies
+ * when prefetching chain heads.
+ */
+#define NP_HASHMAP_EXPORT_PREFETCH 8
+
+/*
+ * Determines the smallest power of two capacity, no less than the initial
+ * capacity, whose threshold is at least the given number of items.
+ */
+static unsigned np_hashmap_capacity_for(unsigned items, float load_factor)
+{
+  unsigned capacity;
+
+  capacity = NP_HASHMAP_INITIAL_CAPACITY;
+  while ((unsigned)(capacity * load_factor) < items && capacity << 1 != 0)
+    capacity <<= 1;
+  return capacity;
+}
+
+static void np_hashmap_set_thresholds(struct NpHashMap *map)
+{
+  map->threshold = map->capacity * map->load_factor;
+  map->low_water = map->threshold * NP_HASHMAP_SHRINK_FACTOR;
+}
 
 struct NpHashMap *np_hashmap_new(int (*key_compare)(void *key1, void *key2),
                             unsigned (*key_hash)(void *key))
+{
+  return np_hashmap_new_with_capacity(key_compare, key_hash, 0);
+}
+
+/*
+ * Initializes a map whose items are of the given size.
+ */
+static struct NpHashMap *np_hashmap_init(
+  int (*key_compare)(void *key1, void *key2), unsigned (*key_hash)(void *key),
+  unsigned capacity, size_t item_size)
 {
   struct NpHashMap *map;
   unsigned i;
-  unsigned capacity;
 
-  capacity = NP_HASHMAP_INITIAL_CAPACITY;
+  capacity = np_hashmap_capacity_for(capacity, NP_HASHMAP_DEFAULT_LOAD_FACTOR);
   map = malloc(sizeof *map);
   if (map != NULL) {
-    if ((map->items = malloc(sizeof *map->items * capacity)) != NULL) {
+    map->items = malloc(sizeof *map->items * capacity);
+    map->pool = np_pool_new(item_size);
+    if (map->items != NULL && map->pool != NULL) {
       map->key_compare = key_compare;
       map->key_hash = key_hash;
+      map->keyed_hash = NULL;
+      map->seed[0] = 0;
+      map->seed[1] = 0;
       map->capacity = capacity;
+      map->min_capacity = capacity;
       map->size = 0;
       map->load_factor = NP_HASHMAP_DEFAULT_LOAD_FACTOR;
-      map->threshold = map->capacity * map->load_factor;
+      np_hashmap_set_thresholds(map);
+      map->resize_mode = NP_HASHMAP_RESIZE_FULL;
+      map->old_items = NULL;
+      map->old_capacity = 0;
+      map->migrate_index = 0;
+      map->arena = NULL;
+      map->key_bytes = 0;
+      map->bloom = NULL;
+      map->resizes = 0;
+      map->resize_seconds = 0;
+      memset(&map->alloc_policy, 0, sizeof map->alloc_policy);
+      map->threads = 1;
       for (i = 0; i < capacity; ++i)
 	map->items[i] = NULL;
     } else {
+      free(map->items);
+      if (map->pool != NULL)
+	np_pool_free(map->pool);
       free(map);
       return NULL;
     }
@@ -47,142 +123,1629 @@ struct NpHashMap *np_hashmap_new(int (*key_compare)(void *key1, void *key2),
   return map;
 }
 
+struct NpHashMap *np_hashmap_new_with_capacity(
+  int (*key_compare)(void *key1, void *key2), unsigned (*key_hash)(void *key),
+  unsigned capacity)
+{
+  return np_hashmap_init(key_compare, key_hash, capacity,
+			 sizeof(struct NpHashMapItem));
+}
+
+struct NpHashMap *np_hashmap_new_with_item_size(
+  int (*key_compare)(void *key1, void *key2), unsigned (*key_hash)(void *key),
+  unsigned capacity, size_t item_size)
+{
+  if (item_size < sizeof(struct NpHashMapItem))
+    return NULL;
+  return np_hashmap_init(key_compare, key_hash, capacity, item_size);
+}
+
+/*
+ * Draws a seed from the system's random source, falling back to the clock
+ * and the address of the seed if there is none.
+ */
+static void np_hashmap_random_seed(uint64_t *seed)
+{
+  struct timespec ts;
+  FILE *random;
+  size_t read;
+
+  read = 0;
+  if ((random = fopen("/dev/urandom", "rb")) != NULL) {
+    read = fread(seed, sizeof *seed, 2, random);
+    fclose(random);
+  }
+  if (read != 2) {
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    seed[0] = np_hashmap_hash64_u64((uint64_t)ts.tv_sec * 1000000000
+				    + ts.tv_nsec);
+    seed[1] = np_hashmap_hash64_u64(seed[0] ^ (uintptr_t)seed);
+  }
+}
+
+struct NpHashMap *np_hashmap_new_keyed(
+  int (*key_compare)(void *key1, void *key2),
+  unsigned (*keyed_hash)(void *key, const uint64_t *seed))
+{
+  struct NpHashMap *map;
+
+  map = np_hashmap_init(key_compare, NULL, 0, sizeof(struct NpHashMapItem));
+  if (map != NULL) {
+    map->keyed_hash = keyed_hash;
+    np_hashmap_random_seed(map->seed);
+  }
+  return map;
+}
+
+unsigned np_hashmap_key_hash(struct NpHashMap *map, void *key)
+{
+  if (map->keyed_hash != NULL)
+    return map->keyed_hash(key, map->seed);
+  return map->key_hash(key);
+}
+
+static int np_hashmap_string_compare(void *key1, void *key2)
+{
+  return strcmp(key1, key2);
+}
+
+static unsigned np_hashmap_string_hash(void *key)
+{
+  return np_hashmap_hash(key, strlen(key));
+}
+
+struct NpHashMap *np_hashmap_new_string_keys(void)
+{
+  struct NpHashMap *map;
+
+  map = np_hashmap_init(np_hashmap_string_compare, np_hashmap_string_hash, 0,
+			sizeof(struct NpHashMapStringItem));
+  if (map != NULL && (map->arena = np_arena_new()) == NULL) {
+    np_hashmap_free(map);
+    return NULL;
+  }
+  return map;
+}
+
 void np_hashmap_free(struct NpHashMap *map)
+{
+  /* all items live in the pool's slabs and all owned keys in the arena */
+  np_pool_free(map->pool);
+  if (map->arena != NULL)
+    np_arena_free(map->arena);
+  if (map->bloom != NULL)
+    np_bloom_free(map->bloom);
+  np_alloc_free(&map->alloc_policy, map->old_items,
+		sizeof *map->old_items * map->old_capacity);
+  np_alloc_free(&map->alloc_policy, map->items,
+		sizeof *map->items * map->capacity);
+  free(map);
+}
+
+/*
+ * Moves up to the given number of buckets from the old table into the
+ * current one, releasing the old table once it is empty. Items are relinked
+ * rather than reallocated.
+ */
+static void np_hashmap_migrate(struct NpHashMap *map, unsigned buckets)
 {
   struct NpHashMapItem *item;
   struct NpHashMapItem *next;
   unsigned i;
 
-  for (i = 0; i < map->capacity; ++i) {
-    if ((item = map->items[i]) == NULL)
-      continue;
+  while (buckets-- > 0 && map->old_items != NULL) {
+    item = map->old_items[map->migrate_index];
     while (item) {
       next = item->next;
-      free(item);
+      i = item->hash % map->capacity;
+      item->next = map->items[i];
+      map->items[i] = item;
       item = next;
     }
+    map->old_items[map->migrate_index] = NULL;
+    if (++map->migrate_index == map->old_capacity) {
+      np_alloc_free(&map->alloc_policy, map->old_items,
+		    sizeof *map->old_items * map->old_capacity);
+      map->old_items = NULL;
+      map->old_capacity = 0;
+      map->migrate_index = 0;
+    }
   }
-  free(map->items);
-  free(map);
 }
 
-static struct NpHashMap *np_hashmap_realloc(struct NpHashMap *map)
+/*
+ * Work shared by the threads of a parallel resize or build. Lists holds,
+ * for each source range s and destination range d, the items of s bound
+ * for d at index s * threads + d.
+ */
+struct NpHashMapJob {
+  struct NpHashMap *map;
+  unsigned threads;
+  struct NpHashMapItem **lists;
+  void **keys;
+  void **values;
+  unsigned count;
+  unsigned *hashes;
+  unsigned *order;
+  unsigned *offsets;
+};
+
+struct NpHashMapWorker {
+  struct NpHashMapJob *job;
+  unsigned index;
+  struct NpPool *pool;
+  unsigned size;
+  int failed;
+};
+
+/*
+ * The range of buckets, or of partitions of the input, a worker owns.
+ */
+static unsigned np_hashmap_range_start(unsigned index, unsigned threads,
+				       unsigned length)
 {
-  if (map->size == map->threshold) {
-    struct NpHashMap new_map;
-    struct NpHashMapItem *item;
-    struct NpHashMapItem *next;
-    unsigned new_capacity;
-    unsigned i;
+  return (unsigned long long)length * index / threads;
+}
 
-    new_capacity = map->capacity * 2;
-    if ((new_map.items = malloc(sizeof *new_map.items * new_capacity)) == NULL)
-      return NULL;
-    new_map.key_compare = map->key_compare;
-    new_map.key_hash = map->key_hash;
-    new_map.capacity = new_capacity;
-    new_map.size = 0;
-    new_map.load_factor = map->load_factor;
-    new_map.threshold = new_capacity * new_map.load_factor;
-    for (i = 0; i < new_capacity; ++i)
-      new_map.items[i] = NULL;
-
-    for (i = 0; i < map->capacity; ++i) {
-      if ((item = map->items[i]) == NULL)
-	continue;
-      while (item) {
-	next = item->next;
-	np_hashmap_put(&new_map, item->key, item->value);
-	free(item);
-	item = next;
-      }
+/*
+ * The destination range of a bucket. Destination ranges are contiguous but
+ * need not line up with np_hashmap_range_start.
+ */
+static unsigned np_hashmap_range_of(unsigned bucket, unsigned threads,
+				    unsigned length)
+{
+  return (unsigned long long)bucket * threads / length;
+}
+
+/*
+ * Runs a function on each worker, one thread per worker with the last run
+ * on the calling thread. Workers whose thread cannot be started are run on
+ * the calling thread too.
+ */
+static void np_hashmap_run(struct NpHashMapWorker *workers, unsigned count,
+			   void *(*run)(void *))
+{
+  pthread_t *ids;
+  int *started;
+  unsigned i;
+
+  ids = malloc(sizeof *ids * count);
+  started = calloc(count, sizeof *started);
+  for (i = 0; i + 1 < count; ++i)
+    if (ids != NULL && started != NULL)
+      started[i] = pthread_create(&ids[i], NULL, run, &workers[i]) == 0;
+  run(&workers[count - 1]);
+  for (i = 0; i + 1 < count; ++i) {
+    if (started != NULL && started[i])
+      pthread_join(ids[i], NULL);
+    else
+      run(&workers[i]);
+  }
+  free(ids);
+  free(started);
+}
+
+/*
+ * First pass of a parallel resize: moves the items of the worker's range of
+ * old buckets onto one list per destination range.
+ */
+static void *np_hashmap_split_run(void *arg)
+{
+  struct NpHashMapWorker *worker = arg;
+  struct NpHashMapJob *job = worker->job;
+  struct NpHashMap *map = job->map;
+  struct NpHashMapItem **lists;
+  struct NpHashMapItem *item;
+  struct NpHashMapItem *next;
+  unsigned end;
+  unsigned i;
+  unsigned d;
+
+  lists = job->lists + worker->index * job->threads;
+  end = np_hashmap_range_start(worker->index + 1, job->threads,
+			       map->old_capacity);
+  for (i = np_hashmap_range_start(worker->index, job->threads,
+				  map->old_capacity); i < end; ++i) {
+    for (item = map->old_items[i]; item != NULL; item = next) {
+      next = item->next;
+      d = np_hashmap_range_of(item->hash % map->capacity, job->threads,
+			      map->capacity);
+      item->next = lists[d];
+      lists[d] = item;
     }
-    free(map->items);
-    map->items = new_map.items;
-    map->capacity = new_capacity;
-    map->threshold = new_map.threshold;
+    map->old_items[i] = NULL;
   }
-  return map;
+  return NULL;
 }
 
-void *np_hashmap_put(struct NpHashMap *map, void *key, void *value)
+/*
+ * Second pass of a parallel resize: links the items bound for the worker's
+ * range of new buckets.
+ */
+static void *np_hashmap_join_run(void *arg)
 {
+  struct NpHashMapWorker *worker = arg;
+  struct NpHashMapJob *job = worker->job;
+  struct NpHashMap *map = job->map;
   struct NpHashMapItem *item;
+  struct NpHashMapItem *next;
   unsigned i;
+  unsigned s;
 
-  map = np_hashmap_realloc(map);
-  if (map == NULL)
-    return NULL;
-  i = map->key_hash(key) % map->capacity;
-  for (item = map->items[i]; item != NULL; item = item->next)
-    if (map->key_compare(key, item->key) == 0)
-      break;
-  if (item == NULL) {
-    item = malloc(sizeof *item);
-    if (item == NULL) {
-      return NULL;
-    } else {
-      item->key = key;
-      item->value = value;
+  for (s = 0; s < job->threads; ++s) {
+    item = job->lists[s * job->threads + worker->index];
+    for (; item != NULL; item = next) {
+      next = item->next;
+      i = item->hash % map->capacity;
       item->next = map->items[i];
       map->items[i] = item;
-      map->size++;
     }
-  } else {
-    item->value = value;
   }
-  return value;
+  return NULL;
 }
 
-void *np_hashmap_get(struct NpHashMap *map, void *key)
+/*
+ * Moves every item of the old table into the current one using the map's
+ * threads. Returns -1, leaving the old table in place, if the work cannot
+ * be set up.
+ */
+static int np_hashmap_migrate_parallel(struct NpHashMap *map)
 {
-  struct NpHashMapItem *item;
+  struct NpHashMapJob job;
+  struct NpHashMapWorker *workers;
+  unsigned i;
+
+  job.map = map;
+  job.threads = map->threads;
+  job.lists = calloc((size_t)job.threads * job.threads, sizeof *job.lists);
+  workers = malloc(sizeof *workers * job.threads);
+  if (job.lists == NULL || workers == NULL) {
+    free(job.lists);
+    free(workers);
+    return -1;
+  }
+  for (i = 0; i < job.threads; ++i) {
+    workers[i].job = &job;
+    workers[i].index = i;
+  }
+  np_hashmap_run(workers, job.threads, np_hashmap_split_run);
+  np_hashmap_run(workers, job.threads, np_hashmap_join_run);
+  np_alloc_free(&map->alloc_policy, map->old_items,
+		sizeof *map->old_items * map->old_capacity);
+  map->old_items = NULL;
+  map->old_capacity = 0;
+  map->migrate_index = 0;
+  free(job.lists);
+  free(workers);
+  return 0;
+}
+
+/*
+ * Current monotonic time in seconds.
+ */
+static double np_hashmap_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Moves the map to a table of the given capacity. The items are migrated
+ * immediately or, in incremental mode, by subsequent operations.
+ */
+static struct NpHashMap *np_hashmap_resize(struct NpHashMap *map,
+					   unsigned capacity)
+{
+  struct NpHashMapItem **items;
+  double start;
   unsigned i;
 
-  i = map->key_hash(key) % map->capacity;
-  for (item = map->items[i]; item != NULL; item = item->next)
-    if (map->key_compare(key, item->key) == 0)
-      return item->value;
+  /* a previous incremental resize must finish before starting another */
+  if (map->old_items != NULL)
+    np_hashmap_migrate(map, map->old_capacity);
+  if (capacity == map->capacity)
+    return map;
+
+  start = np_hashmap_now();
+  items = np_alloc(&map->alloc_policy, sizeof *items * capacity);
+  if (items == NULL)
+    return NULL;
+  for (i = 0; i < capacity; ++i)
+    items[i] = NULL;
+  map->old_items = map->items;
+  map->old_capacity = map->capacity;
+  map->migrate_index = 0;
+  map->items = items;
+  map->capacity = capacity;
+  np_hashmap_set_thresholds(map);
+  if (map->resize_mode == NP_HASHMAP_RESIZE_FULL
+      && (map->threads < 2
+	  || map->old_capacity < NP_HASHMAP_PARALLEL_MIN_BUCKETS
+	  || np_hashmap_migrate_parallel(map) != 0))
+    np_hashmap_migrate(map, map->old_capacity);
+  map->resizes++;
+  map->resize_seconds += np_hashmap_now() - start;
+  return map;
+}
+
+static struct NpHashMap *np_hashmap_realloc(struct NpHashMap *map)
+{
+  if (map->size >= map->threshold)
+    return np_hashmap_resize(map, map->capacity * 2);
+  return map;
+}
+
+/*
+ * Halves the capacity once the map drops below its low water mark. Waits for
+ * any incremental resize to finish rather than forcing it. A failed shrink
+ * leaves the map as it is.
+ */
+static void np_hashmap_shrink(struct NpHashMap *map)
+{
+  if (map->size < map->low_water && map->capacity > map->min_capacity
+      && map->old_items == NULL)
+    np_hashmap_resize(map, map->capacity / 2);
+}
+
+/*
+ * Compares an owned string key with a key of the given length. Keys shorter
+ * than the prefix are stored entirely in it; longer keys only reach the arena
+ * copy when the prefix matches.
+ */
+static int np_hashmap_string_equal(struct NpHashMapItem *item, const char *key,
+				   unsigned length)
+{
+  struct NpHashMapStringItem *string_item;
+
+  string_item = (struct NpHashMapStringItem *)item;
+  if (string_item->length != length)
+    return 0;
+  if (length < NP_HASHMAP_KEY_PREFIX)
+    return memcmp(string_item->prefix, key, length) == 0;
+  return memcmp(string_item->prefix, key, NP_HASHMAP_KEY_PREFIX) == 0
+    && memcmp((char *)item->key + NP_HASHMAP_KEY_PREFIX,
+	      key + NP_HASHMAP_KEY_PREFIX,
+	      length - NP_HASHMAP_KEY_PREFIX) == 0;
+}
+
+/*
+ * Finds the link pointing at the item with the given key in a chain. Keys
+ * are only compared when the cached hashes match.
+ */
+static struct NpHashMapItem **np_hashmap_find_chain(struct NpHashMap *map,
+						    struct NpHashMapItem **link,
+						    void *key, unsigned length,
+						    unsigned hash)
+{
+  for (; *link != NULL; link = &(*link)->next) {
+    if ((*link)->hash != hash)
+      continue;
+    if (map->arena != NULL ? np_hashmap_string_equal(*link, key, length)
+	: map->key_compare(key, (*link)->key) == 0)
+      return link;
+  }
   return NULL;
 }
 
-void *np_hashmap_remove(struct NpHashMap *map, void *key)
+/*
+ * Finds the link pointing at the item with the given key, searching the
+ * unmigrated part of the old table and then the current table.
+ */
+static struct NpHashMapItem **np_hashmap_find_length(struct NpHashMap *map,
+						     void *key,
+						     unsigned length,
+						     unsigned hash)
+{
+  struct NpHashMapItem **link;
+  unsigned i;
+
+  if (map->old_items != NULL) {
+    i = hash % map->old_capacity;
+    if (i >= map->migrate_index
+	&& (link = np_hashmap_find_chain(map, &map->old_items[i], key, length,
+					 hash)) != NULL)
+      return link;
+  }
+  i = hash % map->capacity;
+  return np_hashmap_find_chain(map, &map->items[i], key, length, hash);
+}
+
+static struct NpHashMapItem **np_hashmap_find(struct NpHashMap *map,
+					      void *key, unsigned hash)
+{
+  return np_hashmap_find_length(map, key,
+				map->arena != NULL ? strlen(key) : 0, hash);
+}
+
+/*
+ * Copies a key into an item of a map with owned string keys.
+ */
+static int np_hashmap_own_key(struct NpHashMap *map,
+			      struct NpHashMapItem *item, const char *key,
+			      unsigned length)
+{
+  struct NpHashMapStringItem *string_item;
+  char *copy;
+
+  string_item = (struct NpHashMapStringItem *)item;
+  if (length < NP_HASHMAP_KEY_PREFIX) {
+    copy = string_item->prefix;
+  } else {
+    if ((copy = np_arena_alloc(map->arena, length + 1, 1)) == NULL)
+      return -1;
+    memcpy(string_item->prefix, key, NP_HASHMAP_KEY_PREFIX);
+    map->key_bytes += length + 1;
+  }
+  memcpy(copy, key, length + 1);
+  string_item->length = length;
+  item->key = copy;
+  return 0;
+}
+
+/*
+ * Copies the owned keys of one table to the given block, returning the end
+ * of the copied keys.
+ */
+static char *np_hashmap_compact_table(struct NpHashMapItem **table,
+				      unsigned begin, unsigned end,
+				      char *block)
 {
-  struct NpHashMapItem *prev;
   struct NpHashMapItem *item;
-  void *ret;
+  unsigned length;
   unsigned i;
 
-  ret = NULL;
-  prev = NULL;
-  i = map->key_hash(key) % map->capacity;
-  for (item = map->items[i]; item != NULL; prev = item, item = item->next)
-    if (map->key_compare(key, item->key) == 0) {
-      ret = item->value;
-      if (prev != NULL)
-	prev->next = item->next;
-      else
-	map->items[i] = NULL;
-      free(item);
-      map->size--;
+  for (i = begin; i < end; ++i) {
+    for (item = table[i]; item != NULL; item = item->next) {
+      length = ((struct NpHashMapStringItem *)item)->length;
+      if (length < NP_HASHMAP_KEY_PREFIX)
+	continue;
+      memcpy(block, item->key, length + 1);
+      item->key = block;
+      block += length + 1;
     }
-  return ret;
+  }
+  return block;
 }
 
-unsigned np_hashmap_hash(void *key, int length)
+/*
+ * Moves the owned keys into a single block of a new arena once less than
+ * half of the arena holds keys still in the map. A failed compaction leaves
+ * the keys where they are.
+ */
+static void np_hashmap_compact(struct NpHashMap *map)
 {
- /*  Bob Jenkins, one-at-a-time hash */
-  unsigned char *p = key;
-  unsigned h = 0;
-  int i;
+  struct NpArena *arena;
+  char *block;
+
+  if (map->arena->used < NP_ARENA_CHUNK_SIZE
+      || map->arena->used / 2 < map->key_bytes)
+    return;
+  if ((arena = np_arena_new()) == NULL)
+    return;
+  if (map->key_bytes > 0
+      && (block = np_arena_alloc(arena, map->key_bytes, 1)) == NULL) {
+    np_arena_free(arena);
+    return;
+  }
+  if (map->key_bytes > 0) {
+    if (map->old_items != NULL)
+      block = np_hashmap_compact_table(map->old_items, map->migrate_index,
+				       map->old_capacity, block);
+    np_hashmap_compact_table(map->items, 0, map->capacity, block);
+  }
+  np_arena_free(map->arena);
+  map->arena = arena;
+}
+
+/*
+ * Adds the cached hashes of all items to the Bloom filter.
+ */
+static void np_hashmap_bloom_add_all(struct NpHashMap *map)
+{
+  struct NpHashMapItem *item;
+  unsigned i;
+
+  if (map->old_items != NULL)
+    for (i = map->migrate_index; i < map->old_capacity; ++i)
+      for (item = map->old_items[i]; item != NULL; item = item->next)
+	np_bloom_add(map->bloom, item->hash);
+  for (i = 0; i < map->capacity; ++i)
+    for (item = map->items[i]; item != NULL; item = item->next)
+      np_bloom_add(map->bloom, item->hash);
+}
+
+/*
+ * Rebuilds the Bloom filter sized for twice the current items, so it has
+ * room to grow. If that fails the old filter, which still holds every key,
+ * is kept.
+ */
+static void np_hashmap_bloom_rebuild(struct NpHashMap *map)
+{
+  if (np_bloom_reset(map->bloom, map->size * 2) != NULL)
+    np_hashmap_bloom_add_all(map);
+}
+
+void *np_hashmap_put(struct NpHashMap *map, void *key, void *value)
+{
+  return np_hashmap_put_hashed(map, key, value, np_hashmap_key_hash(map, key));
+}
+
+/*
+ * Allocates an item for a key known not to be in the map and links it at
+ * the head of its bucket.
+ */
+static struct NpHashMapItem *np_hashmap_link(struct NpHashMap *map, void *key,
+					     void *value, unsigned length,
+					     unsigned hash)
+{
+  struct NpHashMapItem *item;
+  unsigned i;
+
+  item = np_pool_alloc(map->pool);
+  if (item == NULL)
+    return NULL;
+  item->key = key;
+  if (map->arena != NULL && np_hashmap_own_key(map, item, key, length) != 0) {
+    np_pool_release(map->pool, item);
+    return NULL;
+  }
+  i = hash % map->capacity;
+  item->value = value;
+  item->hash = hash;
+  item->next = map->items[i];
+  map->items[i] = item;
+  map->size++;
+  if (map->bloom != NULL) {
+    np_bloom_add(map->bloom, hash);
+    if (np_bloom_stale(map->bloom))
+      np_hashmap_bloom_rebuild(map);
+  }
+  return item;
+}
+
+/*
+ * Finds the item holding the key, inserting one with a NULL value if there
+ * is none. Any resize happens before the lookup so the item stays put.
+ */
+static struct NpHashMapItem *np_hashmap_find_or_link(struct NpHashMap *map,
+						     void *key, unsigned hash,
+						     int *inserted)
+{
+  struct NpHashMapItem **link;
+  unsigned length;
 
-  for (i = 0; i < length; ++i) {
-    h += p[i];
-    h += (h << 10);
-    h ^= (h >> 6);
+  map = np_hashmap_realloc(map);
+  if (map == NULL)
+    return NULL;
+  np_hashmap_migrate(map, NP_HASHMAP_MIGRATE_BUCKETS);
+  length = map->arena != NULL ? strlen(key) : 0;
+  if ((link = np_hashmap_find_length(map, key, length, hash)) != NULL) {
+    *inserted = 0;
+    return *link;
   }
-  h += (h << 3);
-  h ^= (h >> 11);
-  h += (h << 15);
-  return h;
+  *inserted = 1;
+  return np_hashmap_link(map, key, NULL, length, hash);
+}
+
+void *np_hashmap_put_hashed(struct NpHashMap *map, void *key, void *value,
+			    unsigned hash)
+{
+  struct NpHashMapItem *item;
+  int inserted;
+
+  if ((item = np_hashmap_find_or_link(map, key, hash, &inserted)) == NULL)
+    return NULL;
+  item->value = value;
+  return value;
+}
+
+void *np_hashmap_put_if_absent(struct NpHashMap *map, void *key, void *value)
+{
+  struct NpHashMapItem *item;
+  int inserted;
+
+  item = np_hashmap_find_or_link(map, key, np_hashmap_key_hash(map, key),
+				 &inserted);
+  if (item == NULL)
+    return NULL;
+  if (inserted)
+    item->value = value;
+  return item->value;
+}
+
+void **np_hashmap_get_or_insert(struct NpHashMap *map, void *key,
+				int *inserted)
+{
+  struct NpHashMapItem *item;
+  int ignored;
+
+  item = np_hashmap_find_or_link(map, key, np_hashmap_key_hash(map, key),
+				 inserted != NULL ? inserted : &ignored);
+  return item != NULL ? &item->value : NULL;
+}
+
+void *np_hashmap_compute(struct NpHashMap *map, void *key,
+			 void *(*remap)(void *key, void *value, void *arg),
+			 void *arg)
+{
+  struct NpHashMapItem *item;
+  int inserted;
+
+  item = np_hashmap_find_or_link(map, key, np_hashmap_key_hash(map, key),
+				 &inserted);
+  if (item == NULL)
+    return NULL;
+  item->value = remap(item->key, item->value, arg);
+  return item->value;
+}
+
+struct NpHashMapItem *np_hashmap_insert_item(struct NpHashMap *map, void *key,
+					     unsigned hash)
+{
+  map = np_hashmap_realloc(map);
+  if (map == NULL)
+    return NULL;
+  np_hashmap_migrate(map, NP_HASHMAP_MIGRATE_BUCKETS);
+  return np_hashmap_link(map, key, NULL,
+			 map->arena != NULL ? strlen(key) : 0, hash);
+}
+
+void *np_hashmap_get(struct NpHashMap *map, void *key)
+{
+  return np_hashmap_get_hashed(map, key, np_hashmap_key_hash(map, key));
+}
+
+void *np_hashmap_get_hashed(struct NpHashMap *map, void *key, unsigned hash)
+{
+  struct NpHashMapItem **link;
+
+  np_hashmap_migrate(map, NP_HASHMAP_MIGRATE_BUCKETS);
+  if (map->bloom != NULL && !np_bloom_contains(map->bloom, hash))
+    return NULL;
+  if ((link = np_hashmap_find(map, key, hash)) != NULL)
+    return (*link)->value;
+  if (map->bloom != NULL)
+    map->bloom->false_positives++;
+  return NULL;
+}
+
+struct NpHashMapItem *np_hashmap_get_item(struct NpHashMap *map, void *key,
+					  unsigned hash)
+{
+  struct NpHashMapItem **link;
+
+  np_hashmap_migrate(map, NP_HASHMAP_MIGRATE_BUCKETS);
+  if ((link = np_hashmap_find(map, key, hash)) != NULL)
+    return *link;
+  return NULL;
+}
+
+void *np_hashmap_remove(struct NpHashMap *map, void *key)
+{
+  return np_hashmap_remove_hashed(map, key, np_hashmap_key_hash(map, key));
+}
+
+void *np_hashmap_remove_hashed(struct NpHashMap *map, void *key,
+			       unsigned hash)
+{
+  struct NpHashMapItem **link;
+  struct NpHashMapItem *item;
+  unsigned length;
+  void *ret;
+
+  np_hashmap_migrate(map, NP_HASHMAP_MIGRATE_BUCKETS);
+  if ((link = np_hashmap_find(map, key, hash)) == NULL)
+    return NULL;
+  item = *link;
+  ret = item->value;
+  *link = item->next;
+  if (map->arena != NULL) {
+    length = ((struct NpHashMapStringItem *)item)->length;
+    if (length >= NP_HASHMAP_KEY_PREFIX)
+      map->key_bytes -= length + 1;
+  }
+  np_pool_release(map->pool, item);
+  map->size--;
+  if (map->bloom != NULL) {
+    np_bloom_remove(map->bloom);
+    if (np_bloom_stale(map->bloom))
+      np_hashmap_bloom_rebuild(map);
+  }
+  np_hashmap_shrink(map);
+  if (map->arena != NULL)
+    np_hashmap_compact(map);
+  return ret;
+}
+
+/*
+ * Prefetches the buckets for a batch of hashes, then the chain heads they
+ * point to. The loads of the second loop hit the buckets fetched by the
+ * first.
+ */
+static void np_hashmap_prefetch(struct NpHashMap *map, unsigned *hashes,
+				unsigned count)
+{
+  unsigned i;
+
+  for (i = 0; i < count; ++i) {
+    NP_HASHMAP_PREFETCH(&map->items[hashes[i] % map->capacity]);
+    if (map->old_items != NULL)
+      NP_HASHMAP_PREFETCH(&map->old_items[hashes[i] % map->old_capacity]);
+  }
+  for (i = 0; i < count; ++i)
+    NP_HASHMAP_PREFETCH(map->items[hashes[i] % map->capacity]);
+}
+
+unsigned np_hashmap_get_many(struct NpHashMap *map, void **keys,
+			     void **values, unsigned count)
+{
+  struct NpHashMapItem **link;
+  unsigned hashes[NP_HASHMAP_BATCH_SIZE];
+  unsigned indexes[NP_HASHMAP_BATCH_SIZE];
+  unsigned batch;
+  unsigned candidates;
+  unsigned found;
+  unsigned hash;
+  unsigned i;
+  unsigned j;
+
+  found = 0;
+  for (i = 0; i < count; i += batch) {
+    batch = count - i < NP_HASHMAP_BATCH_SIZE ? count - i
+      : NP_HASHMAP_BATCH_SIZE;
+    np_hashmap_migrate(map, NP_HASHMAP_MIGRATE_BUCKETS * batch);
+
+    /* keys rejected by the Bloom filter are neither prefetched nor walked */
+    for (j = 0, candidates = 0; j < batch; ++j) {
+      values[i + j] = NULL;
+      hash = np_hashmap_key_hash(map, keys[i + j]);
+      if (map->bloom == NULL || np_bloom_contains(map->bloom, hash)) {
+	hashes[candidates] = hash;
+	indexes[candidates++] = i + j;
+      }
+    }
+    np_hashmap_prefetch(map, hashes, candidates);
+    for (j = 0; j < candidates; ++j) {
+      if ((link = np_hashmap_find(map, keys[indexes[j]], hashes[j])) != NULL) {
+	values[indexes[j]] = (*link)->value;
+	found++;
+      } else if (map->bloom != NULL) {
+	map->bloom->false_positives++;
+      }
+    }
+  }
+  return found;
+}
+
+unsigned np_hashmap_put_many(struct NpHashMap *map, void **keys,
+			     void **values, unsigned count)
+{
+  struct NpHashMapItem *item;
+  unsigned hashes[NP_HASHMAP_BATCH_SIZE];
+  unsigned batch;
+  unsigned i;
+  unsigned j;
+  int inserted;
+
+  for (i = 0; i < count; i += batch) {
+    batch = count - i < NP_HASHMAP_BATCH_SIZE ? count - i
+      : NP_HASHMAP_BATCH_SIZE;
+    for (j = 0; j < batch; ++j)
+      hashes[j] = np_hashmap_key_hash(map, keys[i + j]);
+    np_hashmap_prefetch(map, hashes, batch);
+    for (j = 0; j < batch; ++j) {
+      item = np_hashmap_find_or_link(map, keys[i + j], hashes[j], &inserted);
+      if (item == NULL)
+	return i + j;
+      item->value = values[i + j];
+    }
+  }
+  return count;
+}
+
+void np_hashmap_set_seed(struct NpHashMap *map, uint64_t k0, uint64_t k1)
+{
+  struct NpHashMapItem *list;
+  struct NpHashMapItem *item;
+  unsigned i;
+
+  map->seed[0] = k0;
+  map->seed[1] = k1;
+  if (map->keyed_hash == NULL)
+    return;
+
+  /* unlink every item, then relink it by its new hash */
+  np_hashmap_migrate(map, map->old_capacity);
+  list = NULL;
+  for (i = 0; i < map->capacity; ++i) {
+    while ((item = map->items[i]) != NULL) {
+      map->items[i] = item->next;
+      item->next = list;
+      list = item;
+    }
+  }
+  while ((item = list) != NULL) {
+    list = item->next;
+    item->hash = map->keyed_hash(item->key, map->seed);
+    i = item->hash % map->capacity;
+    item->next = map->items[i];
+    map->items[i] = item;
+  }
+  if (map->bloom != NULL)
+    np_hashmap_bloom_rebuild(map);
+}
+
+struct NpHashMap *np_hashmap_set_alloc_policy(
+  struct NpHashMap *map, const struct NpAllocPolicy *policy)
+{
+  struct NpHashMapItem **items;
+  size_t size;
+
+  np_hashmap_migrate(map, map->old_capacity);
+  size = sizeof *items * map->capacity;
+  if ((items = np_alloc(policy, size)) == NULL)
+    return NULL;
+  memcpy(items, map->items, size);
+  np_alloc_free(&map->alloc_policy, map->items, size);
+  map->items = items;
+  map->alloc_policy = *policy;
+  return map;
+}
+
+void np_hashmap_set_threads(struct NpHashMap *map, unsigned threads)
+{
+  map->threads = threads > 0 ? threads : 1;
+}
+
+/*
+ * First pass of a parallel build: hashes the worker's range of the input
+ * and counts its keys per partition.
+ */
+static void *np_hashmap_count_run(void *arg)
+{
+  struct NpHashMapWorker *worker = arg;
+  struct NpHashMapJob *job = worker->job;
+  unsigned *counts;
+  unsigned end;
+  unsigned i;
+
+  counts = job->offsets + worker->index * job->threads;
+  end = np_hashmap_range_start(worker->index + 1, job->threads, job->count);
+  for (i = np_hashmap_range_start(worker->index, job->threads, job->count);
+       i < end; ++i) {
+    job->hashes[i] = job->map->key_hash(job->keys[i]);
+    counts[np_hashmap_range_of(job->hashes[i] % job->map->capacity,
+			       job->threads, job->map->capacity)]++;
+  }
+  return NULL;
+}
+
+/*
+ * Second pass of a parallel build: writes the indexes of the worker's range
+ * of the input to their partitions, keeping their order.
+ */
+static void *np_hashmap_scatter_run(void *arg)
+{
+  struct NpHashMapWorker *worker = arg;
+  struct NpHashMapJob *job = worker->job;
+  unsigned *offsets;
+  unsigned end;
+  unsigned i;
+
+  offsets = job->offsets + worker->index * job->threads;
+  end = np_hashmap_range_start(worker->index + 1, job->threads, job->count);
+  for (i = np_hashmap_range_start(worker->index, job->threads, job->count);
+       i < end; ++i)
+    job->order[offsets[np_hashmap_range_of(job->hashes[i]
+					   % job->map->capacity,
+					   job->threads,
+					   job->map->capacity)]++] = i;
+  return NULL;
+}
+
+/*
+ * Last pass of a parallel build: inserts the worker's partition, whose keys
+ * all fall in the worker's range of buckets, with items from its own pool.
+ */
+static void *np_hashmap_insert_run(void *arg)
+{
+  struct NpHashMapWorker *worker = arg;
+  struct NpHashMapJob *job = worker->job;
+  struct NpHashMap *map = job->map;
+  struct NpHashMapItem *item;
+  unsigned *last;
+  unsigned start;
+  unsigned end;
+  unsigned hash;
+  unsigned i;
+  unsigned j;
+
+  /* after the scatter each offset is the end of its part of a partition */
+  last = job->offsets + (job->threads - 1) * job->threads;
+  start = worker->index > 0 ? last[worker->index - 1] : 0;
+  end = last[worker->index];
+  for (j = start; j < end; ++j) {
+    i = job->order[j];
+    hash = job->hashes[i];
+    for (item = map->items[hash % map->capacity]; item != NULL;
+	 item = item->next)
+      if (item->hash == hash && map->key_compare(job->keys[i], item->key) == 0)
+	break;
+    if (item == NULL) {
+      if ((item = np_pool_alloc(worker->pool)) == NULL) {
+	worker->failed = 1;
+	return NULL;
+      }
+      item->key = job->keys[i];
+      item->hash = hash;
+      item->next = map->items[hash % map->capacity];
+      map->items[hash % map->capacity] = item;
+      worker->size++;
+    }
+    item->value = job->values[i];
+  }
+  return NULL;
+}
+
+struct NpHashMap *np_hashmap_build_parallel(
+  int (*key_compare)(void *key1, void *key2), unsigned (*key_hash)(void *key),
+  void **keys, void **values, unsigned count, unsigned threads)
+{
+  struct NpHashMap *map;
+  struct NpHashMapJob job;
+  struct NpHashMapWorker *workers;
+  unsigned offset;
+  unsigned c;
+  unsigned i;
+  unsigned p;
+  unsigned r;
+  int failed;
+
+  if ((map = np_hashmap_new_with_capacity(key_compare, key_hash, count))
+      == NULL)
+    return NULL;
+  np_hashmap_set_threads(map, threads);
+  if (count == 0)
+    return map;
+  job.map = map;
+  job.threads = map->threads;
+  job.keys = keys;
+  job.values = values;
+  job.count = count;
+  job.hashes = malloc(sizeof *job.hashes * count);
+  job.order = malloc(sizeof *job.order * count);
+  job.offsets = calloc((size_t)job.threads * job.threads,
+		       sizeof *job.offsets);
+  workers = calloc(job.threads, sizeof *workers);
+  failed = job.hashes == NULL || job.order == NULL || job.offsets == NULL
+    || workers == NULL;
+  for (i = 0; !failed && i < job.threads; ++i) {
+    workers[i].job = &job;
+    workers[i].index = i;
+    failed = (workers[i].pool = np_pool_new(map->pool->item_size)) == NULL;
+  }
+
+  if (!failed) {
+    np_hashmap_run(workers, job.threads, np_hashmap_count_run);
+
+    /* partitions in order, each holding the parts of the input ranges */
+    for (p = 0, offset = 0; p < job.threads; ++p) {
+      for (r = 0; r < job.threads; ++r) {
+	c = job.offsets[r * job.threads + p];
+	job.offsets[r * job.threads + p] = offset;
+	offset += c;
+      }
+    }
+    np_hashmap_run(workers, job.threads, np_hashmap_scatter_run);
+    np_hashmap_run(workers, job.threads, np_hashmap_insert_run);
+  }
+
+  for (i = 0; workers != NULL && i < job.threads; ++i) {
+    if (workers[i].pool != NULL)
+      np_pool_merge(map->pool, workers[i].pool);
+    map->size += workers[i].size;
+    failed |= workers[i].failed;
+  }
+  free(job.hashes);
+  free(job.order);
+  free(job.offsets);
+  free(workers);
+  if (failed) {
+    np_hashmap_free(map);
+    return NULL;
+  }
+  return map;
+}
+
+struct NpHashMap *np_hashmap_reserve(struct NpHashMap *map, unsigned capacity)
+{
+  if (capacity <= map->threshold)
+    return map;
+  capacity = np_hashmap_capacity_for(capacity, map->load_factor);
+  if ((map = np_hashmap_resize(map, capacity)) != NULL
+      && map->min_capacity < capacity)
+    map->min_capacity = capacity;
+  return map;
+}
+
+struct NpHashMap *np_hashmap_shrink_to_fit(struct NpHashMap *map)
+{
+  unsigned capacity;
+
+  capacity = np_hashmap_capacity_for(map->size, map->load_factor);
+  if (map->min_capacity > capacity)
+    map->min_capacity = capacity;
+  return np_hashmap_resize(map, capacity);
+}
+
+struct NpHashMap *np_hashmap_set_load_factor(struct NpHashMap *map,
+					     float load_factor)
+{
+  if (load_factor <= 0)
+    return NULL;
+  map->load_factor = load_factor;
+  np_hashmap_set_thresholds(map);
+  return np_hashmap_reserve(map, map->size + 1);
+}
+
+/*
+ * Finds the first item of the next non-empty bucket, moving on from the
+ * previous table to the current one, and prefetches it.
+ */
+static struct NpHashMapItem *np_hashmap_iterator_scan(
+  struct NpHashMapIterator *iter)
+{
+  struct NpHashMapItem *item;
+
+  for (;;) {
+    while (iter->bucket < iter->capacity) {
+      if ((item = iter->table[iter->bucket++]) != NULL) {
+	NP_HASHMAP_PREFETCH(item);
+	return item;
+      }
+    }
+    if (iter->table == iter->map->items)
+      return NULL;
+    iter->table = iter->map->items;
+    iter->capacity = iter->map->capacity;
+    iter->bucket = 0;
+  }
+}
+
+struct NpHashMapIterator *np_hashmap_iterator(struct NpHashMap *map)
+{
+  struct NpHashMapIterator *iter;
+
+  iter = malloc(sizeof *iter);
+  if (iter)
+    np_hashmap_iterator_init(iter, map);
+  return iter;
+}
+
+void np_hashmap_iterator_init(struct NpHashMapIterator *iter,
+			      struct NpHashMap *map)
+{
+  iter->map = map;
+  if (map->old_items != NULL) {
+    /* buckets below migrate_index are empty */
+    iter->table = map->old_items;
+    iter->capacity = map->old_capacity;
+    iter->bucket = map->migrate_index;
+  } else {
+    iter->table = map->items;
+    iter->capacity = map->capacity;
+    iter->bucket = 0;
+  }
+  iter->item = np_hashmap_iterator_scan(iter);
+  iter->head = np_hashmap_iterator_scan(iter);
+}
+
+void np_hashmap_iterator_free(struct NpHashMapIterator *iter)
+{
+  free(iter);
+}
+
+void *np_hashmap_iterator_next_key(struct NpHashMapIterator *iter)
+{
+  struct NpHashMapItem *item;
+
+  if ((item = iter->item) == NULL)
+    return NULL;
+  if (item->next != NULL) {
+    iter->item = item->next;
+  } else {
+    iter->item = iter->head;
+    iter->head = np_hashmap_iterator_scan(iter);
+  }
+  return item->key;
+}
+
+void *np_hashmap_iterator_peek_next_key(struct NpHashMapIterator *iter)
+{
+  return iter->item != NULL ? iter->item->key : NULL;
+}
+
+void *np_hashmap_iterator_peek_next_value(struct NpHashMapIterator *iter)
+{
+  return iter->item != NULL ? iter->item->value : NULL;
+}
+
+/*
+ * Copies the items of one table, prefetching the chain heads a few buckets
+ * ahead of the bucket being copied.
+ */
+static unsigned np_hashmap_export_table(struct NpHashMapItem **table,
+					unsigned begin, unsigned end,
+					void **keys, void **values,
+					unsigned count)
+{
+  struct NpHashMapItem *item;
+  unsigned i;
+
+  for (i = begin; i < end; ++i) {
+    if (i + NP_HASHMAP_EXPORT_PREFETCH < end)
+      NP_HASHMAP_PREFETCH(table[i + NP_HASHMAP_EXPORT_PREFETCH]);
+    for (item = table[i]; item != NULL; item = item->next) {
+      if (keys != NULL)
+	keys[count] = item->key;
+      if (values != NULL)
+	values[count] = item->value;
+      count++;
+    }
+  }
+  return count;
+}
+
+unsigned np_hashmap_export(struct NpHashMap *map, void **keys, void **values)
+{
+  unsigned count;
+
+  count = 0;
+  if (map->old_items != NULL)
+    count = np_hashmap_export_table(map->old_items, map->migrate_index,
+				    map->old_capacity, keys, values, count);
+  return np_hashmap_export_table(map->items, 0, map->capacity, keys, values,
+				 count);
+}
+
+struct NpHashMap *np_hashmap_attach_bloom(struct NpHashMap *map)
+{
+  if (map->bloom == NULL) {
+    if ((map->bloom = np_bloom_new(map->size * 2)) == NULL)
+      return NULL;
+    np_hashmap_bloom_add_all(map);
+  }
+  return map;
+}
+
+void np_hashmap_detach_bloom(struct NpHashMap *map)
+{
+  if (map->bloom != NULL) {
+    np_bloom_free(map->bloom);
+    map->bloom = NULL;
+  }
+}
+
+void np_hashmap_set_resize_mode(struct NpHashMap *map,
+				enum NpHashMapResizeMode mode)
+{
+  map->resize_mode = mode;
+  if (mode == NP_HASHMAP_RESIZE_FULL && map->old_items != NULL)
+    np_hashmap_migrate(map, map->old_capacity);
+}
+
+/*
+ * Adds the chain lengths of the buckets of a table to the statistics.
+ */
+static void np_hashmap_stats_table(struct NpHashMapItem **table,
+				   unsigned first, unsigned capacity,
+				   struct NpHashMapStats *stats)
+{
+  struct NpHashMapItem *item;
+  unsigned length;
+  unsigned i;
+
+  for (i = first; i < capacity; ++i) {
+    for (length = 0, item = table[i]; item != NULL; item = item->next)
+      length++;
+    stats->buckets++;
+    stats->chains[length < NP_HASHMAP_STATS_CHAINS ? length
+		  : NP_HASHMAP_STATS_CHAINS - 1]++;
+    if (length > stats->max_chain)
+      stats->max_chain = length;
+  }
+}
+
+void np_hashmap_stats(struct NpHashMap *map, struct NpHashMapStats *stats)
+{
+  memset(stats, 0, sizeof *stats);
+  stats->size = map->size;
+  stats->capacity = map->capacity;
+  if (map->old_items != NULL)
+    np_hashmap_stats_table(map->old_items, map->migrate_index,
+			   map->old_capacity, stats);
+  np_hashmap_stats_table(map->items, 0, map->capacity, stats);
+  stats->empty_ratio = (double)stats->chains[0] / stats->buckets;
+  if (stats->buckets > stats->chains[0])
+    stats->mean_chain = (double)map->size
+      / (stats->buckets - stats->chains[0]);
+  stats->resizes = map->resizes;
+  stats->resize_seconds = map->resize_seconds;
+  stats->bytes = sizeof *map + sizeof *map->items * map->capacity
+    + sizeof *map->pool + map->pool->bytes;
+  if (map->old_items != NULL)
+    stats->bytes += sizeof *map->old_items * map->old_capacity;
+  if (map->arena != NULL)
+    stats->bytes += sizeof *map->arena + map->arena->bytes;
+  if (map->bloom != NULL)
+    stats->bytes += sizeof *map->bloom
+      + sizeof *map->bloom->blocks * map->bloom->block_count;
+}
+
+unsigned np_hashmap_hash(void *key, int length)
+{
+  uint64_t h;
+
+  h = np_hashmap_hash64(key, length);
+  return (unsigned)(h ^ (h >> 32));
+}
+
+/*
+ * np_hashmap_hash64 combines the wyhash multiply-mix for keys up to 128
+ * bytes with xxh3 style 64 byte stripe accumulation for longer keys.
+ */
+
+#define NP_HASH64_P0 0xa0761d6478bd642fULL
+#define NP_HASH64_P1 0xe7037ed1a0b428dbULL
+#define NP_HASH64_P2 0x8ebc6af09c88c6e3ULL
+#define NP_HASH64_P3 0x589965cc75374cc3ULL
+#define NP_HASH64_PRIME32 0x9e3779b1U
+
+#define NP_HASH64_STRIPE 64
+#define NP_HASH64_STRIPES_PER_BLOCK 16
+
+static const uint64_t np_hash64_secret[8] = {
+  0xbe4ba423396cfeb8ULL, 0x1cad21f72c81017cULL,
+  0xdb979083e96dd4deULL, 0x1f67b3b7a4a44072ULL,
+  0x78e5c0cc4ee679cbULL, 0x2172ffcc7dd05a82ULL,
+  0x8e2443f7744608b8ULL, 0x4c263a81e69035e0ULL
+};
+
+#ifdef __GNUC__
+__extension__ typedef unsigned __int128 np_hash64_uint128;
+#endif
+
+static uint64_t np_hash64_mix(uint64_t a, uint64_t b)
+{
+#if defined(__GNUC__) && defined(__SIZEOF_INT128__)
+  np_hash64_uint128 r;
+
+  r = (np_hash64_uint128)a * b;
+  return (uint64_t)r ^ (uint64_t)(r >> 64);
+#else
+  uint64_t ha, hb, la, lb, rh, rm0, rm1, rl, t, lo;
+  int c;
+
+  ha = a >> 32;
+  hb = b >> 32;
+  la = (uint32_t)a;
+  lb = (uint32_t)b;
+  rh = ha * hb;
+  rm0 = ha * lb;
+  rm1 = hb * la;
+  rl = la * lb;
+  t = rl + (rm0 << 32);
+  c = t < rl;
+  lo = t + (rm1 << 32);
+  c += lo < t;
+  return lo ^ (rh + (rm0 >> 32) + (rm1 >> 32) + c);
+#endif
+}
+
+static uint64_t np_hash64_swap(uint64_t v)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return __builtin_bswap64(v);
+#else
+  return v;
+#endif
+}
+
+static uint64_t np_hash64_read64(const unsigned char *p)
+{
+  uint64_t v;
+
+  memcpy(&v, p, sizeof v);
+  return np_hash64_swap(v);
+}
+
+static uint64_t np_hash64_read32(const unsigned char *p)
+{
+  uint32_t v;
+
+  memcpy(&v, p, sizeof v);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  v = __builtin_bswap32(v);
+#endif
+  return v;
+}
+
+static uint64_t np_hash64_finish(uint64_t a, uint64_t b, uint64_t seed,
+				 uint64_t length)
+{
+  return np_hash64_mix(NP_HASH64_P1 ^ length,
+		       np_hash64_mix(a ^ NP_HASH64_P1, b ^ seed));
+}
+
+/*
+ * Stripe accumulation. Each 64 bit lane adds the product of the low and
+ * high halves of the keyed input and the input of its neighbouring lane,
+ * which maps directly onto 32x32->64 bit SIMD multiplies.
+ */
+#if defined(__AVX2__)
+
+static void np_hash64_accumulate(uint64_t *acc, const unsigned char *p)
+{
+  __m256i a, d, dk, hi, prod, swap;
+  int j;
+
+  for (j = 0; j < 2; ++j) {
+    a = _mm256_loadu_si256((const __m256i *)(acc + 4 * j));
+    d = _mm256_loadu_si256((const __m256i *)(p + 32 * j));
+    dk = _mm256_xor_si256(d, _mm256_loadu_si256(
+			    (const __m256i *)(np_hash64_secret + 4 * j)));
+    hi = _mm256_shuffle_epi32(dk, _MM_SHUFFLE(0, 3, 0, 1));
+    prod = _mm256_mul_epu32(dk, hi);
+    swap = _mm256_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+    a = _mm256_add_epi64(a, _mm256_add_epi64(prod, swap));
+    _mm256_storeu_si256((__m256i *)(acc + 4 * j), a);
+  }
+}
+
+static void np_hash64_scramble(uint64_t *acc)
+{
+  __m256i a, prime, lo, hi;
+  int j;
+
+  prime = _mm256_set1_epi32((int)NP_HASH64_PRIME32);
+  for (j = 0; j < 2; ++j) {
+    a = _mm256_loadu_si256((const __m256i *)(acc + 4 * j));
+    a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+    a = _mm256_xor_si256(a, _mm256_loadu_si256(
+			   (const __m256i *)(np_hash64_secret + 4 * j)));
+    lo = _mm256_mul_epu32(a, prime);
+    hi = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), prime);
+    a = _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+    _mm256_storeu_si256((__m256i *)(acc + 4 * j), a);
+  }
+}
+
+#elif defined(__SSE2__)
+
+static void np_hash64_accumulate(uint64_t *acc, const unsigned char *p)
+{
+  __m128i a, d, dk, hi, prod, swap;
+  int j;
+
+  for (j = 0; j < 4; ++j) {
+    a = _mm_loadu_si128((const __m128i *)(acc + 2 * j));
+    d = _mm_loadu_si128((const __m128i *)(p + 16 * j));
+    dk = _mm_xor_si128(d, _mm_loadu_si128(
+			 (const __m128i *)(np_hash64_secret + 2 * j)));
+    hi = _mm_shuffle_epi32(dk, _MM_SHUFFLE(0, 3, 0, 1));
+    prod = _mm_mul_epu32(dk, hi);
+    swap = _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+    a = _mm_add_epi64(a, _mm_add_epi64(prod, swap));
+    _mm_storeu_si128((__m128i *)(acc + 2 * j), a);
+  }
+}
+
+static void np_hash64_scramble(uint64_t *acc)
+{
+  __m128i a, prime, lo, hi;
+  int j;
+
+  prime = _mm_set1_epi32((int)NP_HASH64_PRIME32);
+  for (j = 0; j < 4; ++j) {
+    a = _mm_loadu_si128((const __m128i *)(acc + 2 * j));
+    a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+    a = _mm_xor_si128(a, _mm_loadu_si128(
+			(const __m128i *)(np_hash64_secret + 2 * j)));
+    lo = _mm_mul_epu32(a, prime);
+    hi = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+    a = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+    _mm_storeu_si128((__m128i *)(acc + 2 * j), a);
+  }
+}
+
+#else
+
+static void np_hash64_accumulate(uint64_t *acc, const unsigned char *p)
+{
+  uint64_t d;
+  uint64_t dk;
+  int i;
+
+  for (i = 0; i < 8; ++i) {
+    d = np_hash64_read64(p + 8 * i);
+    dk = d ^ np_hash64_secret[i];
+    acc[i ^ 1] += d;
+    acc[i] += (dk & 0xffffffff) * (dk >> 32);
+  }
+}
+
+static void np_hash64_scramble(uint64_t *acc)
+{
+  uint64_t a;
+  int i;
+
+  for (i = 0; i < 8; ++i) {
+    a = acc[i];
+    a ^= a >> 47;
+    a ^= np_hash64_secret[i];
+    acc[i] = a * NP_HASH64_PRIME32;
+  }
+}
+
+#endif
+
+static uint64_t np_hash64_long(const unsigned char *p, size_t length)
+{
+  uint64_t acc[8];
+  uint64_t h;
+  size_t stripes;
+  size_t s;
+  int i;
+
+  acc[0] = NP_HASH64_P0;
+  acc[1] = NP_HASH64_P1;
+  acc[2] = NP_HASH64_P2;
+  acc[3] = NP_HASH64_P3;
+  acc[4] = ~NP_HASH64_P0;
+  acc[5] = ~NP_HASH64_P1;
+  acc[6] = ~NP_HASH64_P2;
+  acc[7] = ~NP_HASH64_P3;
+
+  /* the final, possibly overlapping, stripe ends at the end of the key */
+  stripes = (length - 1) / NP_HASH64_STRIPE;
+  for (s = 0; s < stripes; ++s) {
+    np_hash64_accumulate(acc, p + s * NP_HASH64_STRIPE);
+    if ((s + 1) % NP_HASH64_STRIPES_PER_BLOCK == 0)
+      np_hash64_scramble(acc);
+  }
+  np_hash64_accumulate(acc, p + length - NP_HASH64_STRIPE);
+
+  h = length * NP_HASH64_P0;
+  for (i = 0; i < 8; i += 2)
+    h += np_hash64_mix(acc[i] ^ np_hash64_secret[i],
+		       acc[i + 1] ^ np_hash64_secret[i + 1]);
+  h ^= h >> 37;
+  h *= 0x165667919e3779f9ULL;
+  return h ^ (h >> 32);
+}
+
+uint64_t np_hashmap_hash64(const void *key, size_t length)
+{
+  const unsigned char *p = key;
+  uint64_t seed;
+  uint64_t a;
+  uint64_t b;
+  size_t i;
+  size_t shift;
+
+  seed = NP_HASH64_P0;
+  if (length <= 16) {
+    if (length >= 4) {
+      shift = (length >> 3) << 2;
+      a = (np_hash64_read32(p) << 32) | np_hash64_read32(p + shift);
+      b = (np_hash64_read32(p + length - 4) << 32)
+	| np_hash64_read32(p + length - 4 - shift);
+    } else if (length > 0) {
+      a = ((uint64_t)p[0] << 16) | ((uint64_t)p[length >> 1] << 8)
+	| p[length - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else if (length <= 128) {
+    for (i = 0; length - i > 16; i += 16)
+      seed = np_hash64_mix(np_hash64_read64(p + i) ^ NP_HASH64_P1,
+			   np_hash64_read64(p + i + 8) ^ seed);
+    a = np_hash64_read64(p + length - 16);
+    b = np_hash64_read64(p + length - 8);
+  } else {
+    return np_hash64_long(p, length);
+  }
+  return np_hash64_finish(a, b, seed, length);
+}
+
+uint64_t np_hashmap_hash64_u32(uint32_t key)
+{
+  uint64_t a;
+
+  a = ((uint64_t)key << 32) | key;
+  return np_hash64_finish(a, a, NP_HASH64_P0, 4);
+}
+
+uint64_t np_hashmap_hash64_u64(uint64_t key)
+{
+  uint64_t a;
+
+  a = (key << 32) | (key >> 32);
+  return np_hash64_finish(a, key, NP_HASH64_P0, 8);
+}
+
+#define NP_SIPHASH_ROTL(x, b) (((x) << (b)) | ((x) >> (64 - (b))))
+
+static void np_siphash_round(uint64_t *v)
+{
+  v[0] += v[1];
+  v[1] = NP_SIPHASH_ROTL(v[1], 13);
+  v[1] ^= v[0];
+  v[0] = NP_SIPHASH_ROTL(v[0], 32);
+  v[2] += v[3];
+  v[3] = NP_SIPHASH_ROTL(v[3], 16);
+  v[3] ^= v[2];
+  v[0] += v[3];
+  v[3] = NP_SIPHASH_ROTL(v[3], 21);
+  v[3] ^= v[0];
+  v[2] += v[1];
+  v[1] = NP_SIPHASH_ROTL(v[1], 17);
+  v[1] ^= v[2];
+  v[2] = NP_SIPHASH_ROTL(v[2], 32);
+}
+
+/*
+ * SipHash-1-3: one compression round per word and three finalization
+ * rounds.
+ */
+uint64_t np_hashmap_siphash(const void *key, size_t length,
+			    const uint64_t *seed)
+{
+  const unsigned char *p;
+  uint64_t v[4];
+  uint64_t m;
+  size_t i;
+
+  v[0] = seed[0] ^ 0x736f6d6570736575ULL;
+  v[1] = seed[1] ^ 0x646f72616e646f6dULL;
+  v[2] = seed[0] ^ 0x6c7967656e657261ULL;
+  v[3] = seed[1] ^ 0x7465646279746573ULL;
+  p = key;
+  for (i = 0; i + 8 <= length; i += 8) {
+    m = np_hash64_read64(p + i);
+    v[3] ^= m;
+    np_siphash_round(v);
+    v[0] ^= m;
+  }
+
+  /* the last word holds the remaining bytes and the length */
+  m = (uint64_t)length << 56;
+  switch (length & 7) {
+  case 7: m |= (uint64_t)p[i + 6] << 48; /* fall through */
+  case 6: m |= (uint64_t)p[i + 5] << 40; /* fall through */
+  case 5: m |= (uint64_t)p[i + 4] << 32; /* fall through */
+  case 4: m |= (uint64_t)p[i + 3] << 24; /* fall through */
+  case 3: m |= (uint64_t)p[i + 2] << 16; /* fall through */
+  case 2: m |= (uint64_t)p[i + 1] << 8; /* fall through */
+  case 1: m |= (uint64_t)p[i];
+  }
+  v[3] ^= m;
+  np_siphash_round(v);
+  v[0] ^= m;
+  v[2] ^= 0xff;
+  np_siphash_round(v);
+  np_siphash_round(v);
+  np_siphash_round(v);
+  return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
+
+unsigned np_hashmap_siphash_string(void *key, const uint64_t *seed)
+{
+  uint64_t h;
+
+  h = np_hashmap_siphash(key, strlen(key), seed);
+  return (unsigned)(h ^ (h >> 32));
 }
@@ -19,9 +19,66 @@
 #ifndef __NP_HASHMAP_H
 #define __NP_HASHMAP_H
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include "np_alloc.h"
+
 #define NP_HASHMAP_INITIAL_CAPACITY 16
 #define NP_HASHMAP_DEFAULT_LOAD_FACTOR 0.75
 
+/**
+   Fraction of the threshold below which removing items halves the map
+   capacity.
+*/
+#define NP_HASHMAP_SHRINK_FACTOR 0.25
+
+/**
+   Number of old table buckets migrated by each map operation while an
+   incremental resize is in progress.
+*/
+#define NP_HASHMAP_MIGRATE_BUCKETS 4
+
+/**
+   Number of keys hashed and prefetched together by the batched operations.
+*/
+#define NP_HASHMAP_BATCH_SIZE 16
+
+/**
+   Number of old table buckets below which a map with several threads still
+   resizes on the calling thread alone.
+*/
+#define NP_HASHMAP_PARALLEL_MIN_BUCKETS 65536
+
+/**
+   Number of leading key bytes stored in the items of a map with owned string
+   keys. Keys shorter than this are stored entirely in the item.
+*/
+#define NP_HASHMAP_KEY_PREFIX 12
+
+/**
+   Number of chain lengths counted separately by np_hashmap_stats(). Longer
+   chains are counted with the longest.
+*/
+#define NP_HASHMAP_STATS_CHAINS 16
+
+/**
+   Hash map resize modes.
+*/
+enum NpHashMapResizeMode {
+  /**
+     All items are moved to the new table by the put that triggers the
+     resize.
+  */
+  NP_HASHMAP_RESIZE_FULL,
+
+  /**
+     Both tables are kept while items are moved a few buckets at a time by
+     subsequent put, get, and remove calls.
+  */
+  NP_HASHMAP_RESIZE_INCREMENTAL
+};
+
 /**
    Hash map object.
 */
@@ -38,13 +95,28 @@ struct NpHashMap {
   int (*key_compare)(void *key1, void *key2);
 
   /**
-     Pointer to a function used to hash keys.
+     Pointer to a function used to hash keys, NULL for a keyed map.
 
      @param key the key to hash
      @return the hash
   */
   unsigned (*key_hash)(void *key);
 
+  /**
+     Pointer to a function used to hash keys with the map's seed, NULL for a
+     map that is not keyed.
+
+     @param key the key to hash
+     @param seed the two 64 bit words of the seed
+     @return the hash
+  */
+  unsigned (*keyed_hash)(void *key, const uint64_t *seed);
+
+  /**
+     The seed passed to keyed_hash.
+  */
+  uint64_t seed[2];
+
   /**
      The map capacity.
   */
@@ -60,6 +132,16 @@ struct NpHashMap {
    */
   unsigned threshold;
 
+  /**
+     The size below which the map shrinks (threshold * NP_HASHMAP_SHRINK_FACTOR).
+  */
+  unsigned low_water;
+
+  /**
+     The capacity below which the map never shrinks automatically.
+  */
+  unsigned min_capacity;
+
   /**
      The load factor.
   */
@@ -69,6 +151,131 @@ struct NpHashMap {
      A Pointer to the items.
   */
   struct NpHashMapItem **items;
+
+  /**
+     The resize mode.
+  */
+  enum NpHashMapResizeMode resize_mode;
+
+  /**
+     The items of the previous table while an incremental resize is in
+     progress, NULL otherwise.
+  */
+  struct NpHashMapItem **old_items;
+
+  /**
+     The capacity of the previous table.
+  */
+  unsigned old_capacity;
+
+  /**
+     The next bucket of the previous table to migrate. Buckets below this
+     index are empty.
+  */
+  unsigned migrate_index;
+
+  /**
+     The pool from which the map items are allocated.
+  */
+  struct NpPool *pool;
+
+  /**
+     The arena holding the keys of a map with owned string keys, NULL if the
+     map does not own its keys.
+  */
+  struct NpArena *arena;
+
+  /**
+     The number of arena bytes used by the keys of items in the map.
+  */
+  size_t key_bytes;
+
+  /**
+     The Bloom filter of the key hashes consulted before each get, NULL if
+     none is attached.
+  */
+  struct NpBloom *bloom;
+
+  /**
+     The number of times the map has been resized.
+  */
+  unsigned long resizes;
+
+  /**
+     The total time spent resizing the map, in seconds. For an incremental
+     resize only the allocation of the new table is timed; moving the items
+     is spread over later operations.
+  */
+  double resize_seconds;
+
+  /**
+     The allocation policy of the bucket arrays.
+  */
+  struct NpAllocPolicy alloc_policy;
+
+  /**
+     The number of threads a full resize is spread over.
+  */
+  unsigned threads;
+};
+
+/**
+   Hash map statistics.
+*/
+struct NpHashMapStats {
+  /**
+     The number of items in the map.
+  */
+  unsigned size;
+
+  /**
+     The map capacity.
+  */
+  unsigned capacity;
+
+  /**
+     The number of buckets counted, the capacity plus the unmigrated buckets
+     of the previous table during an incremental resize.
+  */
+  unsigned buckets;
+
+  /**
+     The fraction of the buckets that are empty.
+  */
+  double empty_ratio;
+
+  /**
+     The number of buckets with each chain length, with chains of
+     NP_HASHMAP_STATS_CHAINS - 1 or more items counted in the last element.
+  */
+  unsigned chains[NP_HASHMAP_STATS_CHAINS];
+
+  /**
+     The length of the longest chain.
+  */
+  unsigned max_chain;
+
+  /**
+     The mean length of the non empty chains.
+  */
+  double mean_chain;
+
+  /**
+     The number of times the map has been resized.
+  */
+  unsigned long resizes;
+
+  /**
+     The total time spent resizing the map, in seconds.
+  */
+  double resize_seconds;
+
+  /**
+     The number of bytes of memory used by the map, its tables, item pool,
+     key arena, and Bloom filter. Does not include the keys and values
+     except for the keys owned by a map with owned string keys.
+  */
+  size_t bytes;
 };
 
 /**
@@ -85,12 +292,79 @@ struct NpHashMapItem {
   */
   void *value;
 
+  /**
+     The key hash, cached so that resizes do not rehash keys and chain walks
+     can skip key_compare on items with a different hash.
+  */
+  unsigned hash;
+
   /**
      The next item.
   */
   struct NpHashMapItem *next;
 };
 
+/**
+   Hash map item of a map with owned string keys. The key points either to
+   the prefix, for keys shorter than NP_HASHMAP_KEY_PREFIX, or to a copy of
+   the key in the map's arena.
+*/
+struct NpHashMapStringItem {
+  /**
+     The item.
+  */
+  struct NpHashMapItem item;
+
+  /**
+     The key length, not including the terminating null.
+  */
+  unsigned length;
+
+  /**
+     The leading key bytes.
+  */
+  char prefix[NP_HASHMAP_KEY_PREFIX];
+};
+
+/**
+   Hash map iterator. Items are visited bucket by bucket, starting with the
+   unmigrated buckets of the previous table while an incremental resize is in
+   progress. The iterator may be allocated by np_hashmap_iterator() or
+   declared on the stack and initialized by np_hashmap_iterator_init().
+*/
+struct NpHashMapIterator {
+  /**
+     The map being iterated over.
+  */
+  struct NpHashMap *map;
+
+  /**
+     The next item.
+  */
+  struct NpHashMapItem *item;
+
+  /**
+     The first item of the non-empty bucket following the next item's
+     bucket, prefetched while the next item's chain is walked.
+  */
+  struct NpHashMapItem *head;
+
+  /**
+     The table being scanned for non-empty buckets.
+  */
+  struct NpHashMapItem **table;
+
+  /**
+     The capacity of the table being scanned.
+  */
+  unsigned capacity;
+
+  /**
+     The next bucket to scan.
+  */
+  unsigned bucket;
+};
+
 /**
    Allocates memory for and initializes a map.
 
@@ -102,7 +376,127 @@ struct NpHashMap *np_hashmap_new(int (*cmp)(void *key1, void *key2),
                             unsigned (*hash)(void *key));
 
 /**
-   Frees the memory used by the map. Does not free the keys or values.
+   Allocates memory for and initializes a map able to hold the given number
+   of items without resizing. The map does not automatically shrink below
+   this capacity.
+
+   @param key_compare the function to be used for comparing keys
+   @param key_hash the function to be used for hashing keys
+   @param capacity the number of items to make room for
+   @return a pointer to the allocated memory or NULL on error
+*/
+struct NpHashMap *np_hashmap_new_with_capacity(
+  int (*key_compare)(void *key1, void *key2), unsigned (*key_hash)(void *key),
+  unsigned capacity);
+
+/**
+   Allocates memory for and initializes a map with owned string keys. Put
+   copies new keys into the map, so the caller's key need not outlive the
+   call. Keys are compared by length and content without calling a compare
+   function, and most mismatches are rejected using the key prefix stored in
+   the item.
+
+   @return a pointer to the allocated memory or NULL on error
+*/
+struct NpHashMap *np_hashmap_new_string_keys(void);
+
+/**
+   Allocates memory for and initializes a keyed map. Keys are hashed with a
+   function taking a seed drawn at random for each map, so without knowing
+   the seed a client cannot choose keys that collide into one chain.
+
+   @param key_compare the function to be used for comparing keys
+   @param keyed_hash the function to be used for hashing keys with a seed,
+   such as np_hashmap_siphash_string()
+   @return a pointer to the allocated memory or NULL on error
+*/
+struct NpHashMap *np_hashmap_new_keyed(
+  int (*key_compare)(void *key1, void *key2),
+  unsigned (*keyed_hash)(void *key, const uint64_t *seed));
+
+/**
+   Sets the seed of a keyed map, rehashing the items already in the map.
+   Allows a map to be reproduced, or reseeded if its seed may have leaked.
+
+   @param map the keyed map
+   @param k0 the first word of the seed
+   @param k1 the second word of the seed
+*/
+void np_hashmap_set_seed(struct NpHashMap *map, uint64_t k0, uint64_t k1);
+
+/**
+   Sets the allocation policy of the map's bucket arrays, for instance to
+   back a large table with huge pages. The current table is moved to memory
+   allocated under the new policy, finishing any incremental resize.
+
+   @param map the map
+   @param policy the allocation policy
+   @return the map or NULL on error, in which case the policy is unchanged
+*/
+struct NpHashMap *np_hashmap_set_alloc_policy(
+  struct NpHashMap *map, const struct NpAllocPolicy *policy);
+
+/**
+   Sets the number of threads used by full resizes of large maps. Each
+   thread moves the items of a range of old buckets and then links the
+   items destined for its own range of new buckets, so no two threads
+   write the same bucket. The threads are started for each resize.
+
+   @param map the map
+   @param threads the number of threads, 1 to resize on the calling thread
+*/
+void np_hashmap_set_threads(struct NpHashMap *map, unsigned threads);
+
+/**
+   Allocates memory for and builds a map from arrays of keys and values
+   using several threads. The keys are hashed and partitioned by the range
+   of buckets they fall in, then each thread inserts one partition. Where
+   a key appears more than once the last value is kept. The map uses the
+   same number of threads for later resizes.
+
+   @param key_compare the function to be used for comparing keys
+   @param key_hash the function to be used for hashing keys, which must be
+   safe to call from several threads
+   @param keys the keys
+   @param values the values
+   @param count the number of keys and values
+   @param threads the number of threads
+   @return a pointer to the allocated memory or NULL on error
+*/
+struct NpHashMap *np_hashmap_build_parallel(
+  int (*key_compare)(void *key1, void *key2), unsigned (*key_hash)(void *key),
+  void **keys, void **values, unsigned count, unsigned threads);
+
+/**
+   Hashes a key the way the map does, with the map's seed if it is keyed.
+   This is the hash expected by the functions taking a precomputed hash.
+
+   @param map the map
+   @param key the key to hash
+   @return the hash
+*/
+unsigned np_hashmap_key_hash(struct NpHashMap *map, void *key);
+
+/**
+   Allocates memory for and initializes a map whose items are larger than
+   struct NpHashMapItem. The item is the first member of the caller's item
+   type, so data such as list links can be stored in the map item rather
+   than in a separate allocation. Items are relinked, never moved, while
+   the map resizes.
+
+   @param key_compare the function to be used for comparing keys
+   @param key_hash the function to be used for hashing keys
+   @param capacity the number of items to make room for
+   @param item_size the item size, at least sizeof(struct NpHashMapItem)
+   @return a pointer to the allocated memory or NULL on error
+*/
+struct NpHashMap *np_hashmap_new_with_item_size(
+  int (*key_compare)(void *key1, void *key2), unsigned (*key_hash)(void *key),
+  unsigned capacity, size_t item_size);
+
+/**
+   Frees the memory used by the map. Does not free the keys or values,
+   except for the keys owned by a map with owned string keys.
 
    @param map the map to free
 */
@@ -139,7 +533,290 @@ void *np_hashmap_get(struct NpHashMap *map, void *key);
 void *np_hashmap_remove(struct NpHashMap *map, void *key);
 
 /**
-   Creates a hash for the key of the given length.
+   Puts an item into the map unless the key is already present, hashing the
+   key once and walking its chain once.
+
+   @param map the map in which to put the item
+   @param key the key at which to store the value
+   @param value the value to store if the key is absent
+   @return the value now at the key, which is the existing value if the key
+   was present, or NULL on error
+*/
+void *np_hashmap_put_if_absent(struct NpHashMap *map, void *key, void *value);
+
+/**
+   Gets the value slot of a key, inserting the key with a NULL value if it
+   is absent. The slot can be read and written in place, for instance to
+   count occurrences of keys with a single lookup. Items are never moved,
+   so the slot stays valid until the key is removed.
+
+   @param map the map
+   @param key the key
+   @param inserted if not NULL, set to 1 if the key was inserted or 0 if it
+   was present
+   @return a pointer to the value slot or NULL on error
+*/
+void **np_hashmap_get_or_insert(struct NpHashMap *map, void *key,
+				int *inserted);
+
+/**
+   Replaces the value of a key by the result of a function of its current
+   value, inserting the key if it is absent, with a single lookup.
+
+   @param map the map
+   @param key the key
+   @param remap the function computing the new value from the key as
+   stored in the map, the current value or NULL if the key is absent, and
+   arg
+   @param arg passed to remap
+   @return the new value or NULL on error, in which case remap is not called
+*/
+void *np_hashmap_compute(struct NpHashMap *map, void *key,
+			 void *(*remap)(void *key, void *value, void *arg),
+			 void *arg);
+
+/**
+   Puts an item into the map using a precomputed key hash.
+
+   @param map the map in which to put the item
+   @param key the key at which to store the value, replacing an existing item
+   @param value the value to store
+   @param hash the key hash, which must equal np_hashmap_key_hash(map, key)
+   @return a pointer to the added item or NULL on error
+*/
+void *np_hashmap_put_hashed(struct NpHashMap *map, void *key, void *value,
+			    unsigned hash);
+
+/**
+   Gets an item from the map using a precomputed key hash. Allows a key
+   hashed once to be looked up in several maps sharing the same hash
+   function.
+
+   @param map the map from which to retrieve the item
+   @param key the key of the item to retrieve
+   @param hash the key hash, which must equal np_hashmap_key_hash(map, key)
+   @return a pointer to the item or NULL if the item does not exist
+*/
+void *np_hashmap_get_hashed(struct NpHashMap *map, void *key, unsigned hash);
+
+/**
+   Removes an item from the map using a precomputed key hash.
+
+   @param map the map from which to remove the item
+   @param key the key of the item to remove
+   @param hash the key hash, which must equal np_hashmap_key_hash(map, key)
+   @return a pointer to the removed item or NULL if there is no item at the
+   given key
+*/
+void *np_hashmap_remove_hashed(struct NpHashMap *map, void *key,
+			       unsigned hash);
+
+/**
+   Gets the item holding a key using a precomputed key hash.
+
+   @param map the map from which to retrieve the item
+   @param key the key of the item to retrieve
+   @param hash the key hash, which must equal np_hashmap_key_hash(map, key)
+   @return a pointer to the map item or NULL if the item does not exist
+*/
+struct NpHashMapItem *np_hashmap_get_item(struct NpHashMap *map, void *key,
+					  unsigned hash);
+
+/**
+   Inserts a new item for a key that is not in the map, skipping the search
+   for an existing item. The item value is set to NULL.
+
+   @param map the map in which to insert the item
+   @param key the key, which must not already be in the map
+   @param hash the key hash, which must equal np_hashmap_key_hash(map, key)
+   @return a pointer to the new map item or NULL on error
+*/
+struct NpHashMapItem *np_hashmap_insert_item(struct NpHashMap *map, void *key,
+					     unsigned hash);
+
+/**
+   Gets several items from the map. All keys of a batch are hashed and their
+   buckets and chain heads prefetched before any chain is walked, so the
+   cache misses of the lookups overlap.
+
+   @param map the map from which to retrieve the items
+   @param keys the keys of the items to retrieve
+   @param values receives the item for each key or NULL if it does not exist
+   @param count the number of keys
+   @return the number of keys found
+*/
+unsigned np_hashmap_get_many(struct NpHashMap *map, void **keys,
+			     void **values, unsigned count);
+
+/**
+   Puts several items into the map, hashing and prefetching a batch of keys
+   at a time.
+
+   @param map the map in which to put the items
+   @param keys the keys at which to store the values
+   @param values the values to store
+   @param count the number of items
+   @return the number of items put, less than count on error
+*/
+unsigned np_hashmap_put_many(struct NpHashMap *map, void **keys,
+			     void **values, unsigned count);
+
+/**
+   Grows the map so it can hold the given number of items without resizing.
+   The map does not automatically shrink below the reserved capacity.
+
+   @param map the map
+   @param capacity the number of items to make room for
+   @return the map or NULL on error
+*/
+struct NpHashMap *np_hashmap_reserve(struct NpHashMap *map, unsigned capacity);
+
+/**
+   Shrinks the map to the smallest capacity that holds its current items
+   without resizing, lowering any reserved capacity.
+
+   @param map the map
+   @return the map or NULL on error
+*/
+struct NpHashMap *np_hashmap_shrink_to_fit(struct NpHashMap *map);
+
+/**
+   Sets the load factor of the map, resizing it if needed.
+
+   @param map the map
+   @param load_factor the load factor, greater than 0
+   @return the map or NULL on error
+*/
+struct NpHashMap *np_hashmap_set_load_factor(struct NpHashMap *map,
+					     float load_factor);
+
+/**
+   Creates an iterator for the map. The map must not be modified while using
+   the iterator, which includes calling get on a map with an incremental
+   resize in progress. If the map is modified the iterator behaviour is
+   undefined.
+
+   @param map the map
+   @return the iterator or NULL on error
+*/
+struct NpHashMapIterator *np_hashmap_iterator(struct NpHashMap *map);
+
+/**
+   Initializes an iterator allocated by the caller, usually on the stack.
+   The same restrictions as for np_hashmap_iterator() apply.
+
+   @param iter the iterator to initialize
+   @param map the map
+*/
+void np_hashmap_iterator_init(struct NpHashMapIterator *iter,
+			      struct NpHashMap *map);
+
+/**
+   Frees the memory used by an iterator created by np_hashmap_iterator().
+
+   @param iter the iterator to free
+*/
+void np_hashmap_iterator_free(struct NpHashMapIterator *iter);
+
+/**
+   Retrieves the next key from the iterator.
+
+   @param iter the iterator
+   @return the next key in the map or NULL if no keys are left
+*/
+void *np_hashmap_iterator_next_key(struct NpHashMapIterator *iter);
+
+/**
+   Retrieves the next key without advancing the iterator.
+
+   @param iter the iterator
+   @return the next key or NULL if no keys are left
+*/
+void *np_hashmap_iterator_peek_next_key(struct NpHashMapIterator *iter);
+
+/**
+   Retrieves the next value without advancing the iterator.
+
+   @param iter the iterator
+   @return the next value or NULL if no values are left
+*/
+void *np_hashmap_iterator_peek_next_value(struct NpHashMapIterator *iter);
+
+/**
+   Copies all keys and values of the map into the given arrays in a single
+   pass over the buckets, in iterator order.
+
+   @param map the map
+   @param keys receives the keys, must hold map->size keys, may be NULL
+   @param values receives the values, must hold map->size values, may be NULL
+   @return the number of items copied
+*/
+unsigned np_hashmap_export(struct NpHashMap *map, void **keys, void **values);
+
+/**
+   Attaches a Bloom filter of the key hashes to the map. Gets of absent keys
+   are then usually rejected by the filter without walking a chain. The map
+   adds new keys to the filter and rebuilds it from the cached hashes once
+   it has grown past its size or half of its keys were removed. The filter
+   statistics are in map->bloom.
+
+   @param map the map
+   @return the map or NULL on error
+*/
+struct NpHashMap *np_hashmap_attach_bloom(struct NpHashMap *map);
+
+/**
+   Detaches and frees the Bloom filter of the map, if any.
+
+   @param map the map
+*/
+void np_hashmap_detach_bloom(struct NpHashMap *map);
+
+/**
+   Sets how the map resizes. Switching to NP_HASHMAP_RESIZE_FULL completes
+   any incremental resize in progress.
+
+   @param map the map
+   @param mode the resize mode
+*/
+void np_hashmap_set_resize_mode(struct NpHashMap *map,
+				enum NpHashMapResizeMode mode);
+
+/**
+   Collects statistics about the map's buckets, resizes, and memory use.
+   Visits every bucket, so the cost is linear in the capacity.
+
+   @param map the map
+   @param stats receives the statistics
+*/
+void np_hashmap_stats(struct NpHashMap *map, struct NpHashMapStats *stats);
+
+/**
+   Creates a keyed 64 bit hash for the key of the given length using
+   SipHash-1-3. Slower than np_hashmap_hash64() but, as long as the seed is
+   secret, collisions cannot be found by choosing keys.
+
+   @param key the key to hash
+   @param length the length of the key
+   @param seed the two 64 bit words of the seed
+   @return the hash
+*/
+uint64_t np_hashmap_siphash(const void *key, size_t length,
+			    const uint64_t *seed);
+
+/**
+   Keyed hash function for C string keys for use with np_hashmap_new_keyed().
+   The hash is np_hashmap_siphash() folded to an unsigned.
+
+   @param key the null terminated key to hash
+   @param seed the two 64 bit words of the seed
+   @return the hash
+*/
+unsigned np_hashmap_siphash_string(void *key, const uint64_t *seed);
+
+/**
+   Creates a hash for the key of the given length. The hash is
+   np_hashmap_hash64() folded to an unsigned.
 
    @param key the key to hash
    @param length the length of the key
@@ -147,4 +824,34 @@ void *np_hashmap_remove(struct NpHashMap *map, void *key);
 */
 unsigned np_hashmap_hash(void *key, int length);
 
+/**
+   Creates a 64 bit hash for the key of the given length. Keys are read a
+   word at a time and keys longer than 128 bytes are processed in 64 byte
+   stripes using SSE2 or AVX2 when the compiler targets them. All code paths
+   produce the same hash.
+
+   @param key the key to hash
+   @param length the length of the key in bytes
+   @return the hash
+*/
+uint64_t np_hashmap_hash64(const void *key, size_t length);
+
+/**
+   Creates a 64 bit hash for a 4 byte integer key. Equal to
+   np_hashmap_hash64() of the integer's little endian representation.
+
+   @param key the key to hash
+   @return the hash
+*/
+uint64_t np_hashmap_hash64_u32(uint32_t key);
+
+/**
+   Creates a 64 bit hash for an 8 byte integer key. Equal to
+   np_hashmap_hash64() of the integer's little endian representation.
+
+   @param key the key to hash
+   @return the hash
+*/
+uint64_t np_hashmap_hash64_u64(uint64_t key);
+
 #endif
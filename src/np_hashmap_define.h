@@ -0,0 +1,214 @@
+/*
+ * np_hashmap_define.h: nplib type specialized hash map generator
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NP_HASHMAP_DEFINE_H
+#define __NP_HASHMAP_DEFINE_H
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "np_hashmap.h"
+#include "np_pool.h"
+
+/**
+   Defines a hash map storing keys and values of the given types by value.
+   The map uses the same chaining, cached hashes, and pooled items as
+   np_hashmap, but the hash and equality functions are called directly so
+   the compiler can inline them.
+
+   For a map named name the macro defines:
+
+   struct name - the map object
+   struct name##_item - the map item
+   struct name *name##_new(void) - allocates a map, NULL on error
+   void name##_free(struct name *map) - frees the map
+   value_type *name##_put(struct name *map, key_type key, value_type value)
+     - stores the value at the key, returning a pointer to the stored value
+     or NULL on error
+   value_type *name##_get(struct name *map, key_type key) - returns a
+     pointer to the value stored at the key or NULL if there is none
+   int name##_remove(struct name *map, key_type key, value_type *value) -
+     removes the item at the key, copying its value to value if not NULL,
+     returning 1 if an item was removed and 0 otherwise
+
+   Pointers returned by put and get are valid until the item is removed.
+   Items are allocated from a pool aligned for the key and value types, so
+   these may be over-aligned types such as long double.
+
+   @param name the name of the map type and prefix of its functions
+   @param key_type the key type
+   @param value_type the value type
+   @param hash_fn a function or macro taking a key and returning its hash as
+   an unsigned
+   @param equal_fn a function or macro taking two keys and returning non zero
+   if they are equal
+*/
+#define NP_HASHMAP_DEFINE(name, key_type, value_type, hash_fn, equal_fn)     \
+struct name##_item {                                                         \
+  key_type key;                                                              \
+  value_type value;                                                          \
+  unsigned hash;                                                             \
+  struct name##_item *next;                                                  \
+};                                                                           \
+                                                                             \
+/* the offset of item is the alignment the item needs */                     \
+struct name##_align {                                                        \
+  char c;                                                                    \
+  struct name##_item item;                                                   \
+};                                                                           \
+                                                                             \
+struct name {                                                                \
+  unsigned capacity;                                                         \
+  unsigned size;                                                             \
+  unsigned threshold;                                                        \
+  float load_factor;                                                         \
+  struct name##_item **items;                                                \
+  struct NpPool *pool;                                                       \
+};                                                                           \
+                                                                             \
+static inline struct name *name##_new(void)                                  \
+{                                                                            \
+  struct name *map;                                                          \
+  unsigned i;                                                                \
+                                                                             \
+  map = malloc(sizeof *map);                                                 \
+  if (map != NULL) {                                                         \
+    map->items = malloc(sizeof *map->items * NP_HASHMAP_INITIAL_CAPACITY);   \
+    map->pool = np_pool_new_aligned(sizeof(struct name##_item),              \
+				    offsetof(struct name##_align, item));    \
+    if (map->items == NULL || map->pool == NULL) {                           \
+      free(map->items);                                                      \
+      if (map->pool != NULL)                                                 \
+	np_pool_free(map->pool);                                             \
+      free(map);                                                             \
+      return NULL;                                                           \
+    }                                                                        \
+    map->capacity = NP_HASHMAP_INITIAL_CAPACITY;                             \
+    map->size = 0;                                                           \
+    map->load_factor = NP_HASHMAP_DEFAULT_LOAD_FACTOR;                       \
+    map->threshold = map->capacity * map->load_factor;                       \
+    for (i = 0; i < map->capacity; ++i)                                      \
+      map->items[i] = NULL;                                                  \
+  }                                                                          \
+  return map;                                                                \
+}                                                                            \
+                                                                             \
+static inline void name##_free(struct name *map)                             \
+{                                                                            \
+  np_pool_free(map->pool);                                                   \
+  free(map->items);                                                          \
+  free(map);                                                                 \
+}                                                                            \
+                                                                             \
+static inline struct name##_item **name##_find(struct name *map,             \
+					       key_type key, unsigned hash)  \
+{                                                                            \
+  struct name##_item **link;                                                 \
+                                                                             \
+  link = &map->items[hash & (map->capacity - 1)];                            \
+  for (; *link != NULL; link = &(*link)->next)                               \
+    if ((*link)->hash == hash && equal_fn(key, (*link)->key))                \
+      return link;                                                           \
+  return NULL;                                                               \
+}                                                                            \
+                                                                             \
+static inline int name##_realloc(struct name *map)                           \
+{                                                                            \
+  struct name##_item **items;                                                \
+  struct name##_item *item;                                                  \
+  struct name##_item *next;                                                  \
+  unsigned capacity;                                                         \
+  unsigned i;                                                                \
+  unsigned j;                                                                \
+                                                                             \
+  capacity = map->capacity * 2;                                              \
+  if (capacity == 0 || (items = malloc(sizeof *items * capacity)) == NULL)   \
+    return -1;                                                               \
+  for (i = 0; i < capacity; ++i)                                             \
+    items[i] = NULL;                                                         \
+  for (i = 0; i < map->capacity; ++i) {                                      \
+    for (item = map->items[i]; item != NULL; item = next) {                  \
+      next = item->next;                                                     \
+      j = item->hash & (capacity - 1);                                       \
+      item->next = items[j];                                                 \
+      items[j] = item;                                                       \
+    }                                                                        \
+  }                                                                          \
+  free(map->items);                                                          \
+  map->items = items;                                                        \
+  map->capacity = capacity;                                                  \
+  map->threshold = capacity * map->load_factor;                              \
+  return 0;                                                                  \
+}                                                                            \
+                                                                             \
+static inline value_type *name##_put(struct name *map, key_type key,         \
+				     value_type value)                       \
+{                                                                            \
+  struct name##_item **link;                                                 \
+  struct name##_item *item;                                                  \
+  unsigned hash;                                                             \
+                                                                             \
+  hash = hash_fn(key);                                                       \
+  if ((link = name##_find(map, key, hash)) != NULL) {                        \
+    (*link)->value = value;                                                  \
+    return &(*link)->value;                                                  \
+  }                                                                          \
+  if (map->size >= map->threshold && name##_realloc(map) != 0)               \
+    return NULL;                                                             \
+  if ((item = np_pool_alloc(map->pool)) == NULL)                             \
+    return NULL;                                                             \
+  link = &map->items[hash & (map->capacity - 1)];                            \
+  item->key = key;                                                           \
+  item->value = value;                                                       \
+  item->hash = hash;                                                         \
+  item->next = *link;                                                        \
+  *link = item;                                                              \
+  map->size++;                                                               \
+  return &item->value;                                                       \
+}                                                                            \
+                                                                             \
+static inline value_type *name##_get(struct name *map, key_type key)         \
+{                                                                            \
+  struct name##_item **link;                                                 \
+                                                                             \
+  if ((link = name##_find(map, key, hash_fn(key))) != NULL)                  \
+    return &(*link)->value;                                                  \
+  return NULL;                                                               \
+}                                                                            \
+                                                                             \
+static inline int name##_remove(struct name *map, key_type key,              \
+				value_type *value)                           \
+{                                                                            \
+  struct name##_item **link;                                                 \
+  struct name##_item *item;                                                  \
+                                                                             \
+  if ((link = name##_find(map, key, hash_fn(key))) == NULL)                  \
+    return 0;                                                                \
+  item = *link;                                                              \
+  if (value != NULL)                                                         \
+    *value = item->value;                                                    \
+  *link = item->next;                                                        \
+  np_pool_release(map->pool, item);                                          \
+  map->size--;                                                               \
+  return 1;                                                                  \
+}                                                                            \
+                                                                             \
+/* redeclared so that uses of the macro end with a semicolon */              \
+static inline void name##_free(struct name *map)
+
+#endif
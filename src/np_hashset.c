@@ -0,0 +1,309 @@
+/*
+ * np_hashset.c: nplib hash set
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+
+#include "np_hashset.h"
+#include "np_pool.h"
+
+/*
+ * Determines the smallest power of two capacity, no less than the initial
+ * capacity, whose threshold is at least the given number of keys.
+ */
+static unsigned np_hashset_capacity_for(unsigned keys)
+{
+  unsigned capacity;
+
+  capacity = NP_HASHMAP_INITIAL_CAPACITY;
+  while ((unsigned)(capacity * NP_HASHMAP_DEFAULT_LOAD_FACTOR) < keys
+	 && capacity << 1 != 0)
+    capacity <<= 1;
+  return capacity;
+}
+
+static void np_hashset_set_thresholds(struct NpHashSet *set)
+{
+  set->threshold = set->capacity * NP_HASHMAP_DEFAULT_LOAD_FACTOR;
+  set->low_water = set->threshold * NP_HASHMAP_SHRINK_FACTOR;
+}
+
+struct NpHashSet *np_hashset_new(int (*key_compare)(void *key1, void *key2),
+				 unsigned (*key_hash)(void *key))
+{
+  return np_hashset_new_with_capacity(key_compare, key_hash, 0);
+}
+
+struct NpHashSet *np_hashset_new_with_capacity(
+  int (*key_compare)(void *key1, void *key2), unsigned (*key_hash)(void *key),
+  unsigned capacity)
+{
+  struct NpHashSet *set;
+
+  capacity = np_hashset_capacity_for(capacity);
+  if ((set = malloc(sizeof *set)) == NULL)
+    return NULL;
+  set->items = calloc(capacity, sizeof *set->items);
+  set->pool = np_pool_new(sizeof(struct NpHashSetItem));
+  if (set->items == NULL || set->pool == NULL) {
+    free(set->items);
+    if (set->pool != NULL)
+      np_pool_free(set->pool);
+    free(set);
+    return NULL;
+  }
+  set->key_compare = key_compare;
+  set->key_hash = key_hash;
+  set->capacity = capacity;
+  set->min_capacity = capacity;
+  set->size = 0;
+  np_hashset_set_thresholds(set);
+  return set;
+}
+
+void np_hashset_free(struct NpHashSet *set)
+{
+  np_pool_free(set->pool);
+  free(set->items);
+  free(set);
+}
+
+/*
+ * Moves every item into a table of the given capacity. The items keep
+ * their cached hashes.
+ */
+static struct NpHashSet *np_hashset_resize(struct NpHashSet *set,
+					   unsigned capacity)
+{
+  struct NpHashSetItem **items;
+  struct NpHashSetItem *item;
+  struct NpHashSetItem *next;
+  unsigned i;
+
+  if ((items = calloc(capacity, sizeof *items)) == NULL)
+    return NULL;
+  for (i = 0; i < set->capacity; ++i) {
+    for (item = set->items[i]; item != NULL; item = next) {
+      next = item->next;
+      item->next = items[item->hash % capacity];
+      items[item->hash % capacity] = item;
+    }
+  }
+  free(set->items);
+  set->items = items;
+  set->capacity = capacity;
+  np_hashset_set_thresholds(set);
+  return set;
+}
+
+/*
+ * Shrinks the set until it is above its low water mark or at its minimum
+ * capacity. A failed shrink leaves the set as it is.
+ */
+static void np_hashset_shrink(struct NpHashSet *set)
+{
+  unsigned capacity;
+
+  if (set->size >= set->low_water || set->capacity <= set->min_capacity)
+    return;
+  capacity = np_hashset_capacity_for(set->size);
+  np_hashset_resize(set, capacity > set->min_capacity ? capacity
+		    : set->min_capacity);
+}
+
+/*
+ * Finds the link pointing to the item holding the key.
+ */
+static struct NpHashSetItem **np_hashset_find(struct NpHashSet *set,
+					      void *key, unsigned hash)
+{
+  struct NpHashSetItem **link;
+
+  for (link = &set->items[hash % set->capacity]; *link != NULL;
+       link = &(*link)->next)
+    if ((*link)->hash == hash && set->key_compare(key, (*link)->key) == 0)
+      return link;
+  return NULL;
+}
+
+/*
+ * Adds a key known to hash to the given value.
+ */
+static int np_hashset_add_hashed(struct NpHashSet *set, void *key,
+				 unsigned hash)
+{
+  struct NpHashSetItem *item;
+
+  if (np_hashset_find(set, key, hash) != NULL)
+    return 0;
+  if (set->size >= set->threshold
+      && np_hashset_resize(set, set->capacity * 2) == NULL)
+    return -1;
+  if ((item = np_pool_alloc(set->pool)) == NULL)
+    return -1;
+  item->key = key;
+  item->hash = hash;
+  item->next = set->items[hash % set->capacity];
+  set->items[hash % set->capacity] = item;
+  set->size++;
+  return 1;
+}
+
+int np_hashset_add(struct NpHashSet *set, void *key)
+{
+  return np_hashset_add_hashed(set, key, set->key_hash(key));
+}
+
+int np_hashset_contains(struct NpHashSet *set, void *key)
+{
+  return np_hashset_find(set, key, set->key_hash(key)) != NULL;
+}
+
+void *np_hashset_get(struct NpHashSet *set, void *key)
+{
+  struct NpHashSetItem **link;
+
+  link = np_hashset_find(set, key, set->key_hash(key));
+  return link != NULL ? (*link)->key : NULL;
+}
+
+/*
+ * Unlinks and releases an item, returning its key.
+ */
+static void *np_hashset_unlink(struct NpHashSet *set,
+			       struct NpHashSetItem **link)
+{
+  struct NpHashSetItem *item;
+  void *key;
+
+  item = *link;
+  key = item->key;
+  *link = item->next;
+  np_pool_release(set->pool, item);
+  set->size--;
+  return key;
+}
+
+void *np_hashset_remove(struct NpHashSet *set, void *key)
+{
+  struct NpHashSetItem **link;
+  void *removed;
+
+  if ((link = np_hashset_find(set, key, set->key_hash(key))) == NULL)
+    return NULL;
+  removed = np_hashset_unlink(set, link);
+  np_hashset_shrink(set);
+  return removed;
+}
+
+struct NpHashSet *np_hashset_union(struct NpHashSet *set,
+				   struct NpHashSet *other)
+{
+  struct NpHashSetItem *item;
+  unsigned capacity;
+  unsigned hash;
+  unsigned i;
+
+  /* grow once for the case where the sets are disjoint */
+  if (set->size + other->size > set->threshold
+      && set->size + other->size >= set->size) {
+    capacity = np_hashset_capacity_for(set->size + other->size);
+    if (np_hashset_resize(set, capacity) == NULL)
+      return NULL;
+  }
+  for (i = 0; i < other->capacity; ++i) {
+    for (item = other->items[i]; item != NULL; item = item->next) {
+      hash = set->key_hash == other->key_hash ? item->hash
+	: set->key_hash(item->key);
+      if (np_hashset_add_hashed(set, item->key, hash) < 0)
+	return NULL;
+    }
+  }
+  return set;
+}
+
+/*
+ * Keeps the keys of the set that are in the other set if keep_present is
+ * set, or the keys that are not in it otherwise.
+ */
+static struct NpHashSet *np_hashset_filter(struct NpHashSet *set,
+					   struct NpHashSet *other,
+					   int keep_present)
+{
+  struct NpHashSetItem **link;
+  unsigned hash;
+  unsigned i;
+  int present;
+
+  for (i = 0; i < set->capacity; ++i) {
+    link = &set->items[i];
+    while (*link != NULL) {
+      hash = set->key_hash == other->key_hash ? (*link)->hash
+	: other->key_hash((*link)->key);
+      present = np_hashset_find(other, (*link)->key, hash) != NULL;
+      if (present == keep_present)
+	link = &(*link)->next;
+      else
+	np_hashset_unlink(set, link);
+    }
+  }
+  np_hashset_shrink(set);
+  return set;
+}
+
+struct NpHashSet *np_hashset_intersection(struct NpHashSet *set,
+					  struct NpHashSet *other)
+{
+  return np_hashset_filter(set, other, 1);
+}
+
+struct NpHashSet *np_hashset_difference(struct NpHashSet *set,
+					struct NpHashSet *other)
+{
+  return np_hashset_filter(set, other, 0);
+}
+
+/*
+ * Returns the first item of the next non-empty bucket.
+ */
+static struct NpHashSetItem *np_hashset_iterator_scan(
+  struct NpHashSetIterator *iter)
+{
+  while (iter->bucket < iter->set->capacity)
+    if (iter->set->items[iter->bucket++] != NULL)
+      return iter->set->items[iter->bucket - 1];
+  return NULL;
+}
+
+void np_hashset_iterator_init(struct NpHashSetIterator *iter,
+			      struct NpHashSet *set)
+{
+  iter->set = set;
+  iter->bucket = 0;
+  iter->item = np_hashset_iterator_scan(iter);
+}
+
+void *np_hashset_iterator_next(struct NpHashSetIterator *iter)
+{
+  struct NpHashSetItem *item;
+
+  if ((item = iter->item) == NULL)
+    return NULL;
+  iter->item = item->next != NULL ? item->next
+    : np_hashset_iterator_scan(iter);
+  return item->key;
+}
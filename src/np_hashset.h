@@ -0,0 +1,245 @@
+/*
+ * np_hashset.h: nplib hash set header file
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NP_HASHSET_H
+#define __NP_HASHSET_H
+
+#include "np_hashmap.h"
+
+/**
+   Hash set item. Unlike a hash map item it has no value.
+*/
+struct NpHashSetItem {
+  /**
+     The item key.
+  */
+  void *key;
+
+  /**
+     The key hash, cached so that resizes and bulk operations between sets
+     hashing alike do not rehash keys.
+  */
+  unsigned hash;
+
+  /**
+     The next item.
+  */
+  struct NpHashSetItem *next;
+};
+
+/**
+   Hash set object. Keys are chained in buckets like those of np_hashmap and
+   the set grows and shrinks at the same load factors.
+*/
+struct NpHashSet {
+  /**
+     Pointer to a function used to compare keys.
+
+     @param key1 the first key
+     @param key2 the second key
+     @return 0 if keys are equal, value > 0 if first key is greater than
+     the second key, value < 0 if the first key is lesser than the second
+  */
+  int (*key_compare)(void *key1, void *key2);
+
+  /**
+     Pointer to a function used to hash keys.
+
+     @param key the key to hash
+     @return the hash
+  */
+  unsigned (*key_hash)(void *key);
+
+  /**
+     The set capacity.
+  */
+  unsigned capacity;
+
+  /**
+     The capacity below which the set never shrinks automatically.
+  */
+  unsigned min_capacity;
+
+  /**
+     The number of keys in the set.
+  */
+  unsigned size;
+
+  /**
+     The size at which the set grows.
+  */
+  unsigned threshold;
+
+  /**
+     The size below which removing a key halves the capacity.
+  */
+  unsigned low_water;
+
+  /**
+     The buckets.
+  */
+  struct NpHashSetItem **items;
+
+  /**
+     The pool the items are allocated from.
+  */
+  struct NpPool *pool;
+};
+
+/**
+   Hash set iterator, usually declared on the stack. Keys are visited bucket
+   by bucket.
+*/
+struct NpHashSetIterator {
+  /**
+     The set being iterated over.
+  */
+  struct NpHashSet *set;
+
+  /**
+     The next item.
+  */
+  struct NpHashSetItem *item;
+
+  /**
+     The next bucket to scan.
+  */
+  unsigned bucket;
+};
+
+/**
+   Allocates memory for and initializes a set.
+
+   @param key_compare the function to be used for comparing keys
+   @param key_hash the function to be used for hashing keys, for instance
+   one built on np_hashmap_hash()
+   @return a pointer to the allocated memory or NULL on error
+*/
+struct NpHashSet *np_hashset_new(int (*key_compare)(void *key1, void *key2),
+				 unsigned (*key_hash)(void *key));
+
+/**
+   Allocates memory for and initializes a set able to hold the given number
+   of keys without resizing. The set does not automatically shrink below
+   this capacity.
+
+   @param key_compare the function to be used for comparing keys
+   @param key_hash the function to be used for hashing keys
+   @param capacity the number of keys to make room for
+   @return a pointer to the allocated memory or NULL on error
+*/
+struct NpHashSet *np_hashset_new_with_capacity(
+  int (*key_compare)(void *key1, void *key2), unsigned (*key_hash)(void *key),
+  unsigned capacity);
+
+/**
+   Frees the memory used by the set. Does not free the keys.
+
+   @param set the set to free
+*/
+void np_hashset_free(struct NpHashSet *set);
+
+/**
+   Adds a key to the set.
+
+   @param set the set
+   @param key the key to add
+   @return 1 if the key was added, 0 if an equal key was already in the set,
+   -1 on error
+*/
+int np_hashset_add(struct NpHashSet *set, void *key);
+
+/**
+   Determines whether the set contains a key.
+
+   @param set the set
+   @param key the key to look for
+   @return 1 if the set contains the key, 0 otherwise
+*/
+int np_hashset_contains(struct NpHashSet *set, void *key);
+
+/**
+   Gets the key in the set equal to a key, for instance to intern keys.
+
+   @param set the set
+   @param key the key to look for
+   @return the key in the set or NULL if there is none
+*/
+void *np_hashset_get(struct NpHashSet *set, void *key);
+
+/**
+   Removes a key from the set.
+
+   @param set the set
+   @param key the key to remove
+   @return the removed key, as stored in the set, or NULL if there was none
+*/
+void *np_hashset_remove(struct NpHashSet *set, void *key);
+
+/**
+   Adds every key of another set to the set. Keys are compared with the
+   set's key_compare. When both sets use the same key_hash the cached hashes
+   of the other set are reused.
+
+   @param set the set
+   @param other the set whose keys to add
+   @return the set or NULL on error, in which case some keys may have been
+   added
+*/
+struct NpHashSet *np_hashset_union(struct NpHashSet *set,
+				   struct NpHashSet *other);
+
+/**
+   Removes the keys of the set that are not in another set.
+
+   @param set the set
+   @param other the set whose keys to keep
+   @return the set
+*/
+struct NpHashSet *np_hashset_intersection(struct NpHashSet *set,
+					  struct NpHashSet *other);
+
+/**
+   Removes the keys of the set that are in another set.
+
+   @param set the set
+   @param other the set whose keys to remove
+   @return the set
+*/
+struct NpHashSet *np_hashset_difference(struct NpHashSet *set,
+					struct NpHashSet *other);
+
+/**
+   Initializes an iterator over the set. The set must not be modified while
+   using the iterator.
+
+   @param iter the iterator to initialize
+   @param set the set to iterate over
+*/
+void np_hashset_iterator_init(struct NpHashSetIterator *iter,
+			      struct NpHashSet *set);
+
+/**
+   Retrieves the next key from the iterator.
+
+   @param iter the iterator
+   @return the next key or NULL if there are no more keys
+*/
+void *np_hashset_iterator_next(struct NpHashSetIterator *iter);
+
+#endif
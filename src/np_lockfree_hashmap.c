@@ -0,0 +1,244 @@
+/*
+ * np_lockfree_hashmap.c: nplib lock free read hash map
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+
+#include "np_lockfree_hashmap.h"
+#include "np_hashmap.h"
+#include "np_pool.h"
+
+#define np_lockfree_load(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define np_lockfree_store(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+static struct NpLockFreeHashMapTable *np_lockfree_hashmap_table_new(
+  unsigned capacity)
+{
+  struct NpLockFreeHashMapTable *table;
+  unsigned i;
+
+  table = malloc(sizeof *table + sizeof *table->items * capacity);
+  if (table != NULL) {
+    table->capacity = capacity;
+    for (i = 0; i < capacity; ++i)
+      table->items[i] = NULL;
+  }
+  return table;
+}
+
+struct NpLockFreeHashMap *np_lockfree_hashmap_new(
+  int (*key_compare)(void *key1, void *key2), unsigned (*key_hash)(void *key))
+{
+  struct NpLockFreeHashMap *map;
+
+  map = malloc(sizeof *map);
+  if (map != NULL) {
+    map->key_compare = key_compare;
+    map->key_hash = key_hash;
+    map->size = 0;
+    map->load_factor = NP_HASHMAP_DEFAULT_LOAD_FACTOR;
+    map->threshold = NP_HASHMAP_INITIAL_CAPACITY * map->load_factor;
+    map->table = np_lockfree_hashmap_table_new(NP_HASHMAP_INITIAL_CAPACITY);
+    map->epoch = np_epoch_new();
+    map->pool = np_pool_new(sizeof(struct NpHashMapItem));
+    if (map->table == NULL || map->epoch == NULL || map->pool == NULL
+	|| pthread_mutex_init(&map->lock, NULL) != 0) {
+      free(map->table);
+      if (map->epoch != NULL)
+	np_epoch_free(map->epoch);
+      if (map->pool != NULL)
+	np_pool_free(map->pool);
+      free(map);
+      return NULL;
+    }
+  }
+  return map;
+}
+
+void np_lockfree_hashmap_free(struct NpLockFreeHashMap *map)
+{
+  /* reclaims retired tables before the pool holding their items goes */
+  np_epoch_free(map->epoch);
+  np_pool_free(map->pool);
+  free(map->table);
+  pthread_mutex_destroy(&map->lock);
+  free(map);
+}
+
+struct NpEpochRecord *np_lockfree_hashmap_register(
+  struct NpLockFreeHashMap *map)
+{
+  return np_epoch_register(map->epoch);
+}
+
+void np_lockfree_hashmap_unregister(struct NpEpochRecord *record)
+{
+  np_epoch_unregister(record);
+}
+
+static void np_lockfree_hashmap_reclaim_item(void *item, void *map)
+{
+  np_pool_release(((struct NpLockFreeHashMap *)map)->pool, item);
+}
+
+/*
+ * Reclaims a table replaced by a resize along with the items it holds.
+ * Retired tables are never modified so their chains can be walked freely.
+ */
+static void np_lockfree_hashmap_reclaim_table(void *ptr, void *map)
+{
+  struct NpLockFreeHashMapTable *table;
+  struct NpHashMapItem *item;
+  struct NpHashMapItem *next;
+  unsigned i;
+
+  table = ptr;
+  for (i = 0; i < table->capacity; ++i) {
+    for (item = table->items[i]; item != NULL; item = next) {
+      next = item->next;
+      np_lockfree_hashmap_reclaim_item(item, map);
+    }
+  }
+  free(table);
+}
+
+/*
+ * Copies every item into a table of twice the capacity and publishes it.
+ * Items are copied rather than relinked because readers may be traversing
+ * the old chains. The caller must hold the writer lock.
+ */
+static int np_lockfree_hashmap_realloc(struct NpLockFreeHashMap *map)
+{
+  struct NpLockFreeHashMapTable *old_table;
+  struct NpLockFreeHashMapTable *table;
+  struct NpHashMapItem *item;
+  struct NpHashMapItem *copy;
+  unsigned i;
+  unsigned j;
+
+  old_table = map->table;
+  table = np_lockfree_hashmap_table_new(old_table->capacity * 2);
+  if (table == NULL)
+    return -1;
+  for (i = 0; i < old_table->capacity; ++i) {
+    for (item = old_table->items[i]; item != NULL; item = item->next) {
+      if ((copy = np_pool_alloc(map->pool)) == NULL) {
+	np_lockfree_hashmap_reclaim_table(table, map);
+	return -1;
+      }
+      j = item->hash % table->capacity;
+      copy->key = item->key;
+      copy->value = item->value;
+      copy->hash = item->hash;
+      copy->next = table->items[j];
+      table->items[j] = copy;
+    }
+  }
+  np_lockfree_store(&map->table, table);
+  map->threshold = table->capacity * map->load_factor;
+
+  /* if retiring fails the old table is leaked rather than freed unsafely */
+  np_epoch_retire(map->epoch, old_table, np_lockfree_hashmap_reclaim_table,
+		  map);
+  return 0;
+}
+
+void *np_lockfree_hashmap_put(struct NpLockFreeHashMap *map, void *key,
+			      void *value)
+{
+  struct NpHashMapItem *item;
+  unsigned hash;
+  unsigned i;
+
+  hash = map->key_hash(key);
+  pthread_mutex_lock(&map->lock);
+  i = hash % map->table->capacity;
+  for (item = map->table->items[i]; item != NULL; item = item->next)
+    if (item->hash == hash && map->key_compare(key, item->key) == 0)
+      break;
+  if (item != NULL) {
+    np_lockfree_store(&item->value, value);
+  } else if ((map->size >= map->threshold
+	      && np_lockfree_hashmap_realloc(map) != 0)
+	     || (item = np_pool_alloc(map->pool)) == NULL) {
+    value = NULL;
+  } else {
+    /* fully initialize the item before publishing it */
+    i = hash % map->table->capacity;
+    item->key = key;
+    item->value = value;
+    item->hash = hash;
+    item->next = map->table->items[i];
+    np_lockfree_store(&map->table->items[i], item);
+    map->size++;
+  }
+  pthread_mutex_unlock(&map->lock);
+  return value;
+}
+
+void *np_lockfree_hashmap_get(struct NpLockFreeHashMap *map,
+			      struct NpEpochRecord *reader, void *key)
+{
+  struct NpLockFreeHashMapTable *table;
+  struct NpHashMapItem *item;
+  unsigned hash;
+  void *value;
+
+  hash = map->key_hash(key);
+  value = NULL;
+  np_epoch_enter(reader);
+  table = np_lockfree_load(&map->table);
+  item = np_lockfree_load(&table->items[hash % table->capacity]);
+  for (; item != NULL; item = np_lockfree_load(&item->next)) {
+    if (item->hash == hash && map->key_compare(key, item->key) == 0) {
+      value = np_lockfree_load(&item->value);
+      break;
+    }
+  }
+  np_epoch_exit(reader);
+  return value;
+}
+
+void *np_lockfree_hashmap_remove(struct NpLockFreeHashMap *map, void *key)
+{
+  struct NpHashMapItem **link;
+  struct NpHashMapItem *item;
+  unsigned hash;
+  void *value;
+
+  hash = map->key_hash(key);
+  value = NULL;
+  pthread_mutex_lock(&map->lock);
+  link = &map->table->items[hash % map->table->capacity];
+  for (; (item = *link) != NULL; link = &item->next) {
+    if (item->hash == hash && map->key_compare(key, item->key) == 0) {
+      /*
+       * Readers already on the item still see its next pointer, the item
+       * itself is reclaimed once they are done.
+       */
+      value = item->value;
+      np_lockfree_store(link, item->next);
+
+      /* if retiring fails the item stays allocated until the map is freed */
+      np_epoch_retire(map->epoch, item, np_lockfree_hashmap_reclaim_item, map);
+      map->size--;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&map->lock);
+  return value;
+}
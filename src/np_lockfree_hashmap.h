@@ -0,0 +1,173 @@
+/*
+ * np_lockfree_hashmap.h: nplib lock free read hash map header file
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NP_LOCKFREE_HASHMAP_H
+#define __NP_LOCKFREE_HASHMAP_H
+
+#include <pthread.h>
+
+#include "np_epoch.h"
+
+/**
+   Lock free hash map table. Replaced as a whole on resize.
+*/
+struct NpLockFreeHashMapTable {
+  /**
+     The table capacity.
+  */
+  unsigned capacity;
+
+  /**
+     The items.
+  */
+  struct NpHashMapItem *items[];
+};
+
+/**
+   Hash map with a lock free read path. Gets take no locks and perform no
+   atomic read-modify-write operations; they only announce themselves in an
+   epoch record. Writers are serialized by a mutex, publish new items with
+   release stores, and retire unlinked items and tables through epoch based
+   reclamation. Resizing builds a new table and publishes it atomically so
+   readers always see a consistent table.
+*/
+struct NpLockFreeHashMap {
+  /**
+     Pointer to a function used to compare map keys.
+
+     @param key1 the first key
+     @param key2 the second key
+     @return 0 if keys are equal, value > 0 if first key is greater than
+     the second key, value < 0 if the first key is lesser than the second
+  */
+  int (*key_compare)(void *key1, void *key2);
+
+  /**
+     Pointer to a function used to hash keys. Must be safe to call from
+     multiple threads.
+
+     @param key the key to hash
+     @return the hash
+  */
+  unsigned (*key_hash)(void *key);
+
+  /**
+     The current table.
+  */
+  struct NpLockFreeHashMapTable *table;
+
+  /**
+     The number of items in the map.
+  */
+  unsigned size;
+
+  /**
+     The next size at which the map will grow (capacity * load_factor).
+  */
+  unsigned threshold;
+
+  /**
+     The load factor.
+  */
+  float load_factor;
+
+  /**
+     Serializes writers.
+  */
+  pthread_mutex_t lock;
+
+  /**
+     The epoch domain used to reclaim items and tables.
+  */
+  struct NpEpoch *epoch;
+
+  /**
+     The pool from which the map items are allocated. Only accessed with
+     the writer lock held.
+  */
+  struct NpPool *pool;
+};
+
+/**
+   Allocates memory for and initializes a lock free read map.
+
+   @param key_compare the function to be used for comparing keys
+   @param key_hash the function to be used for hashing keys
+   @return a pointer to the allocated memory or NULL on error
+*/
+struct NpLockFreeHashMap *np_lockfree_hashmap_new(
+  int (*key_compare)(void *key1, void *key2), unsigned (*key_hash)(void *key));
+
+/**
+   Frees the memory used by the map. Does not free the keys or values. No
+   other thread may be using the map.
+
+   @param map the map to free
+*/
+void np_lockfree_hashmap_free(struct NpLockFreeHashMap *map);
+
+/**
+   Registers the calling thread as a reader of the map. Each reading thread
+   needs its own record.
+
+   @param map the map
+   @return the reader record or NULL on error
+*/
+struct NpEpochRecord *np_lockfree_hashmap_register(
+  struct NpLockFreeHashMap *map);
+
+/**
+   Unregisters a reader.
+
+   @param record the reader record
+*/
+void np_lockfree_hashmap_unregister(struct NpEpochRecord *record);
+
+/**
+   Puts an item into the map.
+
+   @param map the map in which to put the item
+   @param key the key at which to store the value, replacing an existing item
+   @param value the value to store
+   @return a pointer to the added item or NULL on error
+*/
+void *np_lockfree_hashmap_put(struct NpLockFreeHashMap *map, void *key,
+			      void *value);
+
+/**
+   Gets an item from the map without taking locks.
+
+   @param map the map from which to retrieve the item
+   @param reader the calling thread's reader record
+   @param key the key of the item to retrieve
+   @return a pointer to the item or NULL if the item does not exist
+*/
+void *np_lockfree_hashmap_get(struct NpLockFreeHashMap *map,
+			      struct NpEpochRecord *reader, void *key);
+
+/**
+   Removes an item from the map.
+
+   @param map the map from which to remove the item
+   @param key the key of the item to remove
+   @return a pointer to the removed item or NULL if there is no item at the
+   given key
+*/
+void *np_lockfree_hashmap_remove(struct NpLockFreeHashMap *map, void *key);
+
+#endif
@@ -0,0 +1,227 @@
+/*
+ * np_lrucache.c: nplib bounded LRU cache
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+
+#include "np_lrucache.h"
+#include "np_hashmap.h"
+
+struct NpLruCache *np_lrucache_new(int (*key_compare)(void *key1, void *key2),
+				   unsigned (*key_hash)(void *key),
+				   size_t capacity)
+{
+  struct NpLruCache *cache;
+
+  cache = malloc(sizeof *cache);
+  if (cache != NULL) {
+    cache->map = np_hashmap_new_with_item_size(key_compare, key_hash, 0,
+					       sizeof(struct NpLruCacheEntry));
+    if (cache->map == NULL) {
+      free(cache);
+      return NULL;
+    }
+    cache->hand = NULL;
+    cache->policy = NP_LRUCACHE_LRU;
+    cache->capacity = capacity;
+    cache->used = 0;
+    cache->evict = NULL;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+  }
+  return cache;
+}
+
+void np_lrucache_free(struct NpLruCache *cache)
+{
+  np_hashmap_free(cache->map);
+  free(cache);
+}
+
+void np_lrucache_set_evict(struct NpLruCache *cache,
+			   void (*evict)(void *key, void *value))
+{
+  cache->evict = evict;
+}
+
+void np_lrucache_set_policy(struct NpLruCache *cache,
+			    enum NpLruCachePolicy policy)
+{
+  cache->policy = policy;
+}
+
+/*
+ * Links an entry into the recency list as the most recently used, just
+ * behind the hand.
+ */
+static void np_lrucache_link(struct NpLruCache *cache,
+			     struct NpLruCacheEntry *entry)
+{
+  if (cache->hand == NULL) {
+    entry->prev = entry;
+    entry->next = entry;
+    cache->hand = entry;
+  } else {
+    entry->prev = cache->hand->prev;
+    entry->next = cache->hand;
+    entry->prev->next = entry;
+    cache->hand->prev = entry;
+  }
+  cache->used += entry->size;
+}
+
+static void np_lrucache_unlink(struct NpLruCache *cache,
+			       struct NpLruCacheEntry *entry)
+{
+  if (entry->next == entry) {
+    cache->hand = NULL;
+  } else {
+    if (cache->hand == entry)
+      cache->hand = entry->next;
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+  }
+  cache->used -= entry->size;
+}
+
+struct NpLruCacheEntry *np_lrucache_victim(struct NpLruCache *cache)
+{
+  if (cache->policy == NP_LRUCACHE_CLOCK && cache->hand != NULL) {
+    while (cache->hand->referenced) {
+      cache->hand->referenced = 0;
+      cache->hand = cache->hand->next;
+    }
+  }
+  return cache->hand;
+}
+
+/*
+ * Evicts entries until one of the given size fits. Under CLOCK the hand
+ * clears and skips referenced entries; since it clears them as it goes it
+ * stops within one revolution.
+ */
+static void np_lrucache_evict(struct NpLruCache *cache, size_t size)
+{
+  struct NpLruCacheEntry *victim;
+  void *key;
+  void *value;
+
+  while (cache->hand != NULL && cache->capacity - cache->used < size) {
+    victim = np_lrucache_victim(cache);
+    key = victim->item.key;
+    value = victim->item.value;
+    np_lrucache_unlink(cache, victim);
+    np_hashmap_remove_hashed(cache->map, key, victim->item.hash);
+    cache->evictions++;
+    if (cache->evict != NULL)
+      cache->evict(key, value);
+  }
+}
+
+void *np_lrucache_put(struct NpLruCache *cache, void *key, void *value)
+{
+  return np_lrucache_put_sized(cache, key, value, 1);
+}
+
+void *np_lrucache_put_sized(struct NpLruCache *cache, void *key, void *value,
+			    size_t size)
+{
+  return np_lrucache_put_hashed(cache, key, value, size,
+				np_hashmap_key_hash(cache->map, key));
+}
+
+void *np_lrucache_put_hashed(struct NpLruCache *cache, void *key, void *value,
+			     size_t size, unsigned hash)
+{
+  struct NpLruCacheEntry *entry;
+
+  if (size > cache->capacity)
+    return NULL;
+  entry = (struct NpLruCacheEntry *)np_hashmap_get_item(cache->map, key,
+							 hash);
+  if (entry != NULL) {
+    /* unlinked while evicting so the entry cannot evict itself */
+    np_lrucache_unlink(cache, entry);
+    np_lrucache_evict(cache, size);
+  } else {
+    np_lrucache_evict(cache, size);
+    entry = (struct NpLruCacheEntry *)np_hashmap_insert_item(cache->map, key,
+							      hash);
+    if (entry == NULL)
+      return NULL;
+  }
+  entry->item.value = value;
+  entry->size = size;
+  entry->referenced = 0;
+  np_lrucache_link(cache, entry);
+  return value;
+}
+
+void *np_lrucache_get(struct NpLruCache *cache, void *key)
+{
+  return np_lrucache_get_hashed(cache, key,
+				np_hashmap_key_hash(cache->map, key));
+}
+
+void *np_lrucache_get_hashed(struct NpLruCache *cache, void *key,
+			     unsigned hash)
+{
+  struct NpLruCacheEntry *entry;
+
+  entry = (struct NpLruCacheEntry *)np_hashmap_get_item(cache->map, key,
+							 hash);
+  if (entry == NULL) {
+    cache->misses++;
+    return NULL;
+  }
+  cache->hits++;
+  if (cache->policy == NP_LRUCACHE_CLOCK) {
+    entry->referenced = 1;
+  } else if (entry == cache->hand) {
+    /* the list is circular: advancing the hand makes the entry the newest */
+    cache->hand = entry->next;
+  } else if (entry->next != cache->hand) {
+    np_lrucache_unlink(cache, entry);
+    np_lrucache_link(cache, entry);
+  }
+  return entry->item.value;
+}
+
+void *np_lrucache_remove(struct NpLruCache *cache, void *key)
+{
+  return np_lrucache_remove_hashed(cache, key,
+				   np_hashmap_key_hash(cache->map, key));
+}
+
+void *np_lrucache_remove_hashed(struct NpLruCache *cache, void *key,
+				unsigned hash)
+{
+  struct NpLruCacheEntry *entry;
+
+  entry = (struct NpLruCacheEntry *)np_hashmap_get_item(cache->map, key,
+							 hash);
+  if (entry == NULL)
+    return NULL;
+  np_lrucache_unlink(cache, entry);
+  return np_hashmap_remove_hashed(cache->map, key, hash);
+}
+
+unsigned np_lrucache_size(struct NpLruCache *cache)
+{
+  return cache->map->size;
+}
@@ -0,0 +1,275 @@
+/*
+ * np_lrucache.h: nplib bounded LRU cache header file
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NP_LRUCACHE_H
+#define __NP_LRUCACHE_H
+
+#include <stddef.h>
+
+#include "np_hashmap.h"
+
+/**
+   Cache replacement policy.
+*/
+enum NpLruCachePolicy {
+  /**
+     Evict the least recently used entry. Every hit moves its entry to the
+     most recently used end of the recency list.
+  */
+  NP_LRUCACHE_LRU,
+
+  /**
+     Evict using the CLOCK approximation of LRU. A hit only sets the entry's
+     referenced flag; the clock hand gives referenced entries a second chance
+     when looking for a victim.
+  */
+  NP_LRUCACHE_CLOCK
+};
+
+/**
+   Cache entry. The hash map item and the recency links share a single
+   allocation from the map's pool.
+*/
+struct NpLruCacheEntry {
+  /**
+     The hash map item holding the key and value.
+  */
+  struct NpHashMapItem item;
+
+  /**
+     The previous (more recently used) entry in the recency list.
+  */
+  struct NpLruCacheEntry *prev;
+
+  /**
+     The next (less recently used) entry in the recency list.
+  */
+  struct NpLruCacheEntry *next;
+
+  /**
+     The entry size charged against the cache capacity.
+  */
+  size_t size;
+
+  /**
+     Non zero if the entry was hit since the clock hand last passed it.
+  */
+  int referenced;
+};
+
+/**
+   Bounded cache object. Entries are kept in a circular recency list whose
+   oldest entry is the clock hand, so the most recently used entry is the one
+   just behind the hand.
+*/
+struct NpLruCache {
+  /**
+     The map from keys to entries.
+  */
+  struct NpHashMap *map;
+
+  /**
+     The oldest entry, the next one considered for eviction, or NULL if the
+     cache is empty.
+  */
+  struct NpLruCacheEntry *hand;
+
+  /**
+     The replacement policy.
+  */
+  enum NpLruCachePolicy policy;
+
+  /**
+     The maximum total size of the entries.
+  */
+  size_t capacity;
+
+  /**
+     The total size of the entries.
+  */
+  size_t used;
+
+  /**
+     Pointer to a function called with the key and value of each entry
+     evicted to make room for another, or NULL.
+
+     @param key the key of the evicted entry
+     @param value the value of the evicted entry
+  */
+  void (*evict)(void *key, void *value);
+
+  /**
+     The number of gets that found their key.
+  */
+  unsigned long hits;
+
+  /**
+     The number of gets that did not find their key.
+  */
+  unsigned long misses;
+
+  /**
+     The number of entries evicted.
+  */
+  unsigned long evictions;
+};
+
+/**
+   Allocates memory for and initializes a cache. Entries put with
+   np_lrucache_put() have a size of 1, making the capacity a number of
+   entries; entries put with np_lrucache_put_sized() can be charged their
+   size in bytes instead.
+
+   @param key_compare the function to be used for comparing keys
+   @param key_hash the function to be used for hashing keys
+   @param capacity the maximum total size of the entries
+   @return a pointer to the allocated memory or NULL on error
+*/
+struct NpLruCache *np_lrucache_new(int (*key_compare)(void *key1, void *key2),
+				   unsigned (*key_hash)(void *key),
+				   size_t capacity);
+
+/**
+   Frees the memory used by the cache. Does not free the keys or values and
+   does not call the eviction callback.
+
+   @param cache the cache to free
+*/
+void np_lrucache_free(struct NpLruCache *cache);
+
+/**
+   Sets the function called for evicted entries.
+
+   @param cache the cache
+   @param evict the function to call or NULL
+*/
+void np_lrucache_set_evict(struct NpLruCache *cache,
+			   void (*evict)(void *key, void *value));
+
+/**
+   Sets the replacement policy. The policy may be changed at any time.
+
+   @param cache the cache
+   @param policy the replacement policy
+*/
+void np_lrucache_set_policy(struct NpLruCache *cache,
+			    enum NpLruCachePolicy policy);
+
+/**
+   Puts an entry of size 1 into the cache, evicting entries as needed.
+
+   @param cache the cache in which to put the entry
+   @param key the key at which to store the value, replacing an existing entry
+   @param value the value to store
+   @return a pointer to the added value or NULL on error
+*/
+void *np_lrucache_put(struct NpLruCache *cache, void *key, void *value);
+
+/**
+   Puts an entry of the given size into the cache, evicting entries as
+   needed. The entry becomes the most recently used.
+
+   @param cache the cache in which to put the entry
+   @param key the key at which to store the value, replacing an existing entry
+   @param value the value to store
+   @param size the entry size charged against the cache capacity
+   @return a pointer to the added value or NULL on error or if the size
+   exceeds the cache capacity
+*/
+void *np_lrucache_put_sized(struct NpLruCache *cache, void *key, void *value,
+			    size_t size);
+
+/**
+   Puts an entry of the given size into the cache using a precomputed key
+   hash.
+
+   @param cache the cache in which to put the entry
+   @param key the key at which to store the value, replacing an existing entry
+   @param value the value to store
+   @param size the entry size charged against the cache capacity
+   @param hash the key hash, which must equal
+   np_hashmap_key_hash(cache->map, key)
+   @return a pointer to the added value or NULL on error or if the size
+   exceeds the cache capacity
+*/
+void *np_lrucache_put_hashed(struct NpLruCache *cache, void *key, void *value,
+			     size_t size, unsigned hash);
+
+/**
+   Gets a value from the cache and marks its entry as recently used.
+
+   @param cache the cache from which to retrieve the value
+   @param key the key of the value to retrieve
+   @return a pointer to the value or NULL if the key is not in the cache
+*/
+void *np_lrucache_get(struct NpLruCache *cache, void *key);
+
+/**
+   Gets a value from the cache using a precomputed key hash.
+
+   @param cache the cache from which to retrieve the value
+   @param key the key of the value to retrieve
+   @param hash the key hash, which must equal
+   np_hashmap_key_hash(cache->map, key)
+   @return a pointer to the value or NULL if the key is not in the cache
+*/
+void *np_lrucache_get_hashed(struct NpLruCache *cache, void *key,
+			     unsigned hash);
+
+/**
+   Removes an entry from the cache without calling the eviction callback.
+
+   @param cache the cache from which to remove the entry
+   @param key the key of the entry to remove
+   @return a pointer to the removed value or NULL if there is no entry at the
+   given key
+*/
+void *np_lrucache_remove(struct NpLruCache *cache, void *key);
+
+/**
+   Removes an entry from the cache using a precomputed key hash.
+
+   @param cache the cache from which to remove the entry
+   @param key the key of the entry to remove
+   @param hash the key hash, which must equal
+   np_hashmap_key_hash(cache->map, key)
+   @return a pointer to the removed value or NULL if there is no entry at the
+   given key
+*/
+void *np_lrucache_remove_hashed(struct NpLruCache *cache, void *key,
+				unsigned hash);
+
+/**
+   Finds the entry the cache would evict next. Under CLOCK this advances the
+   hand past referenced entries, clearing their flags, just as an eviction
+   would. Lets a caller decide whether a new entry is worth an eviction.
+
+   @param cache the cache
+   @return the next entry to evict or NULL if the cache is empty
+*/
+struct NpLruCacheEntry *np_lrucache_victim(struct NpLruCache *cache);
+
+/**
+   Gets the number of entries in the cache.
+
+   @param cache the cache
+   @return the number of entries
+*/
+unsigned np_lrucache_size(struct NpLruCache *cache);
+
+#endif
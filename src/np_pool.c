@@ -0,0 +1,132 @@
+/*
+ * np_pool.c: nplib slab pool allocator
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+
+#include "np_pool.h"
+
+/*
+ * Offset of the first item of a slab, past the header.
+ */
+#define NP_POOL_SLAB_OFFSET(pool) \
+  ((sizeof(struct NpPoolSlab) + (pool)->alignment - 1) \
+   / (pool)->alignment * (pool)->alignment)
+
+struct NpPool *np_pool_new(size_t item_size)
+{
+  return np_pool_new_aligned(item_size, NP_POOL_ALIGNMENT);
+}
+
+struct NpPool *np_pool_new_aligned(size_t item_size, size_t alignment)
+{
+  struct NpPool *pool;
+
+  pool = malloc(sizeof *pool);
+  if (pool != NULL) {
+    /* items must be able to hold the free list link */
+    if (item_size < sizeof(void *))
+      item_size = sizeof(void *);
+    if (alignment < NP_POOL_ALIGNMENT)
+      alignment = NP_POOL_ALIGNMENT;
+    pool->alignment = alignment;
+    pool->item_size = (item_size + alignment - 1) / alignment * alignment;
+    pool->slab_items = NP_POOL_MIN_SLAB_ITEMS;
+    pool->slabs = NULL;
+    pool->next = NULL;
+    pool->end = NULL;
+    pool->free_list = NULL;
+    pool->bytes = 0;
+  }
+  return pool;
+}
+
+void np_pool_free(struct NpPool *pool)
+{
+  struct NpPoolSlab *slab;
+  struct NpPoolSlab *next;
+
+  for (slab = pool->slabs; slab != NULL; slab = next) {
+    next = slab->next;
+    free(slab);
+  }
+  free(pool);
+}
+
+void *np_pool_alloc(struct NpPool *pool)
+{
+  struct NpPoolSlab *slab;
+  void *item;
+  size_t size;
+
+  if ((item = pool->free_list) != NULL) {
+    pool->free_list = *(void **)item;
+    return item;
+  }
+  if (pool->next == pool->end) {
+    size = NP_POOL_SLAB_OFFSET(pool) + pool->item_size * pool->slab_items;
+    if (posix_memalign(&item, pool->alignment, size) != 0)
+      return NULL;
+    slab = item;
+    pool->bytes += size;
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    pool->next = (char *)slab + NP_POOL_SLAB_OFFSET(pool);
+    pool->end = pool->next + pool->item_size * pool->slab_items;
+    if (pool->slab_items < NP_POOL_MAX_SLAB_ITEMS)
+      pool->slab_items *= 2;
+  }
+  item = pool->next;
+  pool->next += pool->item_size;
+  return item;
+}
+
+void np_pool_release(struct NpPool *pool, void *item)
+{
+  *(void **)item = pool->free_list;
+  pool->free_list = item;
+}
+
+void np_pool_merge(struct NpPool *pool, struct NpPool *other)
+{
+  struct NpPoolSlab *slab;
+  void **item;
+
+  /* the unused part of the other pool's current slab becomes free items */
+  while (other->next != other->end) {
+    np_pool_release(other, other->next);
+    other->next += other->item_size;
+  }
+  if (other->free_list != NULL) {
+    for (item = other->free_list; *item != NULL; item = *item)
+      ;
+    *item = pool->free_list;
+    pool->free_list = other->free_list;
+  }
+
+  /* only the pool's fields track its current slab, so order is free */
+  if ((slab = other->slabs) != NULL) {
+    while (slab->next != NULL)
+      slab = slab->next;
+    slab->next = pool->slabs;
+    pool->slabs = other->slabs;
+  }
+  pool->bytes += other->bytes;
+  free(other);
+}
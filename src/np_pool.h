@@ -0,0 +1,150 @@
+/*
+ * np_pool.h: nplib slab pool allocator header file
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NP_POOL_H
+#define __NP_POOL_H
+
+#include <stddef.h>
+
+/**
+   Least alignment of items returned by the pool. Item sizes are rounded up
+   to a multiple of the alignment (the pool's size class).
+*/
+#define NP_POOL_ALIGNMENT 8
+
+/**
+   Number of items in the first slab. Each following slab doubles in size up
+   to NP_POOL_MAX_SLAB_ITEMS.
+*/
+#define NP_POOL_MIN_SLAB_ITEMS 32
+#define NP_POOL_MAX_SLAB_ITEMS 4096
+
+/**
+   Pool slab header. The slab items follow the header.
+*/
+struct NpPoolSlab {
+  /**
+     The next slab.
+  */
+  struct NpPoolSlab *next;
+
+  /**
+     Padding keeping the items following the header aligned.
+  */
+  double align;
+};
+
+/**
+   Slab pool object. Hands out fixed size items carved sequentially from
+   large slabs so items allocated together sit together in memory. Released
+   items go on a free list and are reused before new slab space.
+*/
+struct NpPool {
+  /**
+     The size of each item, rounded up to the pool's size class.
+  */
+  size_t item_size;
+
+  /**
+     The alignment of each item, a power of two.
+  */
+  size_t alignment;
+
+  /**
+     The number of items in the next slab to be allocated.
+  */
+  size_t slab_items;
+
+  /**
+     The allocated slabs, most recent first.
+  */
+  struct NpPoolSlab *slabs;
+
+  /**
+     The next unused item in the most recent slab.
+  */
+  char *next;
+
+  /**
+     The end of the most recent slab.
+  */
+  char *end;
+
+  /**
+     Released items available for reuse.
+  */
+  void *free_list;
+
+  /**
+     The number of bytes allocated for slabs.
+  */
+  size_t bytes;
+};
+
+/**
+   Allocates memory for and initializes a pool.
+
+   @param item_size the size of the items handed out by the pool
+   @return a pointer to the allocated memory or NULL on error
+*/
+struct NpPool *np_pool_new(size_t item_size);
+
+/**
+   Allocates memory for and initializes a pool whose items have at least the
+   given alignment, for items holding over-aligned types.
+
+   @param item_size the size of the items handed out by the pool
+   @param alignment the alignment of the items, a power of two
+   @return a pointer to the allocated memory or NULL on error
+*/
+struct NpPool *np_pool_new_aligned(size_t item_size, size_t alignment);
+
+/**
+   Frees the pool and all of its slabs, including any items still in use.
+
+   @param pool the pool to free
+*/
+void np_pool_free(struct NpPool *pool);
+
+/**
+   Allocates an item from the pool.
+
+   @param pool the pool
+   @return a pointer to the item or NULL on error
+*/
+void *np_pool_alloc(struct NpPool *pool);
+
+/**
+   Returns an item to the pool for reuse.
+
+   @param pool the pool the item was allocated from
+   @param item the item to release
+*/
+void np_pool_release(struct NpPool *pool, void *item);
+
+/**
+   Moves the slabs and released items of another pool with the same item
+   size and alignment into the pool and frees the other pool. Lets threads allocate from
+   pools of their own and hand the items to a single owner afterwards.
+
+   @param pool the pool receiving the items
+   @param other the pool to merge and free
+*/
+void np_pool_merge(struct NpPool *pool, struct NpPool *other);
+
+#endif
@@ -0,0 +1,241 @@
+/*
+ * np_robinhoodmap.c: nplib Robin Hood hash map
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+
+#include "np_robinhoodmap.h"
+
+/*
+ * Fibonacci hashing scrambles the hash so that the home slot, taken from the
+ * high bits, depends on all bits of the key hash.
+ */
+#define NP_ROBINHOODMAP_HOME(map, hash) \
+  ((unsigned)((hash) * 2654435769u) >> (map)->shift)
+
+static int np_robinhoodmap_init(struct NpRobinHoodMap *map, unsigned capacity)
+{
+  unsigned i;
+
+  if ((map->slots = malloc(sizeof *map->slots * capacity)) == NULL)
+    return -1;
+  for (i = 0; i < capacity; ++i)
+    map->slots[i].distance = 0;
+  map->capacity = capacity;
+  map->size = 0;
+  map->threshold = capacity * map->load_factor;
+  if (map->threshold >= capacity)
+    map->threshold = capacity - 1;
+  for (map->shift = 32; capacity > 1; capacity >>= 1)
+    map->shift--;
+  return 0;
+}
+
+struct NpRobinHoodMap *np_robinhoodmap_new(
+  int (*key_compare)(void *key1, void *key2), unsigned (*key_hash)(void *key))
+{
+  struct NpRobinHoodMap *map;
+
+  map = malloc(sizeof *map);
+  if (map != NULL) {
+    map->key_compare = key_compare;
+    map->key_hash = key_hash;
+    map->load_factor = NP_ROBINHOODMAP_DEFAULT_LOAD_FACTOR;
+    if (np_robinhoodmap_init(map, NP_ROBINHOODMAP_INITIAL_CAPACITY) != 0) {
+      free(map);
+      return NULL;
+    }
+  }
+  return map;
+}
+
+void np_robinhoodmap_free(struct NpRobinHoodMap *map)
+{
+  free(map->slots);
+  free(map);
+}
+
+/*
+ * Inserts an item known not to be in the map. The item being placed swaps
+ * with any item closer to its home slot, which is then placed in turn.
+ * Returns the longest probe length of the inserted item and the items it
+ * displaced, the longest a lookup of any of them now takes.
+ */
+static unsigned np_robinhoodmap_insert(struct NpRobinHoodMap *map,
+				       struct NpRobinHoodMapSlot item)
+{
+  struct NpRobinHoodMapSlot tmp;
+  struct NpRobinHoodMapSlot *slot;
+  unsigned mask;
+  unsigned i;
+  unsigned probe;
+
+  mask = map->capacity - 1;
+  i = NP_ROBINHOODMAP_HOME(map, item.hash);
+  item.distance = 1;
+  probe = 0;
+  for (;;) {
+    if (item.distance > probe)
+      probe = item.distance;
+    slot = map->slots + i;
+    if (slot->distance == 0) {
+      *slot = item;
+      break;
+    }
+    if (slot->distance < item.distance) {
+      tmp = *slot;
+      *slot = item;
+      item = tmp;
+    }
+    item.distance++;
+    i = (i + 1) & mask;
+  }
+  map->size++;
+  return probe;
+}
+
+/*
+ * Moves the items into a slot array of the given capacity.
+ */
+static struct NpRobinHoodMap *np_robinhoodmap_resize(
+  struct NpRobinHoodMap *map, unsigned capacity)
+{
+  struct NpRobinHoodMap new_map;
+  unsigned i;
+
+  if (capacity < map->capacity)
+    return NULL; /* overflow */
+  new_map.load_factor = map->load_factor;
+  if (np_robinhoodmap_init(&new_map, capacity) != 0)
+    return NULL;
+  for (i = 0; i < map->capacity; ++i)
+    if (map->slots[i].distance != 0)
+      np_robinhoodmap_insert(&new_map, map->slots[i]);
+  free(map->slots);
+  map->slots = new_map.slots;
+  map->capacity = new_map.capacity;
+  map->threshold = new_map.threshold;
+  map->shift = new_map.shift;
+  return map;
+}
+
+struct NpRobinHoodMap *np_robinhoodmap_set_load_factor(
+  struct NpRobinHoodMap *map, float load_factor)
+{
+  unsigned capacity;
+
+  if (load_factor <= 0 || load_factor >= 1)
+    return NULL;
+  map->load_factor = load_factor;
+  for (capacity = map->capacity; (unsigned)(capacity * load_factor)
+	 <= map->size && capacity << 1 != 0; capacity <<= 1)
+    ;
+  if (capacity == map->capacity) {
+    map->threshold = capacity * load_factor;
+    return map;
+  }
+  return np_robinhoodmap_resize(map, capacity);
+}
+
+/*
+ * Finds the slot holding the key. The probe ends at the first slot whose
+ * item is closer to its home than the key would be, which includes empty
+ * slots.
+ */
+static struct NpRobinHoodMapSlot *np_robinhoodmap_find(
+  struct NpRobinHoodMap *map, void *key, unsigned hash)
+{
+  struct NpRobinHoodMapSlot *slot;
+  unsigned mask;
+  unsigned i;
+  unsigned distance;
+
+  mask = map->capacity - 1;
+  i = NP_ROBINHOODMAP_HOME(map, hash);
+  for (distance = 1;; ++distance) {
+    slot = map->slots + i;
+    if (slot->distance < distance)
+      return NULL;
+    if (slot->hash == hash && map->key_compare(key, slot->key) == 0)
+      return slot;
+    i = (i + 1) & mask;
+  }
+}
+
+void *np_robinhoodmap_put(struct NpRobinHoodMap *map, void *key, void *value)
+{
+  struct NpRobinHoodMapSlot *slot;
+  struct NpRobinHoodMapSlot item;
+
+  item.hash = map->key_hash(key);
+  if ((slot = np_robinhoodmap_find(map, key, item.hash)) != NULL) {
+    slot->value = value;
+    return value;
+  }
+  if (map->size >= map->threshold
+      && np_robinhoodmap_resize(map, map->capacity * 2) == NULL)
+    return NULL;
+  item.key = key;
+  item.value = value;
+
+  /*
+   * An unusually long probe for the new item or any item it displaced
+   * means clustering, so grow early rather than wait for the threshold. A
+   * failed resize leaves a valid map.
+   */
+  if (np_robinhoodmap_insert(map, item) > NP_ROBINHOODMAP_MAX_PROBE
+      && map->size >= map->capacity / 2)
+    np_robinhoodmap_resize(map, map->capacity * 2);
+  return value;
+}
+
+void *np_robinhoodmap_get(struct NpRobinHoodMap *map, void *key)
+{
+  struct NpRobinHoodMapSlot *slot;
+
+  slot = np_robinhoodmap_find(map, key, map->key_hash(key));
+  return slot != NULL ? slot->value : NULL;
+}
+
+void *np_robinhoodmap_remove(struct NpRobinHoodMap *map, void *key)
+{
+  struct NpRobinHoodMapSlot *slot;
+  struct NpRobinHoodMapSlot *next;
+  unsigned mask;
+  unsigned i;
+  void *value;
+
+  if ((slot = np_robinhoodmap_find(map, key, map->key_hash(key))) == NULL)
+    return NULL;
+  value = slot->value;
+
+  /* shift the following displaced items back by one slot */
+  mask = map->capacity - 1;
+  i = slot - map->slots;
+  for (;;) {
+    next = map->slots + ((i + 1) & mask);
+    if (next->distance <= 1)
+      break;
+    *slot = *next;
+    slot->distance--;
+    slot = next;
+    i = (i + 1) & mask;
+  }
+  slot->distance = 0;
+  map->size--;
+  return value;
+}
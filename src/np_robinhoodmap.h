@@ -0,0 +1,172 @@
+/*
+ * np_robinhoodmap.h: nplib Robin Hood hash map header file
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NP_ROBINHOODMAP_H
+#define __NP_ROBINHOODMAP_H
+
+#define NP_ROBINHOODMAP_INITIAL_CAPACITY 16
+#define NP_ROBINHOODMAP_DEFAULT_LOAD_FACTOR 0.9
+
+/**
+   Probe length beyond which an insert grows the map early, provided the map
+   is at least half full. Measured over the inserted item and every item the
+   insert displaces.
+*/
+#define NP_ROBINHOODMAP_MAX_PROBE 64
+
+/**
+   Robin Hood hash map slot.
+*/
+struct NpRobinHoodMapSlot {
+  /**
+     The slot key.
+  */
+  void *key;
+
+  /**
+     The slot value.
+  */
+  void *value;
+
+  /**
+     The key hash, cached so that resizes do not rehash keys and probes can
+     skip key_compare on slots with a different hash.
+  */
+  unsigned hash;
+
+  /**
+     One more than the distance of the slot from the key's home slot, 0 for
+     an empty slot.
+  */
+  unsigned distance;
+};
+
+/**
+   Robin Hood (open addressing) hash map object. An insert takes the slot of
+   any item closer to its home slot than the item being inserted, which then
+   moves on, keeping probe lengths short and even at high load factors. A
+   lookup stops at the first slot closer to its home than the probe. Removes
+   shift the following items back instead of leaving tombstones.
+*/
+struct NpRobinHoodMap {
+  /**
+     Pointer to a function used to compare map keys.
+
+     @param key1 the first key
+     @param key2 the second key
+     @return 0 if keys are equal, value > 0 if first key is greater than
+     the second key, value < 0 if the first key is lesser than the second
+  */
+  int (*key_compare)(void *key1, void *key2);
+
+  /**
+     Pointer to a function used to hash keys.
+
+     @param key the key to hash
+     @return the hash
+  */
+  unsigned (*key_hash)(void *key);
+
+  /**
+     The map capacity (number of slots). Always a power of two.
+  */
+  unsigned capacity;
+
+  /**
+     The number of items in the map.
+  */
+  unsigned size;
+
+  /**
+     The size at which the map grows (capacity * load_factor).
+  */
+  unsigned threshold;
+
+  /**
+     The load factor.
+  */
+  float load_factor;
+
+  /**
+     The shift mapping a scrambled hash to its home slot.
+  */
+  unsigned shift;
+
+  /**
+     The slots.
+  */
+  struct NpRobinHoodMapSlot *slots;
+};
+
+/**
+   Allocates memory for and initializes a Robin Hood map.
+
+   @param key_compare the function to be used for comparing keys
+   @param key_hash the function to be used for hashing keys
+   @return a pointer to the allocated memory or NULL on error
+*/
+struct NpRobinHoodMap *np_robinhoodmap_new(
+  int (*key_compare)(void *key1, void *key2), unsigned (*key_hash)(void *key));
+
+/**
+   Frees the memory used by the map. Does not free the keys or values.
+
+   @param map the map to free
+*/
+void np_robinhoodmap_free(struct NpRobinHoodMap *map);
+
+/**
+   Sets the load factor of the map, growing it if needed.
+
+   @param map the map
+   @param load_factor the load factor, greater than 0 and less than 1
+   @return the map or NULL on error
+*/
+struct NpRobinHoodMap *np_robinhoodmap_set_load_factor(
+  struct NpRobinHoodMap *map, float load_factor);
+
+/**
+   Puts an item into the map.
+
+   @param map the map in which to put the item
+   @param key the key at which to store the value, replacing an existing item
+   @param value the value to store
+   @return a pointer to the added item or NULL on error
+*/
+void *np_robinhoodmap_put(struct NpRobinHoodMap *map, void *key, void *value);
+
+/**
+   Gets an item from the map.
+
+   @param map the map from which to retrieve the item
+   @param key the key of the item to retrieve
+   @return a pointer to the item or NULL if the item does not exist
+*/
+void *np_robinhoodmap_get(struct NpRobinHoodMap *map, void *key);
+
+/**
+   Removes an item from the map.
+
+   @param map the map from which to remove the item
+   @param key the key of the item to remove
+   @return a pointer to the removed item or NULL if there is no item at the
+   given key
+*/
+void *np_robinhoodmap_remove(struct NpRobinHoodMap *map, void *key);
+
+#endif
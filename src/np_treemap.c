@@ -37,6 +37,14 @@
 #include <stdlib.h>
 
 #include "np_treemap.h"
+#include "np_pool.h"
+#include "np_bloom.h"
+
+#ifdef __GNUC__
+#define NP_TREEMAP_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define NP_TREEMAP_PREFETCH(p) ((void)(p))
+#endif
 
 struct NpTreeMap *np_treemap_new(int (*comparator)(void *key1, void *key2))
 {
@@ -44,7 +52,13 @@ struct NpTreeMap *np_treemap_new(int (*comparator)(void *key1, void *key2))
 
   map = malloc(sizeof *map);
   if (map) {
+    if ((map->pool = np_pool_new(sizeof(struct NpTreeMapNode))) == NULL) {
+      free(map);
+      return NULL;
+    }
     map->comparator = comparator;
+    map->bloom = NULL;
+    map->key_hash = NULL;
 
     /*
      * Use self referencing sentinel node named nil to simplify code by
@@ -108,34 +122,94 @@ static void np_treemap_rotate_right(struct NpTreeMap *map,
 }
 
 void np_treemap_free(struct NpTreeMap *map)
+{
+  /* all nodes live in the pool's slabs */
+  np_pool_free(map->pool);
+  if (map->bloom != NULL)
+    np_bloom_free(map->bloom);
+  free(map);
+}
+
+static struct NpTreeMapNode *np_treemap_successor(struct NpTreeMap *map,
+						  struct NpTreeMapNode *node)
+{
+  struct NpTreeMapNode *successor;
+
+  if ((successor = node->right) != &map->nil) {
+    while (successor->left != &map->nil)
+      successor = successor->left;
+  } else {
+    for (successor = node->parent; node == successor->right;
+	 successor = successor->parent)
+      node = successor;
+    if (successor == &map->root)
+      successor = &map->nil;
+  }
+  return successor;
+}
+
+static struct NpTreeMapNode *np_treemap_first(struct NpTreeMap *map)
 {
   struct NpTreeMapNode *node;
-  struct NpTreeMapNode *parent;
 
   node = map->root.left;
-  while (node != &map->nil) {
-    if (node->left != &map->nil) {
-      node = node->left;
-    } else if (node->right != &map->nil) {
-      node = node->right;
-    } else {
-      parent = node->parent;
-      if (parent->left == node)
-	parent->left = &map->nil;
-      else
-	parent->right = &map->nil;
-      if (node != &map->root)
-	free(node);
-      node = parent;
-    }
+  while (node->left != &map->nil)
+    node = node->left;
+  return node;
+}
+
+/*
+ * Rebuilds the Bloom filter from the keys in the tree, sized for twice the
+ * number of keys so it has room to grow. If that fails the old filter, which
+ * still holds every key, is kept.
+ */
+static void np_treemap_bloom_rebuild(struct NpTreeMap *map)
+{
+  struct NpTreeMapNode *node;
+  unsigned size;
+
+  size = 0;
+  for (node = np_treemap_first(map); node != &map->nil;
+       node = np_treemap_successor(map, node))
+    size++;
+  if (np_bloom_reset(map->bloom, size * 2) == NULL)
+    return;
+  for (node = np_treemap_first(map); node != &map->nil;
+       node = np_treemap_successor(map, node))
+    np_bloom_add(map->bloom, map->key_hash(node->key));
+}
+
+struct NpTreeMap *np_treemap_attach_bloom(struct NpTreeMap *map,
+					  unsigned (*key_hash)(void *key))
+{
+  if (map->bloom == NULL) {
+    if ((map->bloom = np_bloom_new(0)) == NULL)
+      return NULL;
+    map->key_hash = key_hash;
+    np_treemap_bloom_rebuild(map);
   }
-  free(map);
+  return map;
 }
 
-void *np_treemap_put(struct NpTreeMap *map, void *key, void *value)
+void np_treemap_detach_bloom(struct NpTreeMap *map)
+{
+  if (map->bloom != NULL) {
+    np_bloom_free(map->bloom);
+    map->bloom = NULL;
+  }
+}
+
+/*
+ * Finds the node holding the key, inserting one with a NULL value if there
+ * is none. Rebalancing rotates nodes but never moves them.
+ */
+static struct NpTreeMapNode *np_treemap_find_or_insert(struct NpTreeMap *map,
+						       void *key,
+						       int *inserted)
 {
   struct NpTreeMapNode *node;
   struct NpTreeMapNode *parent;
+  struct NpTreeMapNode *added;
   int cmp;
 
   /* binary insertion of node */
@@ -144,19 +218,21 @@ void *np_treemap_put(struct NpTreeMap *map, void *key, void *value)
   while (node != &map->nil) {
     parent = node;
 
-    /* replace existing item value */
+    /* existing item */
     if ((cmp = map->comparator(key, node->key)) == 0) {
-      node->value = value;
-      return value;
+      *inserted = 0;
+      return node;
     }
     node = cmp < 0 ? node->left : node->right;
   }
 
-  node = malloc(sizeof *node);
+  node = np_pool_alloc(map->pool);
   if (node == NULL)
     return NULL;
+  *inserted = 1;
+  added = node;
   node->key = key;
-  node->value = value;
+  node->value = NULL;
   node->parent = parent;
   node->left = node->right = &map->nil;
   if (parent == &map->root || map->comparator(key, parent->key) < 0)
@@ -207,39 +283,129 @@ void *np_treemap_put(struct NpTreeMap *map, void *key, void *value)
     }
   }
   map->root.left->color = BLACK; /* first node is always black */
+  if (map->bloom != NULL) {
+    np_bloom_add(map->bloom, map->key_hash(key));
+    if (np_bloom_stale(map->bloom))
+      np_treemap_bloom_rebuild(map);
+  }
+  return added;
+}
+
+void *np_treemap_put(struct NpTreeMap *map, void *key, void *value)
+{
+  struct NpTreeMapNode *node;
+  int inserted;
+
+  if ((node = np_treemap_find_or_insert(map, key, &inserted)) == NULL)
+    return NULL;
+  node->value = value;
   return value;
 }
 
+void *np_treemap_put_if_absent(struct NpTreeMap *map, void *key, void *value)
+{
+  struct NpTreeMapNode *node;
+  int inserted;
+
+  if ((node = np_treemap_find_or_insert(map, key, &inserted)) == NULL)
+    return NULL;
+  if (inserted)
+    node->value = value;
+  return node->value;
+}
+
+void **np_treemap_get_or_insert(struct NpTreeMap *map, void *key,
+				int *inserted)
+{
+  struct NpTreeMapNode *node;
+  int ignored;
+
+  node = np_treemap_find_or_insert(map, key,
+				   inserted != NULL ? inserted : &ignored);
+  return node != NULL ? &node->value : NULL;
+}
+
+void *np_treemap_compute(struct NpTreeMap *map, void *key,
+			 void *(*remap)(void *key, void *value, void *arg),
+			 void *arg)
+{
+  struct NpTreeMapNode *node;
+  int inserted;
+
+  if ((node = np_treemap_find_or_insert(map, key, &inserted)) == NULL)
+    return NULL;
+  node->value = remap(node->key, node->value, arg);
+  return node->value;
+}
+
 void *np_treemap_get(struct NpTreeMap *map, void *key)
 {
   struct NpTreeMapNode *node;
   int cmp;
 
+  if (map->bloom != NULL && !np_bloom_contains(map->bloom, map->key_hash(key)))
+    return NULL;
   node = map->root.left;
   while (node != &map->nil) {
     if ((cmp = map->comparator(key, node->key)) == 0)
       return node->value;
     node = cmp < 0 ? node->left : node->right;
   }
+  if (map->bloom != NULL)
+    map->bloom->false_positives++;
   return NULL;
 }
 
-static struct NpTreeMapNode *np_treemap_successor(struct NpTreeMap *map,
-						  struct NpTreeMapNode *node)
+unsigned np_treemap_get_many(struct NpTreeMap *map, void **keys,
+			     void **values, unsigned count)
 {
-  struct NpTreeMapNode *successor;
+  struct NpTreeMapNode *nodes[NP_TREEMAP_BATCH_SIZE];
+  struct NpTreeMapNode *node;
+  unsigned batch;
+  unsigned active;
+  unsigned found;
+  unsigned i;
+  unsigned j;
+  int cmp;
 
-  if ((successor = node->right) != &map->nil) {
-    while (successor->left != &map->nil)
-      successor = successor->left;
-  } else {
-    for (successor = node->parent; node == successor->right;
-	 successor = successor->parent)
-      node = successor;
-    if (successor == &map->root)
-      successor = &map->nil;
+  found = 0;
+  for (i = 0; i < count; i += batch) {
+    batch = count - i < NP_TREEMAP_BATCH_SIZE ? count - i
+      : NP_TREEMAP_BATCH_SIZE;
+    /* a NULL node marks a finished descent */
+    for (j = 0, active = 0; j < batch; ++j) {
+      if (map->bloom != NULL
+	  && !np_bloom_contains(map->bloom, map->key_hash(keys[i + j]))) {
+	values[i + j] = NULL;
+	nodes[j] = NULL;
+      } else {
+	nodes[j] = map->root.left;
+	active++;
+      }
+    }
+    NP_TREEMAP_PREFETCH(map->root.left);
+    while (active > 0) {
+      for (j = 0; j < batch; ++j) {
+	if ((node = nodes[j]) == NULL)
+	  continue;
+	if (node == &map->nil) {
+	  values[i + j] = NULL;
+	  if (map->bloom != NULL)
+	    map->bloom->false_positives++;
+	} else if ((cmp = map->comparator(keys[i + j], node->key)) == 0) {
+	  values[i + j] = node->value;
+	  found++;
+	} else {
+	  nodes[j] = cmp < 0 ? node->left : node->right;
+	  NP_TREEMAP_PREFETCH(nodes[j]);
+	  continue;
+	}
+	nodes[j] = NULL;
+	active--;
+      }
+    }
   }
-  return successor;
+  return found;
 }
 
 static void np_treemap_repair(struct NpTreeMap *map,
@@ -247,7 +413,7 @@ static void np_treemap_repair(struct NpTreeMap *map,
 {
   struct NpTreeMapNode *sibling;
 
-  while (node->color == BLACK) {
+  while (node != map->root.left && node->color == BLACK) {
     if (node == node->parent->left) {
       sibling = node->parent->right;
       if (sibling->color == RED) {
@@ -264,6 +430,7 @@ static void np_treemap_repair(struct NpTreeMap *map,
 	  sibling->left->color = BLACK;
 	  sibling->color = RED;
 	  np_treemap_rotate_right(map, sibling);
+	  sibling = node->parent->right;
 	}
 	sibling->color = node->parent->color;
 	node->parent->color = BLACK;
@@ -281,7 +448,7 @@ static void np_treemap_repair(struct NpTreeMap *map,
       }
       if (sibling->right->color == BLACK && sibling->left->color == BLACK) {
 	sibling->color = RED;
-	node = node->parent->left;
+	node = node->parent;
       } else {
 	if (sibling->left->color == BLACK) {
 	  sibling->right->color = BLACK;
@@ -297,6 +464,7 @@ static void np_treemap_repair(struct NpTreeMap *map,
       }
     }
   }
+  node->color = BLACK;
 }
 
 void *np_treemap_remove(struct NpTreeMap *map, void *key)
@@ -344,10 +512,49 @@ void *np_treemap_remove(struct NpTreeMap *map, void *key)
     else
       node->parent->right = y;
   }
-  free(node);
+  np_pool_release(map->pool, node);
+  if (map->bloom != NULL) {
+    np_bloom_remove(map->bloom);
+    if (np_bloom_stale(map->bloom))
+      np_treemap_bloom_rebuild(map);
+  }
   return value;
 }
 
+/*
+ * Counts the nodes of a subtree and returns its height.
+ */
+static unsigned np_treemap_stats_node(struct NpTreeMap *map,
+				      struct NpTreeMapNode *node,
+				      struct NpTreeMapStats *stats)
+{
+  unsigned left;
+  unsigned right;
+
+  if (node == &map->nil)
+    return 0;
+  stats->size++;
+  left = np_treemap_stats_node(map, node->left, stats);
+  right = np_treemap_stats_node(map, node->right, stats);
+  return 1 + (left > right ? left : right);
+}
+
+void np_treemap_stats(struct NpTreeMap *map, struct NpTreeMapStats *stats)
+{
+  struct NpTreeMapNode *node;
+
+  stats->size = 0;
+  stats->height = np_treemap_stats_node(map, map->root.left, stats);
+  stats->black_height = 0;
+  for (node = map->root.left; node != &map->nil; node = node->left)
+    if (node->color == BLACK)
+      stats->black_height++;
+  stats->bytes = sizeof *map + sizeof *map->pool + map->pool->bytes;
+  if (map->bloom != NULL)
+    stats->bytes += sizeof *map->bloom
+      + sizeof *map->bloom->blocks * map->bloom->block_count;
+}
+
 struct NpTreeMapIterator *np_treemap_iterator(struct NpTreeMap *map)
 {
   struct NpTreeMapIterator *iter;
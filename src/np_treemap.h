@@ -19,6 +19,13 @@
 #ifndef __NP_TREEMAP_H
 #define __NP_TREEMAP_H
 
+#include <stddef.h>
+
+/**
+   Number of tree descents interleaved by np_treemap_get_many().
+*/
+#define NP_TREEMAP_BATCH_SIZE 8
+
 /**
    Tree node colors.
 */
@@ -62,6 +69,33 @@ struct NpTreeMapNode {
   struct NpTreeMapNode *right;
 };
 
+/**
+   Tree map statistics.
+*/
+struct NpTreeMapStats {
+  /**
+     The number of nodes in the map.
+  */
+  unsigned size;
+
+  /**
+     The number of nodes on the longest path from the root to a leaf, 0 for
+     an empty map.
+  */
+  unsigned height;
+
+  /**
+     The number of black nodes on every path from the root to a leaf.
+  */
+  unsigned black_height;
+
+  /**
+     The number of bytes of memory used by the map, its node pool, and Bloom
+     filter. Does not include the keys and values.
+  */
+  size_t bytes;
+};
+
 /**
    Tree map object.
 */
@@ -81,6 +115,22 @@ struct NpTreeMap {
      A comparator function for the map keys.
   */
   int (*comparator)(void *key1, void *key2);
+
+  /**
+     The pool from which the map nodes are allocated.
+  */
+  struct NpPool *pool;
+
+  /**
+     The Bloom filter of the key hashes consulted before each get, NULL if
+     none is attached.
+  */
+  struct NpBloom *bloom;
+
+  /**
+     The function hashing keys for the Bloom filter.
+  */
+  unsigned (*key_hash)(void *key);
 };
 
 /**
@@ -122,6 +172,47 @@ void np_treemap_free(struct NpTreeMap *map);
 */
 void *np_treemap_put(struct NpTreeMap *map, void *key, void *value);
 
+/**
+   Puts an item into the map unless the key is already present, descending
+   the tree once.
+
+   @param map the map
+   @param key the key used to store/retrieve the value
+   @param value the value to store if the key is absent
+   @return the value now at the key, which is the existing value if the key
+   was present, or NULL on error
+*/
+void *np_treemap_put_if_absent(struct NpTreeMap *map, void *key, void *value);
+
+/**
+   Gets the value slot of a key, inserting the key with a NULL value if it
+   is absent. The slot stays valid until the key is removed.
+
+   @param map the map
+   @param key the key
+   @param inserted if not NULL, set to 1 if the key was inserted or 0 if it
+   was present
+   @return a pointer to the value slot or NULL on error
+*/
+void **np_treemap_get_or_insert(struct NpTreeMap *map, void *key,
+				int *inserted);
+
+/**
+   Replaces the value of a key by the result of a function of its current
+   value, inserting the key if it is absent, with a single descent.
+
+   @param map the map
+   @param key the key
+   @param remap the function computing the new value from the key as
+   stored in the map, the current value or NULL if the key is absent, and
+   arg
+   @param arg passed to remap
+   @return the new value or NULL on error, in which case remap is not called
+*/
+void *np_treemap_compute(struct NpTreeMap *map, void *key,
+			 void *(*remap)(void *key, void *value, void *arg),
+			 void *arg);
+
 /**
    Gets an item from the map.
 
@@ -131,6 +222,20 @@ void *np_treemap_put(struct NpTreeMap *map, void *key, void *value);
 */
 void *np_treemap_get(struct NpTreeMap *map, void *key);
 
+/**
+   Gets several items from the map. Up to NP_TREEMAP_BATCH_SIZE descents are
+   advanced in lockstep, prefetching the next node of each, so the cache
+   misses of the descents overlap.
+
+   @param map the map
+   @param keys the search keys
+   @param values receives the item for each key or NULL if it is not found
+   @param count the number of keys
+   @return the number of keys found
+*/
+unsigned np_treemap_get_many(struct NpTreeMap *map, void **keys,
+			     void **values, unsigned count);
+
 /**
    Removes an item from the map.
 
@@ -140,6 +245,37 @@ void *np_treemap_get(struct NpTreeMap *map, void *key);
 */
 void *np_treemap_remove(struct NpTreeMap *map, void *key);
 
+/**
+   Attaches a Bloom filter of the key hashes to the map. Gets of absent keys
+   are then usually rejected by the filter without descending the tree. The
+   map adds new keys to the filter and rebuilds it by walking the tree once
+   it has grown past its size or half of its keys were removed. The filter
+   statistics are in map->bloom.
+
+   @param map the map
+   @param key_hash the function to be used for hashing keys, equal keys must
+   have equal hashes
+   @return the map or NULL on error
+*/
+struct NpTreeMap *np_treemap_attach_bloom(struct NpTreeMap *map,
+					  unsigned (*key_hash)(void *key));
+
+/**
+   Detaches and frees the Bloom filter of the map, if any.
+
+   @param map the map
+*/
+void np_treemap_detach_bloom(struct NpTreeMap *map);
+
+/**
+   Collects statistics about the shape and memory use of the map. Visits
+   every node, so the cost is linear in the size of the map.
+
+   @param map the map
+   @param stats receives the statistics
+*/
+void np_treemap_stats(struct NpTreeMap *map, struct NpTreeMapStats *stats);
+
 /**
    Creates a key iterator for the map. The map must not be modified while
    using the iterator. If the map is modified the iterator behaviour is
@@ -0,0 +1,344 @@
+/*
+ * np_treemap_define.h: nplib type specialized tree map generator
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NP_TREEMAP_DEFINE_H
+#define __NP_TREEMAP_DEFINE_H
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "np_treemap.h"
+#include "np_pool.h"
+
+/**
+   Defines a tree map storing keys and values of the given types by value.
+   The map is the same red/black tree as np_treemap, with sentinel root and
+   nil nodes and pooled nodes, but the compare function is called directly
+   so the compiler can inline it.
+
+   For a map named name the macro defines:
+
+   struct name - the map object
+   struct name##_node - the map node
+   struct name *name##_new(void) - allocates a map, NULL on error
+   void name##_free(struct name *map) - frees the map
+   value_type *name##_put(struct name *map, key_type key, value_type value)
+     - stores the value at the key, returning a pointer to the stored value
+     or NULL on error
+   value_type *name##_get(struct name *map, key_type key) - returns a
+     pointer to the value stored at the key or NULL if there is none
+   int name##_remove(struct name *map, key_type key, value_type *value) -
+     removes the node at the key, copying its value to value if not NULL,
+     returning 1 if a node was removed and 0 otherwise
+
+   Pointers returned by put and get are valid until the node is removed.
+   Nodes are allocated from a pool aligned for the key and value types, so
+   these may be over-aligned types such as long double.
+
+   @param name the name of the map type and prefix of its functions
+   @param key_type the key type
+   @param value_type the value type
+   @param compare_fn a function or macro taking two keys and returning 0 if
+   they are equal, a value > 0 if the first is greater and a value < 0 if the
+   first is lesser
+*/
+#define NP_TREEMAP_DEFINE(name, key_type, value_type, compare_fn)            \
+struct name##_node {                                                         \
+  key_type key;                                                              \
+  value_type value;                                                          \
+  enum NpTreeMapColor color;                                                 \
+  struct name##_node *parent;                                                \
+  struct name##_node *left;                                                  \
+  struct name##_node *right;                                                 \
+};                                                                           \
+                                                                             \
+/* the offset of node is the alignment the node needs */                     \
+struct name##_align {                                                        \
+  char c;                                                                    \
+  struct name##_node node;                                                   \
+};                                                                           \
+                                                                             \
+struct name {                                                                \
+  struct name##_node root;                                                   \
+  struct name##_node nil;                                                    \
+  unsigned size;                                                             \
+  struct NpPool *pool;                                                       \
+};                                                                           \
+                                                                             \
+static inline struct name *name##_new(void)                                  \
+{                                                                            \
+  struct name *map;                                                          \
+                                                                             \
+  map = malloc(sizeof *map);                                                 \
+  if (map != NULL) {                                                         \
+    map->pool = np_pool_new_aligned(sizeof(struct name##_node),              \
+				    offsetof(struct name##_align, node));    \
+    if (map->pool == NULL) {                                                 \
+      free(map);                                                             \
+      return NULL;                                                           \
+    }                                                                        \
+    map->nil.left = map->nil.right = map->nil.parent = &map->nil;            \
+    map->nil.color = BLACK;                                                  \
+    map->root.left = map->root.right = map->root.parent = &map->nil;         \
+    map->root.color = BLACK;                                                 \
+    map->size = 0;                                                           \
+  }                                                                          \
+  return map;                                                                \
+}                                                                            \
+                                                                             \
+static inline void name##_free(struct name *map)                             \
+{                                                                            \
+  np_pool_free(map->pool);                                                   \
+  free(map);                                                                 \
+}                                                                            \
+                                                                             \
+static inline void name##_rotate_left(struct name *map,                      \
+				      struct name##_node *node)              \
+{                                                                            \
+  struct name##_node *child;                                                 \
+                                                                             \
+  child = node->right;                                                       \
+  node->right = child->left;                                                 \
+  if (child->left != &map->nil)                                              \
+    child->left->parent = node;                                              \
+  child->parent = node->parent;                                              \
+  if (node == node->parent->left)                                            \
+    node->parent->left = child;                                              \
+  else                                                                       \
+    node->parent->right = child;                                             \
+  child->left = node;                                                        \
+  node->parent = child;                                                      \
+}                                                                            \
+                                                                             \
+static inline void name##_rotate_right(struct name *map,                     \
+				       struct name##_node *node)             \
+{                                                                            \
+  struct name##_node *child;                                                 \
+                                                                             \
+  child = node->left;                                                        \
+  node->left = child->right;                                                 \
+  if (child->right != &map->nil)                                             \
+    child->right->parent = node;                                             \
+  child->parent = node->parent;                                              \
+  if (node == node->parent->left)                                            \
+    node->parent->left = child;                                              \
+  else                                                                       \
+    node->parent->right = child;                                             \
+  child->right = node;                                                       \
+  node->parent = child;                                                      \
+}                                                                            \
+                                                                             \
+static inline value_type *name##_put(struct name *map, key_type key,         \
+				     value_type value)                       \
+{                                                                            \
+  struct name##_node *node;                                                  \
+  struct name##_node *parent;                                                \
+  struct name##_node *uncle;                                                 \
+  struct name##_node *added;                                                 \
+  int cmp;                                                                   \
+                                                                             \
+  node = map->root.left;                                                     \
+  parent = &map->root;                                                       \
+  cmp = -1;                                                                  \
+  while (node != &map->nil) {                                                \
+    parent = node;                                                           \
+    if ((cmp = compare_fn(key, node->key)) == 0) {                           \
+      node->value = value;                                                   \
+      return &node->value;                                                   \
+    }                                                                        \
+    node = cmp < 0 ? node->left : node->right;                               \
+  }                                                                          \
+  if ((added = node = np_pool_alloc(map->pool)) == NULL)                     \
+    return NULL;                                                             \
+  node->key = key;                                                           \
+  node->value = value;                                                       \
+  node->parent = parent;                                                     \
+  node->left = node->right = &map->nil;                                      \
+  if (cmp < 0)                                                               \
+    parent->left = node;                                                     \
+  else                                                                       \
+    parent->right = node;                                                    \
+  node->color = RED;                                                         \
+  map->size++;                                                               \
+                                                                             \
+  while (node->parent->color == RED) {                                       \
+    if (node->parent == node->parent->parent->left) {                        \
+      uncle = node->parent->parent->right;                                   \
+      if (uncle->color == RED) {                                             \
+	node->parent->color = BLACK;                                         \
+	uncle->color = BLACK;                                                \
+	node->parent->parent->color = RED;                                   \
+	node = node->parent->parent;                                         \
+      } else {                                                               \
+	if (node == node->parent->right) {                                   \
+	  node = node->parent;                                               \
+	  name##_rotate_left(map, node);                                     \
+	}                                                                    \
+	node->parent->color = BLACK;                                         \
+	node->parent->parent->color = RED;                                   \
+	name##_rotate_right(map, node->parent->parent);                      \
+      }                                                                      \
+    } else {                                                                 \
+      uncle = node->parent->parent->left;                                    \
+      if (uncle->color == RED) {                                             \
+	node->parent->color = BLACK;                                         \
+	uncle->color = BLACK;                                                \
+	node->parent->parent->color = RED;                                   \
+	node = node->parent->parent;                                         \
+      } else {                                                               \
+	if (node == node->parent->left) {                                    \
+	  node = node->parent;                                               \
+	  name##_rotate_right(map, node);                                    \
+	}                                                                    \
+	node->parent->color = BLACK;                                         \
+	node->parent->parent->color = RED;                                   \
+	name##_rotate_left(map, node->parent->parent);                       \
+      }                                                                      \
+    }                                                                        \
+  }                                                                          \
+  map->root.left->color = BLACK;                                             \
+  return &added->value;                                                      \
+}                                                                            \
+                                                                             \
+static inline value_type *name##_get(struct name *map, key_type key)         \
+{                                                                            \
+  struct name##_node *node;                                                  \
+  int cmp;                                                                   \
+                                                                             \
+  node = map->root.left;                                                     \
+  while (node != &map->nil) {                                                \
+    if ((cmp = compare_fn(key, node->key)) == 0)                             \
+      return &node->value;                                                   \
+    node = cmp < 0 ? node->left : node->right;                               \
+  }                                                                          \
+  return NULL;                                                               \
+}                                                                            \
+                                                                             \
+static inline void name##_repair(struct name *map, struct name##_node *node) \
+{                                                                            \
+  struct name##_node *sibling;                                               \
+                                                                             \
+  while (node != map->root.left && node->color == BLACK) {                   \
+    if (node == node->parent->left) {                                        \
+      sibling = node->parent->right;                                         \
+      if (sibling->color == RED) {                                           \
+	sibling->color = BLACK;                                              \
+	node->parent->color = RED;                                           \
+	name##_rotate_left(map, node->parent);                               \
+	sibling = node->parent->right;                                       \
+      }                                                                      \
+      if (sibling->right->color == BLACK && sibling->left->color == BLACK) { \
+	sibling->color = RED;                                                \
+	node = node->parent;                                                 \
+      } else {                                                               \
+	if (sibling->right->color == BLACK) {                                \
+	  sibling->left->color = BLACK;                                      \
+	  sibling->color = RED;                                              \
+	  name##_rotate_right(map, sibling);                                 \
+	  sibling = node->parent->right;                                     \
+	}                                                                    \
+	sibling->color = node->parent->color;                                \
+	node->parent->color = BLACK;                                         \
+	sibling->right->color = BLACK;                                       \
+	name##_rotate_left(map, node->parent);                               \
+	break;                                                               \
+      }                                                                      \
+    } else {                                                                 \
+      sibling = node->parent->left;                                          \
+      if (sibling->color == RED) {                                           \
+	sibling->color = BLACK;                                              \
+	node->parent->color = RED;                                           \
+	name##_rotate_right(map, node->parent);                              \
+	sibling = node->parent->left;                                        \
+      }                                                                      \
+      if (sibling->right->color == BLACK && sibling->left->color == BLACK) { \
+	sibling->color = RED;                                                \
+	node = node->parent;                                                 \
+      } else {                                                               \
+	if (sibling->left->color == BLACK) {                                 \
+	  sibling->right->color = BLACK;                                     \
+	  sibling->color = RED;                                              \
+	  name##_rotate_left(map, sibling);                                  \
+	  sibling = node->parent->left;                                      \
+	}                                                                    \
+	sibling->color = node->parent->color;                                \
+	node->parent->color = BLACK;                                         \
+	sibling->left->color = BLACK;                                        \
+	name##_rotate_right(map, node->parent);                              \
+	break;                                                               \
+      }                                                                      \
+    }                                                                        \
+  }                                                                          \
+  node->color = BLACK;                                                       \
+}                                                                            \
+                                                                             \
+static inline int name##_remove(struct name *map, key_type key,              \
+				value_type *value)                           \
+{                                                                            \
+  struct name##_node *node;                                                  \
+  struct name##_node *x;                                                     \
+  struct name##_node *y;                                                     \
+  int cmp;                                                                   \
+                                                                             \
+  node = map->root.left;                                                     \
+  while (node != &map->nil) {                                                \
+    if ((cmp = compare_fn(key, node->key)) == 0)                             \
+      break;                                                                 \
+    node = cmp < 0 ? node->left : node->right;                               \
+  }                                                                          \
+  if (node == &map->nil)                                                     \
+    return 0;                                                                \
+  if (value != NULL)                                                         \
+    *value = node->value;                                                    \
+                                                                             \
+  /* y is the node unlinked from the tree, node's successor if it has two    \
+     children, and x the child taking its place */                           \
+  if (node->left == &map->nil || node->right == &map->nil) {                 \
+    y = node;                                                                \
+  } else {                                                                   \
+    for (y = node->right; y->left != &map->nil; y = y->left)                 \
+      ;                                                                      \
+  }                                                                          \
+  x = y->left == &map->nil ? y->right : y->left;                             \
+  x->parent = y->parent;                                                     \
+  if (y == y->parent->left)                                                  \
+    y->parent->left = x;                                                     \
+  else                                                                       \
+    y->parent->right = x;                                                    \
+  if (y->color == BLACK)                                                     \
+    name##_repair(map, x);                                                   \
+  if (y != node) {                                                           \
+    y->left = node->left;                                                    \
+    y->right = node->right;                                                  \
+    y->parent = node->parent;                                                \
+    y->color = node->color;                                                  \
+    node->left->parent = node->right->parent = y;                            \
+    if (node == node->parent->left)                                          \
+      node->parent->left = y;                                                \
+    else                                                                     \
+      node->parent->right = y;                                               \
+  }                                                                          \
+  np_pool_release(map->pool, node);                                          \
+  map->size--;                                                               \
+  return 1;                                                                  \
+}                                                                            \
+                                                                             \
+/* redeclared so that uses of the macro end with a semicolon */              \
+static inline void name##_free(struct name *map)
+
+#endif
@@ -0,0 +1,76 @@
+/*
+ * np_alloc_test.c: nplib large array allocation tests
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <CUnit/Basic.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "np_alloc_test.h"
+#include "np_alloc.h"
+
+static void np_alloc_test_policy(const struct NpAllocPolicy *policy)
+{
+  unsigned char *array;
+  size_t size;
+  size_t i;
+
+  /* small, large and resized arrays keep their contents */
+  CU_ASSERT_NOT_EQUAL(NULL, array = np_alloc(policy, 100));
+  memset(array, 1, 100);
+  np_alloc_free(policy, array, 100);
+  size = 3 * NP_ALLOC_HUGE_PAGE_SIZE + 100;
+  CU_ASSERT_NOT_EQUAL(NULL, array = np_alloc(policy, size));
+  if (policy != NULL && policy->huge_pages != NP_ALLOC_HUGE_NONE)
+    CU_ASSERT_EQUAL(0, (uintptr_t)array % NP_ALLOC_HUGE_PAGE_SIZE);
+  for (i = 0; i < size; ++i)
+    array[i] = (unsigned char)i;
+  CU_ASSERT_NOT_EQUAL(NULL, array = np_alloc_realloc(policy, array, size,
+						     size * 2));
+  for (i = 0; i < size; ++i)
+    if (array[i] != (unsigned char)i)
+      break;
+  CU_ASSERT_EQUAL(size, i);
+  CU_ASSERT_NOT_EQUAL(NULL, array = np_alloc_realloc(policy, array,
+						     size * 2, 100));
+  CU_ASSERT_EQUAL(99, array[99]);
+  np_alloc_free(policy, array, 100);
+  np_alloc_free(policy, NULL, 100);
+}
+
+void np_alloc_test(void)
+{
+  struct NpAllocPolicy policy;
+
+  np_alloc_test_policy(NULL);
+  memset(&policy, 0, sizeof policy);
+  np_alloc_test_policy(&policy);
+
+  /* huge pages and placement fall back if the system cannot provide them */
+  policy.min_size = 4096;
+  policy.huge_pages = NP_ALLOC_HUGE_TRANSPARENT;
+  np_alloc_test_policy(&policy);
+  policy.huge_pages = NP_ALLOC_HUGE_RESERVED;
+  np_alloc_test_policy(&policy);
+  policy.huge_pages = NP_ALLOC_HUGE_NONE;
+  policy.numa = NP_ALLOC_NUMA_INTERLEAVE;
+  policy.nodes = 1;
+  np_alloc_test_policy(&policy);
+  policy.huge_pages = NP_ALLOC_HUGE_TRANSPARENT;
+  policy.numa = NP_ALLOC_NUMA_BIND;
+  np_alloc_test_policy(&policy);
+}
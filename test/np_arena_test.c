@@ -0,0 +1,52 @@
+/*
+ * np_arena_test.c: nplib arena allocator tests
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <CUnit/Basic.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "np_arena_test.h"
+#include "np_arena.h"
+
+void np_arena_test(void)
+{
+  struct NpArena *arena;
+  char *blocks[1000];
+  char *big;
+  char *small;
+  int i;
+
+  CU_ASSERT_NOT_EQUAL(NULL, arena = np_arena_new());
+  for (i = 0; i < 1000; ++i) {
+    CU_ASSERT_NOT_EQUAL(NULL, blocks[i] = np_arena_alloc(arena, 1 + i % 13,
+							 1 << i % 4));
+    CU_ASSERT_EQUAL(0, (uintptr_t)blocks[i] % (1 << i % 4));
+    memset(blocks[i], i & 0xff, 1 + i % 13);
+  }
+  for (i = 0; i < 1000; ++i)
+    CU_ASSERT_EQUAL((char)(i & 0xff), blocks[i][i % 13]);
+
+  /* oversized blocks do not end the current chunk */
+  CU_ASSERT_NOT_EQUAL(NULL, small = np_arena_alloc(arena, 1, 1));
+  CU_ASSERT_NOT_EQUAL(NULL, big = np_arena_alloc(arena, 3 * NP_ARENA_CHUNK_SIZE,
+						 8));
+  memset(big, 0, 3 * NP_ARENA_CHUNK_SIZE);
+  CU_ASSERT_EQUAL(small + 1, np_arena_alloc(arena, 1, 1));
+  CU_ASSERT(arena->used >= 3 * NP_ARENA_CHUNK_SIZE + 2);
+  np_arena_free(arena);
+}
@@ -231,3 +231,24 @@ void np_arraylist_test_realloc(void)
   CU_ASSERT_EQUAL(NP_ARRAYLIST_DEFAULT_ALLOC_SIZE + 1, list->size);
 }
 
+
+void np_arraylist_test_alloc(void)
+{
+  struct NpArrayList *list;
+  struct NpAllocPolicy policy;
+  static char items[100000];
+  int i;
+
+  memset(&policy, 0, sizeof policy);
+  policy.huge_pages = NP_ALLOC_HUGE_TRANSPARENT;
+  policy.min_size = 4096;
+  CU_ASSERT_NOT_EQUAL(NULL, list = np_arraylist_new());
+  CU_ASSERT_EQUAL(list, np_arraylist_set_alloc_policy(list, &policy));
+  for (i = 0; i < 100000; ++i)
+    CU_ASSERT_EQUAL(&items[i], np_arraylist_add(list, &items[i], i));
+  for (i = 0; i < 100000; ++i)
+    if (np_arraylist_get(list, i) != &items[i])
+      break;
+  CU_ASSERT_EQUAL(100000, i);
+  np_arraylist_free(list);
+}
@@ -25,5 +25,6 @@ void np_arraylist_test_remove(void);
 void np_arraylist_test_get(void);
 void np_arraylist_test_iterator(void);
 void np_arraylist_test_realloc(void);
+void np_arraylist_test_alloc(void);
 
 #endif
@@ -0,0 +1,81 @@
+/*
+ * np_bloom_test.c: nplib blocked Bloom filter tests
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <CUnit/Basic.h>
+#include <stdint.h>
+
+#include "np_bloom_test.h"
+#include "np_bloom.h"
+
+void np_bloom_test(void)
+{
+  struct NpBloom *bloom;
+  unsigned i;
+  unsigned passed;
+
+  CU_ASSERT_NOT_EQUAL(NULL, bloom = np_bloom_new(10000));
+  CU_ASSERT_EQUAL(0, (uintptr_t)bloom->blocks % 64);
+  for (i = 0; i < 10000; ++i)
+    np_bloom_add(bloom, i * 2654435761u);
+
+  /* no false negatives */
+  for (i = 0; i < 10000; ++i)
+    CU_ASSERT(np_bloom_contains(bloom, i * 2654435761u));
+  CU_ASSERT_EQUAL(0, bloom->rejected);
+
+  /* few false positives at capacity */
+  for (i = 10000, passed = 0; i < 110000; ++i)
+    passed += np_bloom_contains(bloom, i * 2654435761u) != 0;
+  bloom->false_positives = passed;
+  CU_ASSERT_EQUAL(100000 - passed, bloom->rejected);
+  CU_ASSERT(np_bloom_false_positive_rate(bloom) < 0.02);
+  CU_ASSERT_EQUAL(110000, bloom->lookups);
+
+  /* reset clears the bits but keeps the statistics */
+  CU_ASSERT_EQUAL(bloom, np_bloom_reset(bloom, 100));
+  CU_ASSERT_EQUAL(0, bloom->items);
+  CU_ASSERT_EQUAL(0, np_bloom_contains(bloom, 0));
+  CU_ASSERT_EQUAL(110001, bloom->lookups);
+  np_bloom_free(bloom);
+}
+
+void np_bloom_test_stale(void)
+{
+  struct NpBloom *bloom;
+  unsigned i;
+
+  CU_ASSERT_NOT_EQUAL(NULL, bloom = np_bloom_new(0));
+  CU_ASSERT_EQUAL(NP_BLOOM_MIN_CAPACITY, bloom->capacity);
+  for (i = 0; i < NP_BLOOM_MIN_CAPACITY; ++i)
+    np_bloom_add(bloom, i);
+  CU_ASSERT_FALSE(np_bloom_stale(bloom));
+
+  /* overfull */
+  np_bloom_add(bloom, i);
+  CU_ASSERT_TRUE(np_bloom_stale(bloom));
+  CU_ASSERT_EQUAL(bloom, np_bloom_reset(bloom, 2 * NP_BLOOM_MIN_CAPACITY));
+  CU_ASSERT_FALSE(np_bloom_stale(bloom));
+
+  /* mostly removed */
+  for (i = 0; i < NP_BLOOM_MIN_CAPACITY; ++i)
+    np_bloom_add(bloom, i);
+  for (i = 0; i <= NP_BLOOM_MIN_CAPACITY / 2; ++i)
+    np_bloom_remove(bloom);
+  CU_ASSERT_TRUE(np_bloom_stale(bloom));
+  np_bloom_free(bloom);
+}
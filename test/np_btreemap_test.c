@@ -0,0 +1,258 @@
+/*
+ * np_btreemap_test.c: nplib B+tree map tests
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <CUnit/Basic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "np_btreemap_test.h"
+#include "np_btreemap.h"
+
+#define NP_BTREEMAP_TEST_KEYS 100000
+
+static int np_btreemap_test_cmp(void *key1, void *key2)
+{
+  uintptr_t k1 = (uintptr_t)key1;
+  uintptr_t k2 = (uintptr_t)key2;
+
+  return k1 < k2 ? -1 : k1 > k2;
+}
+
+static int np_btreemap_test_int_cmp(void *key1, void *key2)
+{
+  int k1 = *(int *)key1;
+  int k2 = *(int *)key2;
+
+  return k1 < k2 ? -1 : k1 > k2;
+}
+
+/*
+ * Checks that every separator of a subtree is the very key stored first in
+ * the leftmost leaf to its right, so that no separator outlives its key.
+ */
+static int np_btreemap_test_separators(struct NpBTreeMapNode *node)
+{
+  struct NpBTreeMapInner *inner;
+  struct NpBTreeMapNode *child;
+  unsigned i;
+
+  if (node->leaf)
+    return 1;
+  inner = (struct NpBTreeMapInner *)node;
+  for (i = 0; i <= node->count; ++i) {
+    if (i > 0) {
+      for (child = inner->children[i]; !child->leaf;)
+	child = ((struct NpBTreeMapInner *)child)->children[0];
+      if (inner->keys[i - 1] != ((struct NpBTreeMapLeaf *)child)->keys[0])
+	return 0;
+    }
+    if (!np_btreemap_test_separators(inner->children[i]))
+      return 0;
+  }
+  return 1;
+}
+
+/*
+ * Checks the B+tree properties of a subtree whose keys lie in [low, high),
+ * returning its height or -1 if they do not hold. low and high of 0 stand
+ * for no bound.
+ */
+static int np_btreemap_test_check(struct NpBTreeMapNode *node, int root,
+				  uintptr_t low, uintptr_t high)
+{
+  struct NpBTreeMapInner *inner;
+  struct NpBTreeMapLeaf *leaf;
+  uintptr_t key;
+  unsigned i;
+  int height;
+  int h;
+
+  if (node->leaf) {
+    leaf = (struct NpBTreeMapLeaf *)node;
+    if (!root && node->count < NP_BTREEMAP_LEAF_KEYS / 2)
+      return -1;
+    for (i = 0; i < node->count; ++i) {
+      key = (uintptr_t)leaf->keys[i];
+      if ((low != 0 && key < low) || (high != 0 && key >= high)
+	  || (i > 0 && key <= (uintptr_t)leaf->keys[i - 1]))
+	return -1;
+    }
+    return 1;
+  }
+  inner = (struct NpBTreeMapInner *)node;
+  if (node->count < (root ? 1 : NP_BTREEMAP_INNER_KEYS / 2))
+    return -1;
+  height = -1;
+  for (i = 0; i <= node->count; ++i) {
+    h = np_btreemap_test_check(
+      inner->children[i], 0, i > 0 ? (uintptr_t)inner->keys[i - 1] : low,
+      i < node->count ? (uintptr_t)inner->keys[i] : high);
+    if (h < 0 || (height >= 0 && h != height))
+      return -1;
+    height = h;
+  }
+  return height + 1;
+}
+
+void np_btreemap_test(void)
+{
+  struct NpBTreeMap *map;
+  uintptr_t i;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_btreemap_new(np_btreemap_test_cmp));
+  CU_ASSERT_EQUAL(0, (uintptr_t)map->root % NP_BTREEMAP_NODE_ALIGN);
+  CU_ASSERT_EQUAL(NULL, np_btreemap_get(map, (void *)1));
+  CU_ASSERT_EQUAL(NULL, np_btreemap_remove(map, (void *)1));
+
+  /* sequential puts split leaves and inner nodes */
+  for (i = 1; i <= 10000; ++i)
+    CU_ASSERT_EQUAL((void *)(i * 2), np_btreemap_put(map, (void *)i,
+						     (void *)(i * 2)));
+  CU_ASSERT_EQUAL(10000, map->size);
+  CU_ASSERT(np_btreemap_test_check(map->root, 1, 0, 0) >= 3);
+  for (i = 1; i <= 10000; ++i)
+    if (np_btreemap_get(map, (void *)i) != (void *)(i * 2))
+      break;
+  CU_ASSERT_EQUAL(10001, i);
+  CU_ASSERT_EQUAL(NULL, np_btreemap_get(map, (void *)10001));
+
+  /* replacing a value keeps the size */
+  CU_ASSERT_EQUAL((void *)7, np_btreemap_put(map, (void *)5, (void *)7));
+  CU_ASSERT_EQUAL((void *)7, np_btreemap_get(map, (void *)5));
+  CU_ASSERT_EQUAL(10000, map->size);
+
+  /* removing every key merges the tree back into a single leaf */
+  for (i = 1; i <= 10000; ++i)
+    if (np_btreemap_remove(map, (void *)i) != (void *)(i == 5 ? 7 : i * 2))
+      break;
+  CU_ASSERT_EQUAL(10001, i);
+  CU_ASSERT_EQUAL(0, map->size);
+  CU_ASSERT(map->root->leaf);
+  np_btreemap_free(map);
+}
+
+void np_btreemap_test_random(void)
+{
+  struct NpBTreeMap *map;
+  struct NpBTreeMapStats stats;
+  uintptr_t *keys;
+  uintptr_t t;
+  unsigned i;
+  unsigned j;
+
+  CU_ASSERT_NOT_EQUAL(NULL, keys = malloc(sizeof *keys
+					  * NP_BTREEMAP_TEST_KEYS));
+  for (i = 0; i < NP_BTREEMAP_TEST_KEYS; ++i)
+    keys[i] = i + 1;
+  srand(42);
+  for (i = NP_BTREEMAP_TEST_KEYS - 1; i > 0; --i) {
+    j = rand() % (i + 1);
+    t = keys[i];
+    keys[i] = keys[j];
+    keys[j] = t;
+  }
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_btreemap_new(np_btreemap_test_cmp));
+  for (i = 0; i < NP_BTREEMAP_TEST_KEYS; ++i)
+    np_btreemap_put(map, (void *)keys[i], (void *)keys[i]);
+  CU_ASSERT(np_btreemap_test_check(map->root, 1, 0, 0) > 0);
+  np_btreemap_stats(map, &stats);
+  CU_ASSERT_EQUAL(NP_BTREEMAP_TEST_KEYS, stats.size);
+  CU_ASSERT(stats.height >= 3 && stats.height <= 5);
+  CU_ASSERT(stats.fill > 0.5 && stats.fill <= 1.0);
+  CU_ASSERT(stats.bytes < NP_BTREEMAP_TEST_KEYS * 48);
+
+  /* remove the odd keys in random order */
+  for (i = 0; i < NP_BTREEMAP_TEST_KEYS; ++i)
+    if (keys[i] % 2 == 1 && np_btreemap_remove(map, (void *)keys[i])
+	!= (void *)keys[i])
+      break;
+  CU_ASSERT_EQUAL(NP_BTREEMAP_TEST_KEYS, i);
+  CU_ASSERT_EQUAL(NP_BTREEMAP_TEST_KEYS / 2, map->size);
+  CU_ASSERT(np_btreemap_test_check(map->root, 1, 0, 0) > 0);
+  CU_ASSERT(np_btreemap_test_separators(map->root));
+  for (i = 1; i <= NP_BTREEMAP_TEST_KEYS; ++i)
+    if (np_btreemap_get(map, (void *)(uintptr_t)i)
+	!= (i % 2 == 0 ? (void *)(uintptr_t)i : NULL))
+      break;
+  CU_ASSERT_EQUAL(NP_BTREEMAP_TEST_KEYS + 1, i);
+  np_btreemap_free(map);
+  free(keys);
+}
+
+void np_btreemap_test_free_keys(void)
+{
+  struct NpBTreeMap *map;
+  int *keys[2000];
+  int key;
+  unsigned i;
+
+  /* removed keys are freed at once, as they may be with np_treemap */
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_btreemap_new(np_btreemap_test_int_cmp));
+  for (i = 0; i < 2000; ++i) {
+    keys[i] = malloc(sizeof *keys[i]);
+    *keys[i] = i;
+    CU_ASSERT_EQUAL(keys[i], np_btreemap_put(map, keys[i], keys[i]));
+  }
+  for (i = 0; i < 2000; i += 7) {
+    CU_ASSERT_EQUAL(keys[i], np_btreemap_remove(map, keys[i]));
+    free(keys[i]);
+    keys[i] = NULL;
+  }
+  CU_ASSERT(np_btreemap_test_separators(map->root));
+  for (key = 0; key < 2000; ++key)
+    CU_ASSERT_EQUAL(keys[key], np_btreemap_get(map, &key));
+  for (i = 0; i < 2000; ++i) {
+    if (keys[i] != NULL) {
+      CU_ASSERT_EQUAL(keys[i], np_btreemap_remove(map, keys[i]));
+      free(keys[i]);
+    }
+  }
+  CU_ASSERT_EQUAL(0, map->size);
+  np_btreemap_free(map);
+}
+
+void np_btreemap_test_iterator(void)
+{
+  struct NpBTreeMap *map;
+  struct NpBTreeMapIterator *iter;
+  uintptr_t i;
+  uintptr_t key;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_btreemap_new(np_btreemap_test_cmp));
+  CU_ASSERT_NOT_EQUAL(NULL, iter = np_btreemap_iterator(map));
+  CU_ASSERT_EQUAL(NULL, np_btreemap_iterator_peek_next_key(iter));
+  CU_ASSERT_EQUAL(NULL, np_btreemap_iterator_next_key(iter));
+  np_btreemap_iterator_free(iter);
+
+  /* keys put in reverse come back in key order across leaves */
+  for (i = 1000; i > 0; --i)
+    np_btreemap_put(map, (void *)i, (void *)(i + 1));
+  CU_ASSERT_NOT_EQUAL(NULL, iter = np_btreemap_iterator(map));
+  for (i = 1; i <= 1000; ++i) {
+    CU_ASSERT_EQUAL((void *)(i + 1),
+		    np_btreemap_iterator_peek_next_value(iter));
+    CU_ASSERT_EQUAL((void *)i, np_btreemap_iterator_peek_next_key(iter));
+    if ((key = (uintptr_t)np_btreemap_iterator_next_key(iter)) != i)
+      break;
+  }
+  CU_ASSERT_EQUAL(1001, i);
+  CU_ASSERT_EQUAL(NULL, np_btreemap_iterator_next_key(iter));
+  np_btreemap_iterator_free(iter);
+  np_btreemap_free(map);
+}
@@ -0,0 +1,27 @@
+/*
+ * np_btreemap_test.h: nplib B+tree map test header file
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NP_BTREEMAP_TEST_H
+#define __NP_BTREEMAP_TEST_H
+
+void np_btreemap_test(void);
+void np_btreemap_test_random(void);
+void np_btreemap_test_free_keys(void);
+void np_btreemap_test_iterator(void);
+
+#endif
@@ -0,0 +1,227 @@
+/*
+ * np_concurrent_cache_test.c: nplib sharded concurrent cache tests
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <CUnit/Basic.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "np_concurrent_cache_test.h"
+#include "np_concurrent_cache.h"
+#include "np_hashmap_test.h"
+
+#define THREADS 4
+#define KEYS_PER_THREAD 2000
+
+static char keys[THREADS][KEYS_PER_THREAD][16];
+
+void np_concurrent_cache_test(void)
+{
+  struct NpConcurrentCache *cache;
+  struct NpConcurrentCacheStats stats;
+  char *key = "thekey";
+  char *value = "thevalue";
+  char *value2 = "thevalue2";
+  unsigned i;
+  unsigned size;
+
+  CU_ASSERT_NOT_EQUAL(NULL, cache = np_concurrent_cache_new(
+			np_hashmap_test_cmp, np_hashmap_test_hash, 1000, 0));
+  CU_ASSERT_EQUAL(NP_CONCURRENT_CACHE_DEFAULT_SHARDS, cache->shard_count);
+  CU_ASSERT_EQUAL(value, np_concurrent_cache_put(cache, key, value));
+  CU_ASSERT_EQUAL(value, np_concurrent_cache_get(cache, key));
+  CU_ASSERT_EQUAL(value2, np_concurrent_cache_put(cache, key, value2));
+  CU_ASSERT_EQUAL(value2, np_concurrent_cache_remove(cache, key));
+  CU_ASSERT_EQUAL(NULL, np_concurrent_cache_get(cache, key));
+  np_concurrent_cache_stats(cache, &stats);
+  CU_ASSERT_EQUAL(0, stats.size);
+  CU_ASSERT_EQUAL(1, stats.hits);
+  CU_ASSERT_EQUAL(1, stats.misses);
+
+  /* each shard holds at most its share of the capacity */
+  for (i = 0; i < KEYS_PER_THREAD; ++i) {
+    snprintf(keys[0][i], sizeof keys[0][i], "key %u", i);
+    CU_ASSERT_EQUAL(keys[0][i], np_concurrent_cache_put(cache, keys[0][i],
+							keys[0][i]));
+  }
+  for (i = 0, size = 0; i < cache->shard_count; ++i) {
+    np_concurrent_cache_shard_stats(cache, i, &stats);
+    CU_ASSERT(stats.size <= (1000 + cache->shard_count - 1)
+	      / cache->shard_count);
+    size += stats.size;
+  }
+  np_concurrent_cache_stats(cache, &stats);
+  CU_ASSERT_EQUAL(size, stats.size);
+  CU_ASSERT_EQUAL(KEYS_PER_THREAD - size, stats.evictions);
+  CU_ASSERT_EQUAL(0, stats.rejected);
+  np_concurrent_cache_free(cache);
+}
+
+static unsigned np_concurrent_cache_test_int_hash(void *key)
+{
+  return (unsigned)(uintptr_t)key;
+}
+
+static int np_concurrent_cache_test_int_cmp(void *key1, void *key2)
+{
+  return key1 != key2;
+}
+
+void np_concurrent_cache_shards_test(void)
+{
+  struct NpConcurrentCache *cache;
+  struct NpConcurrentCacheStats stats;
+  uintptr_t i;
+
+  /* the shard capacities add up to the capacity */
+  CU_ASSERT_NOT_EQUAL(NULL, cache = np_concurrent_cache_new(
+			np_concurrent_cache_test_int_cmp,
+			np_concurrent_cache_test_int_hash, 100, 0));
+  for (i = 1; i <= 10000; ++i)
+    np_concurrent_cache_put(cache, (void *)i, (void *)i);
+  np_concurrent_cache_stats(cache, &stats);
+  CU_ASSERT_EQUAL(100, stats.size);
+  np_concurrent_cache_free(cache);
+  CU_ASSERT_NOT_EQUAL(NULL, cache = np_concurrent_cache_new(
+			np_concurrent_cache_test_int_cmp,
+			np_concurrent_cache_test_int_hash, 1, 0));
+  CU_ASSERT_EQUAL(1, cache->shard_count);
+  CU_ASSERT_EQUAL((void *)1, np_concurrent_cache_put(cache, (void *)1,
+						       (void *)1));
+  np_concurrent_cache_free(cache);
+
+  /* small integers with an identity hash spread over all shards */
+  CU_ASSERT_NOT_EQUAL(NULL, cache = np_concurrent_cache_new(
+			np_concurrent_cache_test_int_cmp,
+			np_concurrent_cache_test_int_hash, 6400, 0));
+  for (i = 1; i <= 1000; ++i)
+    np_concurrent_cache_put(cache, (void *)i, (void *)i);
+  np_concurrent_cache_stats(cache, &stats);
+  CU_ASSERT_EQUAL(1000, stats.size);
+  for (i = 0; i < cache->shard_count; ++i) {
+    np_concurrent_cache_shard_stats(cache, i, &stats);
+    CU_ASSERT(stats.size > 0 && stats.size < 50);
+  }
+  np_concurrent_cache_free(cache);
+}
+
+void np_concurrent_cache_tinylfu_test(void)
+{
+  struct NpConcurrentCache *cache;
+  struct NpConcurrentCacheStats stats;
+  unsigned i;
+  unsigned j;
+
+  for (i = 0; i < KEYS_PER_THREAD; ++i)
+    snprintf(keys[0][i], sizeof keys[0][i], "key %u", i);
+  CU_ASSERT_NOT_EQUAL(NULL, cache = np_concurrent_cache_new(
+			np_hashmap_test_cmp, np_hashmap_test_hash, 100, 1));
+  np_concurrent_cache_set_admission(cache,
+				    NP_CONCURRENT_CACHE_ADMIT_TINYLFU);
+
+  /* fill the cache with hot keys and cold keys */
+  for (i = 0; i < 100; ++i)
+    CU_ASSERT_EQUAL(keys[0][i], np_concurrent_cache_put(cache, keys[0][i],
+							keys[0][i]));
+  for (j = 0; j < 4; ++j)
+    for (i = 0; i < 50; ++i)
+      np_concurrent_cache_get(cache, keys[0][i]);
+
+  /* a scan of keys seen once does not flush the hot keys */
+  for (i = 100; i < 1100; ++i) {
+    np_concurrent_cache_put(cache, keys[0][i], keys[0][i]);
+    if (i % 4 == 0)
+      np_concurrent_cache_get(cache, keys[0][i / 4 % 50]);
+  }
+  for (i = 0; i < 50; ++i)
+    CU_ASSERT_EQUAL(keys[0][i], np_concurrent_cache_get(cache, keys[0][i]));
+  np_concurrent_cache_stats(cache, &stats);
+  CU_ASSERT_EQUAL(100, stats.size);
+  CU_ASSERT(stats.rejected > 900);
+  CU_ASSERT_EQUAL(1000, stats.rejected + stats.evictions);
+
+  /* a key accessed often enough is admitted */
+  np_concurrent_cache_get(cache, keys[0][1500]);
+  np_concurrent_cache_get(cache, keys[0][1500]);
+  np_concurrent_cache_get(cache, keys[0][1500]);
+  CU_ASSERT_EQUAL(keys[0][1500], np_concurrent_cache_put(cache, keys[0][1500],
+							 keys[0][1500]));
+  np_concurrent_cache_free(cache);
+}
+
+struct np_concurrent_cache_test_arg {
+  struct NpConcurrentCache *cache;
+  int thread;
+  int failures;
+};
+
+static void *np_concurrent_cache_test_worker(void *data)
+{
+  struct np_concurrent_cache_test_arg *arg;
+  char *key;
+  void *value;
+  int i;
+
+  arg = data;
+  for (i = 0; i < KEYS_PER_THREAD; ++i) {
+    key = keys[arg->thread][i];
+    if (np_concurrent_cache_put(arg->cache, key, key) != key)
+      arg->failures++;
+
+    /* entries may be evicted by other threads but never hold another key */
+    value = np_concurrent_cache_get(arg->cache, keys[arg->thread][i / 2]);
+    if (value != NULL && value != keys[arg->thread][i / 2])
+      arg->failures++;
+    np_concurrent_cache_get(arg->cache, keys[(arg->thread + 1) % THREADS][i]);
+  }
+  return NULL;
+}
+
+void np_concurrent_cache_threads_test(void)
+{
+  struct NpConcurrentCache *cache;
+  struct NpConcurrentCacheStats stats;
+  struct np_concurrent_cache_test_arg args[THREADS];
+  pthread_t threads[THREADS];
+  int t;
+  int i;
+
+  for (t = 0; t < THREADS; ++t)
+    for (i = 0; i < KEYS_PER_THREAD; ++i)
+      snprintf(keys[t][i], sizeof keys[t][i], "key %d %d", t, i);
+  CU_ASSERT_NOT_EQUAL(NULL, cache = np_concurrent_cache_new(
+			np_hashmap_test_cmp, np_hashmap_test_hash, 4000, 8));
+  for (t = 0; t < THREADS; ++t) {
+    args[t].cache = cache;
+    args[t].thread = t;
+    args[t].failures = 0;
+    pthread_create(&threads[t], NULL, np_concurrent_cache_test_worker,
+		   &args[t]);
+  }
+  for (t = 0; t < THREADS; ++t) {
+    pthread_join(threads[t], NULL);
+    CU_ASSERT_EQUAL(0, args[t].failures);
+  }
+  np_concurrent_cache_stats(cache, &stats);
+  CU_ASSERT(stats.size <= 4000);
+  CU_ASSERT_EQUAL(THREADS * KEYS_PER_THREAD, stats.size + stats.evictions);
+  CU_ASSERT_EQUAL(2 * THREADS * KEYS_PER_THREAD, stats.hits + stats.misses);
+  np_concurrent_cache_free(cache);
+}
@@ -0,0 +1,117 @@
+/*
+ * np_concurrent_hashmap_test.c: nplib concurrent hash map tests
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <CUnit/Basic.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include "np_concurrent_hashmap_test.h"
+#include "np_concurrent_hashmap.h"
+#include "np_hashmap_test.h"
+
+#define THREADS 4
+#define KEYS_PER_THREAD 2000
+
+static char keys[THREADS][KEYS_PER_THREAD][16];
+
+void np_concurrent_hashmap_test(void)
+{
+  struct NpConcurrentHashMap *map;
+  char *key = "thekey";
+  char *value = "thevalue";
+  char *value2 = "thevalue2";
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_concurrent_hashmap_new(
+			np_hashmap_test_cmp, np_hashmap_test_hash, 0));
+  CU_ASSERT_EQUAL(NP_CONCURRENT_HASHMAP_DEFAULT_STRIPES, map->stripe_count);
+  CU_ASSERT_EQUAL(0, np_concurrent_hashmap_size(map));
+  CU_ASSERT_EQUAL(value, np_concurrent_hashmap_put(map, key, value));
+  CU_ASSERT_EQUAL(value, np_concurrent_hashmap_get(map, key));
+  CU_ASSERT_EQUAL(value2, np_concurrent_hashmap_put(map, key, value2));
+  CU_ASSERT_EQUAL(1, np_concurrent_hashmap_size(map));
+  CU_ASSERT_EQUAL(value2, np_concurrent_hashmap_remove(map, key));
+  CU_ASSERT_EQUAL(NULL, np_concurrent_hashmap_get(map, key));
+  CU_ASSERT_EQUAL(0, np_concurrent_hashmap_size(map));
+  np_concurrent_hashmap_free(map);
+}
+
+struct np_concurrent_hashmap_test_arg {
+  struct NpConcurrentHashMap *map;
+  int thread;
+  int failures;
+};
+
+static void *np_concurrent_hashmap_test_worker(void *data)
+{
+  struct np_concurrent_hashmap_test_arg *arg;
+  char *key;
+  int i;
+
+  arg = data;
+  for (i = 0; i < KEYS_PER_THREAD; ++i) {
+    key = keys[arg->thread][i];
+    if (np_concurrent_hashmap_put(arg->map, key, key) != key)
+      arg->failures++;
+    if (np_concurrent_hashmap_get(arg->map, key) != key)
+      arg->failures++;
+
+    /* read keys owned by other threads while they are being written */
+    np_concurrent_hashmap_get(arg->map, keys[(arg->thread + 1) % THREADS][i]);
+  }
+  for (i = 0; i < KEYS_PER_THREAD; i += 2) {
+    key = keys[arg->thread][i];
+    if (np_concurrent_hashmap_remove(arg->map, key) != key)
+      arg->failures++;
+  }
+  return NULL;
+}
+
+void np_concurrent_hashmap_threads_test(void)
+{
+  struct NpConcurrentHashMap *map;
+  struct np_concurrent_hashmap_test_arg args[THREADS];
+  pthread_t threads[THREADS];
+  int t;
+  int i;
+
+  for (t = 0; t < THREADS; ++t)
+    for (i = 0; i < KEYS_PER_THREAD; ++i)
+      snprintf(keys[t][i], sizeof keys[t][i], "key %d %d", t, i);
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_concurrent_hashmap_new(
+			np_hashmap_test_cmp, np_hashmap_test_hash, 8));
+  for (t = 0; t < THREADS; ++t) {
+    args[t].map = map;
+    args[t].thread = t;
+    args[t].failures = 0;
+    pthread_create(&threads[t], NULL, np_concurrent_hashmap_test_worker,
+		   &args[t]);
+  }
+  for (t = 0; t < THREADS; ++t) {
+    pthread_join(threads[t], NULL);
+    CU_ASSERT_EQUAL(0, args[t].failures);
+  }
+  CU_ASSERT_EQUAL(THREADS * KEYS_PER_THREAD / 2,
+		  np_concurrent_hashmap_size(map));
+  for (t = 0; t < THREADS; ++t)
+    for (i = 0; i < KEYS_PER_THREAD; ++i)
+      CU_ASSERT_EQUAL(i % 2 ? keys[t][i] : NULL,
+		      np_concurrent_hashmap_get(map, keys[t][i]));
+  np_concurrent_hashmap_free(map);
+}
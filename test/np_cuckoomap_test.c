@@ -0,0 +1,138 @@
+/*
+ * np_cuckoomap_test.c: nplib cuckoo hash map tests
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <CUnit/Basic.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "np_cuckoomap_test.h"
+#include "np_cuckoomap.h"
+#include "np_hashmap.h"
+
+/*
+ * Hashes keys onto only four distinct values.
+ */
+static unsigned np_cuckoomap_test_bad_hash(void *key)
+{
+  return np_hashmap_hash(key, strlen(key)) % 4;
+}
+
+void np_cuckoomap_test(void)
+{
+  struct NpCuckooMap *map;
+  char *key = "thekey";
+  char *value = "thevalue";
+  char *value2 = "thevalue2";
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_cuckoomap_new(np_cuckoomap_test_cmp,
+						   np_cuckoomap_test_hash));
+  CU_ASSERT_EQUAL(0, map->size);
+  CU_ASSERT_STRING_EQUAL(value, np_cuckoomap_put(map, key, value));
+  CU_ASSERT_EQUAL(1, map->size);
+  CU_ASSERT_STRING_EQUAL(value, np_cuckoomap_get(map, key));
+  CU_ASSERT_EQUAL(1, map->size);
+  CU_ASSERT_STRING_EQUAL(value2, np_cuckoomap_put(map, key, value2));
+  CU_ASSERT_EQUAL(1, map->size);
+  CU_ASSERT_STRING_EQUAL(value2, np_cuckoomap_remove(map, key));
+  CU_ASSERT_EQUAL(0, map->size);
+  CU_ASSERT_EQUAL(NULL, np_cuckoomap_get(map, key));
+  CU_ASSERT_EQUAL(NULL, np_cuckoomap_remove(map, key));
+  np_cuckoomap_free(map);
+}
+
+void np_cuckoomap_realloc_test(void)
+{
+  struct NpCuckooMap *map;
+  char **keys;
+  unsigned i;
+  unsigned size;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_cuckoomap_new(np_cuckoomap_test_cmp,
+						   np_cuckoomap_test_hash));
+  size = 20000;
+  keys = malloc(sizeof *keys * size);
+  for (i = 0; i < size; ++i) {
+    keys[i] = malloc(BUFSIZ);
+    snprintf(keys[i], BUFSIZ, "key %d", i);
+    CU_ASSERT_EQUAL(keys[i], np_cuckoomap_put(map, keys[i], keys[i]));
+  }
+  CU_ASSERT_EQUAL(size, map->size);
+  CU_ASSERT_EQUAL(0, (size_t)map->buckets % 64);
+  if (sizeof(void *) == 8)
+    CU_ASSERT_EQUAL(64, sizeof *map->buckets);
+
+  /* evictions fill the map close to its load factor before it grows */
+  CU_ASSERT(map->size > map->bucket_count * NP_CUCKOOMAP_SLOTS / 2);
+  for (i = 0; i < size; ++i)
+    CU_ASSERT_EQUAL(keys[i], np_cuckoomap_get(map, keys[i]));
+  for (i = 0; i < size; i += 2)
+    CU_ASSERT_EQUAL(keys[i], np_cuckoomap_remove(map, keys[i]));
+  for (i = 0; i < size; ++i) {
+    CU_ASSERT_EQUAL(i % 2 ? keys[i] : NULL, np_cuckoomap_get(map, keys[i]));
+    free(keys[i]);
+  }
+  CU_ASSERT_EQUAL(size / 2, map->size);
+  free(keys);
+  np_cuckoomap_free(map);
+}
+
+void np_cuckoomap_collision_test(void)
+{
+  struct NpCuckooMap *map;
+  char keys[100][16];
+  unsigned i;
+  unsigned count;
+
+  /*
+   * With four distinct hashes at most eight buckets and the
+   * stash can be used, after which puts fail without losing items.
+   */
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_cuckoomap_new(np_cuckoomap_test_cmp,
+						   np_cuckoomap_test_bad_hash));
+  for (i = 0, count = 0; i < 100; ++i) {
+    snprintf(keys[i], sizeof keys[i], "key %d", i);
+    if (np_cuckoomap_put(map, keys[i], keys[i]) != NULL)
+      count++;
+  }
+  CU_ASSERT(count >= 2 * NP_CUCKOOMAP_SLOTS + NP_CUCKOOMAP_STASH_SIZE);
+  CU_ASSERT(count <= 8 * NP_CUCKOOMAP_SLOTS + NP_CUCKOOMAP_STASH_SIZE);
+  CU_ASSERT_EQUAL(count, map->size);
+  CU_ASSERT_EQUAL(NP_CUCKOOMAP_STASH_SIZE, map->stash_size);
+  for (i = 0, count = 0; i < 100; ++i)
+    count += np_cuckoomap_get(map, keys[i]) == keys[i];
+  CU_ASSERT_EQUAL(count, map->size);
+
+  /* stashed items can be removed */
+  for (i = 0; i < 100; ++i)
+    np_cuckoomap_remove(map, keys[i]);
+  CU_ASSERT_EQUAL(0, map->size);
+  CU_ASSERT_EQUAL(0, map->stash_size);
+  np_cuckoomap_free(map);
+}
+
+int np_cuckoomap_test_cmp(void *key1, void *key2)
+{
+  return strcmp(key1, key2);
+}
+
+unsigned np_cuckoomap_test_hash(void *key)
+{
+  int length = strlen(key);
+  return np_hashmap_hash(key, length);
+}
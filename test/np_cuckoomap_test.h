@@ -0,0 +1,28 @@
+/*
+ * np_cuckoomap_test.h: nplib cuckoo hash map test header
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NP_CUCKOOMAP_TEST_H
+#define __NP_CUCKOOMAP_TEST_H
+
+void np_cuckoomap_test(void);
+void np_cuckoomap_realloc_test(void);
+void np_cuckoomap_collision_test(void);
+int np_cuckoomap_test_cmp(void *, void *);
+unsigned np_cuckoomap_test_hash(void *);
+
+#endif
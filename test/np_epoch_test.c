@@ -0,0 +1,66 @@
+/*
+ * np_epoch_test.c: nplib epoch based reclamation tests
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <CUnit/Basic.h>
+
+#include "np_epoch_test.h"
+#include "np_epoch.h"
+
+static void np_epoch_test_reclaim(void *ptr, void *arg)
+{
+  (void)ptr;
+  ++*(int *)arg;
+}
+
+void np_epoch_test(void)
+{
+  struct NpEpoch *epoch;
+  struct NpEpochRecord *reader;
+  int object;
+  int reclaimed;
+
+  reclaimed = 0;
+  CU_ASSERT_NOT_EQUAL(NULL, epoch = np_epoch_new());
+  CU_ASSERT_NOT_EQUAL(NULL, reader = np_epoch_register(epoch));
+
+  /* an active reader holds back reclamation */
+  np_epoch_enter(reader);
+  CU_ASSERT_EQUAL(0, np_epoch_retire(epoch, &object, np_epoch_test_reclaim,
+				     &reclaimed));
+  CU_ASSERT_EQUAL(1, np_epoch_collect(epoch));
+  CU_ASSERT_EQUAL(0, np_epoch_collect(epoch));
+  CU_ASSERT_EQUAL(0, np_epoch_collect(epoch));
+  CU_ASSERT_EQUAL(0, reclaimed);
+  np_epoch_exit(reader);
+
+  /* the object is reclaimed once the epoch is two past its retirement */
+  CU_ASSERT_EQUAL(1, np_epoch_collect(epoch));
+  CU_ASSERT_EQUAL(0, reclaimed);
+  CU_ASSERT_EQUAL(1, np_epoch_collect(epoch));
+  CU_ASSERT_EQUAL(1, reclaimed);
+
+  /* unregistered records are reused */
+  np_epoch_unregister(reader);
+  CU_ASSERT_EQUAL(reader, np_epoch_register(epoch));
+
+  /* remaining objects are reclaimed when the epoch is freed */
+  CU_ASSERT_EQUAL(0, np_epoch_retire(epoch, &object, np_epoch_test_reclaim,
+				     &reclaimed));
+  np_epoch_free(epoch);
+  CU_ASSERT_EQUAL(2, reclaimed);
+}
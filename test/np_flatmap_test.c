@@ -0,0 +1,123 @@
+/*
+ * np_flatmap_test.c: nplib flat hash map tests
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <CUnit/Basic.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "np_flatmap_test.h"
+#include "np_flatmap.h"
+#include "np_hashmap.h"
+
+void np_flatmap_test(void)
+{
+  struct NpFlatMap *map;
+  char *key = "thekey";
+  char *value = "thevalue";
+  char *value2 = "thevalue2";
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_flatmap_new(np_flatmap_test_cmp,
+						 np_flatmap_test_hash));
+  CU_ASSERT_EQUAL(0, map->size);
+  CU_ASSERT_STRING_EQUAL(value, np_flatmap_put(map, key, value));
+  CU_ASSERT_EQUAL(1, map->size);
+  CU_ASSERT_STRING_EQUAL(value, np_flatmap_get(map, key));
+  CU_ASSERT_EQUAL(1, map->size);
+  CU_ASSERT_STRING_EQUAL(value2, np_flatmap_put(map, key, value2));
+  CU_ASSERT_EQUAL(1, map->size);
+  CU_ASSERT_STRING_EQUAL(value2, np_flatmap_remove(map, key));
+  CU_ASSERT_EQUAL(0, map->size);
+  CU_ASSERT_EQUAL(NULL, np_flatmap_get(map, key));
+  CU_ASSERT_EQUAL(NULL, np_flatmap_remove(map, key));
+  np_flatmap_free(map);
+}
+
+void np_flatmap_realloc_test(void)
+{
+  struct NpFlatMap *map;
+  char **keys;
+  unsigned i;
+  unsigned size;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_flatmap_new(np_flatmap_test_cmp,
+						 np_flatmap_test_hash));
+  size = map->threshold * 8 + 1;
+  keys = malloc(sizeof *keys * size);
+  for (i = 0; i < size; ++i) {
+    keys[i] = malloc(BUFSIZ);
+    snprintf(keys[i], BUFSIZ, "key %d", i);
+    CU_ASSERT_EQUAL(keys[i], np_flatmap_put(map, keys[i], keys[i]));
+  }
+  CU_ASSERT_EQUAL(size, map->size);
+  CU_ASSERT_EQUAL(NP_FLATMAP_INITIAL_CAPACITY * 16, map->capacity);
+  for (i = 0; i < size; ++i)
+    CU_ASSERT_EQUAL(keys[i], np_flatmap_get(map, keys[i]));
+  for (i = 0; i < size; ++i) {
+    CU_ASSERT_EQUAL(keys[i], np_flatmap_remove(map, keys[i]));
+    free(keys[i]);
+  }
+  CU_ASSERT_EQUAL(0, map->size);
+  free(keys);
+  np_flatmap_free(map);
+}
+
+void np_flatmap_remove_test(void)
+{
+  struct NpFlatMap *map;
+  char keys[1000][16];
+  unsigned capacity;
+  unsigned i;
+  unsigned round;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_flatmap_new(np_flatmap_test_cmp,
+						 np_flatmap_test_hash));
+  for (i = 0; i < 1000; ++i)
+    snprintf(keys[i], sizeof keys[i], "key %d", i);
+
+  /* churn through the keys, tombstones must not grow the map */
+  for (i = 0; i < 80; ++i)
+    np_flatmap_put(map, keys[i], keys[i]);
+  capacity = map->capacity;
+  for (round = 0; round < 11; ++round) {
+    for (i = 0; i < 80; ++i) {
+      CU_ASSERT_EQUAL(keys[round * 80 + i],
+		      np_flatmap_remove(map, keys[round * 80 + i]));
+      np_flatmap_put(map, keys[round * 80 + i + 80],
+		     keys[round * 80 + i + 80]);
+    }
+    CU_ASSERT_EQUAL(80, map->size);
+    CU_ASSERT_EQUAL(capacity, map->capacity);
+  }
+  for (i = 0; i < 880; ++i)
+    CU_ASSERT_EQUAL(NULL, np_flatmap_get(map, keys[i]));
+  for (i = 880; i < 960; ++i)
+    CU_ASSERT_EQUAL(keys[i], np_flatmap_get(map, keys[i]));
+  np_flatmap_free(map);
+}
+
+int np_flatmap_test_cmp(void *key1, void *key2)
+{
+  return strcmp(key1, key2);
+}
+
+unsigned np_flatmap_test_hash(void *key)
+{
+  int length = strlen(key);
+  return np_hashmap_hash(key, length);
+}
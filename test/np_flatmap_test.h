@@ -0,0 +1,28 @@
+/*
+ * np_flatmap_test.h: nplib flat hash map test header
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NP_FLATMAP_TEST_H
+#define __NP_FLATMAP_TEST_H
+
+void np_flatmap_test(void);
+void np_flatmap_realloc_test(void);
+void np_flatmap_remove_test(void);
+int np_flatmap_test_cmp(void *, void *);
+unsigned np_flatmap_test_hash(void *);
+
+#endif
@@ -0,0 +1,208 @@
+/*
+ * np_hashindex_test.c: nplib memory mapped hash index tests
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <CUnit/Basic.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "np_hashindex_test.h"
+#include "np_hashindex.h"
+#include "np_hashmap.h"
+#include "np_hashmap_test.h"
+
+#define NP_HASHINDEX_TEST_PATH "np_hashindex_test.idx"
+
+static size_t np_hashindex_test_length(void *key)
+{
+  return strlen(key) + 1;
+}
+
+void np_hashindex_test(void)
+{
+  struct NpHashMap *map;
+  struct NpHashIndex *index;
+  char (*keys)[16];
+  char (*values)[24];
+  const char *value;
+  size_t length;
+  unsigned i;
+  unsigned size;
+
+  size = 10000;
+  keys = malloc(sizeof *keys * size);
+  values = malloc(sizeof *values * size);
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_hashmap_new(np_hashmap_test_cmp,
+						 np_hashmap_test_hash));
+
+  /* an empty map gives an empty index */
+  CU_ASSERT_EQUAL(0, np_hashindex_write(map, NP_HASHINDEX_TEST_PATH,
+					np_hashindex_test_length,
+					np_hashindex_test_length));
+  CU_ASSERT_NOT_EQUAL(NULL, index = np_hashindex_open(NP_HASHINDEX_TEST_PATH));
+  CU_ASSERT_EQUAL(0, index->count);
+  CU_ASSERT_EQUAL(NULL, np_hashindex_get(index, "key", 4, NULL));
+  np_hashindex_close(index);
+
+  for (i = 0; i < size; ++i) {
+    snprintf(keys[i], sizeof keys[i], "key %u", i);
+    snprintf(values[i], sizeof values[i], "value %u", i * 7);
+    np_hashmap_put(map, keys[i], values[i]);
+  }
+  CU_ASSERT_EQUAL(0, np_hashindex_write(map, NP_HASHINDEX_TEST_PATH,
+					np_hashindex_test_length,
+					np_hashindex_test_length));
+  np_hashmap_free(map);
+
+  /* the index does not refer to the map's keys and values */
+  for (i = 0; i < size; ++i)
+    values[i][0] = '\0';
+  CU_ASSERT_NOT_EQUAL(NULL, index = np_hashindex_open(NP_HASHINDEX_TEST_PATH));
+  CU_ASSERT_EQUAL(size, index->count);
+  for (i = 0; i < size; ++i) {
+    value = np_hashindex_get(index, keys[i], strlen(keys[i]) + 1, &length);
+    CU_ASSERT_NOT_EQUAL(NULL, value);
+    if (value != NULL) {
+      CU_ASSERT_EQUAL(0, (value - (const char *)index->base) % 8);
+      snprintf(values[i], sizeof values[i], "value %u", i * 7);
+      CU_ASSERT_EQUAL(strlen(values[i]) + 1, length);
+      CU_ASSERT_STRING_EQUAL(values[i], value);
+    }
+  }
+  CU_ASSERT_EQUAL(NULL, np_hashindex_get(index, "key 10000", 10, NULL));
+  CU_ASSERT_EQUAL(NULL, np_hashindex_get(index, "key 1", 5, NULL));
+  np_hashindex_close(index);
+  unlink(NP_HASHINDEX_TEST_PATH);
+  free(keys);
+  free(values);
+}
+
+/*
+ * Writes a header over the index file, growing or shrinking the file to
+ * the header's file size.
+ */
+static void np_hashindex_test_write_header(struct NpHashIndexHeader *header)
+{
+  FILE *file;
+
+  CU_ASSERT_EQUAL(0, truncate(NP_HASHINDEX_TEST_PATH, header->file_size));
+  CU_ASSERT_NOT_EQUAL(NULL, file = fopen(NP_HASHINDEX_TEST_PATH, "r+b"));
+  CU_ASSERT_EQUAL(1, fwrite(header, sizeof *header, 1, file));
+  fclose(file);
+}
+
+void np_hashindex_corrupt_test(void)
+{
+  struct NpHashMap *map;
+  struct NpHashIndex *index;
+  struct NpHashIndexHeader valid;
+  struct NpHashIndexHeader header;
+  FILE *file;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_hashmap_new(np_hashmap_test_cmp,
+						 np_hashmap_test_hash));
+  np_hashmap_put(map, "key", "value");
+  CU_ASSERT_EQUAL(0, np_hashindex_write(map, NP_HASHINDEX_TEST_PATH,
+					np_hashindex_test_length,
+					np_hashindex_test_length));
+  np_hashmap_free(map);
+  CU_ASSERT_NOT_EQUAL(NULL, file = fopen(NP_HASHINDEX_TEST_PATH, "rb"));
+  CU_ASSERT_EQUAL(1, fread(&valid, sizeof valid, 1, file));
+  fclose(file);
+
+  /* the header read back is accepted in a larger file */
+  header = valid;
+  header.file_size = 1 << 20;
+  np_hashindex_test_write_header(&header);
+  CU_ASSERT_NOT_EQUAL(NULL, index = np_hashindex_open(NP_HASHINDEX_TEST_PATH));
+  if (index != NULL)
+    np_hashindex_close(index);
+
+  /* entries wrapping past the end of the address space */
+  header.entries_offset = -(uint64_t)959992;
+  header.count = 40000;
+  np_hashindex_test_write_header(&header);
+  CU_ASSERT_EQUAL(NULL, np_hashindex_open(NP_HASHINDEX_TEST_PATH));
+
+  /* buckets wrapping, overlapping the header, or misaligned */
+  header = valid;
+  header.buckets_offset = -(uint64_t)8;
+  np_hashindex_test_write_header(&header);
+  CU_ASSERT_EQUAL(NULL, np_hashindex_open(NP_HASHINDEX_TEST_PATH));
+  header.buckets_offset = 0;
+  np_hashindex_test_write_header(&header);
+  CU_ASSERT_EQUAL(NULL, np_hashindex_open(NP_HASHINDEX_TEST_PATH));
+  header.buckets_offset = valid.buckets_offset + 2;
+  np_hashindex_test_write_header(&header);
+  CU_ASSERT_EQUAL(NULL, np_hashindex_open(NP_HASHINDEX_TEST_PATH));
+
+  /* too many buckets or entries for the file */
+  header = valid;
+  header.bucket_count = (uint64_t)1 << 62;
+  np_hashindex_test_write_header(&header);
+  CU_ASSERT_EQUAL(NULL, np_hashindex_open(NP_HASHINDEX_TEST_PATH));
+  header = valid;
+  header.count = valid.file_size;
+  np_hashindex_test_write_header(&header);
+  CU_ASSERT_EQUAL(NULL, np_hashindex_open(NP_HASHINDEX_TEST_PATH));
+
+  /* data beyond the end of the file */
+  header = valid;
+  header.data_offset = valid.file_size + 8;
+  np_hashindex_test_write_header(&header);
+  CU_ASSERT_EQUAL(NULL, np_hashindex_open(NP_HASHINDEX_TEST_PATH));
+
+  /* a file holding only part of a header */
+  CU_ASSERT_EQUAL(0, truncate(NP_HASHINDEX_TEST_PATH, sizeof header / 2));
+  CU_ASSERT_EQUAL(NULL, np_hashindex_open(NP_HASHINDEX_TEST_PATH));
+  unlink(NP_HASHINDEX_TEST_PATH);
+}
+
+void np_hashindex_invalid_test(void)
+{
+  struct NpHashMap *map;
+  FILE *file;
+  long size;
+
+  CU_ASSERT_EQUAL(NULL, np_hashindex_open(NP_HASHINDEX_TEST_PATH));
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_hashmap_new(np_hashmap_test_cmp,
+						 np_hashmap_test_hash));
+  np_hashmap_put(map, "key", "value");
+  CU_ASSERT_EQUAL(0, np_hashindex_write(map, NP_HASHINDEX_TEST_PATH,
+					np_hashindex_test_length,
+					np_hashindex_test_length));
+  np_hashmap_free(map);
+
+  /* a truncated file is rejected */
+  CU_ASSERT_NOT_EQUAL(NULL, file = fopen(NP_HASHINDEX_TEST_PATH, "rb"));
+  fseek(file, 0, SEEK_END);
+  size = ftell(file);
+  fclose(file);
+  CU_ASSERT_EQUAL(0, truncate(NP_HASHINDEX_TEST_PATH, size - 1));
+  CU_ASSERT_EQUAL(NULL, np_hashindex_open(NP_HASHINDEX_TEST_PATH));
+
+  /* so is a file that is not an index */
+  CU_ASSERT_NOT_EQUAL(NULL, file = fopen(NP_HASHINDEX_TEST_PATH, "wb"));
+  fprintf(file, "%0*d", 200, 0);
+  fclose(file);
+  CU_ASSERT_EQUAL(NULL, np_hashindex_open(NP_HASHINDEX_TEST_PATH));
+  unlink(NP_HASHINDEX_TEST_PATH);
+}
@@ -17,13 +17,42 @@
  */
 
 #include <CUnit/Basic.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 
 #include "np_hashmap_test.h"
 #include "np_hashmap.h"
-#include "np_arraylist.h"
+#include "np_arena.h"
+#include "np_bloom.h"
+#include "np_hashmap_define.h"
+
+struct np_hashmap_test_point {
+  double x;
+  double y;
+};
+
+static inline unsigned np_hashmap_test_hash_u64(uint64_t key)
+{
+  uint64_t h;
+
+  h = np_hashmap_hash64_u64(key);
+  return (unsigned)(h ^ (h >> 32));
+}
+
+#define NP_HASHMAP_TEST_EQUAL(key1, key2) ((key1) == (key2))
+
+NP_HASHMAP_DEFINE(np_hashmap_test_u64map, uint64_t,
+		  struct np_hashmap_test_point, np_hashmap_test_hash_u64,
+		  NP_HASHMAP_TEST_EQUAL);
+NP_HASHMAP_DEFINE(np_hashmap_test_ldmap, uint64_t, long double,
+		  np_hashmap_test_hash_u64, NP_HASHMAP_TEST_EQUAL);
+
+struct np_hashmap_test_ldalign {
+  char c;
+  long double value;
+};
 
 void np_hashmap_test(void)
 {
@@ -49,35 +78,728 @@ void np_hashmap_test(void)
 
 void np_hashmap_realloc_test(void)
 {
-  struct NpArrayList *key_list;
   struct NpHashMap *map;
+  void **keys;
   unsigned i;
   unsigned size;
   char *key_prefix = "key %d";
 
-  key_list = np_arraylist_new();
   CU_ASSERT_NOT_EQUAL(NULL, map = np_hashmap_new(np_hashmap_test_cmp,
 						 np_hashmap_test_hash));
   size = map->threshold + 1;
   for (i = 0; i < size; ++i) {
     char *key = malloc(BUFSIZ);
     snprintf(key, BUFSIZ, key_prefix, i);
-    np_arraylist_add(key_list, key, i);
     CU_ASSERT_EQUAL(key, np_hashmap_put(map, key, key));
   }
 
   CU_ASSERT_EQUAL(NP_HASHMAP_INITIAL_CAPACITY * 2, map->capacity);
   CU_ASSERT_EQUAL(map->capacity * map->load_factor, map->threshold);
-  for (i = size - 1; i <= size; --i) {
-    char *key;
+  keys = malloc(sizeof *keys * size);
+  CU_ASSERT_EQUAL(size, np_hashmap_export(map, keys, NULL));
+  for (i = 0; i < size; ++i) {
+    CU_ASSERT_EQUAL(keys[i], np_hashmap_remove(map, keys[i]));
+    free(keys[i]);
+  }
+  CU_ASSERT_EQUAL(0, map->size);
+  free(keys);
+  np_hashmap_free(map);
+}
+
+void np_hashmap_incremental_test(void)
+{
+  struct NpHashMap *map;
+  char keys[1000][16];
+  unsigned i;
+  int migrating;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_hashmap_new(np_hashmap_test_cmp,
+						 np_hashmap_test_hash));
+  np_hashmap_set_resize_mode(map, NP_HASHMAP_RESIZE_INCREMENTAL);
+  migrating = 0;
+  for (i = 0; i < 1000; ++i) {
+    snprintf(keys[i], sizeof keys[i], "key %d", i);
+    CU_ASSERT_EQUAL(keys[i], np_hashmap_put(map, keys[i], keys[i]));
+    if (map->old_items != NULL) {
+      migrating = 1;
+      CU_ASSERT_EQUAL(keys[0], np_hashmap_get(map, keys[0]));
+      CU_ASSERT_EQUAL(keys[i / 2], np_hashmap_get(map, keys[i / 2]));
+    }
+  }
+  CU_ASSERT(migrating);
+  CU_ASSERT_EQUAL(1000, map->size);
+  for (i = 0; i < 1000; i += 2)
+    CU_ASSERT_EQUAL(keys[i], np_hashmap_remove(map, keys[i]));
+  for (i = 0; i < 1000; ++i)
+    CU_ASSERT_EQUAL(i % 2 ? keys[i] : NULL, np_hashmap_get(map, keys[i]));
+  CU_ASSERT_EQUAL(500, map->size);
+
+  /* switching back to full resizing completes the migration */
+  np_hashmap_set_resize_mode(map, NP_HASHMAP_RESIZE_FULL);
+  CU_ASSERT_EQUAL(NULL, map->old_items);
+  for (i = 1; i < 1000; i += 2)
+    CU_ASSERT_EQUAL(keys[i], np_hashmap_get(map, keys[i]));
+  np_hashmap_free(map);
+}
+
+void np_hashmap_hashed_test(void)
+{
+  struct NpHashMap *map1;
+  struct NpHashMap *map2;
+  char *key = "thekey";
+  char *value1 = "thevalue1";
+  char *value2 = "thevalue2";
+  unsigned hash;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map1 = np_hashmap_new(np_hashmap_test_cmp,
+						  np_hashmap_test_hash));
+  CU_ASSERT_NOT_EQUAL(NULL, map2 = np_hashmap_new(np_hashmap_test_cmp,
+						  np_hashmap_test_hash));
+  hash = np_hashmap_test_hash(key);
+  CU_ASSERT_EQUAL(value1, np_hashmap_put_hashed(map1, key, value1, hash));
+  CU_ASSERT_EQUAL(value2, np_hashmap_put(map2, key, value2));
+  CU_ASSERT_EQUAL(value1, np_hashmap_get(map1, key));
+  CU_ASSERT_EQUAL(value1, np_hashmap_get_hashed(map1, key, hash));
+  CU_ASSERT_EQUAL(value2, np_hashmap_get_hashed(map2, key, hash));
+  CU_ASSERT_EQUAL(NULL, np_hashmap_get_hashed(map1, key, hash + 1));
+  CU_ASSERT_EQUAL(value2, np_hashmap_remove_hashed(map2, key, hash));
+  CU_ASSERT_EQUAL(NULL, np_hashmap_get_hashed(map2, key, hash));
+  CU_ASSERT_EQUAL(0, map2->size);
+  np_hashmap_free(map1);
+  np_hashmap_free(map2);
+}
+
+void np_hashmap_many_test(void)
+{
+  struct NpHashMap *map;
+  char keys[100][16];
+  void *key_ptrs[100];
+  void *values[100];
+  unsigned i;
+
+  for (i = 0; i < 100; ++i) {
+    snprintf(keys[i], sizeof keys[i], "key %d", i);
+    key_ptrs[i] = keys[i];
+  }
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_hashmap_new(np_hashmap_test_cmp,
+						 np_hashmap_test_hash));
+  CU_ASSERT_EQUAL(50, np_hashmap_put_many(map, key_ptrs, key_ptrs, 50));
+  CU_ASSERT_EQUAL(50, map->size);
+  CU_ASSERT_EQUAL(50, np_hashmap_get_many(map, key_ptrs, values, 100));
+  for (i = 0; i < 100; ++i)
+    CU_ASSERT_EQUAL(i < 50 ? keys[i] : NULL, values[i]);
+  CU_ASSERT_EQUAL(0, np_hashmap_get_many(map, key_ptrs + 50, values, 50));
+  for (i = 0; i < 50; ++i)
+    values[i] = NULL;
+  CU_ASSERT_EQUAL(50, np_hashmap_put_many(map, key_ptrs + 50, values, 50));
+  CU_ASSERT_EQUAL(100, map->size);
+  np_hashmap_free(map);
+}
+
+void np_hashmap_hash64_test(void)
+{
+  unsigned char buf[1024];
+  uint32_t k32 = 0xdeadbeef;
+  uint64_t k64 = 0x0123456789abcdefULL;
+  unsigned char k32_bytes[4] = { 0xef, 0xbe, 0xad, 0xde };
+  unsigned char k64_bytes[8] = {
+    0xef, 0xcd, 0xab, 0x89, 0x67, 0x45, 0x23, 0x01
+  };
+  uint64_t hashes[sizeof buf];
+  unsigned i;
+  unsigned j;
+
+  /* integer specializations match the generic hash */
+  CU_ASSERT_EQUAL(np_hashmap_hash64(k32_bytes, 4), np_hashmap_hash64_u32(k32));
+  CU_ASSERT_EQUAL(np_hashmap_hash64(k64_bytes, 8), np_hashmap_hash64_u64(k64));
+
+  /* every prefix length of the buffer hashes differently */
+  for (i = 0; i < sizeof buf; ++i)
+    buf[i] = (unsigned char)(i * 131 + 7);
+  for (i = 0; i < sizeof buf; ++i)
+    hashes[i] = np_hashmap_hash64(buf, i);
+  for (i = 0; i < sizeof buf; ++i)
+    for (j = i + 1; j < sizeof buf; ++j)
+      if (hashes[i] == hashes[j])
+	CU_FAIL("hash collision");
+
+  /* a single bit flip anywhere changes the hash */
+  for (i = 0; i < 300; ++i) {
+    buf[i] ^= 1;
+    CU_ASSERT_NOT_EQUAL(hashes[300], np_hashmap_hash64(buf, 300));
+    buf[i] ^= 1;
+  }
+  CU_ASSERT_EQUAL(hashes[300], np_hashmap_hash64(buf, 300));
+}
+
+void np_hashmap_capacity_test(void)
+{
+  struct NpHashMap *map;
+  char keys[1000][16];
+  unsigned i;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_hashmap_new_with_capacity(
+			np_hashmap_test_cmp, np_hashmap_test_hash, 1000));
+  CU_ASSERT_EQUAL(2048, map->capacity);
+  CU_ASSERT(map->threshold >= 1000);
+
+  /* presized maps do not resize while loading */
+  for (i = 0; i < 1000; ++i) {
+    snprintf(keys[i], sizeof keys[i], "key %d", i);
+    CU_ASSERT_EQUAL(keys[i], np_hashmap_put(map, keys[i], keys[i]));
+  }
+  CU_ASSERT_EQUAL(2048, map->capacity);
+
+  /* nor do they shrink below their initial capacity */
+  for (i = 0; i < 990; ++i)
+    CU_ASSERT_EQUAL(keys[i], np_hashmap_remove(map, keys[i]));
+  CU_ASSERT_EQUAL(2048, map->capacity);
+  CU_ASSERT_EQUAL(map, np_hashmap_shrink_to_fit(map));
+  CU_ASSERT_EQUAL(NP_HASHMAP_INITIAL_CAPACITY, map->capacity);
+  for (i = 990; i < 1000; ++i)
+    CU_ASSERT_EQUAL(keys[i], np_hashmap_get(map, keys[i]));
+
+  /* growth followed by removals shrinks back at the low water mark */
+  for (i = 0; i < 990; ++i)
+    CU_ASSERT_EQUAL(keys[i], np_hashmap_put(map, keys[i], keys[i]));
+  CU_ASSERT_EQUAL(2048, map->capacity);
+  for (i = 0; i < 990; ++i)
+    CU_ASSERT_EQUAL(keys[i], np_hashmap_remove(map, keys[i]));
+  CU_ASSERT(map->capacity < 2048);
+  CU_ASSERT(map->size >= map->low_water);
+  for (i = 990; i < 1000; ++i)
+    CU_ASSERT_EQUAL(keys[i], np_hashmap_get(map, keys[i]));
+
+  /* reserve */
+  CU_ASSERT_EQUAL(map, np_hashmap_reserve(map, 5000));
+  CU_ASSERT_EQUAL(8192, map->capacity);
+  CU_ASSERT_EQUAL(keys[995], np_hashmap_remove(map, keys[995]));
+  CU_ASSERT_EQUAL(8192, map->capacity);
+
+  /* load factor */
+  CU_ASSERT_EQUAL(NULL, np_hashmap_set_load_factor(map, 0));
+  CU_ASSERT_EQUAL(map, np_hashmap_set_load_factor(map, 0.5));
+  CU_ASSERT_EQUAL(4096, map->threshold);
+  for (i = 990; i < 1000; ++i)
+    CU_ASSERT_EQUAL(i == 995 ? NULL : keys[i], np_hashmap_get(map, keys[i]));
+  np_hashmap_free(map);
+}
+
+void np_hashmap_iterator_test(void)
+{
+  struct NpHashMap *map;
+  struct NpHashMapIterator *iter;
+  struct NpHashMapIterator stack_iter;
+  char keys[1000][16];
+  char seen[1000];
+  void *exported_keys[1000];
+  void *exported_values[1000];
+  void *key;
+  unsigned i;
+  unsigned count;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_hashmap_new(np_hashmap_test_cmp,
+						 np_hashmap_test_hash));
+
+  /* empty map */
+  CU_ASSERT_NOT_EQUAL(NULL, iter = np_hashmap_iterator(map));
+  CU_ASSERT_EQUAL(NULL, np_hashmap_iterator_peek_next_key(iter));
+  CU_ASSERT_EQUAL(NULL, np_hashmap_iterator_peek_next_value(iter));
+  CU_ASSERT_EQUAL(NULL, np_hashmap_iterator_next_key(iter));
+  np_hashmap_iterator_free(iter);
+  CU_ASSERT_EQUAL(0, np_hashmap_export(map, exported_keys, exported_values));
+
+  /* iterate while an incremental resize is in progress */
+  np_hashmap_set_resize_mode(map, NP_HASHMAP_RESIZE_INCREMENTAL);
+  for (i = 0; i < 1000; ++i) {
+    snprintf(keys[i], sizeof keys[i], "key %d", i);
+    CU_ASSERT_EQUAL(keys[i], np_hashmap_put(map, keys[i], keys[i]));
+  }
+  CU_ASSERT_NOT_EQUAL(NULL, map->old_items);
+
+  memset(seen, 0, sizeof seen);
+  np_hashmap_iterator_init(&stack_iter, map);
+  for (count = 0; np_hashmap_iterator_peek_next_key(&stack_iter); ++count) {
+    CU_ASSERT_EQUAL(np_hashmap_iterator_peek_next_key(&stack_iter),
+		    np_hashmap_iterator_peek_next_value(&stack_iter));
+    key = np_hashmap_iterator_next_key(&stack_iter);
+    i = (char (*)[16])key - keys;
+    CU_ASSERT(i < 1000 && !seen[i]);
+    seen[i] = 1;
+  }
+  CU_ASSERT_EQUAL(1000, count);
+  CU_ASSERT_EQUAL(NULL, np_hashmap_iterator_next_key(&stack_iter));
+
+  /* export follows iterator order */
+  CU_ASSERT_EQUAL(1000, np_hashmap_export(map, exported_keys,
+					  exported_values));
+  np_hashmap_iterator_init(&stack_iter, map);
+  for (i = 0; i < 1000; ++i) {
+    CU_ASSERT_EQUAL(exported_keys[i], exported_values[i]);
+    CU_ASSERT_EQUAL(exported_keys[i],
+		    np_hashmap_iterator_next_key(&stack_iter));
+  }
+  CU_ASSERT_EQUAL(1000, np_hashmap_export(map, NULL, exported_values));
+  np_hashmap_free(map);
+}
+
+void np_hashmap_string_keys_test(void)
+{
+  struct NpHashMap *map;
+  struct NpHashMapIterator iter;
+  char key[64];
+  char *owned;
+  size_t used;
+  unsigned i;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_hashmap_new_string_keys());
+
+  /* short keys live in the items, long keys share a prefix */
+  for (i = 0; i < 2000; ++i) {
+    if (i % 2)
+      snprintf(key, sizeof key, "k%u", i);
+    else
+      snprintf(key, sizeof key, "a long key sharing a prefix %u", i);
+    CU_ASSERT_EQUAL(map, np_hashmap_put(map, key, map));
+  }
+  CU_ASSERT_EQUAL(2000, map->size);
+  for (i = 0; i < 2000; ++i) {
+    if (i % 2)
+      snprintf(key, sizeof key, "k%u", i);
+    else
+      snprintf(key, sizeof key, "a long key sharing a prefix %u", i);
+    CU_ASSERT_EQUAL(map, np_hashmap_get(map, key));
+  }
+  CU_ASSERT_EQUAL(NULL, np_hashmap_get(map, "a long key sharing a prefix 1"));
+  CU_ASSERT_EQUAL(NULL, np_hashmap_get(map, "k2"));
+  CU_ASSERT_EQUAL(NULL, np_hashmap_get(map, ""));
+
+  /* the map owns copies of the keys */
+  np_hashmap_iterator_init(&iter, map);
+  while ((owned = np_hashmap_iterator_next_key(&iter)) != NULL)
+    CU_ASSERT(owned != key && (owned[0] == 'k' || owned[0] == 'a'));
+
+  /* removing most long keys compacts the arena */
+  used = map->arena->used;
+  for (i = 0; i < 1900; i += 2) {
+    snprintf(key, sizeof key, "a long key sharing a prefix %u", i);
+    CU_ASSERT_EQUAL(map, np_hashmap_remove(map, key));
+  }
+  CU_ASSERT(map->arena->used < used / 2);
+  CU_ASSERT(map->arena->used >= map->key_bytes);
+  for (i = 0; i < 2000; ++i) {
+    if (i % 2)
+      snprintf(key, sizeof key, "k%u", i);
+    else
+      snprintf(key, sizeof key, "a long key sharing a prefix %u", i);
+    CU_ASSERT_EQUAL(i % 2 || i >= 1900 ? map : NULL,
+		    np_hashmap_get(map, key));
+  }
+  np_hashmap_free(map);
+}
+
+void np_hashmap_define_test(void)
+{
+  struct np_hashmap_test_u64map *map;
+  struct np_hashmap_test_point point;
+  struct np_hashmap_test_point *stored;
+  uint64_t i;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_hashmap_test_u64map_new());
+  for (i = 0; i < 1000; ++i) {
+    point.x = i;
+    point.y = -(double)i;
+    CU_ASSERT_NOT_EQUAL(NULL, stored = np_hashmap_test_u64map_put(
+			  map, i << 32, point));
+    CU_ASSERT_EQUAL(point.x, stored->x);
+  }
+  CU_ASSERT_EQUAL(1000, map->size);
+  CU_ASSERT(map->capacity >= 1000 / NP_HASHMAP_DEFAULT_LOAD_FACTOR);
+
+  /* values are stored by value and can be updated in place */
+  CU_ASSERT_NOT_EQUAL(NULL, stored = np_hashmap_test_u64map_get(map, 7ull << 32));
+  stored->y = 42;
+  CU_ASSERT_EQUAL(42, np_hashmap_test_u64map_get(map, 7ull << 32)->y);
+  CU_ASSERT_EQUAL(NULL, np_hashmap_test_u64map_get(map, 7));
+
+  for (i = 0; i < 1000; i += 2) {
+    CU_ASSERT_EQUAL(1, np_hashmap_test_u64map_remove(map, i << 32, &point));
+    CU_ASSERT_EQUAL(i, point.x);
+  }
+  CU_ASSERT_EQUAL(0, np_hashmap_test_u64map_remove(map, 0, NULL));
+  CU_ASSERT_EQUAL(500, map->size);
+  for (i = 0; i < 1000; ++i) {
+    stored = np_hashmap_test_u64map_get(map, i << 32);
+    if (i % 2) {
+      CU_ASSERT(stored != NULL && stored->x == i);
+    } else {
+      CU_ASSERT_EQUAL(NULL, stored);
+    }
+  }
+  np_hashmap_test_u64map_free(map);
+}
+
+void np_hashmap_define_aligned_test(void)
+{
+  struct np_hashmap_test_ldmap *map;
+  long double *stored;
+  uint64_t i;
+
+  /* over-aligned values are stored aligned */
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_hashmap_test_ldmap_new());
+  for (i = 0; i < 1000; ++i) {
+    CU_ASSERT_NOT_EQUAL(NULL, stored = np_hashmap_test_ldmap_put(map, i,
+								 i / 4.0L));
+    CU_ASSERT_EQUAL(0, (uintptr_t)stored
+		    % offsetof(struct np_hashmap_test_ldalign, value));
+  }
+  CU_ASSERT_EQUAL(0, (uintptr_t)np_hashmap_test_ldmap_get(map, 7)
+		  % offsetof(struct np_hashmap_test_ldalign, value));
+  CU_ASSERT_EQUAL(7 / 4.0L, *np_hashmap_test_ldmap_get(map, 7));
+  np_hashmap_test_ldmap_free(map);
+}
+
+void np_hashmap_bloom_test(void)
+{
+  struct NpHashMap *map;
+  char keys[2000][16];
+  void *key_ptrs[2000];
+  void *values[2000];
+  unsigned i;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_hashmap_new(np_hashmap_test_cmp,
+						 np_hashmap_test_hash));
+  for (i = 0; i < 2000; ++i) {
+    snprintf(keys[i], sizeof keys[i], "key %d", i);
+    key_ptrs[i] = keys[i];
+  }
+  for (i = 0; i < 500; ++i)
+    CU_ASSERT_EQUAL(keys[i], np_hashmap_put(map, keys[i], keys[i]));
+
+  /* existing keys are added when the filter is attached */
+  CU_ASSERT_EQUAL(map, np_hashmap_attach_bloom(map));
+  CU_ASSERT_EQUAL(500, map->bloom->items);
+  for (i = 500; i < 1000; ++i)
+    CU_ASSERT_EQUAL(keys[i], np_hashmap_put(map, keys[i], keys[i]));
+
+  /* the filter is rebuilt as the map grows, absent keys are rejected */
+  CU_ASSERT(map->bloom->capacity >= 1000);
+  for (i = 0; i < 2000; ++i)
+    CU_ASSERT_EQUAL(i < 1000 ? keys[i] : NULL, np_hashmap_get(map, keys[i]));
+  CU_ASSERT(map->bloom->rejected > 900);
+  CU_ASSERT_EQUAL(1000, map->bloom->rejected + map->bloom->false_positives);
+  CU_ASSERT(np_bloom_false_positive_rate(map->bloom) < 0.1);
+  CU_ASSERT_EQUAL(1000, np_hashmap_get_many(map, key_ptrs, values, 2000));
+  for (i = 0; i < 2000; ++i)
+    CU_ASSERT_EQUAL(i < 1000 ? keys[i] : NULL, values[i]);
+
+  /* removing most keys rebuilds the filter */
+  for (i = 0; i < 900; ++i)
+    CU_ASSERT_EQUAL(keys[i], np_hashmap_remove(map, keys[i]));
+  CU_ASSERT(map->bloom->removed < 900);
+  CU_ASSERT(map->bloom->items < 1000);
+  for (i = 0; i < 2000; ++i)
+    CU_ASSERT_EQUAL(i >= 900 && i < 1000 ? keys[i] : NULL,
+		    np_hashmap_get(map, keys[i]));
+
+  np_hashmap_detach_bloom(map);
+  CU_ASSERT_EQUAL(NULL, map->bloom);
+  CU_ASSERT_EQUAL(keys[950], np_hashmap_get(map, keys[950]));
+  CU_ASSERT_EQUAL(map, np_hashmap_attach_bloom(map));
+  CU_ASSERT_EQUAL(100, map->bloom->items);
+  np_hashmap_free(map);
+}
+
+void np_hashmap_item_test(void)
+{
+  struct NpHashMap *map;
+  struct NpHashMapItem *item;
+  char *key = "thekey";
+  unsigned hash;
+
+  CU_ASSERT_EQUAL(NULL, np_hashmap_new_with_item_size(
+		    np_hashmap_test_cmp, np_hashmap_test_hash, 0,
+		    sizeof(struct NpHashMapItem) - 1));
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_hashmap_new_with_item_size(
+			np_hashmap_test_cmp, np_hashmap_test_hash, 0,
+			sizeof(struct NpHashMapItem) + sizeof(double)));
+  hash = np_hashmap_test_hash(key);
+  CU_ASSERT_EQUAL(NULL, np_hashmap_get_item(map, key, hash));
+  CU_ASSERT_NOT_EQUAL(NULL, item = np_hashmap_insert_item(map, key, hash));
+  CU_ASSERT_EQUAL(key, item->key);
+  CU_ASSERT_EQUAL(NULL, item->value);
+  *(double *)(item + 1) = 1.5;
+  item->value = key;
+  CU_ASSERT_EQUAL(item, np_hashmap_get_item(map, key, hash));
+  CU_ASSERT_EQUAL(key, np_hashmap_get(map, key));
+  CU_ASSERT_EQUAL(1.5, *(double *)(item + 1));
+  CU_ASSERT_EQUAL(1, map->size);
+  CU_ASSERT_EQUAL(key, np_hashmap_remove(map, key));
+  CU_ASSERT_EQUAL(NULL, np_hashmap_get_item(map, key, hash));
+  np_hashmap_free(map);
+}
+
+/*
+ * Hashes keys onto only eight distinct values.
+ */
+static unsigned np_hashmap_test_bad_hash(void *key)
+{
+  return np_hashmap_test_hash(key) % 8;
+}
+
+void np_hashmap_stats_test(void)
+{
+  struct NpHashMap *map;
+  struct NpHashMapStats stats;
+  char keys[1000][16];
+  unsigned buckets;
+  unsigned items;
+  unsigned i;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_hashmap_new(np_hashmap_test_cmp,
+						 np_hashmap_test_hash));
+  np_hashmap_stats(map, &stats);
+  CU_ASSERT_EQUAL(0, stats.size);
+  CU_ASSERT_EQUAL(NP_HASHMAP_INITIAL_CAPACITY, stats.capacity);
+  CU_ASSERT_EQUAL(1.0, stats.empty_ratio);
+  CU_ASSERT_EQUAL(0, stats.max_chain);
+  CU_ASSERT_EQUAL(0, stats.resizes);
+  for (i = 0; i < 1000; ++i) {
+    snprintf(keys[i], sizeof keys[i], "key %d", i);
+    np_hashmap_put(map, keys[i], keys[i]);
+  }
+
+  /* the histogram accounts for every bucket and item */
+  np_hashmap_stats(map, &stats);
+  CU_ASSERT_EQUAL(1000, stats.size);
+  CU_ASSERT_EQUAL(map->capacity, stats.capacity);
+  CU_ASSERT_EQUAL(stats.capacity, stats.buckets);
+  for (i = 0, buckets = 0, items = 0; i < NP_HASHMAP_STATS_CHAINS; ++i) {
+    buckets += stats.chains[i];
+    items += i * stats.chains[i];
+  }
+  CU_ASSERT_EQUAL(stats.buckets, buckets);
+  CU_ASSERT_EQUAL(1000, items);
+  CU_ASSERT(stats.max_chain < 8);
+  CU_ASSERT(stats.mean_chain >= 1.0 && stats.mean_chain < 2.0);
+  CU_ASSERT(stats.empty_ratio > 0.4 && stats.empty_ratio < 0.8);
+  CU_ASSERT_EQUAL(7, stats.resizes);
+  CU_ASSERT(stats.resize_seconds >= 0);
+  CU_ASSERT(stats.bytes > sizeof *map->items * map->capacity
+	    + 1000 * sizeof(struct NpHashMapItem));
+  np_hashmap_free(map);
+
+  /* a bad hash function shows up as long chains and empty buckets */
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_hashmap_new(np_hashmap_test_cmp,
+						 np_hashmap_test_bad_hash));
+  for (i = 0; i < 1000; ++i)
+    np_hashmap_put(map, keys[i], keys[i]);
+  np_hashmap_stats(map, &stats);
+  CU_ASSERT(stats.max_chain >= 125);
+  CU_ASSERT(stats.mean_chain >= 125);
+  CU_ASSERT_EQUAL(stats.buckets - 8, stats.chains[0]);
+  CU_ASSERT_EQUAL(8, stats.chains[NP_HASHMAP_STATS_CHAINS - 1]);
+  np_hashmap_free(map);
+}
+
+void np_hashmap_keyed_test(void)
+{
+  struct NpHashMap *map;
+  struct NpHashMap *map2;
+  struct NpHashMapStats stats;
+  uint64_t seed[2] = {0x0706050403020100ULL, 0x0f0e0d0c0b0a0908ULL};
+  unsigned char bytes[63];
+  char keys[1000][16];
+  unsigned i;
+  unsigned same;
+
+  /* SipHash-1-3 reference values for the key bytes 0, 1, 2, ... */
+  for (i = 0; i < sizeof bytes; ++i)
+    bytes[i] = i;
+  CU_ASSERT_EQUAL(0xabac0158050fc4dcULL, np_hashmap_siphash(bytes, 0, seed));
+  CU_ASSERT_EQUAL(0xc9f49bf37d57ca93ULL, np_hashmap_siphash(bytes, 1, seed));
+  CU_ASSERT_EQUAL(0x369095118d299a8eULL, np_hashmap_siphash(bytes, 8, seed));
+  CU_ASSERT_EQUAL(0xd320d86d2a519956ULL, np_hashmap_siphash(bytes, 15, seed));
+  CU_ASSERT_EQUAL(0x9d199062b7bbb3a8ULL, np_hashmap_siphash(bytes, 63, seed));
 
-    key = np_arraylist_get(key_list, i);
-    CU_ASSERT_EQUAL(key, np_hashmap_remove(map, key));
-    CU_ASSERT_EQUAL(key, np_arraylist_remove(key_list, i))
-    free(key);
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_hashmap_new_keyed(
+			np_hashmap_test_cmp, np_hashmap_siphash_string));
+  CU_ASSERT_NOT_EQUAL(NULL, map2 = np_hashmap_new_keyed(
+			np_hashmap_test_cmp, np_hashmap_siphash_string));
+  CU_ASSERT(map->seed[0] != map2->seed[0] || map->seed[1] != map2->seed[1]);
+  for (i = 0; i < 1000; ++i) {
+    snprintf(keys[i], sizeof keys[i], "key %d", i);
+    CU_ASSERT_EQUAL(keys[i], np_hashmap_put(map, keys[i], keys[i]));
   }
+
+  /* maps with different seeds hash keys differently */
+  for (i = 0, same = 0; i < 1000; ++i)
+    same += np_hashmap_key_hash(map, keys[i])
+      == np_hashmap_key_hash(map2, keys[i]);
+  CU_ASSERT(same < 10);
+
+  /* reseeding rehashes the items */
+  CU_ASSERT_EQUAL(map, np_hashmap_attach_bloom(map));
+  np_hashmap_set_seed(map, seed[0], seed[1]);
+  CU_ASSERT_EQUAL(seed[0], map->seed[0]);
+  CU_ASSERT_EQUAL(np_hashmap_siphash_string(keys[0], seed),
+		  np_hashmap_key_hash(map, keys[0]));
+  for (i = 0; i < 1000; ++i)
+    CU_ASSERT_EQUAL(keys[i], np_hashmap_get(map, keys[i]));
+  CU_ASSERT_EQUAL(NULL, np_hashmap_get(map, "key 1000"));
+  np_hashmap_stats(map, &stats);
+  CU_ASSERT(stats.max_chain < 8);
+  for (i = 0; i < 1000; ++i)
+    CU_ASSERT_EQUAL(keys[i], np_hashmap_remove(map, keys[i]));
+  CU_ASSERT_EQUAL(0, map->size);
+  np_hashmap_free(map);
+  np_hashmap_free(map2);
+}
+
+void np_hashmap_alloc_test(void)
+{
+  struct NpHashMap *map;
+  struct NpAllocPolicy policy;
+  static char keys[100000][16];
+  unsigned i;
+
+  memset(&policy, 0, sizeof policy);
+  policy.huge_pages = NP_ALLOC_HUGE_TRANSPARENT;
+  policy.min_size = 4096;
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_hashmap_new(np_hashmap_test_cmp,
+						 np_hashmap_test_hash));
+  for (i = 0; i < 100; ++i) {
+    snprintf(keys[i], sizeof keys[i], "key %u", i);
+    np_hashmap_put(map, keys[i], keys[i]);
+  }
+
+  /* the existing table moves to the new policy, later tables follow it */
+  CU_ASSERT_EQUAL(map, np_hashmap_set_alloc_policy(map, &policy));
+  CU_ASSERT_EQUAL(keys[42], np_hashmap_get(map, keys[42]));
+  for (i = 100; i < 100000; ++i) {
+    snprintf(keys[i], sizeof keys[i], "key %u", i);
+    np_hashmap_put(map, keys[i], keys[i]);
+  }
+  for (i = 0; i < 100000; ++i)
+    if (np_hashmap_get(map, keys[i]) != keys[i])
+      break;
+  CU_ASSERT_EQUAL(100000, i);
+
+  /* incremental resizes release the old table under the policy too */
+  np_hashmap_set_resize_mode(map, NP_HASHMAP_RESIZE_INCREMENTAL);
+  for (i = 0; i < 90000; ++i)
+    np_hashmap_remove(map, keys[i]);
+  CU_ASSERT_EQUAL(keys[99999], np_hashmap_get(map, keys[99999]));
+  np_hashmap_free(map);
+}
+
+void np_hashmap_parallel_test(void)
+{
+  struct NpHashMap *map;
+  static char keys[200000][16];
+  static void *key_ptrs[210000];
+  static void *values[210000];
+  unsigned i;
+
+  for (i = 0; i < 200000; ++i) {
+    snprintf(keys[i], sizeof keys[i], "key %u", i);
+    key_ptrs[i] = keys[i];
+    values[i] = keys[i];
+  }
+
+  /* repeated keys keep the last value */
+  for (i = 200000; i < 210000; ++i) {
+    key_ptrs[i] = keys[i - 200000];
+    values[i] = keys[i - 190000];
+  }
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_hashmap_build_parallel(
+			np_hashmap_test_cmp, np_hashmap_test_hash, key_ptrs,
+			values, 210000, 4));
+  CU_ASSERT_EQUAL(200000, map->size);
+  CU_ASSERT_EQUAL(4, map->threads);
+  for (i = 0; i < 200000; ++i)
+    if (np_hashmap_get(map, keys[i])
+	!= (i < 10000 ? keys[i + 10000] : keys[i]))
+      break;
+  CU_ASSERT_EQUAL(200000, i);
+  CU_ASSERT_EQUAL(keys[10003], np_hashmap_remove(map, keys[3]));
+  np_hashmap_free(map);
+
+  /* resizes past NP_HASHMAP_PARALLEL_MIN_BUCKETS move items in parallel */
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_hashmap_new(np_hashmap_test_cmp,
+						 np_hashmap_test_hash));
+  np_hashmap_set_threads(map, 3);
+  for (i = 0; i < 200000; ++i)
+    np_hashmap_put(map, keys[i], keys[i]);
+  CU_ASSERT(map->capacity > NP_HASHMAP_PARALLEL_MIN_BUCKETS);
+  for (i = 0; i < 200000; ++i)
+    if (np_hashmap_get(map, keys[i]) != keys[i])
+      break;
+  CU_ASSERT_EQUAL(200000, i);
+  np_hashmap_free(map);
+
+  /* an empty build gives an empty map */
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_hashmap_build_parallel(
+			np_hashmap_test_cmp, np_hashmap_test_hash, NULL, NULL,
+			0, 2));
   CU_ASSERT_EQUAL(0, map->size);
-  np_arraylist_free(key_list);
+  np_hashmap_free(map);
+}
+
+static void *np_hashmap_test_add(void *key, void *value, void *arg)
+{
+  (void)key;
+  return (void *)((uintptr_t)value + (uintptr_t)arg);
+}
+
+void np_hashmap_upsert_test(void)
+{
+  struct NpHashMap *map;
+  char keys[500][16];
+  char copy[16];
+  char *other = "other";
+  void **slot;
+  unsigned i;
+  int inserted;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_hashmap_new(np_hashmap_test_cmp,
+						 np_hashmap_test_hash));
+  for (i = 0; i < 500; ++i)
+    snprintf(keys[i], sizeof keys[i], "key %u", i);
+
+  /* put if absent keeps the first value */
+  CU_ASSERT_EQUAL(keys[0], np_hashmap_put_if_absent(map, keys[0], keys[0]));
+  CU_ASSERT_EQUAL(keys[0], np_hashmap_put_if_absent(map, keys[0], other));
+  CU_ASSERT_EQUAL(keys[0], np_hashmap_get(map, keys[0]));
+  CU_ASSERT_EQUAL(keys[0], np_hashmap_remove(map, keys[0]));
+
+  /* count keys i % 100 through their slots, which survive resizes */
+  for (i = 0; i < 500; ++i) {
+    CU_ASSERT_NOT_EQUAL(NULL, slot = np_hashmap_get_or_insert(
+			  map, keys[i % 100], &inserted));
+    CU_ASSERT_EQUAL(i < 100, inserted);
+    *slot = (void *)((uintptr_t)*slot + 1);
+  }
+  CU_ASSERT_EQUAL(100, map->size);
+  for (i = 0; i < 100; ++i)
+    CU_ASSERT_EQUAL((void *)5, np_hashmap_get(map, keys[i]));
+
+  /* compute sees NULL for absent keys and the value for present ones */
+  for (i = 0; i < 200; ++i)
+    np_hashmap_compute(map, keys[i], np_hashmap_test_add, (void *)2);
+  CU_ASSERT_EQUAL(200, map->size);
+  CU_ASSERT_EQUAL((void *)7, np_hashmap_get(map, keys[99]));
+  CU_ASSERT_EQUAL((void *)2, np_hashmap_get(map, keys[100]));
+  np_hashmap_free(map);
+
+  /* maps with owned keys pass the map's copy of the key */
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_hashmap_new_string_keys());
+  strcpy(copy, keys[1]);
+  CU_ASSERT_NOT_EQUAL(NULL, slot = np_hashmap_get_or_insert(map, copy,
+							     NULL));
+  *slot = other;
+  copy[0] = 'x';
+  CU_ASSERT_EQUAL(other, np_hashmap_get(map, keys[1]));
   np_hashmap_free(map);
 }
 
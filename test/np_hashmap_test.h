@@ -21,6 +21,22 @@
 
 void np_hashmap_test(void);
 void np_hashmap_realloc_test(void);
+void np_hashmap_incremental_test(void);
+void np_hashmap_hashed_test(void);
+void np_hashmap_many_test(void);
+void np_hashmap_hash64_test(void);
+void np_hashmap_capacity_test(void);
+void np_hashmap_iterator_test(void);
+void np_hashmap_string_keys_test(void);
+void np_hashmap_define_test(void);
+void np_hashmap_define_aligned_test(void);
+void np_hashmap_bloom_test(void);
+void np_hashmap_item_test(void);
+void np_hashmap_stats_test(void);
+void np_hashmap_keyed_test(void);
+void np_hashmap_alloc_test(void);
+void np_hashmap_parallel_test(void);
+void np_hashmap_upsert_test(void);
 int np_hashmap_test_cmp(void *, void *);
 unsigned np_hashmap_test_hash(void *);
 
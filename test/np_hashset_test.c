@@ -0,0 +1,147 @@
+/*
+ * np_hashset_test.c: nplib hash set tests
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <CUnit/Basic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "np_hashset_test.h"
+#include "np_hashset.h"
+
+static int np_hashset_test_cmp(void *key1, void *key2)
+{
+  return strcmp(key1, key2);
+}
+
+static unsigned np_hashset_test_hash(void *key)
+{
+  return np_hashmap_hash(key, strlen(key));
+}
+
+/* the same hash computed by a different function */
+static unsigned np_hashset_test_hash2(void *key)
+{
+  return np_hashmap_hash(key, strlen(key));
+}
+
+static unsigned np_hashset_test_count(struct NpHashSet *set)
+{
+  struct NpHashSetIterator iter;
+  unsigned count;
+
+  count = 0;
+  np_hashset_iterator_init(&iter, set);
+  while (np_hashset_iterator_next(&iter) != NULL)
+    count++;
+  return count;
+}
+
+void np_hashset_test(void)
+{
+  struct NpHashSet *set;
+  static char keys[10000][16];
+  char copy[16];
+  unsigned i;
+
+  CU_ASSERT_NOT_EQUAL(NULL, set = np_hashset_new(np_hashset_test_cmp,
+						 np_hashset_test_hash));
+  CU_ASSERT_EQUAL(0, np_hashset_contains(set, "a"));
+  CU_ASSERT_EQUAL(NULL, np_hashset_remove(set, "a"));
+  for (i = 0; i < 10000; ++i) {
+    snprintf(keys[i], sizeof keys[i], "key %u", i);
+    CU_ASSERT_EQUAL(1, np_hashset_add(set, keys[i]));
+  }
+  CU_ASSERT_EQUAL(10000, set->size);
+  CU_ASSERT_EQUAL(10000, np_hashset_test_count(set));
+  CU_ASSERT(set->capacity * NP_HASHMAP_DEFAULT_LOAD_FACTOR >= 10000);
+
+  /* equal keys are present once and the stored key is returned */
+  strcpy(copy, keys[42]);
+  CU_ASSERT_EQUAL(0, np_hashset_add(set, copy));
+  CU_ASSERT_EQUAL(1, np_hashset_contains(set, copy));
+  CU_ASSERT_EQUAL(keys[42], np_hashset_get(set, copy));
+  CU_ASSERT_EQUAL(10000, set->size);
+
+  /* removing most keys shrinks the set */
+  for (i = 0; i < 9990; ++i)
+    CU_ASSERT_EQUAL(keys[i], np_hashset_remove(set, keys[i]));
+  CU_ASSERT_EQUAL(10, set->size);
+  CU_ASSERT(set->capacity < 1024);
+  CU_ASSERT_EQUAL(0, np_hashset_contains(set, keys[0]));
+  for (i = 9990; i < 10000; ++i)
+    CU_ASSERT_EQUAL(1, np_hashset_contains(set, keys[i]));
+  CU_ASSERT_EQUAL(10, np_hashset_test_count(set));
+  np_hashset_free(set);
+}
+
+void np_hashset_bulk_test(void)
+{
+  struct NpHashSet *evens;
+  struct NpHashSet *threes;
+  struct NpHashSet *set;
+  static char keys[3000][16];
+  unsigned i;
+
+  CU_ASSERT_NOT_EQUAL(NULL, evens = np_hashset_new(np_hashset_test_cmp,
+						   np_hashset_test_hash));
+  CU_ASSERT_NOT_EQUAL(NULL, threes = np_hashset_new(np_hashset_test_cmp,
+						    np_hashset_test_hash2));
+  for (i = 0; i < 3000; ++i) {
+    snprintf(keys[i], sizeof keys[i], "key %u", i);
+    if (i % 2 == 0)
+      np_hashset_add(evens, keys[i]);
+    if (i % 3 == 0)
+      np_hashset_add(threes, keys[i]);
+  }
+
+  /* union of sets hashing alike and differently */
+  CU_ASSERT_NOT_EQUAL(NULL, set = np_hashset_new(np_hashset_test_cmp,
+						 np_hashset_test_hash));
+  CU_ASSERT_EQUAL(set, np_hashset_union(set, evens));
+  CU_ASSERT_EQUAL(set, np_hashset_union(set, threes));
+  CU_ASSERT_EQUAL(2000, set->size);
+  for (i = 0; i < 3000; ++i)
+    if (np_hashset_contains(set, keys[i]) != (i % 2 == 0 || i % 3 == 0))
+      break;
+  CU_ASSERT_EQUAL(3000, i);
+
+  /* intersection */
+  CU_ASSERT_EQUAL(set, np_hashset_intersection(set, threes));
+  CU_ASSERT_EQUAL(1000, set->size);
+  CU_ASSERT_EQUAL(set, np_hashset_intersection(set, evens));
+  CU_ASSERT_EQUAL(500, set->size);
+  for (i = 0; i < 3000; ++i)
+    if (np_hashset_contains(set, keys[i]) != (i % 6 == 0))
+      break;
+  CU_ASSERT_EQUAL(3000, i);
+  CU_ASSERT_EQUAL(500, np_hashset_test_count(set));
+
+  /* difference */
+  CU_ASSERT_EQUAL(threes, np_hashset_difference(threes, set));
+  CU_ASSERT_EQUAL(500, threes->size);
+  for (i = 0; i < 3000; ++i)
+    if (np_hashset_contains(threes, keys[i]) != (i % 3 == 0 && i % 2 != 0))
+      break;
+  CU_ASSERT_EQUAL(3000, i);
+  CU_ASSERT_EQUAL(threes, np_hashset_difference(threes, threes));
+  CU_ASSERT_EQUAL(0, threes->size);
+  CU_ASSERT_EQUAL(0, np_hashset_test_count(threes));
+  np_hashset_free(set);
+  np_hashset_free(evens);
+  np_hashset_free(threes);
+}
@@ -22,6 +22,21 @@
 #include "np_treemap_test.h"
 #include "np_linkedlist_test.h"
 #include "np_arraylist_test.h"
+#include "np_flatmap_test.h"
+#include "np_robinhoodmap_test.h"
+#include "np_cuckoomap_test.h"
+#include "np_pool_test.h"
+#include "np_arena_test.h"
+#include "np_bloom_test.h"
+#include "np_alloc_test.h"
+#include "np_hashset_test.h"
+#include "np_btreemap_test.h"
+#include "np_lrucache_test.h"
+#include "np_hashindex_test.h"
+#include "np_concurrent_hashmap_test.h"
+#include "np_concurrent_cache_test.h"
+#include "np_epoch_test.h"
+#include "np_lockfree_hashmap_test.h"
 
 int setup(void);
 int teardown(void);
@@ -45,6 +60,79 @@ int main(void)
   if (CU_add_test(pSuite, "Hash Map Realloc Tests", np_hashmap_realloc_test) == NULL) {
     goto exit;
   }
+  if (CU_add_test(pSuite, "Hash Map Incremental Resize Tests",
+		  np_hashmap_incremental_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Hash Map Hashed Tests",
+		  np_hashmap_hashed_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Hash Map Get/Put Many Tests",
+		  np_hashmap_many_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Hash Map Hash64 Tests",
+		  np_hashmap_hash64_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Hash Map Capacity Tests",
+		  np_hashmap_capacity_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Hash Map Iterator Tests",
+		  np_hashmap_iterator_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Hash Map String Key Tests",
+		  np_hashmap_string_keys_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Hash Map Define Tests",
+		  np_hashmap_define_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Hash Map Define Aligned Tests",
+		  np_hashmap_define_aligned_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Hash Map Bloom Filter Tests",
+		  np_hashmap_bloom_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Hash Map Item Tests",
+		  np_hashmap_item_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Hash Map Stats Tests",
+		  np_hashmap_stats_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Hash Map Keyed Tests",
+		  np_hashmap_keyed_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Hash Map Alloc Policy Tests",
+		  np_hashmap_alloc_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Hash Map Parallel Tests",
+		  np_hashmap_parallel_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Hash Map Upsert Tests",
+		  np_hashmap_upsert_test) == NULL) {
+    goto exit;
+  }
+
+  /* hash set */
+  if (CU_add_test(pSuite, "Hash Set Tests", np_hashset_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Hash Set Bulk Tests",
+		  np_hashset_bulk_test) == NULL) {
+    goto exit;
+  }
 
   /* tree map */
   if (CU_add_test(pSuite, "Tree Map Tests", np_treemap_test) == NULL) {
@@ -54,6 +142,51 @@ int main(void)
 		  np_treemap_test_iterator) == NULL) {
     goto exit;
   }
+  if (CU_add_test(pSuite, "Tree Map Get Many Tests",
+		  np_treemap_test_get_many) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Tree Map Random Remove Tests",
+		  np_treemap_test_remove_random) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Tree Map Define Tests",
+		  np_treemap_test_define) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Tree Map Define Aligned Tests",
+		  np_treemap_test_define_aligned) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Tree Map Bloom Filter Tests",
+		  np_treemap_test_bloom) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Tree Map Stats Tests",
+		  np_treemap_test_stats) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Tree Map Upsert Tests",
+		  np_treemap_test_upsert) == NULL) {
+    goto exit;
+  }
+
+  /* b+tree map */
+  if (CU_add_test(pSuite, "B+Tree Map Tests", np_btreemap_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "B+Tree Map Random Tests",
+		  np_btreemap_test_random) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "B+Tree Map Free Keys Tests",
+		  np_btreemap_test_free_keys) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "B+Tree Map Iterator Tests",
+		  np_btreemap_test_iterator) == NULL) {
+    goto exit;
+  }
 
   /* linked list */
   if (CU_add_test(pSuite, "Linked List Basic Tests",
@@ -102,6 +235,157 @@ int main(void)
 		  np_arraylist_test_realloc) == NULL) {
     goto exit;
   }
+  if (CU_add_test(pSuite, "Array List Alloc Policy Tests",
+		  np_arraylist_test_alloc) == NULL) {
+    goto exit;
+  }
+
+  /* flat map */
+  if (CU_add_test(pSuite, "Flat Map Tests", np_flatmap_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Flat Map Realloc Tests",
+		  np_flatmap_realloc_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Flat Map Remove Tests",
+		  np_flatmap_remove_test) == NULL) {
+    goto exit;
+  }
+
+  /* robin hood map */
+  if (CU_add_test(pSuite, "Robin Hood Map Tests",
+		  np_robinhoodmap_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Robin Hood Map Realloc Tests",
+		  np_robinhoodmap_realloc_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Robin Hood Map Remove Tests",
+		  np_robinhoodmap_remove_test) == NULL) {
+    goto exit;
+  }
+
+  /* cuckoo map */
+  if (CU_add_test(pSuite, "Cuckoo Map Tests", np_cuckoomap_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Cuckoo Map Realloc Tests",
+		  np_cuckoomap_realloc_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Cuckoo Map Collision Tests",
+		  np_cuckoomap_collision_test) == NULL) {
+    goto exit;
+  }
+
+  /* pool */
+  if (CU_add_test(pSuite, "Pool Tests", np_pool_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Pool Reuse Tests", np_pool_test_reuse) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Pool Aligned Tests",
+		  np_pool_test_aligned) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Pool Merge Tests", np_pool_test_merge) == NULL) {
+    goto exit;
+  }
+
+  /* arena */
+  if (CU_add_test(pSuite, "Arena Tests", np_arena_test) == NULL) {
+    goto exit;
+  }
+
+  /* large array allocation */
+  if (CU_add_test(pSuite, "Alloc Policy Tests", np_alloc_test) == NULL) {
+    goto exit;
+  }
+
+  /* bloom filter */
+  if (CU_add_test(pSuite, "Bloom Filter Tests", np_bloom_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Bloom Filter Stale Tests",
+		  np_bloom_test_stale) == NULL) {
+    goto exit;
+  }
+
+  /* lru cache */
+  if (CU_add_test(pSuite, "LRU Cache Tests", np_lrucache_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "LRU Cache Sized Tests",
+		  np_lrucache_sized_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "LRU Cache CLOCK Tests",
+		  np_lrucache_clock_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "LRU Cache Realloc Tests",
+		  np_lrucache_realloc_test) == NULL) {
+    goto exit;
+  }
+
+  /* hash index */
+  if (CU_add_test(pSuite, "Hash Index Tests", np_hashindex_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Hash Index Invalid File Tests",
+		  np_hashindex_invalid_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Hash Index Corrupt Header Tests",
+		  np_hashindex_corrupt_test) == NULL) {
+    goto exit;
+  }
+
+  /* concurrent hash map */
+  if (CU_add_test(pSuite, "Concurrent Hash Map Tests",
+		  np_concurrent_hashmap_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Concurrent Hash Map Thread Tests",
+		  np_concurrent_hashmap_threads_test) == NULL) {
+    goto exit;
+  }
+
+  /* concurrent cache */
+  if (CU_add_test(pSuite, "Concurrent Cache Tests",
+		  np_concurrent_cache_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Concurrent Cache Shard Tests",
+		  np_concurrent_cache_shards_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Concurrent Cache TinyLFU Tests",
+		  np_concurrent_cache_tinylfu_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Concurrent Cache Thread Tests",
+		  np_concurrent_cache_threads_test) == NULL) {
+    goto exit;
+  }
+
+  /* epoch */
+  if (CU_add_test(pSuite, "Epoch Tests", np_epoch_test) == NULL) {
+    goto exit;
+  }
+
+  /* lock free hash map */
+  if (CU_add_test(pSuite, "Lock Free Hash Map Tests",
+		  np_lockfree_hashmap_test) == NULL) {
+    goto exit;
+  }
+  if (CU_add_test(pSuite, "Lock Free Hash Map Thread Tests",
+		  np_lockfree_hashmap_threads_test) == NULL) {
+    goto exit;
+  }
 
   CU_basic_set_mode(CU_BRM_VERBOSE);
   CU_basic_run_tests();
@@ -0,0 +1,117 @@
+/*
+ * np_lockfree_hashmap_test.c: nplib lock free read hash map tests
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <CUnit/Basic.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include "np_lockfree_hashmap_test.h"
+#include "np_lockfree_hashmap.h"
+#include "np_hashmap_test.h"
+
+#define READERS 3
+#define KEYS 5000
+
+static char keys[KEYS][16];
+
+void np_lockfree_hashmap_test(void)
+{
+  struct NpLockFreeHashMap *map;
+  struct NpEpochRecord *reader;
+  char *key = "thekey";
+  char *value = "thevalue";
+  char *value2 = "thevalue2";
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_lockfree_hashmap_new(
+			np_hashmap_test_cmp, np_hashmap_test_hash));
+  CU_ASSERT_NOT_EQUAL(NULL, reader = np_lockfree_hashmap_register(map));
+  CU_ASSERT_EQUAL(value, np_lockfree_hashmap_put(map, key, value));
+  CU_ASSERT_EQUAL(value, np_lockfree_hashmap_get(map, reader, key));
+  CU_ASSERT_EQUAL(value2, np_lockfree_hashmap_put(map, key, value2));
+  CU_ASSERT_EQUAL(1, map->size);
+  CU_ASSERT_EQUAL(value2, np_lockfree_hashmap_remove(map, key));
+  CU_ASSERT_EQUAL(NULL, np_lockfree_hashmap_get(map, reader, key));
+  CU_ASSERT_EQUAL(0, map->size);
+  np_lockfree_hashmap_unregister(reader);
+  np_lockfree_hashmap_free(map);
+}
+
+struct np_lockfree_hashmap_test_arg {
+  struct NpLockFreeHashMap *map;
+  int done;
+  int failures;
+};
+
+static void *np_lockfree_hashmap_test_reader(void *data)
+{
+  struct np_lockfree_hashmap_test_arg *arg;
+  struct NpEpochRecord *reader;
+  void *value;
+  int i;
+
+  arg = data;
+  reader = np_lockfree_hashmap_register(arg->map);
+  while (!__atomic_load_n(&arg->done, __ATOMIC_ACQUIRE)) {
+    for (i = 0; i < KEYS; ++i) {
+      value = np_lockfree_hashmap_get(arg->map, reader, keys[i]);
+      if (value != NULL && value != keys[i])
+	arg->failures++;
+    }
+  }
+  np_lockfree_hashmap_unregister(reader);
+  return NULL;
+}
+
+void np_lockfree_hashmap_threads_test(void)
+{
+  struct NpLockFreeHashMap *map;
+  struct np_lockfree_hashmap_test_arg args[READERS];
+  pthread_t threads[READERS];
+  int round;
+  int t;
+  int i;
+
+  for (i = 0; i < KEYS; ++i)
+    snprintf(keys[i], sizeof keys[i], "key %d", i);
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_lockfree_hashmap_new(
+			np_hashmap_test_cmp, np_hashmap_test_hash));
+  for (t = 0; t < READERS; ++t) {
+    args[t].map = map;
+    args[t].done = 0;
+    args[t].failures = 0;
+    pthread_create(&threads[t], NULL, np_lockfree_hashmap_test_reader,
+		   &args[t]);
+  }
+
+  /* grow through several resizes and churn while readers run */
+  for (round = 0; round < 3; ++round) {
+    for (i = 0; i < KEYS; ++i)
+      CU_ASSERT_EQUAL(keys[i], np_lockfree_hashmap_put(map, keys[i], keys[i]));
+    for (i = 0; i < KEYS; i += 2)
+      CU_ASSERT_EQUAL(keys[i], np_lockfree_hashmap_remove(map, keys[i]));
+  }
+  for (t = 0; t < READERS; ++t) {
+    __atomic_store_n(&args[t].done, 1, __ATOMIC_RELEASE);
+    pthread_join(threads[t], NULL);
+    CU_ASSERT_EQUAL(0, args[t].failures);
+  }
+  CU_ASSERT_EQUAL(KEYS / 2, map->size);
+  np_lockfree_hashmap_free(map);
+}
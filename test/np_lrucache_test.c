@@ -0,0 +1,199 @@
+/*
+ * np_lrucache_test.c: nplib bounded LRU cache tests
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <CUnit/Basic.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "np_lrucache_test.h"
+#include "np_lrucache.h"
+#include "np_hashmap.h"
+
+static char *np_lrucache_test_evicted[8];
+static unsigned np_lrucache_test_evicted_count;
+
+static void np_lrucache_test_evict(void *key, void *value)
+{
+  (void)value;
+  if (np_lrucache_test_evicted_count < 8)
+    np_lrucache_test_evicted[np_lrucache_test_evicted_count] = key;
+  np_lrucache_test_evicted_count++;
+}
+
+void np_lrucache_test(void)
+{
+  struct NpLruCache *cache;
+  char *keys[] = {"a", "b", "c", "d", "e"};
+
+  CU_ASSERT_NOT_EQUAL(NULL, cache = np_lrucache_new(np_lrucache_test_cmp,
+						    np_lrucache_test_hash, 3));
+  np_lrucache_set_evict(cache, np_lrucache_test_evict);
+  np_lrucache_test_evicted_count = 0;
+  CU_ASSERT_EQUAL(keys[0], np_lrucache_put(cache, keys[0], keys[0]));
+  CU_ASSERT_EQUAL(keys[1], np_lrucache_put(cache, keys[1], keys[1]));
+  CU_ASSERT_EQUAL(keys[2], np_lrucache_put(cache, keys[2], keys[2]));
+  CU_ASSERT_EQUAL(3, np_lrucache_size(cache));
+  CU_ASSERT_EQUAL(3, cache->used);
+
+  /* a hit makes "a" the most recently used, so "b" is evicted */
+  CU_ASSERT_EQUAL(keys[0], np_lrucache_get(cache, "a"));
+  CU_ASSERT_EQUAL(keys[3], np_lrucache_put(cache, keys[3], keys[3]));
+  CU_ASSERT_EQUAL(1, np_lrucache_test_evicted_count);
+  CU_ASSERT_EQUAL(keys[1], np_lrucache_test_evicted[0]);
+  CU_ASSERT_EQUAL(NULL, np_lrucache_get(cache, "b"));
+  CU_ASSERT_EQUAL(3, np_lrucache_size(cache));
+
+  /* replacing a value refreshes the entry without evicting */
+  CU_ASSERT_EQUAL(keys[4], np_lrucache_put(cache, keys[2], keys[4]));
+  CU_ASSERT_EQUAL(1, np_lrucache_test_evicted_count);
+  CU_ASSERT_EQUAL(keys[4], np_lrucache_get(cache, "c"));
+  CU_ASSERT_EQUAL(keys[4], np_lrucache_put(cache, keys[4], keys[4]));
+  CU_ASSERT_EQUAL(2, np_lrucache_test_evicted_count);
+  CU_ASSERT_EQUAL(keys[0], np_lrucache_test_evicted[1]);
+
+  /* removal does not call the eviction callback */
+  CU_ASSERT_EQUAL(keys[3], np_lrucache_remove(cache, "d"));
+  CU_ASSERT_EQUAL(NULL, np_lrucache_remove(cache, "d"));
+  CU_ASSERT_EQUAL(2, np_lrucache_size(cache));
+  CU_ASSERT_EQUAL(2, cache->used);
+  CU_ASSERT_EQUAL(2, np_lrucache_test_evicted_count);
+  CU_ASSERT_EQUAL(2, cache->evictions);
+  CU_ASSERT_EQUAL(2, cache->hits);
+  CU_ASSERT_EQUAL(1, cache->misses);
+  np_lrucache_free(cache);
+}
+
+void np_lrucache_sized_test(void)
+{
+  struct NpLruCache *cache;
+  char *keys[] = {"a", "b", "c", "d"};
+
+  CU_ASSERT_NOT_EQUAL(NULL, cache = np_lrucache_new(np_lrucache_test_cmp,
+						    np_lrucache_test_hash,
+						    100));
+  np_lrucache_set_evict(cache, np_lrucache_test_evict);
+  np_lrucache_test_evicted_count = 0;
+  CU_ASSERT_EQUAL(NULL, np_lrucache_put_sized(cache, keys[0], keys[0], 101));
+  CU_ASSERT_EQUAL(keys[0], np_lrucache_put_sized(cache, keys[0], keys[0], 40));
+  CU_ASSERT_EQUAL(keys[1], np_lrucache_put_sized(cache, keys[1], keys[1], 40));
+  CU_ASSERT_EQUAL(keys[2], np_lrucache_put_sized(cache, keys[2], keys[2], 20));
+  CU_ASSERT_EQUAL(100, cache->used);
+  CU_ASSERT_EQUAL(0, np_lrucache_test_evicted_count);
+
+  /* one large entry evicts the two oldest */
+  CU_ASSERT_EQUAL(keys[3], np_lrucache_put_sized(cache, keys[3], keys[3], 70));
+  CU_ASSERT_EQUAL(2, np_lrucache_test_evicted_count);
+  CU_ASSERT_EQUAL(keys[0], np_lrucache_test_evicted[0]);
+  CU_ASSERT_EQUAL(keys[1], np_lrucache_test_evicted[1]);
+  CU_ASSERT_EQUAL(90, cache->used);
+
+  /* growing an entry evicts others but never the entry itself */
+  CU_ASSERT_EQUAL(keys[3], np_lrucache_put_sized(cache, keys[3], keys[3],
+						 100));
+  CU_ASSERT_EQUAL(1, np_lrucache_size(cache));
+  CU_ASSERT_EQUAL(100, cache->used);
+  CU_ASSERT_EQUAL(keys[3], np_lrucache_get(cache, "d"));
+  np_lrucache_free(cache);
+}
+
+void np_lrucache_clock_test(void)
+{
+  struct NpLruCache *cache;
+  char *keys[] = {"a", "b", "c", "d", "e"};
+
+  CU_ASSERT_NOT_EQUAL(NULL, cache = np_lrucache_new(np_lrucache_test_cmp,
+						    np_lrucache_test_hash, 3));
+  np_lrucache_set_policy(cache, NP_LRUCACHE_CLOCK);
+  np_lrucache_set_evict(cache, np_lrucache_test_evict);
+  np_lrucache_test_evicted_count = 0;
+  np_lrucache_put(cache, keys[0], keys[0]);
+  np_lrucache_put(cache, keys[1], keys[1]);
+  np_lrucache_put(cache, keys[2], keys[2]);
+
+  /* a hit only sets the referenced flag; the hand stays on "a" */
+  CU_ASSERT_EQUAL(keys[0], np_lrucache_get(cache, "a"));
+  CU_ASSERT_EQUAL(keys[0], cache->hand->item.key);
+
+  /* "a" gets a second chance and "b" is evicted */
+  CU_ASSERT_EQUAL(keys[3], np_lrucache_put(cache, keys[3], keys[3]));
+  CU_ASSERT_EQUAL(1, np_lrucache_test_evicted_count);
+  CU_ASSERT_EQUAL(keys[1], np_lrucache_test_evicted[0]);
+
+  /* with every entry referenced the hand goes round once */
+  np_lrucache_get(cache, "a");
+  np_lrucache_get(cache, "c");
+  np_lrucache_get(cache, "d");
+  CU_ASSERT_EQUAL(keys[4], np_lrucache_put(cache, keys[4], keys[4]));
+  CU_ASSERT_EQUAL(2, np_lrucache_test_evicted_count);
+  CU_ASSERT_EQUAL(keys[2], np_lrucache_test_evicted[1]);
+  CU_ASSERT_EQUAL(3, np_lrucache_size(cache));
+  np_lrucache_free(cache);
+}
+
+void np_lrucache_realloc_test(void)
+{
+  struct NpLruCache *cache;
+  char **keys;
+  unsigned i;
+  unsigned size;
+  unsigned found;
+
+  CU_ASSERT_NOT_EQUAL(NULL, cache = np_lrucache_new(np_lrucache_test_cmp,
+						    np_lrucache_test_hash,
+						    5000));
+  np_lrucache_set_evict(cache, NULL);
+  size = 20000;
+  keys = malloc(sizeof *keys * size);
+  for (i = 0; i < size; ++i) {
+    keys[i] = malloc(16);
+    snprintf(keys[i], 16, "key %u", i);
+    CU_ASSERT_EQUAL(keys[i], np_lrucache_put(cache, keys[i], keys[i]));
+    CU_ASSERT_EQUAL(keys[0], np_lrucache_get(cache, keys[0]));
+  }
+  CU_ASSERT_EQUAL(5000, np_lrucache_size(cache));
+  CU_ASSERT_EQUAL(15000, cache->evictions);
+  CU_ASSERT_EQUAL(size, cache->hits);
+
+  /* the key hit after every put and the most recent puts are cached */
+  for (i = 0, found = 0; i < size; ++i)
+    if (np_lrucache_get(cache, keys[i]) != NULL) {
+      CU_ASSERT(i == 0 || i > size - 5000);
+      found++;
+    }
+  CU_ASSERT_EQUAL(5000, found);
+  for (i = 0; i < size; ++i) {
+    np_lrucache_remove(cache, keys[i]);
+    free(keys[i]);
+  }
+  CU_ASSERT_EQUAL(0, np_lrucache_size(cache));
+  CU_ASSERT_EQUAL(NULL, cache->hand);
+  free(keys);
+  np_lrucache_free(cache);
+}
+
+int np_lrucache_test_cmp(void *key1, void *key2)
+{
+  return strcmp(key1, key2);
+}
+
+unsigned np_lrucache_test_hash(void *key)
+{
+  int length = strlen(key);
+  return np_hashmap_hash(key, length);
+}
@@ -0,0 +1,29 @@
+/*
+ * np_lrucache_test.h: nplib bounded LRU cache test header
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NP_LRUCACHE_TEST_H
+#define __NP_LRUCACHE_TEST_H
+
+void np_lrucache_test(void);
+void np_lrucache_sized_test(void);
+void np_lrucache_clock_test(void);
+void np_lrucache_realloc_test(void);
+int np_lrucache_test_cmp(void *, void *);
+unsigned np_lrucache_test_hash(void *);
+
+#endif
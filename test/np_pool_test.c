@@ -0,0 +1,121 @@
+/*
+ * np_pool_test.c: nplib slab pool tests
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <CUnit/Basic.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "np_pool_test.h"
+#include "np_pool.h"
+
+void np_pool_test(void)
+{
+  struct NpPool *pool;
+  char *items[1000];
+  int i;
+
+  CU_ASSERT_NOT_EQUAL(NULL, pool = np_pool_new(20));
+  CU_ASSERT_EQUAL(24, pool->item_size);
+  for (i = 0; i < 1000; ++i) {
+    CU_ASSERT_NOT_EQUAL(NULL, items[i] = np_pool_alloc(pool));
+    CU_ASSERT_EQUAL(0, (uintptr_t)items[i] % NP_POOL_ALIGNMENT);
+    memset(items[i], i & 0xff, 20);
+  }
+
+  /* items of the first slab are contiguous */
+  for (i = 1; i < NP_POOL_MIN_SLAB_ITEMS; ++i)
+    CU_ASSERT_EQUAL(items[i - 1] + pool->item_size, items[i]);
+  for (i = 0; i < 1000; ++i)
+    CU_ASSERT_EQUAL((char)(i & 0xff), items[i][19]);
+  np_pool_free(pool);
+}
+
+void np_pool_test_reuse(void)
+{
+  struct NpPool *pool;
+  void *item1;
+  void *item2;
+
+  CU_ASSERT_NOT_EQUAL(NULL, pool = np_pool_new(1));
+  CU_ASSERT_EQUAL(sizeof(void *), pool->item_size);
+  CU_ASSERT_NOT_EQUAL(NULL, item1 = np_pool_alloc(pool));
+  CU_ASSERT_NOT_EQUAL(NULL, item2 = np_pool_alloc(pool));
+  CU_ASSERT_NOT_EQUAL(item1, item2);
+
+  /* released items are handed out again, most recent first */
+  np_pool_release(pool, item1);
+  np_pool_release(pool, item2);
+  CU_ASSERT_EQUAL(item2, np_pool_alloc(pool));
+  CU_ASSERT_EQUAL(item1, np_pool_alloc(pool));
+  CU_ASSERT_NOT_EQUAL(item1, np_pool_alloc(pool));
+  np_pool_free(pool);
+}
+
+void np_pool_test_aligned(void)
+{
+  struct NpPool *pool;
+  void *item;
+  int i;
+
+  CU_ASSERT_NOT_EQUAL(NULL, pool = np_pool_new_aligned(24, 64));
+  CU_ASSERT_EQUAL(64, pool->item_size);
+  for (i = 0; i < 1000; ++i) {
+    CU_ASSERT_NOT_EQUAL(NULL, item = np_pool_alloc(pool));
+    CU_ASSERT_EQUAL(0, (uintptr_t)item % 64);
+  }
+
+  /* smaller alignments are raised to the pool's least alignment */
+  np_pool_release(pool, item);
+  CU_ASSERT_EQUAL(item, np_pool_alloc(pool));
+  np_pool_free(pool);
+  CU_ASSERT_NOT_EQUAL(NULL, pool = np_pool_new_aligned(12, 1));
+  CU_ASSERT_EQUAL(NP_POOL_ALIGNMENT, pool->alignment);
+  CU_ASSERT_EQUAL(16, pool->item_size);
+  np_pool_free(pool);
+}
+
+void np_pool_test_merge(void)
+{
+  struct NpPool *pool;
+  struct NpPool *other;
+  char *items[40];
+  size_t bytes;
+  int i;
+
+  CU_ASSERT_NOT_EQUAL(NULL, pool = np_pool_new(16));
+  CU_ASSERT_NOT_EQUAL(NULL, other = np_pool_new(16));
+  CU_ASSERT_NOT_EQUAL(NULL, np_pool_alloc(pool));
+  for (i = 0; i < 40; ++i) {
+    CU_ASSERT_NOT_EQUAL(NULL, items[i] = np_pool_alloc(other));
+    memset(items[i], i, 16);
+  }
+  np_pool_release(other, items[0]);
+
+  /* merged items stay valid and unused space is reused before new slabs */
+  bytes = pool->bytes + other->bytes;
+  np_pool_merge(pool, other);
+  CU_ASSERT_EQUAL(bytes, pool->bytes);
+  for (i = 1; i < 40; ++i)
+    CU_ASSERT_EQUAL((char)i, items[i][15]);
+  for (i = 0; i < 1 + 3 * NP_POOL_MIN_SLAB_ITEMS - 40 + 31; ++i)
+    CU_ASSERT_NOT_EQUAL(NULL, np_pool_alloc(pool));
+  CU_ASSERT_EQUAL(bytes, pool->bytes);
+  CU_ASSERT_NOT_EQUAL(NULL, np_pool_alloc(pool));
+  CU_ASSERT(pool->bytes > bytes);
+  np_pool_free(pool);
+}
@@ -0,0 +1,156 @@
+/*
+ * np_robinhoodmap_test.c: nplib Robin Hood hash map tests
+ *
+ * Copyright 2012 Jeremy Raymond
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <CUnit/Basic.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "np_robinhoodmap_test.h"
+#include "np_robinhoodmap.h"
+#include "np_hashmap.h"
+
+/*
+ * Checks that every item can be reached from its home slot without passing
+ * an empty slot and that the item distances match their positions.
+ */
+static int np_robinhoodmap_test_check(struct NpRobinHoodMap *map)
+{
+  struct NpRobinHoodMapSlot *slot;
+  unsigned i;
+  unsigned j;
+  unsigned size;
+
+  size = 0;
+  for (i = 0; i < map->capacity; ++i) {
+    slot = map->slots + i;
+    if (slot->distance == 0)
+      continue;
+    size++;
+    j = (i - (slot->distance - 1)) & (map->capacity - 1);
+    if (j != (unsigned)(slot->hash * 2654435769u) >> map->shift)
+      return 0;
+    for (; j != i; j = (j + 1) & (map->capacity - 1))
+      if (map->slots[j].distance == 0)
+	return 0;
+  }
+  return size == map->size;
+}
+
+void np_robinhoodmap_test(void)
+{
+  struct NpRobinHoodMap *map;
+  char *key = "thekey";
+  char *value = "thevalue";
+  char *value2 = "thevalue2";
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_robinhoodmap_new(
+			np_robinhoodmap_test_cmp, np_robinhoodmap_test_hash));
+  CU_ASSERT_EQUAL(0, map->size);
+  CU_ASSERT_STRING_EQUAL(value, np_robinhoodmap_put(map, key, value));
+  CU_ASSERT_EQUAL(1, map->size);
+  CU_ASSERT_STRING_EQUAL(value, np_robinhoodmap_get(map, key));
+  CU_ASSERT_EQUAL(1, map->size);
+  CU_ASSERT_STRING_EQUAL(value2, np_robinhoodmap_put(map, key, value2));
+  CU_ASSERT_EQUAL(1, map->size);
+  CU_ASSERT_STRING_EQUAL(value2, np_robinhoodmap_remove(map, key));
+  CU_ASSERT_EQUAL(0, map->size);
+  CU_ASSERT_EQUAL(NULL, np_robinhoodmap_get(map, key));
+  CU_ASSERT_EQUAL(NULL, np_robinhoodmap_remove(map, key));
+  np_robinhoodmap_free(map);
+}
+
+void np_robinhoodmap_realloc_test(void)
+{
+  struct NpRobinHoodMap *map;
+  char **keys;
+  unsigned i;
+  unsigned size;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_robinhoodmap_new(
+			np_robinhoodmap_test_cmp, np_robinhoodmap_test_hash));
+  CU_ASSERT_EQUAL(NULL, np_robinhoodmap_set_load_factor(map, 1));
+  CU_ASSERT_EQUAL(map, np_robinhoodmap_set_load_factor(map, 0.95));
+  size = 15000;
+  keys = malloc(sizeof *keys * size);
+  for (i = 0; i < size; ++i) {
+    keys[i] = malloc(BUFSIZ);
+    snprintf(keys[i], BUFSIZ, "key %d", i);
+    CU_ASSERT_EQUAL(keys[i], np_robinhoodmap_put(map, keys[i], keys[i]));
+  }
+
+  /* 15000 items fit in 16384 slots at a load factor of 0.95 */
+  CU_ASSERT_EQUAL(size, map->size);
+  CU_ASSERT_EQUAL(16384, map->capacity);
+  CU_ASSERT(np_robinhoodmap_test_check(map));
+  for (i = 0; i < size; ++i)
+    CU_ASSERT_EQUAL(keys[i], np_robinhoodmap_get(map, keys[i]));
+  for (i = 0; i < size; ++i) {
+    CU_ASSERT_EQUAL(keys[i], np_robinhoodmap_remove(map, keys[i]));
+    free(keys[i]);
+  }
+  CU_ASSERT_EQUAL(0, map->size);
+  free(keys);
+  np_robinhoodmap_free(map);
+}
+
+void np_robinhoodmap_remove_test(void)
+{
+  struct NpRobinHoodMap *map;
+  char keys[2000][16];
+  char present[2000];
+  unsigned x;
+  unsigned i;
+  unsigned k;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_robinhoodmap_new(
+			np_robinhoodmap_test_cmp, np_robinhoodmap_test_hash));
+  memset(present, 0, sizeof present);
+  for (i = 0; i < 2000; ++i)
+    snprintf(keys[i], sizeof keys[i], "key %d", i);
+
+  /* backward shift deletion keeps every remaining item reachable */
+  for (i = 0, x = 1; i < 50000; ++i) {
+    x = x * 1103515245 + 12345;
+    k = (x >> 8) % 2000;
+    if (x & 0x80) {
+      CU_ASSERT_EQUAL(keys[k], np_robinhoodmap_put(map, keys[k], keys[k]));
+      present[k] = 1;
+    } else {
+      CU_ASSERT_EQUAL(present[k] ? keys[k] : NULL,
+		      np_robinhoodmap_remove(map, keys[k]));
+      present[k] = 0;
+    }
+  }
+  CU_ASSERT(np_robinhoodmap_test_check(map));
+  for (i = 0; i < 2000; ++i)
+    CU_ASSERT_EQUAL(present[i] ? keys[i] : NULL,
+		    np_robinhoodmap_get(map, keys[i]));
+  np_robinhoodmap_free(map);
+}
+
+int np_robinhoodmap_test_cmp(void *key1, void *key2)
+{
+  return strcmp(key1, key2);
+}
+
+unsigned np_robinhoodmap_test_hash(void *key)
+{
+  int length = strlen(key);
+  return np_hashmap_hash(key, length);
+}
@@ -17,10 +17,48 @@
  */
 
 #include <CUnit/Basic.h>
+#include <stdint.h>
 #include <string.h>
+#include <stdio.h>
 
 #include "np_treemap_test.h"
 #include "np_treemap.h"
+#include "np_treemap_define.h"
+#include "np_hashmap.h"
+#include "np_bloom.h"
+
+#define NP_TREEMAP_TEST_CMP(key1, key2) ((key1) < (key2) ? -1 : (key1) > (key2))
+
+NP_TREEMAP_DEFINE(np_treemap_test_intmap, int, double, NP_TREEMAP_TEST_CMP);
+NP_TREEMAP_DEFINE(np_treemap_test_ldmap, int, long double,
+		  NP_TREEMAP_TEST_CMP);
+
+struct np_treemap_test_ldalign {
+  char c;
+  long double value;
+};
+
+/*
+ * Checks the red/black properties of a subtree, returning its black height
+ * or -1 if they do not hold.
+ */
+static int np_treemap_test_black_height(struct NpTreeMap *map,
+					struct NpTreeMapNode *node)
+{
+  int left;
+  int right;
+
+  if (node == &map->nil)
+    return 1;
+  if (node->color == RED
+      && (node->left->color == RED || node->right->color == RED))
+    return -1;
+  left = np_treemap_test_black_height(map, node->left);
+  right = np_treemap_test_black_height(map, node->right);
+  if (left < 0 || left != right)
+    return -1;
+  return left + (node->color == BLACK);
+}
 
 void np_treemap_test(void)
 {
@@ -90,6 +128,240 @@ void np_treemap_test_iterator(void)
 
 }
 
+void np_treemap_test_get_many(void)
+{
+  struct NpTreeMap *map;
+  char keys[100][16];
+  void *key_ptrs[100];
+  void *values[100];
+  unsigned i;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_treemap_new(np_treemap_test_cmp));
+  for (i = 0; i < 100; ++i) {
+    snprintf(keys[i], sizeof keys[i], "key %d", i);
+    key_ptrs[i] = keys[i];
+    if (i % 3 != 0)
+      CU_ASSERT_EQUAL(keys[i], np_treemap_put(map, keys[i], keys[i]));
+  }
+  CU_ASSERT_EQUAL(66, np_treemap_get_many(map, key_ptrs, values, 100));
+  for (i = 0; i < 100; ++i)
+    CU_ASSERT_EQUAL(i % 3 != 0 ? keys[i] : NULL, values[i]);
+  np_treemap_free(map);
+}
+
+void np_treemap_test_remove_random(void)
+{
+  struct NpTreeMap *map;
+  char keys[2000][16];
+  char present[2000];
+  unsigned x;
+  unsigned i;
+  unsigned k;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_treemap_new(np_treemap_test_cmp));
+  memset(present, 0, sizeof present);
+  for (i = 0; i < 2000; ++i)
+    snprintf(keys[i], sizeof keys[i], "key %d", i);
+  for (i = 0, x = 1; i < 20000; ++i) {
+    x = x * 1103515245 + 12345;
+    k = (x >> 8) % 2000;
+    if (x & 0x80) {
+      CU_ASSERT_EQUAL(keys[k], np_treemap_put(map, keys[k], keys[k]));
+      present[k] = 1;
+    } else {
+      CU_ASSERT_EQUAL(present[k] ? keys[k] : NULL,
+		      np_treemap_remove(map, keys[k]));
+      present[k] = 0;
+    }
+  }
+  CU_ASSERT(np_treemap_test_black_height(map, map->root.left) > 0);
+  CU_ASSERT_EQUAL(BLACK, map->nil.color);
+  for (i = 0; i < 2000; ++i)
+    CU_ASSERT_EQUAL(present[i] ? keys[i] : NULL, np_treemap_get(map, keys[i]));
+  np_treemap_free(map);
+}
+
+void np_treemap_test_define(void)
+{
+  struct np_treemap_test_intmap *map;
+  char present[2000];
+  double value;
+  unsigned x;
+  unsigned i;
+  int k;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_treemap_test_intmap_new());
+  memset(present, 0, sizeof present);
+  for (i = 0, x = 1; i < 20000; ++i) {
+    x = x * 1103515245 + 12345;
+    k = (x >> 8) % 2000;
+    if (x & 0x80) {
+      CU_ASSERT_EQUAL(k / 2.0, *np_treemap_test_intmap_put(map, k, k / 2.0));
+      present[k] = 1;
+    } else {
+      CU_ASSERT_EQUAL(present[k],
+		      np_treemap_test_intmap_remove(map, k, &value));
+      if (present[k]) {
+	CU_ASSERT_EQUAL(k / 2.0, value);
+      }
+      present[k] = 0;
+    }
+  }
+  for (i = 0, x = 0; i < 2000; ++i) {
+    if (present[i]) {
+      CU_ASSERT_EQUAL(i / 2.0, *np_treemap_test_intmap_get(map, i));
+      x++;
+    } else {
+      CU_ASSERT_EQUAL(NULL, np_treemap_test_intmap_get(map, i));
+    }
+  }
+  CU_ASSERT_EQUAL(x, map->size);
+  CU_ASSERT_EQUAL(BLACK, map->root.left->color);
+  np_treemap_test_intmap_free(map);
+}
+
+void np_treemap_test_define_aligned(void)
+{
+  struct np_treemap_test_ldmap *map;
+  long double *stored;
+  int i;
+
+  /* over-aligned values are stored aligned */
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_treemap_test_ldmap_new());
+  for (i = 0; i < 1000; ++i) {
+    CU_ASSERT_NOT_EQUAL(NULL, stored = np_treemap_test_ldmap_put(map, i,
+								 i / 4.0L));
+    CU_ASSERT_EQUAL(0, (uintptr_t)stored
+		    % offsetof(struct np_treemap_test_ldalign, value));
+  }
+  CU_ASSERT_EQUAL(7 / 4.0L, *np_treemap_test_ldmap_get(map, 7));
+  np_treemap_test_ldmap_free(map);
+}
+
+static unsigned np_treemap_test_hash(void *key)
+{
+  return np_hashmap_hash(key, strlen(key));
+}
+
+void np_treemap_test_bloom(void)
+{
+  struct NpTreeMap *map;
+  char keys[2000][16];
+  void *key_ptrs[2000];
+  void *values[2000];
+  unsigned i;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_treemap_new(np_treemap_test_cmp));
+  for (i = 0; i < 2000; ++i) {
+    snprintf(keys[i], sizeof keys[i], "key %d", i);
+    key_ptrs[i] = keys[i];
+  }
+  for (i = 0; i < 500; ++i)
+    CU_ASSERT_EQUAL(keys[i], np_treemap_put(map, keys[i], keys[i]));
+  CU_ASSERT_EQUAL(map, np_treemap_attach_bloom(map, np_treemap_test_hash));
+  CU_ASSERT_EQUAL(500, map->bloom->items);
+  for (i = 500; i < 1000; ++i)
+    CU_ASSERT_EQUAL(keys[i], np_treemap_put(map, keys[i], keys[i]));
+  CU_ASSERT(map->bloom->capacity >= 1000);
+  for (i = 0; i < 2000; ++i)
+    CU_ASSERT_EQUAL(i < 1000 ? keys[i] : NULL, np_treemap_get(map, keys[i]));
+  CU_ASSERT(map->bloom->rejected > 900);
+  CU_ASSERT(np_bloom_false_positive_rate(map->bloom) < 0.1);
+  CU_ASSERT_EQUAL(1000, np_treemap_get_many(map, key_ptrs, values, 2000));
+  for (i = 0; i < 2000; ++i)
+    CU_ASSERT_EQUAL(i < 1000 ? keys[i] : NULL, values[i]);
+
+  /* removing most keys rebuilds the filter */
+  for (i = 0; i < 900; ++i)
+    CU_ASSERT_EQUAL(keys[i], np_treemap_remove(map, keys[i]));
+  CU_ASSERT(map->bloom->removed < 900);
+  for (i = 0; i < 2000; ++i)
+    CU_ASSERT_EQUAL(i >= 900 && i < 1000 ? keys[i] : NULL,
+		    np_treemap_get(map, keys[i]));
+  np_treemap_detach_bloom(map);
+  CU_ASSERT_EQUAL(NULL, map->bloom);
+  np_treemap_free(map);
+}
+
+void np_treemap_test_stats(void)
+{
+  struct NpTreeMap *map;
+  struct NpTreeMapStats stats;
+  char keys[1023][16];
+  unsigned i;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_treemap_new(np_treemap_test_cmp));
+  np_treemap_stats(map, &stats);
+  CU_ASSERT_EQUAL(0, stats.size);
+  CU_ASSERT_EQUAL(0, stats.height);
+  CU_ASSERT_EQUAL(0, stats.black_height);
+  for (i = 0; i < 1023; ++i) {
+    snprintf(keys[i], sizeof keys[i], "key %04d", i);
+    np_treemap_put(map, keys[i], keys[i]);
+  }
+
+  /* sorted inserts still give a tree of logarithmic height */
+  np_treemap_stats(map, &stats);
+  CU_ASSERT_EQUAL(1023, stats.size);
+  CU_ASSERT(stats.height >= 10 && stats.height <= 20);
+  /* the checker also counts the black nil leaf */
+  CU_ASSERT_EQUAL(np_treemap_test_black_height(map, map->root.left),
+		  (int)stats.black_height + 1);
+  CU_ASSERT(stats.height <= 2 * stats.black_height);
+  CU_ASSERT(stats.bytes > 1023 * sizeof(struct NpTreeMapNode));
+  np_treemap_free(map);
+}
+
+static void *np_treemap_test_add(void *key, void *value, void *arg)
+{
+  (void)key;
+  return (void *)((uintptr_t)value + (uintptr_t)arg);
+}
+
+void np_treemap_test_upsert(void)
+{
+  struct NpTreeMap *map;
+  struct NpTreeMapStats stats;
+  char keys[500][16];
+  char *other = "other";
+  void **slot;
+  unsigned i;
+  int inserted;
+
+  CU_ASSERT_NOT_EQUAL(NULL, map = np_treemap_new(np_treemap_test_cmp));
+  for (i = 0; i < 500; ++i)
+    snprintf(keys[i], sizeof keys[i], "key %04u", i);
+
+  /* put if absent keeps the first value */
+  CU_ASSERT_EQUAL(keys[0], np_treemap_put_if_absent(map, keys[0], keys[0]));
+  CU_ASSERT_EQUAL(keys[0], np_treemap_put_if_absent(map, keys[0], other));
+  CU_ASSERT_EQUAL(keys[0], np_treemap_get(map, keys[0]));
+  CU_ASSERT_EQUAL(keys[0], np_treemap_remove(map, keys[0]));
+
+  /* count keys i % 100 through their slots */
+  for (i = 0; i < 500; ++i) {
+    CU_ASSERT_NOT_EQUAL(NULL, slot = np_treemap_get_or_insert(
+			  map, keys[i % 100], &inserted));
+    CU_ASSERT_EQUAL(i < 100, inserted);
+    *slot = (void *)((uintptr_t)*slot + 1);
+  }
+  np_treemap_stats(map, &stats);
+  CU_ASSERT_EQUAL(100, stats.size);
+  CU_ASSERT(np_treemap_test_black_height(map, map->root.left) > 0);
+  for (i = 0; i < 100; ++i)
+    CU_ASSERT_EQUAL((void *)5, np_treemap_get(map, keys[i]));
+
+  /* compute sees NULL for absent keys and the value for present ones */
+  for (i = 0; i < 200; ++i)
+    np_treemap_compute(map, keys[i], np_treemap_test_add, (void *)2);
+  np_treemap_stats(map, &stats);
+  CU_ASSERT_EQUAL(200, stats.size);
+  CU_ASSERT_EQUAL((void *)7, np_treemap_get(map, keys[99]));
+  CU_ASSERT_EQUAL((void *)2, np_treemap_get(map, keys[100]));
+  CU_ASSERT(np_treemap_test_black_height(map, map->root.left) > 0);
+  np_treemap_free(map);
+}
+
 int np_treemap_test_cmp(void *key1, void *key2)
 {
   return strcmp(key1, key2);
@@ -22,5 +22,12 @@
 int np_treemap_test_cmp(void *, void*);
 void np_treemap_test(void);
 void np_treemap_test_iterator(void);
+void np_treemap_test_get_many(void);
+void np_treemap_test_remove_random(void);
+void np_treemap_test_define(void);
+void np_treemap_test_define_aligned(void);
+void np_treemap_test_bloom(void);
+void np_treemap_test_stats(void);
+void np_treemap_test_upsert(void);
 
 #endif